@@ -25,6 +25,17 @@ const QString WS_LOG_API_RESPONSE = WS_PREFIX + "log-api-response";
 const QString WS_WG_VERBOSE_LOGGING = WS_PREFIX + "wireguard-verbose-logging";
 const QString WS_SCREEN_TRANSITION_HOTKEYS = WS_PREFIX + "screen-transition-hotkeys";
 const QString WS_USE_ICMP_PINGS = WS_PREFIX + "use-icmp-pings";
+const QString WS_DNS_SHARED_CHANNEL = WS_PREFIX + "dns-shared-channel";
+const QString WS_PING_STATISTICS = WS_PREFIX + "ping-statistics";
+const QString WS_PING_SCORE_JITTER_WEIGHT = WS_PREFIX + "ping-score-jitter-weight";
+const QString WS_PING_SCORE_LOSS_WEIGHT = WS_PREFIX + "ping-score-loss-weight";
+const QString WS_FAILOVER_HEDGE_DELAY = WS_PREFIX + "failover-hedge-delay";
+const QString WS_CURL_EVENT_LOOP = WS_PREFIX + "curl-event-loop";
+const QString WS_LOG_REQUEST_TIMINGS = WS_PREFIX + "log-request-timings";
+const QString WS_DNS_HONOR_TTL = WS_PREFIX + "dns-honor-ttl";
+const QString WS_HAPPY_EYEBALLS = WS_PREFIX + "happy-eyeballs";
+const QString WS_DNS_CACHE_SNAPSHOT = WS_PREFIX + "dns-cache-snapshot";
+const QString WS_DNS_OVER_HTTPS = WS_PREFIX + "dns-over-https";
 
 void ExtraConfig::writeConfig(const QString &cfg)
 {
@@ -227,6 +238,76 @@ bool ExtraConfig::getUseICMPPings()
     return getFlagFromExtraConfigLines(WS_USE_ICMP_PINGS);
 }
 
+bool ExtraConfig::getUseDnsSharedChannel()
+{
+    return getFlagFromExtraConfigLines(WS_DNS_SHARED_CHANNEL);
+}
+
+bool ExtraConfig::getUseCurlEventLoop()
+{
+    return getFlagFromExtraConfigLines(WS_CURL_EVENT_LOOP);
+}
+
+bool ExtraConfig::getLogRequestTimings()
+{
+    return getFlagFromExtraConfigLines(WS_LOG_REQUEST_TIMINGS);
+}
+
+bool ExtraConfig::getDnsHonorTtl()
+{
+    return getFlagFromExtraConfigLines(WS_DNS_HONOR_TTL);
+}
+
+bool ExtraConfig::getHappyEyeballs()
+{
+    return getFlagFromExtraConfigLines(WS_HAPPY_EYEBALLS);
+}
+
+bool ExtraConfig::getDnsCacheSnapshot()
+{
+    return getFlagFromExtraConfigLines(WS_DNS_CACHE_SNAPSHOT);
+}
+
+QString ExtraConfig::getDnsOverHttpsUpstreams()
+{
+    return getStringFromExtraConfigLines(WS_DNS_OVER_HTTPS);
+}
+
+bool ExtraConfig::getUsePingStatistics()
+{
+    return getFlagFromExtraConfigLines(WS_PING_STATISTICS);
+}
+
+int ExtraConfig::getPingScoreJitterWeight(bool &success)
+{
+    int weight = getIntFromExtraConfigLines(WS_PING_SCORE_JITTER_WEIGHT, success);
+    if (success && weight < 0) {
+        weight = 0;
+    }
+
+    return weight;
+}
+
+int ExtraConfig::getPingScoreLossWeight(bool &success)
+{
+    int weight = getIntFromExtraConfigLines(WS_PING_SCORE_LOSS_WEIGHT, success);
+    if (success && weight < 0) {
+        weight = 0;
+    }
+
+    return weight;
+}
+
+int ExtraConfig::getFailoverHedgeDelay(bool &success)
+{
+    int delay = getIntFromExtraConfigLines(WS_FAILOVER_HEDGE_DELAY, success);
+    if (success && delay < 0) {
+        delay = 0;
+    }
+
+    return delay;
+}
+
 int ExtraConfig::getIntFromLineWithString(const QString &line, const QString &str, bool &success)
 {
     int endOfId = line.indexOf(str, Qt::CaseInsensitive) + str.length();
@@ -263,6 +344,22 @@ int ExtraConfig::getIntFromExtraConfigLines(const QString &variableName, bool &s
     return 0;
 }
 
+QString ExtraConfig::getStringFromExtraConfigLines(const QString &variableName)
+{
+    const QString strExtraConfig = getExtraConfig();
+    const QStringList strs = strExtraConfig.split("\n");
+
+    for (const QString &line : strs) {
+        QString lineTrimmed = line.trimmed();
+        if (lineTrimmed.startsWith(variableName, Qt::CaseInsensitive)) {
+            int equals = lineTrimmed.indexOf("=", variableName.length());
+            if (equals != -1)
+                return lineTrimmed.mid(equals + 1).trimmed();
+        }
+    }
+    return QString();
+}
+
 bool ExtraConfig::getFlagFromExtraConfigLines(const QString &flagName)
 {
     const QString strExtraConfig = getExtraConfig();
@@ -48,6 +48,18 @@ public:
     bool getWireGuardVerboseLogging();
     bool getUsingScreenTransitionHotkeys();
     bool getUseICMPPings();
+    bool getUseDnsSharedChannel();
+    bool getUsePingStatistics();
+    int getPingScoreJitterWeight(bool &success);
+    int getPingScoreLossWeight(bool &success);
+    int getFailoverHedgeDelay(bool &success);
+    bool getUseCurlEventLoop();
+    bool getLogRequestTimings();
+    bool getDnsHonorTtl();
+    bool getHappyEyeballs();
+    bool getDnsCacheSnapshot();
+    // the DNS over HTTPS upstreams in the format of DnsResolver_doh::parseUpstreams(), empty if not set
+    QString getDnsOverHttpsUpstreams();
 
 private:
     ExtraConfig();
@@ -60,6 +72,7 @@ private:
     int getIntFromLineWithString(const QString &line, const QString &str, bool &success);
     int getIntFromExtraConfigLines(const QString &variableName, bool &success);
     bool getFlagFromExtraConfigLines(const QString &flagName);
+    QString getStringFromExtraConfigLines(const QString &variableName);
 
     bool isLegalOpenVpnCommand(const QString &command) const;
 };
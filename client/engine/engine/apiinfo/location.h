@@ -65,6 +65,7 @@ public:
 
     friend QDataStream& operator <<(QDataStream& stream, const Location& l);
     friend QDataStream& operator >>(QDataStream& stream, Location& l);
+    friend class ServerListParser;
 
 private:
     QSharedDataPointer<LocationData> d;
@@ -0,0 +1,833 @@
+#include "serverlistparser.h"
+
+#include <QVarLengthArray>
+#include <cstring>
+#include <limits>
+
+namespace apiinfo {
+
+// Minimal pull reader over a JSON text in memory (RFC 8259).
+// The containers are entered and walked explicitly with nextMember()/nextElement(), the values that are not needed are skipped.
+// Any syntax error puts the reader into the error state, after that all the calls return false.
+class JsonReader
+{
+public:
+    struct Key
+    {
+        const char *data = nullptr;
+        int size = 0;
+
+        template <size_t N>
+        bool is(const char (&str)[N]) const
+        {
+            return size == static_cast<int>(N - 1) && memcmp(data, str, N - 1) == 0;
+        }
+    };
+
+    // a scalar value with the same conversions as QJsonValue
+    struct Scalar
+    {
+        enum Type { kNull, kBool, kNumber, kString, kArray, kObject };
+        Type type = kNull;
+        double number = 0;
+        QString string;
+
+        int toInt(int defaultValue = 0) const
+        {
+            if (type == kNumber && number >= std::numeric_limits<int>::min() && number <= std::numeric_limits<int>::max()) {
+                const int n = static_cast<int>(number);
+                if (n == number) {
+                    return n;
+                }
+            }
+            return defaultValue;
+        }
+        QString toString() const { return type == kString ? string : QString(); }
+    };
+
+    JsonReader(const char *begin, const char *end) : p_(begin), end_(end), hasError_(false) {}
+
+    bool hasError() const { return hasError_; }
+    const char *pos() const { return p_; }
+
+    // the next non-whitespace character or 0 at the end
+    char peek()
+    {
+        skipWhitespace();
+        return p_ < end_ ? *p_ : 0;
+    }
+
+    bool atEnd()
+    {
+        skipWhitespace();
+        return p_ == end_;
+    }
+
+    bool enterObject() { return enter('{'); }
+    bool enterArray() { return enter('['); }
+
+    // Must be called before each member of the entered object.
+    // Returns false at the end of the object (the closing brace is consumed) or on an error.
+    bool nextMember(Key &key)
+    {
+        if (!beforeNext('}')) {
+            return false;
+        }
+        if (!readKey(key)) {
+            return false;
+        }
+        skipWhitespace();
+        if (p_ >= end_ || *p_ != ':') {
+            return fail();
+        }
+        ++p_;
+        return true;
+    }
+
+    // Must be called before each element of the entered array.
+    // Returns false at the end of the array (the closing bracket is consumed) or on an error.
+    bool nextElement() { return beforeNext(']'); }
+
+    // reads the next value, the containers are skipped and returned as kArray/kObject
+    bool readScalar(Scalar &out)
+    {
+        switch (peek()) {
+        case '"':
+            out.type = Scalar::kString;
+            return readString(&out.string);
+        case '{':
+            out.type = Scalar::kObject;
+            return skipValue();
+        case '[':
+            out.type = Scalar::kArray;
+            return skipValue();
+        case 't':
+            out.type = Scalar::kBool;
+            out.number = 1;
+            return readLiteral("true", 4);
+        case 'f':
+            out.type = Scalar::kBool;
+            out.number = 0;
+            return readLiteral("false", 5);
+        case 'n':
+            out.type = Scalar::kNull;
+            return readLiteral("null", 4);
+        default:
+            out.type = Scalar::kNumber;
+            return readNumber(out.number);
+        }
+    }
+
+    bool skipValue()
+    {
+        switch (peek()) {
+        case '"':
+            return readString(nullptr);
+        case '{': {
+            if (!enterObject()) {
+                return false;
+            }
+            Key key;
+            while (nextMember(key)) {
+                if (!skipValue()) {
+                    return false;
+                }
+            }
+            return !hasError_;
+        }
+        case '[': {
+            if (!enterArray()) {
+                return false;
+            }
+            while (nextElement()) {
+                if (!skipValue()) {
+                    return false;
+                }
+            }
+            return !hasError_;
+        }
+        default: {
+            Scalar scalar;
+            return readScalar(scalar);
+        }
+        }
+    }
+
+private:
+    // the same nesting limit as in the Qt JSON parser
+    static constexpr int kMaxDepth = 1024;
+
+    const char *p_;
+    const char *end_;
+    bool hasError_;
+    // true for the containers where no member/element was read yet
+    QVarLengthArray<bool, 16> isFirst_;
+    QByteArray keyBuffer_;
+
+    bool fail()
+    {
+        hasError_ = true;
+        return false;
+    }
+
+    void skipWhitespace()
+    {
+        while (p_ < end_ && (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t')) {
+            ++p_;
+        }
+    }
+
+    bool enter(char bracket)
+    {
+        if (hasError_ || peek() != bracket) {
+            return fail();
+        }
+        if (isFirst_.size() >= kMaxDepth) {
+            return fail();
+        }
+        ++p_;
+        isFirst_.append(true);
+        return true;
+    }
+
+    bool beforeNext(char closingBracket)
+    {
+        if (hasError_ || isFirst_.isEmpty()) {
+            return fail();
+        }
+        const char c = peek();
+        if (c == closingBracket) {
+            ++p_;
+            isFirst_.removeLast();
+            return false;
+        }
+        if (isFirst_.last()) {
+            isFirst_.last() = false;
+        } else {
+            if (c != ',') {
+                return fail();
+            }
+            ++p_;
+            skipWhitespace();
+        }
+        return p_ < end_ || fail();
+    }
+
+    bool readLiteral(const char *literal, int len)
+    {
+        if (end_ - p_ < len || memcmp(p_, literal, len) != 0) {
+            return fail();
+        }
+        p_ += len;
+        return true;
+    }
+
+    static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+    bool readNumber(double &out)
+    {
+        const char *start = p_;
+        if (p_ < end_ && *p_ == '-') {
+            ++p_;
+        }
+        if (p_ >= end_ || !isDigit(*p_)) {
+            return fail();
+        }
+        if (*p_ == '0') {
+            ++p_;
+        } else {
+            while (p_ < end_ && isDigit(*p_)) {
+                ++p_;
+            }
+        }
+        bool isInteger = true;
+        if (p_ < end_ && *p_ == '.') {
+            isInteger = false;
+            ++p_;
+            if (p_ >= end_ || !isDigit(*p_)) {
+                return fail();
+            }
+            while (p_ < end_ && isDigit(*p_)) {
+                ++p_;
+            }
+        }
+        if (p_ < end_ && (*p_ == 'e' || *p_ == 'E')) {
+            isInteger = false;
+            ++p_;
+            if (p_ < end_ && (*p_ == '+' || *p_ == '-')) {
+                ++p_;
+            }
+            if (p_ >= end_ || !isDigit(*p_)) {
+                return fail();
+            }
+            while (p_ < end_ && isDigit(*p_)) {
+                ++p_;
+            }
+        }
+
+        // the fast path for the integers which are the most of the numbers in the list
+        if (isInteger && p_ - start <= 18) {
+            const bool isNegative = *start == '-';
+            qint64 value = 0;
+            for (const char *c = isNegative ? start + 1 : start; c < p_; ++c) {
+                value = value * 10 + (*c - '0');
+            }
+            out = static_cast<double>(isNegative ? -value : value);
+        } else {
+            out = QByteArray::fromRawData(start, p_ - start).toDouble();
+        }
+        return true;
+    }
+
+    // if out is null, the string is only validated and skipped
+    bool readString(QString *out)
+    {
+        if (p_ >= end_ || *p_ != '"') {
+            return fail();
+        }
+        ++p_;
+        const char *start = p_;
+        while (p_ < end_) {
+            const unsigned char c = *p_;
+            if (c == '"') {
+                if (out) {
+                    *out = QString::fromUtf8(start, p_ - start);
+                }
+                ++p_;
+                return true;
+            }
+            if (c == '\\') {
+                QByteArray utf8(start, p_ - start);
+                if (!readEscapedTail(utf8)) {
+                    return false;
+                }
+                if (out) {
+                    *out = QString::fromUtf8(utf8);
+                }
+                return true;
+            }
+            if (c < 0x20) {
+                return fail();
+            }
+            ++p_;
+        }
+        return fail();
+    }
+
+    bool readKey(Key &key)
+    {
+        if (p_ >= end_ || *p_ != '"') {
+            return fail();
+        }
+        ++p_;
+        const char *start = p_;
+        while (p_ < end_) {
+            const unsigned char c = *p_;
+            if (c == '"') {
+                key.data = start;
+                key.size = p_ - start;
+                ++p_;
+                return true;
+            }
+            if (c == '\\') {
+                // rare, the keys of the server list never have the escapes
+                keyBuffer_ = QByteArray(start, p_ - start);
+                if (!readEscapedTail(keyBuffer_)) {
+                    return false;
+                }
+                key.data = keyBuffer_.constData();
+                key.size = keyBuffer_.size();
+                return true;
+            }
+            if (c < 0x20) {
+                return fail();
+            }
+            ++p_;
+        }
+        return fail();
+    }
+
+    // decodes the rest of the string starting from an escape, consumes the closing quote
+    bool readEscapedTail(QByteArray &utf8)
+    {
+        while (p_ < end_) {
+            const unsigned char c = *p_++;
+            if (c == '"') {
+                return true;
+            }
+            if (c < 0x20) {
+                return fail();
+            }
+            if (c != '\\') {
+                utf8.append(static_cast<char>(c));
+                continue;
+            }
+            if (p_ >= end_) {
+                return fail();
+            }
+            switch (*p_++) {
+            case '"': utf8.append('"'); break;
+            case '\\': utf8.append('\\'); break;
+            case '/': utf8.append('/'); break;
+            case 'b': utf8.append('\b'); break;
+            case 'f': utf8.append('\f'); break;
+            case 'n': utf8.append('\n'); break;
+            case 'r': utf8.append('\r'); break;
+            case 't': utf8.append('\t'); break;
+            case 'u': {
+                uint code;
+                if (!readHex4(code)) {
+                    return false;
+                }
+                if (code >= 0xD800 && code <= 0xDBFF) {
+                    // a surrogate pair is expected
+                    uint low;
+                    if (end_ - p_ >= 6 && p_[0] == '\\' && p_[1] == 'u') {
+                        p_ += 2;
+                        if (!readHex4(low)) {
+                            return false;
+                        }
+                        if (low >= 0xDC00 && low <= 0xDFFF) {
+                            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                        } else {
+                            appendUtf8(utf8, 0xFFFD);
+                            code = low;
+                        }
+                    } else {
+                        code = 0xFFFD;
+                    }
+                }
+                if (code >= 0xD800 && code <= 0xDFFF) {
+                    code = 0xFFFD;
+                }
+                appendUtf8(utf8, code);
+                break;
+            }
+            default:
+                // any other character is escaped to itself, like the Qt JSON parser does
+                utf8.append(p_[-1]);
+                break;
+            }
+        }
+        return fail();
+    }
+
+    bool readHex4(uint &out)
+    {
+        if (end_ - p_ < 4) {
+            return fail();
+        }
+        out = 0;
+        for (int i = 0; i < 4; ++i) {
+            const char c = *p_++;
+            out <<= 4;
+            if (c >= '0' && c <= '9') {
+                out |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                out |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                out |= c - 'A' + 10;
+            } else {
+                return fail();
+            }
+        }
+        return true;
+    }
+
+    static void appendUtf8(QByteArray &utf8, uint code)
+    {
+        if (code < 0x80) {
+            utf8.append(static_cast<char>(code));
+        } else if (code < 0x800) {
+            utf8.append(static_cast<char>(0xC0 | (code >> 6)));
+            utf8.append(static_cast<char>(0x80 | (code & 0x3F)));
+        } else if (code < 0x10000) {
+            utf8.append(static_cast<char>(0xE0 | (code >> 12)));
+            utf8.append(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+            utf8.append(static_cast<char>(0x80 | (code & 0x3F)));
+        } else {
+            utf8.append(static_cast<char>(0xF0 | (code >> 18)));
+            utf8.append(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+            utf8.append(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+            utf8.append(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+    }
+};
+
+
+ServerListParser::Result ServerListParser::parse(const QByteArray &json)
+{
+    clear();
+    JsonReader reader(json.constData(), json.constData() + json.size());
+    if (!reader.enterObject()) {
+        return Result::kIncorrectJson;
+    }
+
+    bool hasInfo = false;
+    bool hasData = false;
+    JsonReader::Key key;
+    while (reader.nextMember(key)) {
+        if (key.is("info")) {
+            hasInfo = true;
+            if (!parseInfo(reader)) {
+                break;
+            }
+        } else if (key.is("data")) {
+            hasData = true;
+            // no need to build the locations if we already know the revision has not changed
+            const bool isSuccess = (hasInfo && !isChanged_) ? reader.skipValue() : parseData(reader);
+            if (!isSuccess) {
+                break;
+            }
+        } else if (!reader.skipValue()) {
+            break;
+        }
+    }
+
+    Result result = Result::kSuccess;
+    if (reader.hasError() || !reader.atEnd()) {
+        result = Result::kIncorrectJson;
+    } else if (!hasInfo) {
+        result = Result::kNoInfo;
+    } else if (!hasData) {
+        result = Result::kNoData;
+    }
+
+    // the data could come before the info
+    if (result != Result::kSuccess || !isChanged_) {
+        locations_.clear();
+        forceDisconnectNodes_.clear();
+        invalidElements_.clear();
+    }
+    return result;
+}
+
+void ServerListParser::clear()
+{
+    isChanged_ = false;
+    revision_ = 0;
+    revisionHash_.clear();
+    hasCountryOverride_ = false;
+    countryOverride_.clear();
+    locations_.clear();
+    forceDisconnectNodes_.clear();
+    invalidElements_.clear();
+}
+
+bool ServerListParser::parseInfo(JsonReader &reader)
+{
+    isChanged_ = false;
+    revision_ = 0;
+    revisionHash_.clear();
+    hasCountryOverride_ = false;
+    countryOverride_.clear();
+
+    // not an object is treated as an empty object, like QJsonValue::toObject() does
+    if (reader.peek() != '{') {
+        return reader.skipValue();
+    }
+    reader.enterObject();
+
+    JsonReader::Key key;
+    JsonReader::Scalar value;
+    while (reader.nextMember(key)) {
+        if (!reader.readScalar(value)) {
+            return false;
+        }
+        if (key.is("changed")) {
+            isChanged_ = value.toInt() != 0;
+        } else if (key.is("revision")) {
+            revision_ = value.toInt();
+        } else if (key.is("revision_hash")) {
+            revisionHash_ = value.toString();
+        } else if (key.is("country_override")) {
+            hasCountryOverride_ = true;
+            countryOverride_ = value.toString();
+        }
+    }
+    return !reader.hasError();
+}
+
+bool ServerListParser::parseData(JsonReader &reader)
+{
+    locations_.clear();
+    forceDisconnectNodes_.clear();
+    invalidElements_.clear();
+
+    if (reader.peek() != '[') {
+        return reader.skipValue();
+    }
+    reader.enterArray();
+
+    int index = 0;
+    while (reader.nextElement()) {
+        if (reader.peek() == '{') {
+            const char *start = reader.pos();
+            Location location;
+            bool isValid;
+            if (!parseLocation(reader, location, forceDisconnectNodes_, isValid)) {
+                return false;
+            }
+            if (isValid) {
+                locations_ << location;
+            } else {
+                invalidElements_ << InvalidElement{ index, true, QByteArray(start, reader.pos() - start) };
+            }
+        } else {
+            if (!reader.skipValue()) {
+                return false;
+            }
+            invalidElements_ << InvalidElement{ index, false, QByteArray() };
+        }
+        ++index;
+    }
+    return !reader.hasError();
+}
+
+bool ServerListParser::parseLocation(JsonReader &reader, Location &location, QStringList &forceDisconnectNodes, bool &outIsValid)
+{
+    // the same required fields and conversions as in Location::initFromJson()
+    enum { kId = 0x01, kName = 0x02, kCountryCode = 0x04, kPremiumOnly = 0x08, kP2P = 0x10, kGroups = 0x20, kAllRequired = 0x3F };
+
+    outIsValid = false;
+    LocationData *d = location.d.data();
+    int foundFields = 0;
+    bool isGroupsValid = true;
+    // added to the output only if the location has all the required fields, the groups are not parsed otherwise
+    QStringList locationForceDisconnectNodes;
+
+    if (!reader.enterObject()) {
+        return false;
+    }
+    JsonReader::Key key;
+    JsonReader::Scalar value;
+    while (reader.nextMember(key)) {
+        if (key.is("groups")) {
+            foundFields |= kGroups;
+            d->groups_.clear();
+            if (reader.peek() != '[') {
+                if (!reader.skipValue()) {
+                    return false;
+                }
+                continue;
+            }
+            reader.enterArray();
+            while (reader.nextElement()) {
+                // the groups after an invalid one are not parsed
+                if (!isGroupsValid) {
+                    if (!reader.skipValue()) {
+                        return false;
+                    }
+                    continue;
+                }
+                Group group;
+                bool isGroupValid;
+                if (!parseGroup(reader, group, locationForceDisconnectNodes, isGroupValid)) {
+                    return false;
+                }
+                if (isGroupValid) {
+                    d->groups_ << group;
+                } else {
+                    isGroupsValid = false;
+                }
+            }
+            if (reader.hasError()) {
+                return false;
+            }
+            continue;
+        }
+
+        if (!reader.readScalar(value)) {
+            return false;
+        }
+        if (key.is("id")) {
+            foundFields |= kId;
+            d->id_ = value.toInt();
+        } else if (key.is("name")) {
+            foundFields |= kName;
+            d->name_ = value.toString();
+        } else if (key.is("country_code")) {
+            foundFields |= kCountryCode;
+            d->countryCode_ = value.toString();
+        } else if (key.is("premium_only")) {
+            foundFields |= kPremiumOnly;
+            d->premiumOnly_ = value.toInt();
+        } else if (key.is("p2p")) {
+            foundFields |= kP2P;
+            d->p2p_ = value.toInt();
+        } else if (key.is("dns_hostname")) {
+            d->dnsHostName_ = value.toString();
+        }
+    }
+    if (reader.hasError()) {
+        return false;
+    }
+
+    if (foundFields == kAllRequired) {
+        forceDisconnectNodes << locationForceDisconnectNodes;
+        outIsValid = isGroupsValid;
+    }
+    d->isValid_ = outIsValid;
+    return true;
+}
+
+bool ServerListParser::parseGroup(JsonReader &reader, Group &group, QStringList &forceDisconnectNodes, bool &outIsValid)
+{
+    // the same required fields and conversions as in Group::initFromJson()
+    enum { kId = 0x01, kCity = 0x02, kNick = 0x04, kPro = 0x08, kPingIp = 0x10, kWgPubKey = 0x20, kAllRequired = 0x3F };
+
+    outIsValid = false;
+    if (reader.peek() != '{') {
+        return reader.skipValue();
+    }
+
+    GroupData *d = group.d.data();
+    d->health_ = -1;
+    int foundFields = 0;
+    bool isNodesValid = true;
+    QStringList groupForceDisconnectNodes;
+
+    reader.enterObject();
+    JsonReader::Key key;
+    JsonReader::Scalar value;
+    while (reader.nextMember(key)) {
+        if (key.is("nodes")) {
+            d->nodes_.clear();
+            if (reader.peek() != '[') {
+                if (!reader.skipValue()) {
+                    return false;
+                }
+                continue;
+            }
+            reader.enterArray();
+            while (reader.nextElement()) {
+                // the nodes after an invalid one are not parsed
+                if (!isNodesValid) {
+                    if (!reader.skipValue()) {
+                        return false;
+                    }
+                    continue;
+                }
+                Node node;
+                bool isNodeValid;
+                if (!parseNode(reader, node, isNodeValid)) {
+                    return false;
+                }
+                if (!isNodeValid) {
+                    isNodesValid = false;
+                } else if (node.isForceDisconnect()) {
+                    // not add node with flag force_diconnect, but add it to another list
+                    groupForceDisconnectNodes << node.getHostname();
+                } else {
+                    d->nodes_ << node;
+                }
+            }
+            if (reader.hasError()) {
+                return false;
+            }
+            continue;
+        }
+
+        if (!reader.readScalar(value)) {
+            return false;
+        }
+        if (key.is("id")) {
+            foundFields |= kId;
+            d->id_ = value.toInt();
+        } else if (key.is("city")) {
+            foundFields |= kCity;
+            d->city_ = value.toString();
+        } else if (key.is("nick")) {
+            foundFields |= kNick;
+            d->nick_ = value.toString();
+        } else if (key.is("pro")) {
+            foundFields |= kPro;
+            d->pro_ = value.toInt();
+        } else if (key.is("ping_ip")) {
+            foundFields |= kPingIp;
+            d->pingIp_ = value.toString();
+        } else if (key.is("ping_host")) {
+            d->pingHost_ = value.toString();
+        } else if (key.is("wg_pubkey")) {
+            foundFields |= kWgPubKey;
+            d->wg_pubkey_ = value.toString();
+        } else if (key.is("ovpn_x509")) {
+            d->ovpn_x509_ = value.toString();
+        } else if (key.is("link_speed")) {
+            bool bConverted;
+            d->link_speed_ = value.toString().toInt(&bConverted);
+            if (!bConverted) {
+                d->link_speed_ = 100;
+            }
+        } else if (key.is("health")) {
+            d->health_ = value.toInt(-1);
+            if ((d->health_ < 0) || (d->health_ > 100)) {
+                d->health_ = -1;
+            }
+        }
+    }
+    if (reader.hasError()) {
+        return false;
+    }
+
+    if (foundFields == kAllRequired) {
+        forceDisconnectNodes << groupForceDisconnectNodes;
+        outIsValid = isNodesValid;
+    }
+    d->isValid_ = outIsValid;
+    return true;
+}
+
+bool ServerListParser::parseNode(JsonReader &reader, Node &node, bool &outIsValid)
+{
+    // the same required fields and conversions as in Node::initFromJson()
+    enum { kIp = 0x01, kIp2 = 0x02, kIp3 = 0x04, kHostname = 0x08, kWeight = 0x10, kAllRequired = 0x1F };
+
+    outIsValid = false;
+    if (reader.peek() != '{') {
+        return reader.skipValue();
+    }
+
+    NodeData *d = node.d.data();
+    int foundFields = 0;
+    QString ips[3];
+
+    reader.enterObject();
+    JsonReader::Key key;
+    JsonReader::Scalar value;
+    while (reader.nextMember(key)) {
+        if (!reader.readScalar(value)) {
+            return false;
+        }
+        if (key.is("ip")) {
+            foundFields |= kIp;
+            ips[0] = value.toString();
+        } else if (key.is("ip2")) {
+            foundFields |= kIp2;
+            ips[1] = value.toString();
+        } else if (key.is("ip3")) {
+            foundFields |= kIp3;
+            ips[2] = value.toString();
+        } else if (key.is("hostname")) {
+            foundFields |= kHostname;
+            d->hostname_ = value.toString();
+        } else if (key.is("weight")) {
+            foundFields |= kWeight;
+            d->weight_ = value.toInt();
+        } else if (key.is("force_disconnect")) {
+            d->forceDisconnect_ = value.toInt();
+        }
+    }
+    if (reader.hasError()) {
+        return false;
+    }
+
+    outIsValid = (foundFields == kAllRequired);
+    if (outIsValid) {
+        d->ips_ = { ips[0], ips[1], ips[2] };
+    }
+    d->isValid_ = outIsValid;
+    return true;
+}
+
+} // namespace apiinfo
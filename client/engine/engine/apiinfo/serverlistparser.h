@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "location.h"
+
+namespace apiinfo {
+
+class JsonReader;
+
+// Parser of the server list API response ({"info": {...}, "data": [locations]}).
+// parse() is a streaming (pull) parser that builds Location/Group/Node objects directly from the bytes without building
+// the QJsonDocument DOM first, so a large list is not held twice in memory.
+// The reference implementation on top of QJsonDocument and Location::initFromJson() is in the tests (DomServerListParser).
+class ServerListParser
+{
+public:
+    enum class Result { kSuccess, kIncorrectJson, kNoInfo, kNoData };
+
+    struct InvalidElement
+    {
+        int index;
+        bool isObject;
+        QByteArray json;    // the element as it was in the response, only for the objects
+    };
+
+    Result parse(const QByteArray &json);
+
+    // the output values are valid if parse() returned kSuccess
+    bool isChanged() const { return isChanged_; }
+    int revision() const { return revision_; }
+    QString revisionHash() const { return revisionHash_; }
+    bool hasCountryOverride() const { return hasCountryOverride_; }
+    QString countryOverride() const { return countryOverride_; }
+
+    // filled only if the revision changed
+    const QVector<Location> &locations() const { return locations_; }
+    const QStringList &forceDisconnectNodes() const { return forceDisconnectNodes_; }
+    // the skipped invalid/incomplete elements of the "data" array
+    const QVector<InvalidElement> &invalidElements() const { return invalidElements_; }
+
+private:
+    bool isChanged_ = false;
+    int revision_ = 0;
+    QString revisionHash_;
+    bool hasCountryOverride_ = false;
+    QString countryOverride_;
+    QVector<Location> locations_;
+    QStringList forceDisconnectNodes_;
+    QVector<InvalidElement> invalidElements_;
+
+    void clear();
+
+    // these return false on the syntax error, the semantic validity is returned in outIsValid
+    bool parseInfo(JsonReader &reader);
+    bool parseData(JsonReader &reader);
+    static bool parseLocation(JsonReader &reader, Location &location, QStringList &forceDisconnectNodes, bool &outIsValid);
+    static bool parseGroup(JsonReader &reader, Group &group, QStringList &forceDisconnectNodes, bool &outIsValid);
+    static bool parseNode(JsonReader &reader, Node &node, bool &outIsValid);
+};
+
+} //namespace apiinfo
@@ -0,0 +1,49 @@
+#include "domserverlistparser.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+using namespace apiinfo;
+
+ServerListParser::Result DomServerListParser::parse(const QByteArray &json)
+{
+    *this = DomServerListParser();
+    QJsonParseError errCode;
+    QJsonDocument doc = QJsonDocument::fromJson(json, &errCode);
+    if (errCode.error != QJsonParseError::NoError || !doc.isObject()) {
+        return ServerListParser::Result::kIncorrectJson;
+    }
+    QJsonObject jsonObject = doc.object();
+    if (!jsonObject.contains("info")) {
+        return ServerListParser::Result::kNoInfo;
+    }
+    if (!jsonObject.contains("data")) {
+        return ServerListParser::Result::kNoData;
+    }
+
+    QJsonObject jsonInfo = jsonObject["info"].toObject();
+    isChanged_ = jsonInfo["changed"].toInt() != 0;
+    revision_ = jsonInfo["revision"].toInt();
+    revisionHash_ = jsonInfo["revision_hash"].toString();
+    hasCountryOverride_ = jsonInfo.contains("country_override");
+    countryOverride_ = jsonInfo["country_override"].toString();
+
+    if (isChanged_) {
+        const QJsonArray jsonData = jsonObject["data"].toArray();
+        for (int i = 0; i < jsonData.size(); ++i) {
+            if (jsonData.at(i).isObject()) {
+                Location sl;
+                QJsonObject dataElement = jsonData.at(i).toObject();
+                if (sl.initFromJson(dataElement, forceDisconnectNodes_)) {
+                    locations_ << sl;
+                } else {
+                    invalidElements_ << ServerListParser::InvalidElement{ i, true, QJsonDocument(dataElement).toJson(QJsonDocument::Compact) };
+                }
+            } else {
+                invalidElements_ << ServerListParser::InvalidElement{ i, false, QByteArray() };
+            }
+        }
+    }
+    return ServerListParser::Result::kSuccess;
+}
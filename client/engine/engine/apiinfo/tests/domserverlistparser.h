@@ -0,0 +1,30 @@
+#pragma once
+
+#include "engine/apiinfo/serverlistparser.h"
+
+// The reference implementation of ServerListParser on top of QJsonDocument and Location::initFromJson(),
+// the streaming parser is compared and benchmarked against it.
+class DomServerListParser
+{
+public:
+    apiinfo::ServerListParser::Result parse(const QByteArray &json);
+
+    bool isChanged() const { return isChanged_; }
+    int revision() const { return revision_; }
+    QString revisionHash() const { return revisionHash_; }
+    bool hasCountryOverride() const { return hasCountryOverride_; }
+    QString countryOverride() const { return countryOverride_; }
+    const QVector<apiinfo::Location> &locations() const { return locations_; }
+    const QStringList &forceDisconnectNodes() const { return forceDisconnectNodes_; }
+    const QVector<apiinfo::ServerListParser::InvalidElement> &invalidElements() const { return invalidElements_; }
+
+private:
+    bool isChanged_ = false;
+    int revision_ = 0;
+    QString revisionHash_;
+    bool hasCountryOverride_ = false;
+    QString countryOverride_;
+    QVector<apiinfo::Location> locations_;
+    QStringList forceDisconnectNodes_;
+    QVector<apiinfo::ServerListParser::InvalidElement> invalidElements_;
+};
@@ -0,0 +1,296 @@
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QFile>
+
+#include "engine/apiinfo/serverlistparser.h"
+#include "domserverlistparser.h"
+
+using namespace apiinfo;
+
+// Checks that the streaming parser gives the same results as the QJsonDocument based one
+// and compares their parse time and peak memory on the synthetic server lists.
+class TestServerListParser : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void test_equivalence();
+    void test_incorrect_json_data();
+    void test_incorrect_json();
+    void test_not_changed();
+    void test_large_list();
+    void benchmark_dom_data();
+    void benchmark_dom();
+    void benchmark_streaming_data();
+    void benchmark_streaming();
+    void report_peak_memory();
+
+private:
+    static void addListSizes();
+    // 10 groups of 5 nodes per location
+    static QByteArray makeServerList(int nodesCount);
+    static void compareParsers(const QByteArray &json);
+    // returns false if it is not supported on this platform
+    static bool resetPeakRss();
+    // the peak RSS in KB since the last reset
+    static qint64 peakRssKb();
+    static qint64 currentRssKb();
+};
+
+void TestServerListParser::test_equivalence()
+{
+    const QByteArray json = R"({
+        "info": {"changed": 1, "revision": 1234, "revision_hash": "abcé\"", "country_override": "CA"},
+        "data": [
+            {"id": 1, "name": "Canada Éast", "country_code": "CA", "premium_only": 0, "p2p": 1, "dns_hostname": "ca.example.com",
+             "groups": [
+                {"id": 10, "city": "Toronto", "nick": "The \\ Six", "pro": 1, "ping_ip": "1.1.1.1", "ping_host": "https://ping.example.com",
+                 "wg_pubkey": "key=", "ovpn_x509": "x509", "link_speed": "1000", "health": 45,
+                 "nodes": [
+                    {"ip": "10.0.0.1", "ip2": "10.0.0.2", "ip3": "10.0.0.3", "hostname": "node1.example.com", "weight": 10},
+                    {"hostname": "node2.example.com", "ip3": "10.0.1.3", "ip2": "10.0.1.2", "ip": "10.0.1.1", "weight": 1, "force_disconnect": 1}
+                 ]},
+                {"id": 11, "city": "Montreal", "nick": "Bagel", "pro": 0, "ping_ip": "2.2.2.2", "wg_pubkey": "key2=",
+                 "link_speed": 1000, "health": 101}
+             ]},
+            "not an object",
+            {"id": 2, "name": "Missing p2p", "country_code": "US", "premium_only": 1,
+             "groups": [{"id": 20, "city": "NYC", "nick": "Empire", "pro": 1, "ping_ip": "3.3.3.3", "wg_pubkey": "k",
+                         "nodes": [{"ip": "1", "ip2": "2", "ip3": "3", "hostname": "fd-lost.example.com", "weight": 1, "force_disconnect": 1}]}]},
+            {"id": 3, "name": "Invalid node", "country_code": "DE", "premium_only": 0, "p2p": 0,
+             "groups": [
+                {"id": 30, "city": "Berlin", "nick": "Bear", "pro": 1, "ping_ip": "4.4.4.4", "wg_pubkey": "k",
+                 "nodes": [{"ip": "1", "ip2": "2", "ip3": "3", "hostname": "fd-kept.example.com", "weight": 1, "force_disconnect": 1},
+                           {"ip": "1", "hostname": "broken"},
+                           {"ip": "1", "ip2": "2", "ip3": "3", "hostname": "fd-after.example.com", "weight": 1, "force_disconnect": 1}]},
+                {"id": 31, "city": "Munich", "nick": "Beer", "pro": 1, "ping_ip": "5.5.5.5", "wg_pubkey": "k"}
+             ]},
+            {"groups": [], "p2p": 0, "premium_only": 0, "country_code": "FR", "name": "Reordered", "id": 4.0, "extra": {"a": [1, 2, {"b": null}]}},
+            {"id": 5.5, "name": 7, "country_code": "JP", "premium_only": true, "p2p": "1", "groups": {}},
+            {"id": 6, "name": "Group not an object", "country_code": "GB", "premium_only": 0, "p2p": 0, "groups": [1]},
+            {"id": 7, "name": "Emoji 😀 and escaped \ud83d\ude00", "country_code": "NL", "premium_only": 0, "p2p": 0, "groups": []}
+        ]
+    })";
+    compareParsers(json);
+
+    ServerListParser parser;
+    QCOMPARE(parser.parse(json), ServerListParser::Result::kSuccess);
+    QCOMPARE(parser.revision(), 1234);
+    QCOMPARE(parser.countryOverride(), QString("CA"));
+    QCOMPARE(parser.locations().size(), 4);
+    QCOMPARE(parser.locations()[0].getGroup(0).getNodesCount(), 1);
+    QCOMPARE(parser.locations()[0].getGroup(0).getLinkSpeed(), 1000);
+    QCOMPARE(parser.locations()[0].getGroup(1).getLinkSpeed(), 100);
+    QCOMPARE(parser.locations()[0].getGroup(1).getHealth(), -1);
+    QCOMPARE(parser.forceDisconnectNodes(), QStringList({ "node2.example.com", "fd-kept.example.com" }));
+    QCOMPARE(parser.invalidElements().size(), 4);
+}
+
+void TestServerListParser::test_incorrect_json_data()
+{
+    QTest::addColumn<QByteArray>("json");
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("array") << QByteArray("[]");
+    QTest::newRow("truncated") << QByteArray(R"({"info": {"changed": 1}, "data": [{"id": 1)");
+    QTest::newRow("trailing garbage") << QByteArray(R"({"info": {}, "data": []} x)");
+    QTest::newRow("trailing comma") << QByteArray(R"({"info": {}, "data": [1,]})");
+    QTest::newRow("missing comma") << QByteArray(R"({"info": {} "data": []})");
+    QTest::newRow("bad literal") << QByteArray(R"({"info": {"changed": tru}, "data": []})");
+    QTest::newRow("bad number") << QByteArray(R"({"info": {"changed": 01}, "data": []})");
+    QTest::newRow("unknown escape") << QByteArray(R"({"info": {"revision_hash": "\x"}, "data": []})");
+    QTest::newRow("truncated escape") << QByteArray(R"({"info": {"revision_hash": "\u12"}, "data": []})");
+    QTest::newRow("no info") << QByteArray(R"({"data": []})");
+    QTest::newRow("no data") << QByteArray(R"({"info": {"changed": 1}})");
+    QTest::newRow("info not object") << QByteArray(R"({"info": 1, "data": [1]})");
+    QTest::newRow("data not array") << QByteArray(R"({"info": {"changed": 1}, "data": {"a": 1}})");
+}
+
+void TestServerListParser::test_incorrect_json()
+{
+    QFETCH(QByteArray, json);
+    compareParsers(json);
+}
+
+void TestServerListParser::test_not_changed()
+{
+    // the data before the info is parsed, but dropped since the revision has not changed
+    QByteArray list = makeServerList(100);
+    list.replace("\"changed\": 1", "\"changed\": 0");
+    compareParsers(list);
+
+    ServerListParser parser;
+    QCOMPARE(parser.parse(list), ServerListParser::Result::kSuccess);
+    QVERIFY(!parser.isChanged());
+    QVERIFY(parser.locations().isEmpty());
+}
+
+void TestServerListParser::test_large_list()
+{
+    compareParsers(makeServerList(10000));
+}
+
+void TestServerListParser::addListSizes()
+{
+    QTest::addColumn<int>("nodesCount");
+    QTest::newRow("1k nodes") << 1000;
+    QTest::newRow("10k nodes") << 10000;
+    QTest::newRow("50k nodes") << 50000;
+}
+
+void TestServerListParser::benchmark_dom_data()
+{
+    addListSizes();
+}
+
+void TestServerListParser::benchmark_dom()
+{
+    QFETCH(int, nodesCount);
+    const QByteArray json = makeServerList(nodesCount);
+    QBENCHMARK {
+        DomServerListParser parser;
+        QCOMPARE(parser.parse(json), ServerListParser::Result::kSuccess);
+    }
+}
+
+void TestServerListParser::benchmark_streaming_data()
+{
+    addListSizes();
+}
+
+void TestServerListParser::benchmark_streaming()
+{
+    QFETCH(int, nodesCount);
+    const QByteArray json = makeServerList(nodesCount);
+    QBENCHMARK {
+        ServerListParser parser;
+        QCOMPARE(parser.parse(json), ServerListParser::Result::kSuccess);
+    }
+}
+
+void TestServerListParser::report_peak_memory()
+{
+    if (!resetPeakRss()) {
+        QSKIP("Resetting the peak RSS is not supported on this platform");
+    }
+
+    for (int nodesCount : { 1000, 10000, 50000 }) {
+        const QByteArray json = makeServerList(nodesCount);
+        for (bool isStreaming : { false, true }) {
+            QVERIFY(resetPeakRss());
+            const qint64 rssBefore = currentRssKb();
+            QElapsedTimer timer;
+            timer.start();
+            {
+                const auto result = isStreaming ? ServerListParser().parse(json) : DomServerListParser().parse(json);
+                QCOMPARE(result, ServerListParser::Result::kSuccess);
+            }
+            const qint64 elapsedMs = timer.elapsed();
+            qDebug().noquote() << QString("%1 nodes (%2 KB json), %3: %4 ms, peak RSS +%5 KB")
+                                      .arg(nodesCount).arg(json.size() / 1024).arg(isStreaming ? "streaming" : "dom")
+                                      .arg(elapsedMs).arg(peakRssKb() - rssBefore);
+        }
+    }
+}
+
+QByteArray TestServerListParser::makeServerList(int nodesCount)
+{
+    const int kGroupsPerLocation = 10;
+    const int kNodesPerGroup = 5;
+    const int locationsCount = qMax(1, nodesCount / (kGroupsPerLocation * kNodesPerGroup));
+
+    QByteArray json;
+    json.reserve(nodesCount * 160);
+    json += "{\"data\": [";
+    int nodeId = 0;
+    for (int l = 0; l < locationsCount; ++l) {
+        if (l > 0) json += ",";
+        json += QString("{\"id\": %1, \"name\": \"Location %1\", \"country_code\": \"C%2\", \"premium_only\": %3, \"p2p\": 1, "
+                        "\"dns_hostname\": \"loc%1.example.com\", \"groups\": [")
+                    .arg(l).arg(l % 10).arg(l % 2).toUtf8();
+        for (int g = 0; g < kGroupsPerLocation; ++g) {
+            if (g > 0) json += ",";
+            const int groupId = l * kGroupsPerLocation + g;
+            json += QString("{\"id\": %1, \"city\": \"City %1\", \"nick\": \"Nick %1\", \"pro\": %2, \"ping_ip\": \"10.%3.%4.1\", "
+                            "\"ping_host\": \"https://ping%1.example.com:6363/latency\", \"wg_pubkey\": \"pUbKeY%1pUbKeYpUbKeYpUbKeYpUbKeYpUbKeY=\", "
+                            "\"ovpn_x509\": \"group%1.example.com\", \"link_speed\": \"1000\", \"health\": %5, \"nodes\": [")
+                        .arg(groupId).arg(g % 2).arg(groupId / 256 % 256).arg(groupId % 256).arg(groupId % 100).toUtf8();
+            for (int n = 0; n < kNodesPerGroup; ++n) {
+                if (n > 0) json += ",";
+                json += QString("{\"ip\": \"172.16.%1.%2\", \"ip2\": \"172.17.%1.%2\", \"ip3\": \"172.18.%1.%2\", "
+                                "\"hostname\": \"node%3.example.com\", \"weight\": %4, \"force_disconnect\": %5}")
+                            .arg(nodeId / 256 % 256).arg(nodeId % 256).arg(nodeId).arg(1 + nodeId % 10).arg(nodeId % 97 == 0 ? 1 : 0).toUtf8();
+                nodeId++;
+            }
+            json += "]}";
+        }
+        json += "]}";
+    }
+    json += "], \"info\": {\"changed\": 1, \"revision\": 42, \"revision_hash\": \"deadbeef\"}}";
+    return json;
+}
+
+void TestServerListParser::compareParsers(const QByteArray &json)
+{
+    ServerListParser streaming;
+    DomServerListParser dom;
+    const ServerListParser::Result result = streaming.parse(json);
+    QCOMPARE(result, dom.parse(json));
+    if (result != ServerListParser::Result::kSuccess) {
+        return;
+    }
+
+    QCOMPARE(streaming.isChanged(), dom.isChanged());
+    QCOMPARE(streaming.revision(), dom.revision());
+    QCOMPARE(streaming.revisionHash(), dom.revisionHash());
+    QCOMPARE(streaming.hasCountryOverride(), dom.hasCountryOverride());
+    QCOMPARE(streaming.countryOverride(), dom.countryOverride());
+    QCOMPARE(streaming.locations().size(), dom.locations().size());
+    for (int i = 0; i < streaming.locations().size(); ++i) {
+        QVERIFY2(streaming.locations()[i] == dom.locations()[i], qPrintable(QString("location %1 differs").arg(i)));
+    }
+    QCOMPARE(streaming.forceDisconnectNodes(), dom.forceDisconnectNodes());
+    QCOMPARE(streaming.invalidElements().size(), dom.invalidElements().size());
+    for (int i = 0; i < streaming.invalidElements().size(); ++i) {
+        QCOMPARE(streaming.invalidElements()[i].index, dom.invalidElements()[i].index);
+        QCOMPARE(streaming.invalidElements()[i].isObject, dom.invalidElements()[i].isObject);
+    }
+}
+
+bool TestServerListParser::resetPeakRss()
+{
+#ifdef Q_OS_LINUX
+    // writing 5 to clear_refs resets the VmHWM (peak RSS) of the process
+    QFile file("/proc/self/clear_refs");
+    return file.open(QIODevice::WriteOnly) && file.write("5") == 1;
+#else
+    return false;
+#endif
+}
+
+static qint64 readProcStatusKb(const char *field)
+{
+    QFile file("/proc/self/status");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    const QList<QByteArray> lines = file.readAll().split('\n');
+    for (const QByteArray &line : lines) {
+        if (line.startsWith(field)) {
+            return line.mid(qstrlen(field)).trimmed().split(' ').first().toLongLong();
+        }
+    }
+    return -1;
+}
+
+qint64 TestServerListParser::peakRssKb()
+{
+    return readProcStatusKb("VmHWM:");
+}
+
+qint64 TestServerListParser::currentRssKb()
+{
+    return readProcStatusKb("VmRSS:");
+}
+
+QTEST_MAIN(TestServerListParser)
+#include "serverlistparser.test.moc"
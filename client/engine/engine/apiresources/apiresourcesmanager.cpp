@@ -80,13 +80,23 @@ void ApiResourcesManager::fetchServerCredentials()
 
 bool ApiResourcesManager::loadFromSettings()
 {
-    return apiInfo_.loadFromSettings();
+    if (!apiInfo_.loadFromSettings())
+        return false;
+    // The saved data is the one last received from the API, so it still matches the validators in ResponseCache.
+    // Except the locations: the force disconnect nodes that come with them are not saved.
+    receivedResources_ = { RequestType::kServerCredentialsOpenVPN, RequestType::kServerCredentialsIkev2,
+                           RequestType::kServerConfigs, RequestType::kPortMap, RequestType::kStaticIps };
+    return true;
 }
 
 void ApiResourcesManager::setServerCredentials(const apiinfo::ServerCredentials &serverCredentials, const QString &serverConfig)
 {
     apiInfo_.setServerCredentials(serverCredentials);
     apiInfo_.setOvpnConfig(serverConfig);
+    // not from the API, must be fetched in full next time
+    receivedResources_.remove(RequestType::kServerCredentialsOpenVPN);
+    receivedResources_.remove(RequestType::kServerCredentialsIkev2);
+    receivedResources_.remove(RequestType::kServerConfigs);
 }
 
 bool ApiResourcesManager::isCanBeLoadFromSettings()
@@ -127,8 +137,11 @@ void ApiResourcesManager::onServerConfigsAnswer()
 {
     QSharedPointer<server_api::ServerConfigsRequest> request(static_cast<server_api::ServerConfigsRequest *>(sender()), &QObject::deleteLater);
     if (request->networkRetCode() == SERVER_RETURN_SUCCESS) {
-        apiInfo_.setOvpnConfig(request->ovpnConfig());
-        saveApiInfoToSettings();
+        if (!request->isNotModified()) {
+            apiInfo_.setOvpnConfig(request->ovpnConfig());
+            saveApiInfoToSettings();
+            receivedResources_.insert(RequestType::kServerConfigs);
+        }
         lastUpdateTimeMs_[RequestType::kServerConfigs] = QDateTime::currentMSecsSinceEpoch();
         isServerConfigsReceived_ = true;
         checkForServerCredentialsFetchFinished();
@@ -141,8 +154,11 @@ void ApiResourcesManager::onServerCredentialsOpenVpnAnswer()
 {
     QSharedPointer<server_api::ServerCredentialsRequest> request(static_cast<server_api::ServerCredentialsRequest *>(sender()), &QObject::deleteLater);
     if (request->networkRetCode() == SERVER_RETURN_SUCCESS) {
-        apiInfo_.setServerCredentialsOpenVpn(request->radiusUsername(), request->radiusPassword());
-        saveApiInfoToSettings();
+        if (!request->isNotModified()) {
+            apiInfo_.setServerCredentialsOpenVpn(request->radiusUsername(), request->radiusPassword());
+            saveApiInfoToSettings();
+            receivedResources_.insert(RequestType::kServerCredentialsOpenVPN);
+        }
         lastUpdateTimeMs_[RequestType::kServerCredentialsOpenVPN] = QDateTime::currentMSecsSinceEpoch();
         isOpenVpnCredentialsReceived_ = true;
         checkForServerCredentialsFetchFinished();
@@ -155,8 +171,11 @@ void ApiResourcesManager::onServerCredentialsIkev2Answer()
 {
     QSharedPointer<server_api::ServerCredentialsRequest> request(static_cast<server_api::ServerCredentialsRequest *>(sender()), &QObject::deleteLater);
     if (request->networkRetCode() == SERVER_RETURN_SUCCESS) {
-        apiInfo_.setServerCredentialsIkev2(request->radiusUsername(), request->radiusPassword());
-        saveApiInfoToSettings();
+        if (!request->isNotModified()) {
+            apiInfo_.setServerCredentialsIkev2(request->radiusUsername(), request->radiusPassword());
+            saveApiInfoToSettings();
+            receivedResources_.insert(RequestType::kServerCredentialsIkev2);
+        }
         lastUpdateTimeMs_[RequestType::kServerCredentialsIkev2] = QDateTime::currentMSecsSinceEpoch();
         isIkev2CredentialsReceived_ = true;
         checkForServerCredentialsFetchFinished();
@@ -169,11 +188,14 @@ void ApiResourcesManager::onServerLocationsAnswer()
 {
     QSharedPointer<server_api::ServerListRequest> request(static_cast<server_api::ServerListRequest *>(sender()), &QObject::deleteLater);
     if (request->networkRetCode() == SERVER_RETURN_SUCCESS) {
-        apiInfo_.setLocations(request->locations());
-        apiInfo_.setForceDisconnectNodes(request->forceDisconnectNodes());
-        saveApiInfoToSettings();
         lastUpdateTimeMs_[RequestType::kLocations] = QDateTime::currentMSecsSinceEpoch();
-        emit locationsUpdated();
+        if (!request->isNotModified()) {
+            apiInfo_.setLocations(request->locations());
+            apiInfo_.setForceDisconnectNodes(request->forceDisconnectNodes());
+            saveApiInfoToSettings();
+            receivedResources_.insert(RequestType::kLocations);
+            emit locationsUpdated();
+        }
         checkForReadyLogin();
     }
     requestsInProgress_.remove(RequestType::kLocations);
@@ -183,8 +205,11 @@ void ApiResourcesManager::onPortMapAnswer()
 {
     QSharedPointer<server_api::PortMapRequest> request(static_cast<server_api::PortMapRequest *>(sender()), &QObject::deleteLater);
     if (request->networkRetCode() == SERVER_RETURN_SUCCESS) {
-        apiInfo_.setPortMap(request->portMap());
-        saveApiInfoToSettings();
+        if (!request->isNotModified()) {
+            apiInfo_.setPortMap(request->portMap());
+            saveApiInfoToSettings();
+            receivedResources_.insert(RequestType::kPortMap);
+        }
         lastUpdateTimeMs_[RequestType::kPortMap] = QDateTime::currentMSecsSinceEpoch();
         checkForReadyLogin();
     }
@@ -195,10 +220,13 @@ void ApiResourcesManager::onStaticIpsAnswer()
 {
     QSharedPointer<server_api::StaticIpsRequest> request(static_cast<server_api::StaticIpsRequest *>(sender()), &QObject::deleteLater);
     if (request->networkRetCode() == SERVER_RETURN_SUCCESS) {
-        apiInfo_.setStaticIps(request->staticIps());
-        saveApiInfoToSettings();
         lastUpdateTimeMs_[RequestType::kStaticIps] = QDateTime::currentMSecsSinceEpoch();
-        emit staticIpsUpdated();
+        if (!request->isNotModified()) {
+            apiInfo_.setStaticIps(request->staticIps());
+            saveApiInfoToSettings();
+            receivedResources_.insert(RequestType::kStaticIps);
+            emit staticIpsUpdated();
+        }
         checkForReadyLogin();
     }
     requestsInProgress_.remove(RequestType::kStaticIps);
@@ -208,7 +236,10 @@ void ApiResourcesManager::onNotificationsAnswer()
 {
     QSharedPointer<server_api::NotificationsRequest> request(static_cast<server_api::NotificationsRequest *>(sender()), &QObject::deleteLater);
     if (request->networkRetCode() == SERVER_RETURN_SUCCESS) {
-        emit notificationsUpdated(request->notifications());
+        if (!request->isNotModified()) {
+            receivedResources_.insert(RequestType::kNotifications);
+            emit notificationsUpdated(request->notifications());
+        }
         lastUpdateTimeMs_[RequestType::kNotifications] = QDateTime::currentMSecsSinceEpoch();
     }
     requestsInProgress_.remove(RequestType::kNotifications);
@@ -370,7 +401,7 @@ void ApiResourcesManager::fetchServerConfigs(const QString &authHash)
 {
     if (requestsInProgress_.contains(RequestType::kServerConfigs))
         return;
-    requestsInProgress_[RequestType::kServerConfigs] = serverAPI_->serverConfigs(authHash);
+    requestsInProgress_[RequestType::kServerConfigs] = serverAPI_->serverConfigs(authHash, receivedResources_.contains(RequestType::kServerConfigs));
     connect(requestsInProgress_[RequestType::kServerConfigs], &server_api::BaseRequest::finished, this, &ApiResourcesManager::onServerConfigsAnswer);
 }
 
@@ -378,7 +409,8 @@ void ApiResourcesManager::fetchServerCredentialsOpenVpn(const QString &authHash)
 {
     if (requestsInProgress_.contains(RequestType::kServerCredentialsOpenVPN))
         return;
-    requestsInProgress_[RequestType::kServerCredentialsOpenVPN] = serverAPI_->serverCredentials(authHash, types::Protocol::OPENVPN_UDP);
+    requestsInProgress_[RequestType::kServerCredentialsOpenVPN] = serverAPI_->serverCredentials(authHash, types::Protocol::OPENVPN_UDP,
+                                                                                                      receivedResources_.contains(RequestType::kServerCredentialsOpenVPN));
     connect(requestsInProgress_[RequestType::kServerCredentialsOpenVPN], &server_api::BaseRequest::finished, this, &ApiResourcesManager::onServerCredentialsOpenVpnAnswer);
 }
 
@@ -386,7 +418,8 @@ void ApiResourcesManager::fetchServerCredentialsIkev2(const QString &authHash)
 {
     if (requestsInProgress_.contains(RequestType::kServerCredentialsIkev2))
         return;
-    requestsInProgress_[RequestType::kServerCredentialsIkev2] = serverAPI_->serverCredentials(authHash, types::Protocol::IKEV2);
+    requestsInProgress_[RequestType::kServerCredentialsIkev2] = serverAPI_->serverCredentials(authHash, types::Protocol::IKEV2,
+                                                                                                   receivedResources_.contains(RequestType::kServerCredentialsIkev2));
     connect(requestsInProgress_[RequestType::kServerCredentialsIkev2], &server_api::BaseRequest::finished, this, &ApiResourcesManager::onServerCredentialsIkev2Answer);
 }
 
@@ -394,7 +427,8 @@ void ApiResourcesManager::fetchLocations()
 {
     if (requestsInProgress_.contains(RequestType::kLocations))
         return;
-    requestsInProgress_[RequestType::kLocations] = serverAPI_->serverLocations("en", apiInfo_.getSessionStatus().getRevisionHash(), apiInfo_.getSessionStatus().isPremium(), apiInfo_.getSessionStatus().getAlc());
+    requestsInProgress_[RequestType::kLocations] = serverAPI_->serverLocations("en", apiInfo_.getSessionStatus().getRevisionHash(), apiInfo_.getSessionStatus().isPremium(), apiInfo_.getSessionStatus().getAlc(),
+                                                                             receivedResources_.contains(RequestType::kLocations));
     connect(requestsInProgress_[RequestType::kLocations], &server_api::BaseRequest::finished, this, &ApiResourcesManager::onServerLocationsAnswer);
 }
 
@@ -402,7 +436,7 @@ void ApiResourcesManager::fetchPortMap(const QString &authHash)
 {
     if (requestsInProgress_.contains(RequestType::kPortMap))
         return;
-    requestsInProgress_[RequestType::kPortMap] = serverAPI_->portMap(authHash);
+    requestsInProgress_[RequestType::kPortMap] = serverAPI_->portMap(authHash, receivedResources_.contains(RequestType::kPortMap));
     connect(requestsInProgress_[RequestType::kPortMap], &server_api::BaseRequest::finished, this, &ApiResourcesManager::onPortMapAnswer);
 }
 
@@ -412,10 +446,12 @@ void ApiResourcesManager::fetchStaticIps(const QString &authHash)
         return;
 
     if (apiInfo_.getSessionStatus().getStaticIpsCount() > 0) {
-        requestsInProgress_[RequestType::kStaticIps] = serverAPI_->staticIps(authHash, GetDeviceId::instance().getDeviceId());
+        requestsInProgress_[RequestType::kStaticIps] = serverAPI_->staticIps(authHash, GetDeviceId::instance().getDeviceId(),
+                                                                                receivedResources_.contains(RequestType::kStaticIps));
         connect(requestsInProgress_[RequestType::kStaticIps], &server_api::BaseRequest::finished, this, &ApiResourcesManager::onStaticIpsAnswer);
     } else {
         apiInfo_.setStaticIps(apiinfo::StaticIps());
+        receivedResources_.remove(RequestType::kStaticIps);
         lastUpdateTimeMs_[RequestType::kStaticIps] = QDateTime::currentMSecsSinceEpoch();
         checkForReadyLogin();
     }
@@ -425,7 +461,7 @@ void ApiResourcesManager::fetchNotifications(const QString &authHash)
 {
     if (requestsInProgress_.contains(RequestType::kNotifications))
         return;
-    requestsInProgress_[RequestType::kNotifications] = serverAPI_->notifications(authHash);
+    requestsInProgress_[RequestType::kNotifications] = serverAPI_->notifications(authHash, receivedResources_.contains(RequestType::kNotifications));
     connect(requestsInProgress_[RequestType::kNotifications], &server_api::BaseRequest::finished, this, &ApiResourcesManager::onNotificationsAnswer);
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "engine/serverapi/serverapi.h"
+#include "engine/serverapi/responsecache.h"
 #include "engine/apiinfo/apiinfo.h"
 #include "engine/connectstatecontroller/iconnectstatecontroller.h"
 #include "engine/serverapi/requests/sessionerrorcode.h"
@@ -39,7 +40,11 @@ public:
     static bool isAuthHashExists() { return !apiinfo::ApiInfo::getAuthHash().isEmpty(); }
     static QString authHash() { return apiinfo::ApiInfo::getAuthHash(); }
     static bool isCanBeLoadFromSettings();
-    static void removeFromSettings() { apiinfo::ApiInfo::removeFromSettings(); }
+    static void removeFromSettings()
+    {
+        apiinfo::ApiInfo::removeFromSettings();
+        server_api::ResponseCache::instance().clear();
+    }
 
     types::SessionStatus sessionStatus() const { return apiInfo_.getSessionStatus(); }
     types::PortMap portMap() const { return apiInfo_.getPortMap(); }
@@ -90,6 +95,8 @@ private:
 
     QHash<RequestType, qint64> lastUpdateTimeMs_;
     QHash<RequestType, QPointer<server_api::BaseRequest>> requestsInProgress_;
+    // the resources whose data was received from the API and is still held, only they are requested conditionally (see ResponseCache)
+    QSet<RequestType> receivedResources_;
     QTimer *fetchTimer_;
 
     types::SessionStatus prevSessionStatus_;
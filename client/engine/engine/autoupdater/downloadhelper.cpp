@@ -201,6 +201,8 @@ void DownloadHelper::getInner(const QString url, const QString targetFilenamePat
 
     NetworkRequest request(QUrl(url), 60000 * 5, true);     // timeout 5 mins
     request.setRemoveFromWhitelistIpsAfterFinish();
+    // written to the file on readyRead, in chunks of up to 4 MB instead of one per curl chunk
+    request.setCoalesceBody(true);
 
     NetworkReply *reply = networkAccessManager_->get(request);
     replies_.insert(reply, fileAndProgess);
@@ -0,0 +1,413 @@
+#include "areschannelloop.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "utils/crashhandler.h"
+#include "utils/logger.h"
+#include "utils/ws_assert.h"
+
+AresChannelLoop::AresChannelLoop() : bNeedFinish_(false)
+{
+    if (pipe(wakeupPipe_) == 0) {
+        fcntl(wakeupPipe_[0], F_SETFL, fcntl(wakeupPipe_[0], F_GETFL) | O_NONBLOCK);
+        fcntl(wakeupPipe_[1], F_SETFL, fcntl(wakeupPipe_[1], F_GETFL) | O_NONBLOCK);
+    } else {
+        qCDebug(LOG_BASIC) << "AresChannelLoop: can't create the wakeup pipe";
+        wakeupPipe_[0] = wakeupPipe_[1] = -1;
+    }
+    start(LowPriority);
+}
+
+AresChannelLoop::~AresChannelLoop()
+{
+    bNeedFinish_ = true;
+    wakeup();
+    wait();
+    if (wakeupPipe_[0] != -1) {
+        close(wakeupPipe_[0]);
+        close(wakeupPipe_[1]);
+    }
+}
+
+void AresChannelLoop::lookup(const QString &hostname, const QStringList &dnsServers, int timeoutMs, bool isDualStack, Callback callback)
+{
+    Query *query = new Query();
+    query->hostname = hostname;
+    query->dnsServers = dnsServers;
+    query->timeoutMs = timeoutMs;
+    query->isDualStack = isDualStack;
+    query->callback = callback;
+    query->loop = this;
+    query->elapsedTimer.start();
+
+    {
+        QMutexLocker locker(&mutex_);
+        newQueries_.enqueue(query);
+    }
+    wakeup();
+}
+
+void AresChannelLoop::run()
+{
+    BIND_CRASH_HANDLER_FOR_THREAD();
+    loopTimer_.start();
+
+    QVector<pollfd> fds;
+    QVector<Channel *> fdChannels;
+
+    while (!bNeedFinish_) {
+        startQueries();
+        processTimeouts();
+        startRetries();
+
+        const QVector<Channel *> channels = allChannels();
+        fds.clear();
+        fdChannels.clear();
+        fds.push_back({ wakeupPipe_[0], POLLIN, 0 });
+        fdChannels.push_back(nullptr);
+        for (Channel *channel : channels) {
+            for (auto it = channel->sockets.cbegin(); it != channel->sockets.cend(); ++it) {
+                fds.push_back({ it.key(), (short)it.value(), 0 });
+                fdChannels.push_back(channel);
+            }
+        }
+
+        int ret = poll(fds.data(), fds.size(), nextTimeoutMs());
+        if (ret < 0 && errno != EINTR) {
+            qCDebug(LOG_BASIC) << "AresChannelLoop: poll failed:" << errno;
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            char buf[64];
+            while (read(wakeupPipe_[0], buf, sizeof(buf)) > 0) {}
+        }
+
+        for (int i = 1; i < fds.size(); ++i) {
+            if (fds[i].revents == 0)
+                continue;
+            ares_socket_t readFd = (fds[i].revents & (POLLIN | POLLERR | POLLHUP)) ? fds[i].fd : ARES_SOCKET_BAD;
+            ares_socket_t writeFd = (fds[i].revents & POLLOUT) ? fds[i].fd : ARES_SOCKET_BAD;
+            ares_process_fd(fdChannels[i]->channel, readFd, writeFd);
+        }
+
+        // let cares handle its own timeouts and retransmissions
+        for (Channel *channel : channels)
+            ares_process_fd(channel->channel, ARES_SOCKET_BAD, ARES_SOCKET_BAD);
+
+        destroyDrainedChannels();
+    }
+
+    // pending queries are finished with ARES_ECANCELLED from the callback (status ARES_EDESTRUCTION)
+    const QVector<Channel *> channels = allChannels();
+    for (Channel *channel : channels)
+        destroyChannel(channel);
+    while (!retries_.isEmpty()) {
+        Query *query = retries_.first();
+        retries_.erase(retries_.begin());
+        finishQuery(query, QStringList(), ARES_ECANCELLED);
+        delete query;
+    }
+
+    QMutexLocker locker(&mutex_);
+    while (!newQueries_.isEmpty()) {
+        Query *query = newQueries_.dequeue();
+        query->callback(QStringList(), ARES_ECANCELLED, query->elapsedTimer.elapsed(), 0);
+        delete query;
+    }
+}
+
+void AresChannelLoop::wakeup()
+{
+    if (wakeupPipe_[1] != -1) {
+        char c = 0;
+        // if the pipe is full, the loop is going to wake up anyway
+        ssize_t ret = write(wakeupPipe_[1], &c, 1);
+        Q_UNUSED(ret);
+    }
+}
+
+void AresChannelLoop::startQueries()
+{
+    QQueue<Query *> queries;
+    {
+        QMutexLocker locker(&mutex_);
+        queries.swap(newQueries_);
+    }
+
+    for (Query *query : qAsConst(queries)) {
+        query->deadline = loopTimer_.elapsed() + query->timeoutMs - query->elapsedTimer.elapsed();
+        deadlines_.insert(query->deadline, query);
+        query->channel = channelForServers(query->dnsServers);
+        if (query->channel) {
+            sendQuery(query);
+        } else {
+            finishQuery(query, QStringList(), ARES_ENOMEM);
+            delete query;
+        }
+    }
+}
+
+void AresChannelLoop::sendQuery(Query *query)
+{
+    query->channel->pendingQueries++;
+    // the callback can be called synchronously (for example, for IP-address or a hostname from the hosts file),
+    // so the query must not be accessed after this call
+    ares_getaddrinfo(query->channel->channel, query->hostname.toStdString().c_str(), NULL, &addrInfoHints(query->isDualStack), addrInfoCallback, query);
+}
+
+void AresChannelLoop::finishQuery(Query *query, const QStringList &ips, int status, quint32 ttl)
+{
+    if (query->isFinished)
+        return;
+    query->isFinished = true;
+    deadlines_.remove(query->deadline, query);
+    query->callback(ips, status, query->elapsedTimer.elapsed(), ttl);
+}
+
+void AresChannelLoop::processTimeouts()
+{
+    const qint64 now = loopTimer_.elapsed();
+    while (!deadlines_.isEmpty() && deadlines_.firstKey() <= now) {
+        Query *query = deadlines_.first();
+        finishQuery(query, QStringList(), ARES_ETIMEOUT);
+        // a query in cares stays there until it completes on its own, then it's deleted in the addrInfoCallback
+        if (!query->channel) {
+            retries_.remove(query->retryTime, query);
+            delete query;
+        }
+    }
+}
+
+void AresChannelLoop::scheduleRetry(Query *query, int status)
+{
+    // a timeout has already waited for the answer, the fast failures would make the loop spin on a refusing server
+    qint64 delayMs = 0;
+    if (status != ARES_ETIMEOUT)
+        delayMs = qMin((qint64)kRetryMaxDelayMs, (qint64)kRetryInitialDelayMs << qMin(query->retriesCount, 16));
+    query->retriesCount++;
+    query->channel = nullptr;
+    query->retryTime = loopTimer_.elapsed() + delayMs;
+    retries_.insert(query->retryTime, query);
+}
+
+void AresChannelLoop::startRetries()
+{
+    // taken first, a retry can fail synchronously and be scheduled again
+    QVector<Query *> queries;
+    const qint64 now = loopTimer_.elapsed();
+    while (!retries_.isEmpty() && retries_.firstKey() <= now) {
+        queries << retries_.first();
+        retries_.erase(retries_.begin());
+    }
+
+    for (Query *query : qAsConst(queries)) {
+        query->channel = channelForServers(query->dnsServers);
+        if (query->channel) {
+            sendQuery(query);
+        } else {
+            finishQuery(query, QStringList(), ARES_ENOMEM);
+            delete query;
+        }
+    }
+}
+
+AresChannelLoop::Channel *AresChannelLoop::channelForServers(const QStringList &dnsServers)
+{
+    const QString key = dnsServers.join(",");
+    auto it = channels_.find(key);
+    if (it != channels_.end()) {
+        Channel *channel = it.value();
+        if (channel->age.elapsed() < kChannelMaxAgeMs)
+            return channel;
+        // recreate the channel to reread the OS DNS configuration, a busy one is kept until its queries complete
+        if (channel->pendingQueries > 0) {
+            channels_.erase(it);
+            retiredChannels_ << channel;
+        } else {
+            destroyChannel(channel);
+        }
+    }
+    return createChannel(dnsServers);
+}
+
+AresChannelLoop::Channel *AresChannelLoop::createChannel(const QStringList &dnsServers)
+{
+    Channel *channel = new Channel();
+    channel->dnsServersKey = dnsServers.join(",");
+
+    struct ares_options options;
+    memset(&options, 0, sizeof(options));
+    int optmask = ARES_OPT_TRIES | ARES_OPT_TIMEOUTMS | ARES_OPT_SOCK_STATE_CB;
+    options.tries = kChannelTries;
+    options.timeout = kChannelTimeoutMs;
+    options.sock_state_cb = sockStateCallback;
+    options.sock_state_cb_data = channel;
+
+    int status = ares_init_options(&channel->channel, &options, optmask);
+    if (status != ARES_SUCCESS) {
+        qCDebug(LOG_BASIC) << "ares_init_options failed:" << QString::fromStdString(ares_strerror(status));
+        delete channel;
+        return nullptr;
+    }
+
+    if (!dnsServers.isEmpty()) {
+        status = ares_set_servers_ports_csv(channel->channel, channel->dnsServersKey.toStdString().c_str());
+        if (status != ARES_SUCCESS) {
+            qCDebug(LOG_BASIC) << "ares_set_servers_ports_csv failed:" << QString::fromStdString(ares_strerror(status));
+            ares_destroy(channel->channel);
+            delete channel;
+            return nullptr;
+        }
+    }
+
+    channel->age.start();
+    channels_[channel->dnsServersKey] = channel;
+    return channel;
+}
+
+void AresChannelLoop::destroyChannel(Channel *channel)
+{
+    if (channels_.value(channel->dnsServersKey) == channel)
+        channels_.remove(channel->dnsServersKey);
+    retiredChannels_.removeOne(channel);
+    ares_destroy(channel->channel);
+    WS_ASSERT(channel->pendingQueries == 0);
+    delete channel;
+}
+
+void AresChannelLoop::destroyDrainedChannels()
+{
+    // not from the callbacks, a channel can't be destroyed while cares is inside it
+    for (int i = retiredChannels_.size() - 1; i >= 0; --i) {
+        if (retiredChannels_[i]->pendingQueries == 0)
+            destroyChannel(retiredChannels_[i]);
+    }
+}
+
+QVector<AresChannelLoop::Channel *> AresChannelLoop::allChannels() const
+{
+    QVector<Channel *> channels = retiredChannels_;
+    for (Channel *channel : channels_)
+        channels << channel;
+    return channels;
+}
+
+int AresChannelLoop::nextTimeoutMs()
+{
+    qint64 timeoutMs = -1;  // infinite, until a new query or socket activity
+    if (!deadlines_.isEmpty())
+        timeoutMs = qMax((qint64)0, deadlines_.firstKey() - loopTimer_.elapsed());
+    if (!retries_.isEmpty()) {
+        const qint64 retryTimeoutMs = qMax((qint64)0, retries_.firstKey() - loopTimer_.elapsed());
+        if (timeoutMs == -1 || retryTimeoutMs < timeoutMs)
+            timeoutMs = retryTimeoutMs;
+    }
+
+    const QVector<Channel *> channels = allChannels();
+    for (Channel *channel : channels) {
+        timeval tv;
+        if (ares_timeout(channel->channel, NULL, &tv) != NULL) {
+            qint64 channelTimeoutMs = (qint64)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+            if (timeoutMs == -1 || channelTimeoutMs < timeoutMs)
+                timeoutMs = channelTimeoutMs;
+        }
+    }
+    return (int)timeoutMs;
+}
+
+void AresChannelLoop::sockStateCallback(void *data, ares_socket_t socket, int readable, int writable)
+{
+    Channel *channel = static_cast<Channel *>(data);
+    if (!readable && !writable)
+        channel->sockets.remove(socket);
+    else
+        channel->sockets[socket] = (readable ? POLLIN : 0) | (writable ? POLLOUT : 0);
+}
+
+void AresChannelLoop::addrInfoCallback(void *arg, int status, int timeouts, struct ares_addrinfo *result)
+{
+    Q_UNUSED(timeouts);
+    Query *query = static_cast<Query *>(arg);
+    AresChannelLoop *loop = query->loop;
+    query->channel->pendingQueries--;
+
+    QStringList addresses;
+    quint32 ttl = 0;
+    if (result) {
+        addresses = extractAddrInfo(result, ttl);
+        ares_freeaddrinfo(result);
+    }
+
+    if (query->isFinished) {
+        delete query;
+        return;
+    }
+
+    if (status == ARES_SUCCESS) {
+        loop->finishQuery(query, addresses, status, ttl);
+    } else if (status == ARES_EDESTRUCTION) {
+        loop->finishQuery(query, QStringList(), ARES_ECANCELLED);
+    } else if (isRetryableStatus(status) && query->elapsedTimer.elapsed() < query->timeoutMs && !loop->bNeedFinish_) {
+        // resent from the loop, since the channel can't be recreated while we are inside its callback
+        loop->scheduleRetry(query, status);
+        return;
+    } else {
+        loop->finishQuery(query, QStringList(), status);
+    }
+    delete query;
+}
+
+const ares_addrinfo_hints &AresChannelLoop::addrInfoHints(bool isDualStack)
+{
+    // with AF_UNSPEC cares sends the A and AAAA queries at the same time
+    static const auto makeHints = [](int family) {
+        ares_addrinfo_hints h;
+        memset(&h, 0, sizeof(h));
+        h.ai_family = family;
+        return h;
+    };
+    static const ares_addrinfo_hints ipv4Hints = makeHints(AF_INET);
+    static const ares_addrinfo_hints dualStackHints = makeHints(AF_UNSPEC);
+    return isDualStack ? dualStackHints : ipv4Hints;
+}
+
+QStringList AresChannelLoop::extractAddrInfo(const ares_addrinfo *result, quint32 &outTtl)
+{
+    QStringList addresses;
+    bool isFirst = true;
+    outTtl = 0;
+    for (const ares_addrinfo_node *node = result->nodes; node; node = node->ai_next) {
+        char addr_buf[INET6_ADDRSTRLEN] = "??";
+        if (node->ai_family == AF_INET)
+            ares_inet_ntop(AF_INET, &((const sockaddr_in *)node->ai_addr)->sin_addr, addr_buf, sizeof(addr_buf));
+        else if (node->ai_family == AF_INET6)
+            ares_inet_ntop(AF_INET6, &((const sockaddr_in6 *)node->ai_addr)->sin6_addr, addr_buf, sizeof(addr_buf));
+        else
+            continue;
+        const QString address = QString::fromStdString(addr_buf);
+        if (!addresses.contains(address))
+            addresses << address;
+        // the smallest TTL of the records, the numeric hosts and the hosts file entries have zero TTL
+        const quint32 ttl = (quint32)qMax(node->ai_ttl, 0);
+        if (isFirst || ttl < outTtl)
+            outTtl = ttl;
+        isFirst = false;
+    }
+    return addresses;
+}
+
+bool AresChannelLoop::isNegativeAnswerStatus(int status)
+{
+    return status == ARES_ENOTFOUND || status == ARES_ENODATA || status == ARES_ESERVFAIL || status == ARES_ETIMEOUT;
+}
+
+bool AresChannelLoop::isRetryableStatus(int status)
+{
+    // definitive answers (no such domain, bad name, etc.) are not retried
+    return status == ARES_ETIMEOUT || status == ARES_ECONNREFUSED || status == ARES_ESERVFAIL;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMultiMap>
+#include <QMutex>
+#include <QQueue>
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+#include <functional>
+
+#include "ares.h"
+
+// Long-lived cares channels driven by a single thread with a poll() loop (for Mac/Linux).
+// Unlike the LookupJob in DnsResolver_posix it doesn't create a channel (parse /etc/resolv.conf) for every lookup
+// and doesn't occupy a thread per query, so thousands of lookups are multiplexed over a few sockets.
+// One channel is created for every distinct list of DNS servers. The channels are recreated periodically to pick up changes
+// of the OS default DNS servers: after kChannelMaxAgeMs the new queries go to a new channel, the old one is destroyed once
+// its pending queries complete.
+class AresChannelLoop : public QThread
+{
+public:
+    // ips is empty on error, aresStatus is one of the cares status codes (ARES_SUCCESS, ARES_ETIMEOUT, ...),
+    // ttl is the smallest TTL of the records in seconds (0 if unknown)
+    typedef std::function<void(const QStringList &ips, int aresStatus, qint64 elapsedMs, quint32 ttl)> Callback;
+
+    AresChannelLoop();
+    virtual ~AresChannelLoop();
+
+    // Thread safe. The callback is called from the loop thread.
+    // dnsServers can contain the port ("127.0.0.1:5353"), if empty then use the OS default DNS servers.
+    // If isDualStack is true, the A and AAAA queries are sent in parallel and the results are merged.
+    void lookup(const QString &hostname, const QStringList &dnsServers, int timeoutMs, bool isDualStack, Callback callback);
+
+    // helpers shared with the LookupJob of DnsResolver_posix
+    static const ares_addrinfo_hints &addrInfoHints(bool isDualStack);
+    static QStringList extractAddrInfo(const ares_addrinfo *result, quint32 &outTtl);
+    // the failure is the answer of the DNS server or a timeout, so it can be cached
+    static bool isNegativeAnswerStatus(int status);
+    // the failure may go away on a new attempt (a timeout, a refused connection, SERVFAIL), the definitive answers are not retried
+    static bool isRetryableStatus(int status);
+
+protected:
+    void run() override;
+
+private:
+    static constexpr int kChannelTimeoutMs = 2000;
+    static constexpr int kChannelTries = 1;
+    static constexpr int kChannelMaxAgeMs = 30000;
+    // the retries of the fast failures (a refused connection, SERVFAIL) back off from kRetryInitialDelayMs to kRetryMaxDelayMs
+    static constexpr int kRetryInitialDelayMs = 100;
+    static constexpr int kRetryMaxDelayMs = 1000;
+
+    struct Channel
+    {
+        ares_channel channel = nullptr;
+        QString dnsServersKey;
+        QHash<ares_socket_t, int> sockets;      // socket -> poll events
+        int pendingQueries = 0;
+        QElapsedTimer age;
+    };
+
+    struct Query
+    {
+        QString hostname;
+        QStringList dnsServers;
+        int timeoutMs = 0;
+        bool isDualStack = false;
+        Callback callback;
+        QElapsedTimer elapsedTimer;
+        qint64 deadline = 0;            // in loopTimer_ ms
+        Channel *channel = nullptr;     // nullptr while waiting for the retry
+        int retriesCount = 0;
+        qint64 retryTime = 0;           // in loopTimer_ ms
+        bool isFinished = false;        // the callback was already called (timeout), waiting for cares to release the query
+        AresChannelLoop *loop = nullptr;
+    };
+
+    std::atomic<bool> bNeedFinish_;
+    int wakeupPipe_[2];
+
+    QMutex mutex_;
+    QQueue<Query *> newQueries_;
+
+    // accessed from the loop thread only
+    QElapsedTimer loopTimer_;
+    QHash<QString, Channel *> channels_;
+    QVector<Channel *> retiredChannels_;    // replaced by the new channels, destroyed when their pending queries complete
+    QMultiMap<qint64, Query *> deadlines_;
+    QMultiMap<qint64, Query *> retries_;
+
+    void wakeup();
+    void startQueries();
+    void sendQuery(Query *query);
+    void finishQuery(Query *query, const QStringList &ips, int status, quint32 ttl = 0);
+    void processTimeouts();
+    void scheduleRetry(Query *query, int status);
+    void startRetries();
+    Channel *channelForServers(const QStringList &dnsServers);
+    Channel *createChannel(const QStringList &dnsServers);
+    void destroyChannel(Channel *channel);
+    void destroyDrainedChannels();
+    QVector<Channel *> allChannels() const;
+    int nextTimeoutMs();
+
+    static void sockStateCallback(void *data, ares_socket_t socket, int readable, int writable);
+    static void addrInfoCallback(void *arg, int status, int timeouts, struct ares_addrinfo *result);
+};
@@ -1,4 +1,5 @@
 #include "dnsrequest.h"
+#include "dnsresolver_doh.h"
 #include "idnsresolver.h"
 #include "utils/logger.h"
 #ifdef Q_OS_WIN
@@ -49,22 +50,51 @@ qint64 DnsRequest::elapsedMs() const
     return elapsedMs_;
 }
 
+quint32 DnsRequest::ttl() const
+{
+    return ttl_;
+}
+
+bool DnsRequest::isNegativeAnswer() const
+{
+    return isError() && isNegativeAnswer_;
+}
+
+void DnsRequest::setDualStack(bool isDualStack)
+{
+    isDualStack_ = isDualStack;
+}
+
+void DnsRequest::setDnsOverHttps(bool isDnsOverHttps)
+{
+    isDnsOverHttps_ = isDnsOverHttps;
+}
+
 void DnsRequest::lookup()
 {
    privateDnsRequestObject_ = QSharedPointer<DnsRequestPrivate>(new DnsRequestPrivate, &QObject::deleteLater);
    privateDnsRequestObject_->moveToThread(this->thread());
    connect(privateDnsRequestObject_.staticCast<DnsRequestPrivate>().get(), &DnsRequestPrivate::resolved, this, &DnsRequest::onResolved);
-   dnsResolver_.lookup(hostname_, privateDnsRequestObject_.staticCast<QObject>(), dnsServers_, timeoutMs_);
+   resolver().lookup(hostname_, privateDnsRequestObject_.staticCast<QObject>(), dnsServers_, timeoutMs_, isDualStack_);
 }
 
 void DnsRequest::lookupBlocked()
 {
-    ips_ = dnsResolver_.lookupBlocked(hostname_, dnsServers_, timeoutMs_, &error_);
+    ips_ = resolver().lookupBlocked(hostname_, dnsServers_, timeoutMs_, &error_);
+}
+
+IDnsResolver &DnsRequest::resolver() const
+{
+    if (isDnsOverHttps_ && DnsResolver_doh::instance().isEnabled())
+        return DnsResolver_doh::instance();
+    return dnsResolver_;
 }
 
-void DnsRequest::onResolved(const QStringList &ips, const QString &error, qint64 elapsedMs)
+void DnsRequest::onResolved(const QStringList &ips, const QString &error, qint64 elapsedMs, quint32 ttl, bool isNegativeAnswer)
 {
     elapsedMs_ = elapsedMs;
+    ttl_ = ttl;
+    isNegativeAnswer_ = isNegativeAnswer;
     error_ = error;
     ips_ = ips;
     if (isError()) {
@@ -73,7 +103,7 @@ void DnsRequest::onResolved(const QStringList &ips, const QString &error, qint64
     emit finished();
 }
 
-void DnsRequestPrivate::onResolved(const QStringList &ips, const QString &error, qint64 elapsedMs)
+void DnsRequestPrivate::onResolved(const QStringList &ips, const QString &error, qint64 elapsedMs, quint32 ttl, bool isNegativeAnswer)
 {
-    emit resolved(ips, error, elapsedMs);
+    emit resolved(ips, error, elapsedMs, ttl, isNegativeAnswer);
 }
@@ -14,6 +14,11 @@ public:
     explicit DnsRequest(QObject *parent, const QString &hostname, const QStringList &dnsServers = QStringList(), int timeoutMs = 5000);
     virtual ~DnsRequest();
 
+    // query the AAAA records in parallel with the A records, only for lookup() (Mac/Linux only, ignored on Windows)
+    void setDualStack(bool isDualStack);
+    // resolve with DnsResolver_doh instead of the system resolver if it's enabled (has the upstreams), the dnsServers are ignored then
+    void setDnsOverHttps(bool isDnsOverHttps);
+
     void lookup();
     void lookupBlocked();
 
@@ -22,21 +27,32 @@ public:
     bool isError() const;
     QString errorString() const;
     qint64 elapsedMs() const;
+    // the smallest TTL of the received records in seconds, 0 if unknown
+    quint32 ttl() const;
+    // the failure is the answer of the DNS server (NXDOMAIN, no records, SERVFAIL) or a timeout,
+    // not a local error (cancelled, no network, bad configuration), so it can be cached
+    bool isNegativeAnswer() const;
 
 signals:
     void finished();
 
 private slots:
-    void onResolved(const QStringList &ips, const QString &error, qint64 elapsedMs);
+    void onResolved(const QStringList &ips, const QString &error, qint64 elapsedMs, quint32 ttl, bool isNegativeAnswer);
 
 private:
+    IDnsResolver &resolver() const;
+
     IDnsResolver &dnsResolver_;
     QString hostname_;
     QStringList ips_;
     QStringList dnsServers_;
     int timeoutMs_;
+    bool isDualStack_ = false;
+    bool isDnsOverHttps_ = false;
     QString error_;
     qint64 elapsedMs_;
+    quint32 ttl_ = 0;
+    bool isNegativeAnswer_ = false;
     // this object is shared with DnsResolver object
     // we need to store it here otherwise it may be deleted by DnsResolver before the signal finished() is emitted
     QSharedPointer<QObject> privateDnsRequestObject_;
@@ -48,8 +64,8 @@ class DnsRequestPrivate : public QObject
     Q_OBJECT
 
 signals:
-    void resolved(const QStringList &ips,  const QString &error, qint64 elapsedMs);
+    void resolved(const QStringList &ips,  const QString &error, qint64 elapsedMs, quint32 ttl, bool isNegativeAnswer);
 
 private slots:
-    void onResolved(const QStringList &ips,  const QString &error, qint64 elapsedMs);
+    void onResolved(const QStringList &ips,  const QString &error, qint64 elapsedMs, quint32 ttl, bool isNegativeAnswer);
 };
@@ -0,0 +1,399 @@
+#include "dnsresolver_doh.h"
+
+#include <QHostAddress>
+#include <QSemaphore>
+#include <QTimer>
+#include <algorithm>
+#include <numeric>
+
+#include "dnswireformat.h"
+#include "engine/networkaccessmanager/curlnetworkmanager.h"
+#include "utils/logger.h"
+#include "utils/ws_assert.h"
+
+DnsResolver_doh::DnsResolver_doh() : isEnabled_(false)
+{
+    thread_ = new QThread();
+    client_ = new DohClient();
+    client_->moveToThread(thread_);
+    thread_->start();
+}
+
+DnsResolver_doh::~DnsResolver_doh()
+{
+    // a blocking call to the thread is not possible here, the event loops can be gone already
+    WS_ASSERT(thread_ == nullptr);
+}
+
+void DnsResolver_doh::shutdown()
+{
+    WS_ASSERT(QThread::currentThread() != thread_);
+    DohClient *client;
+    {
+        QMutexLocker locker(&mutex_);
+        if (!client_)
+            return;
+        client = client_;
+        client_ = nullptr;
+        isEnabled_ = false;
+    }
+
+    // the client and its curl manager must be deleted in the client thread, after the lookups queued to it
+    QMetaObject::invokeMethod(client, [client]() {
+        delete client;
+    }, Qt::BlockingQueuedConnection);
+    thread_->quit();
+    thread_->wait();
+    delete thread_;
+    thread_ = nullptr;
+}
+
+void DnsResolver_doh::setUpstreams(const QVector<Upstream> &upstreams)
+{
+    QMutexLocker locker(&mutex_);
+    if (!client_)
+        return;
+    isEnabled_ = !upstreams.isEmpty();
+    client_->setUpstreams(upstreams);
+}
+
+QVector<DnsResolver_doh::Upstream> DnsResolver_doh::upstreams() const
+{
+    QMutexLocker locker(&mutex_);
+    return client_ ? client_->upstreams() : QVector<Upstream>();
+}
+
+bool DnsResolver_doh::isEnabled() const
+{
+    QMutexLocker locker(&mutex_);
+    return isEnabled_;
+}
+
+QVector<DnsResolver_doh::UpstreamStatistics> DnsResolver_doh::statistics() const
+{
+    QMutexLocker locker(&mutex_);
+    return client_ ? client_->statistics() : QVector<UpstreamStatistics>();
+}
+
+QVector<DnsResolver_doh::Upstream> DnsResolver_doh::parseUpstreams(const QString &str)
+{
+    QVector<Upstream> upstreams;
+    const QStringList entries = str.split(';', Qt::SkipEmptyParts);
+    for (const QString &entry : entries) {
+        const QStringList parts = entry.trimmed().split('@');
+        Upstream upstream;
+        upstream.url = QUrl(parts.first().trimmed(), QUrl::StrictMode);
+        if (!upstream.url.isValid() || upstream.url.host().isEmpty() ||
+            (upstream.url.scheme() != "https" && upstream.url.scheme() != "http")) {
+            qCDebug(LOG_BASIC) << "DnsResolver_doh: invalid upstream URL skipped";
+            continue;
+        }
+        if (parts.size() > 1) {
+            const QStringList ips = parts[1].split(',', Qt::SkipEmptyParts);
+            for (const QString &ip : ips) {
+                if (!QHostAddress(ip.trimmed()).isNull())
+                    upstream.ips << ip.trimmed();
+            }
+        }
+        if (upstream.ips.isEmpty() && QHostAddress(upstream.url.host()).isNull()) {
+            // resolving the upstream itself with the system resolver would defeat the purpose
+            qCDebug(LOG_BASIC) << "DnsResolver_doh: the upstream" << upstream.url.host() << "has no IP addresses, skipped";
+            continue;
+        }
+        upstreams << upstream;
+    }
+    return upstreams;
+}
+
+void DnsResolver_doh::lookup(const QString &hostname, QSharedPointer<QObject> object, const QStringList &dnsServers, int timeoutMs, bool isDualStack)
+{
+    Q_UNUSED(dnsServers);
+    QMutexLocker locker(&mutex_);
+    if (!client_) {
+        bool bSuccess = QMetaObject::invokeMethod(object.get(), "onResolved",
+                        Qt::QueuedConnection, Q_ARG(QStringList, QStringList()), Q_ARG(QString, QString("DoH: shut down")), Q_ARG(qint64, 0),
+                        Q_ARG(quint32, 0), Q_ARG(bool, false));
+        WS_ASSERT(bSuccess);
+        return;
+    }
+    // the queued call runs before the deletion of the client in shutdown()
+    DohClient *client = client_;
+    QMetaObject::invokeMethod(client, [client, hostname, object, timeoutMs, isDualStack]() {
+        client->lookup(hostname, timeoutMs, isDualStack, [object](const QStringList &ips, const QString &error, qint64 elapsedMs, quint32 ttl, bool isNegativeAnswer) {
+            bool bSuccess = QMetaObject::invokeMethod(object.get(), "onResolved",
+                            Qt::QueuedConnection, Q_ARG(QStringList, ips), Q_ARG(QString, error), Q_ARG(qint64, elapsedMs),
+                            Q_ARG(quint32, ttl), Q_ARG(bool, isNegativeAnswer));
+            WS_ASSERT(bSuccess);
+        });
+    }, Qt::QueuedConnection);
+}
+
+QStringList DnsResolver_doh::lookupBlocked(const QString &hostname, const QStringList &dnsServers, int timeoutMs, QString *outError)
+{
+    Q_UNUSED(dnsServers);
+    WS_ASSERT(QThread::currentThread() != thread_);
+
+    QSemaphore semaphore;
+    QStringList result;
+    QString resultError;
+    {
+        QMutexLocker locker(&mutex_);
+        if (!client_) {
+            if (outError)
+                *outError = "DoH: shut down";
+            return QStringList();
+        }
+        DohClient *client = client_;
+        QMetaObject::invokeMethod(client, [&, client]() {
+            client->lookup(hostname, timeoutMs, false, [&](const QStringList &ips, const QString &error, qint64, quint32, bool) {
+                result = ips;
+                resultError = error;
+                semaphore.release();
+            });
+        }, Qt::QueuedConnection);
+    }
+    // released by the client destructor as well, if it's shut down in the meantime
+    semaphore.acquire();
+
+    if (outError)
+        *outError = resultError;
+    return result;
+}
+
+
+DohClient::DohClient() : generation_(0), curlNetworkManager_(nullptr)
+{
+}
+
+DohClient::~DohClient()
+{
+    // the callers of the lookups in progress get the failure
+    const QList<Exchange *> exchanges = exchanges_.values();
+    exchanges_.clear();
+    for (Exchange *exchange : exchanges) {
+        exchange->query->error = "DoH: shut down";
+        exchange->query->isTimeout = false;
+        finishExchange(exchange);
+    }
+    // deletes the replies
+    delete curlNetworkManager_;
+}
+
+void DohClient::setUpstreams(const QVector<DnsResolver_doh::Upstream> &upstreams)
+{
+    QMutexLocker locker(&mutex_);
+    upstreams_ = upstreams;
+    statistics_.clear();
+    for (const DnsResolver_doh::Upstream &upstream : upstreams) {
+        DnsResolver_doh::UpstreamStatistics statistics;
+        statistics.url = upstream.url.toString();
+        statistics_ << statistics;
+    }
+    generation_++;
+}
+
+QVector<DnsResolver_doh::Upstream> DohClient::upstreams() const
+{
+    QMutexLocker locker(&mutex_);
+    return upstreams_;
+}
+
+QVector<DnsResolver_doh::UpstreamStatistics> DohClient::statistics() const
+{
+    QMutexLocker locker(&mutex_);
+    return statistics_;
+}
+
+void DohClient::lookup(const QString &hostname, int timeoutMs, bool isDualStack, Callback callback)
+{
+    if (!curlNetworkManager_)
+        curlNetworkManager_ = new CurlNetworkManager(this);
+
+    QSharedPointer<Query> query(new Query());
+    query->hostname = hostname;
+    query->timeoutMs = timeoutMs;
+    query->callback = callback;
+    query->elapsedTimer.start();
+
+    QVector<quint16> types;
+    types << DnsWireFormat::kTypeA;
+    if (isDualStack)
+        types << DnsWireFormat::kTypeAAAA;
+
+    QVector<Exchange *> exchanges;
+    for (quint16 type : qAsConst(types)) {
+        Exchange *exchange = new Exchange();
+        exchange->query = query;
+        exchange->type = type;
+        exchange->message = DnsWireFormat::makeQuery(hostname, type);
+        exchanges << exchange;
+    }
+    if (exchanges.first()->message.isEmpty()) {
+        qDeleteAll(exchanges);
+        callback(QStringList(), "DoH: invalid hostname", 0, 0, false);
+        return;
+    }
+
+    // set before sending, since an exchange can finish right away (no upstreams)
+    query->pendingExchanges = exchanges.size();
+    for (Exchange *exchange : qAsConst(exchanges))
+        sendExchange(exchange);
+}
+
+void DohClient::sendExchange(Exchange *exchange)
+{
+    Query *query = exchange->query.get();
+    const qint64 remainingMs = query->timeoutMs - query->elapsedTimer.elapsed();
+    int upstreamInd;
+    DnsResolver_doh::Upstream upstream;
+    bool isLastUpstream = true;
+    {
+        QMutexLocker locker(&mutex_);
+        upstreamInd = nextUpstream(exchange);
+        if (upstreamInd != -1) {
+            upstream = upstreams_[upstreamInd];
+            isLastUpstream = exchange->triedUpstreams.size() + 1 >= upstreams_.size();
+            exchange->generation = generation_;
+        }
+    }
+    if (upstreamInd == -1 || remainingMs <= 0) {
+        if (remainingMs <= 0)
+            query->isTimeout = true;
+        else if (query->error.isEmpty())
+            query->error = "DoH: no upstreams";
+        finishExchange(exchange);
+        return;
+    }
+    exchange->upstream = upstreamInd;
+    exchange->triedUpstreams << upstreamInd;
+
+    // leave the time for the next upstream
+    const int attemptTimeoutMs = isLastUpstream ? (int)remainingMs : (int)qMin(remainingMs, (qint64)kAttemptTimeoutMs);
+    NetworkRequest request(upstream.url, attemptTimeoutMs, false);
+    request.setContentTypeHeader("Content-Type: application/dns-message");
+    request.setRawHeader("Accept", "application/dns-message");
+    request.setMultiplexed(true);
+    const QStringList ips = upstream.ips.isEmpty() ? QStringList() << upstream.url.host() : upstream.ips;
+
+    CurlReply *reply = curlNetworkManager_->post(request, exchange->message, ips);
+    exchange->reply = reply;
+    exchange->elapsedTimer.start();
+    exchanges_[reply] = exchange;
+    connect(reply, &CurlReply::finished, this, [this, reply]() {
+        onReplyFinished(reply, false);
+    });
+    // the timer is gone with the reply if it finished earlier
+    QTimer::singleShot(attemptTimeoutMs, reply, [this, reply]() {
+        onReplyFinished(reply, true);
+    });
+}
+
+void DohClient::onReplyFinished(CurlReply *reply, bool isTimeout)
+{
+    Exchange *exchange = exchanges_.take(reply);
+    if (!exchange)
+        return;
+    exchange->reply = nullptr;
+    // aborts the transfer if it's not finished, the connection stays in the pool otherwise
+    reply->deleteLater();
+
+    Query *query = exchange->query.get();
+    const qint64 elapsedMs = exchange->elapsedTimer.elapsed();
+    bool isCurrentGeneration;
+    {
+        QMutexLocker locker(&mutex_);
+        isCurrentGeneration = exchange->generation == generation_;
+    }
+
+    if (isTimeout) {
+        query->isTimeout = true;
+        query->error = "DoH: timeout";
+    } else if (!reply->isSuccess()) {
+        query->error = "DoH: " + reply->errorString();
+    } else if (reply->httpCode() != 200) {
+        query->error = "DoH: HTTP " + QString::number(reply->httpCode());
+    } else {
+        DnsWireFormat::Response response;
+        if (!DnsWireFormat::parseResponse(reply->readAll(), exchange->type, response)) {
+            query->error = "DoH: malformed response";
+        } else if (response.responseCode == DnsWireFormat::kNoError || response.responseCode == DnsWireFormat::kNxDomain) {
+            // the definitive answer
+            if (isCurrentGeneration)
+                updateStatistics(exchange->upstream, true, elapsedMs);
+            if (response.responseCode == DnsWireFormat::kNxDomain) {
+                query->isNxDomain = true;
+            } else {
+                query->isAnswered = true;
+                (exchange->type == DnsWireFormat::kTypeA ? query->ipv4 : query->ipv6) << response.ips;
+                if (!response.ips.isEmpty())
+                    query->ttl = query->ttl == 0 ? response.ttl : qMin(query->ttl, response.ttl);
+            }
+            finishExchange(exchange);
+            return;
+        } else {
+            // SERVFAIL, REFUSED, etc., the next upstream may do better
+            query->error = "DoH: response code " + QString::number(response.responseCode);
+        }
+    }
+
+    if (!isCurrentGeneration) {
+        // the upstreams were changed, the indexes are not valid anymore
+        finishExchange(exchange);
+        return;
+    }
+    updateStatistics(exchange->upstream, false, elapsedMs);
+    sendExchange(exchange);
+}
+
+void DohClient::finishExchange(Exchange *exchange)
+{
+    QSharedPointer<Query> query = exchange->query;
+    delete exchange;
+    if (--query->pendingExchanges > 0)
+        return;
+
+    const QStringList ips = query->ipv4 + query->ipv6;
+    const qint64 elapsedMs = query->elapsedTimer.elapsed();
+    if (!ips.isEmpty())
+        query->callback(ips, QString(), elapsedMs, query->ttl, false);
+    else if (query->isNxDomain)
+        query->callback(QStringList(), "DoH: domain name not found", elapsedMs, 0, true);
+    else if (query->isAnswered)
+        query->callback(QStringList(), "DoH: no records", elapsedMs, 0, true);
+    else
+        query->callback(QStringList(), query->error, elapsedMs, 0, query->isTimeout);
+}
+
+void DohClient::updateStatistics(int upstream, bool isSuccess, qint64 elapsedMs)
+{
+    QMutexLocker locker(&mutex_);
+    if (upstream < 0 || upstream >= statistics_.size())
+        return;
+
+    for (int i = 0; i < statistics_.size(); ++i) {
+        if (i != upstream)
+            statistics_[i].srttMs *= kSrttDecay;
+    }
+    DnsResolver_doh::UpstreamStatistics &statistics = statistics_[upstream];
+    statistics.queries++;
+    if (!isSuccess)
+        statistics.failures++;
+    // at least 1 ms, 0 means not measured
+    const double sample = isSuccess ? qMax((double)elapsedMs, 1.0) : kFailurePenaltyMs;
+    statistics.srttMs = statistics.srttMs == 0 ? sample : statistics.srttMs * (1 - kSrttAlpha) + sample * kSrttAlpha;
+}
+
+int DohClient::nextUpstream(const Exchange *exchange) const
+{
+    QVector<int> order(upstreams_.size());
+    std::iota(order.begin(), order.end(), 0);
+    // the upstreams that were not measured yet go first, then by the smoothed response time, the configured order otherwise
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+        return statistics_[a].srttMs < statistics_[b].srttMs;
+    });
+    for (int ind : qAsConst(order)) {
+        if (!exchange->triedUpstreams.contains(ind))
+            return ind;
+    }
+    return -1;
+}
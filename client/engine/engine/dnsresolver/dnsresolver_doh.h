@@ -0,0 +1,146 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QThread>
+#include <QUrl>
+#include <QVector>
+#include <functional>
+
+#include "idnsresolver.h"
+
+class CurlNetworkManager;
+class CurlReply;
+class DohClient;
+
+// DNS over HTTPS resolver (RFC 8484, for all platforms). The queries in the DNS wire format are POSTed to the configured upstreams
+// over pooled HTTP/2 connections, so the concurrent lookups are multiplexed over one connection per upstream that stays open
+// between the lookups. The upstreams are tried in the order of their smoothed response time, an upstream that fails or times out
+// is penalized and the lookup moves to the next one.
+// The dnsServers of the lookups are ignored, the upstreams are used instead.
+class DnsResolver_doh : public IDnsResolver
+{
+
+public:
+    struct Upstream
+    {
+        QUrl url;           // e.g. https://cloudflare-dns.com/dns-query
+        QStringList ips;    // the addresses of the host of the URL, not needed if the host is an IP address
+    };
+
+    struct UpstreamStatistics
+    {
+        QString url;
+        double srttMs = 0;      // smoothed response time, 0 if not measured yet
+        quint64 queries = 0;
+        quint64 failures = 0;
+    };
+
+    static DnsResolver_doh &instance()
+    {
+        static DnsResolver_doh s;
+        return s;
+    }
+
+    // Deletes the client and stops the thread, must be called before the app exits (the instance is destroyed with the statics,
+    // when the event loops are gone). The lookups in progress fail, the later ones fail right away. Not from the resolver thread.
+    void shutdown();
+
+    // Thread safe. The empty list disables the resolver, the statistics are reset.
+    void setUpstreams(const QVector<Upstream> &upstreams);
+    QVector<Upstream> upstreams() const;
+    bool isEnabled() const;
+    QVector<UpstreamStatistics> statistics() const;
+
+    // Parses "url[@ip1,ip2][;url2[@ip...]]", e.g. "https://dns.example/dns-query@192.0.2.1;https://198.51.100.1/dns-query".
+    // The invalid entries are skipped.
+    static QVector<Upstream> parseUpstreams(const QString &str);
+
+    void lookup(const QString &hostname, QSharedPointer<QObject> object, const QStringList &dnsServers, int timeoutMs, bool isDualStack) override;
+    QStringList lookupBlocked(const QString &hostname, const QStringList &dnsServers, int timeoutMs, QString *outError) override;
+
+private:
+    DnsResolver_doh();
+    virtual ~DnsResolver_doh();
+
+    mutable QMutex mutex_;
+    QThread *thread_;
+    DohClient *client_;     // lives in thread_, nullptr after shutdown()
+    bool isEnabled_;
+};
+
+// The DNS over HTTPS exchanges of DnsResolver_doh, runs in its thread. Don't use it directly.
+class DohClient : public QObject
+{
+    Q_OBJECT
+public:
+    // the callback is called in the client thread
+    typedef std::function<void(const QStringList &ips, const QString &error, qint64 elapsedMs, quint32 ttl, bool isNegativeAnswer)> Callback;
+
+    DohClient();
+    virtual ~DohClient();
+
+    void setUpstreams(const QVector<DnsResolver_doh::Upstream> &upstreams);
+    QVector<DnsResolver_doh::Upstream> upstreams() const;
+    QVector<DnsResolver_doh::UpstreamStatistics> statistics() const;
+
+    void lookup(const QString &hostname, int timeoutMs, bool isDualStack, Callback callback);
+
+private:
+    // every upstream gets at most this time to answer if there are other upstreams to try
+    static constexpr int kAttemptTimeoutMs = 2000;
+    // the weight of the new sample in the smoothed response time
+    static constexpr double kSrttAlpha = 0.3;
+    // the sample for a failed or timed out exchange
+    static constexpr double kFailurePenaltyMs = 5000;
+    // the smoothed time of the upstreams that were not chosen decays by this factor on every exchange,
+    // so a penalized upstream is retried eventually (as the SRTT decay of the recursive resolvers)
+    static constexpr double kSrttDecay = 0.98;
+
+    struct Query
+    {
+        QString hostname;
+        int timeoutMs = 0;
+        Callback callback;
+        QElapsedTimer elapsedTimer;
+        int pendingExchanges = 0;
+        QStringList ipv4;
+        QStringList ipv6;
+        quint32 ttl = 0;
+        bool isAnswered = false;    // at least one of the questions got NOERROR (maybe without the records)
+        bool isNxDomain = false;
+        bool isTimeout = false;
+        QString error;
+    };
+
+    // one question (A or AAAA) of the query, sent to the upstreams one at a time until one of them answers
+    struct Exchange
+    {
+        QSharedPointer<Query> query;
+        quint16 type = 0;
+        QByteArray message;
+        QVector<int> triedUpstreams;
+        int upstream = -1;
+        quint64 generation = 0;
+        CurlReply *reply = nullptr;
+        QElapsedTimer elapsedTimer;
+    };
+
+    mutable QMutex mutex_;      // guards upstreams_, statistics_ and generation_, they are also accessed from the other threads
+    QVector<DnsResolver_doh::Upstream> upstreams_;
+    QVector<DnsResolver_doh::UpstreamStatistics> statistics_;
+    quint64 generation_;        // incremented on setUpstreams(), the exchanges of the previous upstreams are not counted
+
+    CurlNetworkManager *curlNetworkManager_;
+    QHash<CurlReply *, Exchange *> exchanges_;
+
+    void sendExchange(Exchange *exchange);
+    void onReplyFinished(CurlReply *reply, bool isTimeout);
+    void finishExchange(Exchange *exchange);
+    void updateStatistics(int upstream, bool isSuccess, qint64 elapsedMs);
+    // the next upstream for the exchange, -1 if all of them were tried, mutex_ must be locked
+    int nextUpstream(const Exchange *exchange) const;
+};
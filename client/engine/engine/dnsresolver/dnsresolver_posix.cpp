@@ -1,10 +1,13 @@
 #include "dnsresolver_posix.h"
+#include "areschannelloop.h"
 #include "dnsutils.h"
+#include "utils/extraconfig.h"
 #include "utils/ws_assert.h"
 #include "utils/logger.h"
 #include "ares.h"
 
 #include <QRunnable>
+#include <algorithm>
 
 #if defined(Q_OS_MAC) || defined(Q_OS_LINUX)
     #include <netinet/in.h>
@@ -26,17 +29,36 @@ std::atomic_bool g_FinishAll = false;
 struct UserArg
 {
     QStringList ips;
+    quint32 ttl = 0;
     int errorCode = ARES_ECANCELLED;
 };
 
+QStringList getDnsIps(const QStringList &ips)
+{
+    if (ips.isEmpty()) {
+#if defined(Q_OS_MAC)
+        QStringList osDefaultList;  // Empty by default.
+        // On Mac, don't rely on automatic OS default DNS fetch in CARES, because it reads them from
+        // the "/etc/resolv.conf", which is sometimes not available immediately after reboot.
+        // Feed the CARES with valid OS default DNS values taken from scutil.
+        const auto listDns = DnsUtils::getOSDefaultDnsServers();
+        for (auto it = listDns.cbegin(); it != listDns.cend(); ++it)
+            osDefaultList.push_back(QString::fromStdWString(*it));
+        return osDefaultList;
+#endif
+    }
+    return ips;
+}
+
 class LookupJob : public QRunnable
 {
 public:
-     LookupJob(const QString &hostname, QSharedPointer<QObject> object, const QStringList &dnsServers, int timeoutMs) :
+     LookupJob(const QString &hostname, QSharedPointer<QObject> object, const QStringList &dnsServers, int timeoutMs, bool isDualStack) :
         hostname_(hostname),
         object_(object),
         dnsServers_(dnsServers),
         timeoutMs_(timeoutMs),
+        isDualStack_(isDualStack),
         elapsedMs_(0)
     {
     }
@@ -46,16 +68,19 @@ public:
         QElapsedTimer elapsedTimer;
         elapsedTimer.start();
 
-        while (errorCode_ != ARES_SUCCESS && elapsedTimer.elapsed() <= timeoutMs_) {
+        while (elapsedTimer.elapsed() <= timeoutMs_) {
 
-            // fill dns addresses
+            // fill dns addresses, the servers with a non-standard port ("127.0.0.1:5353") are set after the channel init
             DnsAddrs dnsAddrs;
             const QStringList dnsList = getDnsIps(dnsServers_);
-            dnsAddrs.reserve(dnsList.count());
-            for (const auto &dnsIp : dnsList) {
-                struct sockaddr_in sa;
-                ares_inet_pton(AF_INET, dnsIp.toStdString().c_str(), &(sa.sin_addr));
-                dnsAddrs.push_back(sa.sin_addr);
+            const bool isServersWithPorts = std::any_of(dnsList.cbegin(), dnsList.cend(), [](const QString &dnsIp) { return dnsIp.contains(':'); });
+            if (!isServersWithPorts) {
+                dnsAddrs.reserve(dnsList.count());
+                for (const auto &dnsIp : dnsList) {
+                    struct sockaddr_in sa;
+                    ares_inet_pton(AF_INET, dnsIp.toStdString().c_str(), &(sa.sin_addr));
+                    dnsAddrs.push_back(sa.sin_addr);
+                }
             }
 
             // create channel and set options
@@ -68,9 +93,17 @@ public:
                 qCDebug(LOG_BASIC) << "ares_init_options failed:" << QString::fromStdString(ares_strerror(status));
                 return;
             }
+            if (isServersWithPorts) {
+                status = ares_set_servers_ports_csv(channel, dnsList.join(",").toStdString().c_str());
+                if (status != ARES_SUCCESS) {
+                    qCDebug(LOG_BASIC) << "ares_set_servers_ports_csv failed:" << QString::fromStdString(ares_strerror(status));
+                    ares_destroy(channel);
+                    return;
+                }
+            }
 
             UserArg userArg;
-            ares_gethostbyname(channel, hostname_.toStdString().c_str(), AF_INET, callback, &userArg);
+            ares_getaddrinfo(channel, hostname_.toStdString().c_str(), NULL, &AresChannelLoop::addrInfoHints(isDualStack_), callback, &userArg);
 
             // process loop
             timeval tv;
@@ -92,8 +125,13 @@ public:
             ares_destroy(channel);
 
             ips_ = userArg.ips;
+            ttl_ = userArg.ttl;
             errorCode_ = userArg.errorCode;
             elapsedMs_ = elapsedTimer.elapsed();
+
+            // NXDOMAIN and the empty answers are final, they go to the negative cache right away
+            if (!AresChannelLoop::isRetryableStatus(errorCode_))
+                break;
         }
 
         if (object_) {
@@ -102,7 +140,8 @@ public:
                 errorStr = QString::fromStdString(ares_strerror(errorCode_));
 
             bool bSuccess = QMetaObject::invokeMethod(object_.get(), "onResolved",
-                            Qt::QueuedConnection, Q_ARG(QStringList, ips_), Q_ARG(QString, errorStr), Q_ARG(qint64, elapsedMs_));
+                            Qt::QueuedConnection, Q_ARG(QStringList, ips_), Q_ARG(QString, errorStr), Q_ARG(qint64, elapsedMs_),
+                            Q_ARG(quint32, ttl_), Q_ARG(bool, AresChannelLoop::isNegativeAnswerStatus(errorCode_)));
             WS_ASSERT(bSuccess);
         }
     }
@@ -118,28 +157,13 @@ private:
     QSharedPointer<QObject> object_;
     QStringList dnsServers_;
     int timeoutMs_;
+    bool isDualStack_;
     qint64 elapsedMs_;
 
     QStringList ips_;
+    quint32 ttl_ = 0;
     int errorCode_ = ARES_ECANCELLED;
 
-    QStringList getDnsIps(const QStringList &ips)
-    {
-        if (ips.isEmpty()) {
-    #if defined(Q_OS_MAC)
-            QStringList osDefaultList;  // Empty by default.
-            // On Mac, don't rely on automatic OS default DNS fetch in CARES, because it reads them from
-            // the "/etc/resolv.conf", which is sometimes not available immediately after reboot.
-            // Feed the CARES with valid OS default DNS values taken from scutil.
-            const auto listDns = DnsUtils::getOSDefaultDnsServers();
-            for (auto it = listDns.cbegin(); it != listDns.cend(); ++it)
-                osDefaultList.push_back(QString::fromStdWString(*it));
-            return osDefaultList;
-    #endif
-        }
-        return ips;
-    }
-
     void createOptionsForAresChannel(int timeoutMs, ares_options &options, int &optmask, DnsAddrs &dnsAddrs)
     {
         memset(&options, 0, sizeof(options));
@@ -157,22 +181,17 @@ private:
         }
     }
 
-    static void callback(void *arg, int status, int timeouts, struct hostent *host)
+    static void callback(void *arg, int status, int timeouts, struct ares_addrinfo *result)
     {
         Q_UNUSED(timeouts);
         UserArg *userArg = static_cast<UserArg *>(arg);
 
-        if (status == ARES_SUCCESS) {
-            QStringList addresses;
-            for (char **p = host->h_addr_list; *p; p++) {
-                char addr_buf[46] = "??";
-
-                ares_inet_ntop(host->h_addrtype, *p, addr_buf, sizeof(addr_buf));
-                addresses << QString::fromStdString(addr_buf);
-            }
-            userArg->ips = addresses;
-        } else {
-            userArg->ips.clear();
+        userArg->ips.clear();
+        userArg->ttl = 0;
+        if (result) {
+            if (status == ARES_SUCCESS)
+                userArg->ips = AresChannelLoop::extractAddrInfo(result, userArg->ttl);
+            ares_freeaddrinfo(result);
         }
         userArg->errorCode = status;
     }
@@ -180,10 +199,11 @@ private:
 
 } // namespace
 
-DnsResolver_posix::DnsResolver_posix()
+DnsResolver_posix::DnsResolver_posix() : isUseSharedChannel_(false), aresChannelLoop_(nullptr)
 {
     aresLibraryInit_.init();
     threadPool_ = new QThreadPool();
+    setUseSharedChannel(ExtraConfig::instance().getUseDnsSharedChannel());
 }
 
 DnsResolver_posix::~DnsResolver_posix()
@@ -191,19 +211,50 @@ DnsResolver_posix::~DnsResolver_posix()
     g_FinishAll = true;
     threadPool_->waitForDone();
     delete threadPool_;
+    delete aresChannelLoop_;
     qCDebug(LOG_BASIC) << "DnsResolver stopped";
 }
 
-void DnsResolver_posix::lookup(const QString &hostname, QSharedPointer<QObject> object, const QStringList &dnsServers, int timeoutMs)
+void DnsResolver_posix::lookup(const QString &hostname, QSharedPointer<QObject> object, const QStringList &dnsServers, int timeoutMs, bool isDualStack)
 {
-    LookupJob *job = new LookupJob(hostname, object, dnsServers, timeoutMs);
+    if (isUseSharedChannel_) {
+        AresChannelLoop *loop;
+        {
+            QMutexLocker locker(&mutex_);
+            if (!aresChannelLoop_)
+                aresChannelLoop_ = new AresChannelLoop();
+            loop = aresChannelLoop_;
+        }
+        loop->lookup(hostname, getDnsIps(dnsServers), timeoutMs, isDualStack, [object](const QStringList &ips, int aresStatus, qint64 elapsedMs, quint32 ttl) {
+            QString errorStr;
+            if (aresStatus != ARES_SUCCESS)
+                errorStr = QString::fromStdString(ares_strerror(aresStatus));
+            bool bSuccess = QMetaObject::invokeMethod(object.get(), "onResolved",
+                            Qt::QueuedConnection, Q_ARG(QStringList, ips), Q_ARG(QString, errorStr), Q_ARG(qint64, elapsedMs),
+                            Q_ARG(quint32, ttl), Q_ARG(bool, AresChannelLoop::isNegativeAnswerStatus(aresStatus)));
+            WS_ASSERT(bSuccess);
+        });
+        return;
+    }
+
+    LookupJob *job = new LookupJob(hostname, object, dnsServers, timeoutMs, isDualStack);
     threadPool_->start(job);
     WS_ASSERT(threadPool_->activeThreadCount() <= threadPool_->maxThreadCount());   // in this case, we probably need to redo the logic
 }
 
+void DnsResolver_posix::setUseSharedChannel(bool isUseSharedChannel)
+{
+    isUseSharedChannel_ = isUseSharedChannel;
+}
+
+bool DnsResolver_posix::isUseSharedChannel() const
+{
+    return isUseSharedChannel_;
+}
+
 QStringList DnsResolver_posix::lookupBlocked(const QString &hostname, const QStringList &dnsServers, int timeoutMs, QString *outError)
 {
-    LookupJob job(hostname, nullptr, dnsServers, timeoutMs);
+    LookupJob job(hostname, nullptr, dnsServers, timeoutMs, false);
     job.run();
     if (outError) {
         if (job.errorCode() != ARES_SUCCESS)
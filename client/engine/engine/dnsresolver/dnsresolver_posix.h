@@ -1,9 +1,12 @@
 #pragma once
 
+#include <QMutex>
 #include <QThreadPool>
 #include "idnsresolver.h"
 #include "areslibraryinit.h"
 
+class AresChannelLoop;
+
 // DnsResolver implementation based on the cares library (for Mac/Linux)
 class DnsResolver_posix : public IDnsResolver
 {
@@ -15,9 +18,14 @@ public:
         return s;
     }
 
-    void lookup(const QString &hostname, QSharedPointer<QObject> object, const QStringList &dnsServers, int timeoutMs) override;
+    void lookup(const QString &hostname, QSharedPointer<QObject> object, const QStringList &dnsServers, int timeoutMs, bool isDualStack) override;
     QStringList lookupBlocked(const QString &hostname, const QStringList &dnsServers, int timeoutMs, QString *outError) override;
 
+    // In the shared channel mode asynchronous lookups are multiplexed over long-lived cares channels in a single thread
+    // instead of a channel and a thread pool thread per lookup. Enabled by the "ws-dns-shared-channel" flag in the extra config.
+    void setUseSharedChannel(bool isUseSharedChannel);
+    bool isUseSharedChannel() const;
+
 private:
     explicit DnsResolver_posix();
     virtual ~DnsResolver_posix();
@@ -25,5 +33,8 @@ private:
 private:
     AresLibraryInit aresLibraryInit_;
     QThreadPool *threadPool_;
+    std::atomic<bool> isUseSharedChannel_;
+    AresChannelLoop *aresChannelLoop_;
+    QMutex mutex_;
 };
 
@@ -109,10 +109,13 @@ private:
     unsigned char *p_;
 };
 
-void extractResults(DNS_QUERY_RESULT *queryResults, QStringList &outIps, QString &outError)
+void extractResults(DNS_QUERY_RESULT *queryResults, QStringList &outIps, QString &outError, quint32 &outTtl, bool &outIsNegativeAnswer)
 {
     outIps.clear();
+    outTtl = 0;
+    outIsNegativeAnswer = false;
     if (queryResults->QueryStatus == ERROR_SUCCESS) {
+        bool isFirst = true;
         for (PDNS_RECORD p = queryResults->pQueryRecords; p; p = p->pNext) {
             WCHAR ipAddress[128] = {0};
 
@@ -121,6 +124,10 @@ void extractResults(DNS_QUERY_RESULT *queryResults, QStringList &outIps, QString
                 IN_ADDR ipv4;
                 ipv4.S_un.S_addr = p->Data.A.IpAddress;
                 RtlIpv4AddressToStringW(&ipv4, ipAddress);
+                // the smallest TTL of the records
+                if (isFirst || p->dwTtl < outTtl)
+                    outTtl = p->dwTtl;
+                isFirst = false;
                 break;
             default:
                 break;
@@ -130,8 +137,11 @@ void extractResults(DNS_QUERY_RESULT *queryResults, QStringList &outIps, QString
         }
     } else if (queryResults->QueryStatus == ERROR_CANCELLED) {
         outError = "DnsQueryEx cancelled by timeout";
+        outIsNegativeAnswer = true;
     } else {
         outError = "DnsQueryEx failed: " + QString::number(queryResults->QueryStatus);
+        outIsNegativeAnswer = (queryResults->QueryStatus == DNS_ERROR_RCODE_NAME_ERROR || queryResults->QueryStatus == DNS_INFO_NO_RECORDS ||
+                               queryResults->QueryStatus == ERROR_TIMEOUT);
     }
 }
 
@@ -145,7 +155,9 @@ VOID WINAPI queryCompleteCallback(PVOID context, PDNS_QUERY_RESULT queryResults)
 
     QStringList ips;
     QString errMsg;
-    extractResults(queryResults, ips, errMsg);
+    quint32 ttl;
+    bool isNegativeAnswer;
+    extractResults(queryResults, ips, errMsg, ttl, isNegativeAnswer);
 
     unsigned char *requestId = (unsigned char *)context;
     QMutexLocker locker(&g_activeDnsRequests->mutex);
@@ -153,7 +165,8 @@ VOID WINAPI queryCompleteCallback(PVOID context, PDNS_QUERY_RESULT queryResults)
     if (it != g_activeDnsRequests->queries.end()) {
         DnsQueryInfo *info = it.value();
         bool bSuccess = QMetaObject::invokeMethod(info->object.get(), "onResolved",
-                                              Qt::QueuedConnection, Q_ARG(QStringList, ips), Q_ARG(QString, errMsg), Q_ARG(qint64, info->elapsed.elapsed()));
+                                              Qt::QueuedConnection, Q_ARG(QStringList, ips), Q_ARG(QString, errMsg), Q_ARG(qint64, info->elapsed.elapsed()),
+                                              Q_ARG(quint32, ttl), Q_ARG(bool, isNegativeAnswer));
         WS_ASSERT(bSuccess);
         g_activeDnsRequests->queries.remove(requestId);
         delete info;
@@ -217,12 +230,14 @@ DnsResolver_win::~DnsResolver_win()
     g_activeDnsRequests = nullptr;
 }
 
-void DnsResolver_win::lookup(const QString &hostname, QSharedPointer<QObject> object, const QStringList &dnsServers, int timeoutMs)
+void DnsResolver_win::lookup(const QString &hostname, QSharedPointer<QObject> object, const QStringList &dnsServers, int timeoutMs, bool isDualStack)
 {
+    Q_UNUSED(isDualStack);
     DnsAddrArray dnsAddrs(dnsServers);
     if (!dnsAddrs.isValid()) {
         QMetaObject::invokeMethod(object.get(), "onResolved",
-                                  Qt::QueuedConnection, Q_ARG(QStringList, QStringList()), Q_ARG(QString, "DnsAddrArray failed"), Q_ARG(qint64, 0));
+                                  Qt::QueuedConnection, Q_ARG(QStringList, QStringList()), Q_ARG(QString, "DnsAddrArray failed"), Q_ARG(qint64, 0),
+                                  Q_ARG(quint32, 0), Q_ARG(bool, false));
         return;
     }
 
@@ -249,9 +264,11 @@ void DnsResolver_win::lookup(const QString &hostname, QSharedPointer<QObject> ob
     if (err == ERROR_SUCCESS) {     // results are received immediately, without calling callback
         QStringList ips;
         QString errMsg;
-        extractResults(&info->dnsQueryResult, ips, errMsg);
+        quint32 ttl;
+        bool isNegativeAnswer;
+        extractResults(&info->dnsQueryResult, ips, errMsg, ttl, isNegativeAnswer);
         QMetaObject::invokeMethod(object.get(), "onResolved", Qt::QueuedConnection,
-                                  Q_ARG(QStringList, ips), Q_ARG(QString, errMsg), Q_ARG(qint64, 0));
+                                  Q_ARG(QStringList, ips), Q_ARG(QString, errMsg), Q_ARG(qint64, 0), Q_ARG(quint32, ttl), Q_ARG(bool, isNegativeAnswer));
         delete info;
         return;
     }
@@ -260,7 +277,8 @@ void DnsResolver_win::lookup(const QString &hostname, QSharedPointer<QObject> ob
         WS_ASSERT(false);
         // but if suddenly we are here, then we will process it
         QMetaObject::invokeMethod(object.get(), "onResolved", Qt::QueuedConnection,
-                                  Q_ARG(QStringList, QStringList()), Q_ARG(QString, "DnsQueryEx failed"), Q_ARG(qint64, 0));
+                                  Q_ARG(QStringList, QStringList()), Q_ARG(QString, "DnsQueryEx failed"), Q_ARG(qint64, 0),
+                                  Q_ARG(quint32, 0), Q_ARG(bool, false));
         delete info;
         return;
     }
@@ -318,7 +336,9 @@ QStringList DnsResolver_win::lookupBlocked(const QString &hostname, const QStrin
 
     QStringList ips;
     QString errMsg;
-    extractResults(&dnsQueryResult, ips, errMsg);
+    quint32 ttl;
+    bool isNegativeAnswer;
+    extractResults(&dnsQueryResult, ips, errMsg, ttl, isNegativeAnswer);
 
     if (outError)
         *outError = errMsg;
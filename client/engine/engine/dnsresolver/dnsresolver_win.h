@@ -18,7 +18,8 @@ public:
         return s;
     }
 
-    void lookup(const QString &hostname, QSharedPointer<QObject> object, const QStringList &dnsServers, int timeoutMs) override;
+    // only the A records are queried, isDualStack is ignored
+    void lookup(const QString &hostname, QSharedPointer<QObject> object, const QStringList &dnsServers, int timeoutMs, bool isDualStack) override;
     QStringList lookupBlocked(const QString &hostname, const QStringList &dnsServers, int timeoutMs, QString *outError) override;
 
 private:
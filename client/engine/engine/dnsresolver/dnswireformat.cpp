@@ -0,0 +1,142 @@
+#include "dnswireformat.h"
+
+#include <QHostAddress>
+#include <QUrl>
+
+namespace {
+
+const int kHeaderSize = 12;
+const quint16 kClassIN = 1;
+const int kMaxLabelSize = 63;
+const int kMaxNameSize = 255;
+
+void appendUInt16(QByteArray &arr, quint16 value)
+{
+    arr.append((char)(value >> 8));
+    arr.append((char)(value & 0xFF));
+}
+
+bool readUInt16(const QByteArray &arr, int offset, quint16 &outValue)
+{
+    if (offset < 0 || offset + 2 > arr.size())
+        return false;
+    outValue = ((quint8)arr[offset] << 8) | (quint8)arr[offset + 1];
+    return true;
+}
+
+bool readUInt32(const QByteArray &arr, int offset, quint32 &outValue)
+{
+    quint16 high, low;
+    if (!readUInt16(arr, offset, high) || !readUInt16(arr, offset + 2, low))
+        return false;
+    outValue = ((quint32)high << 16) | low;
+    return true;
+}
+
+// moves the offset past the (possibly compressed) name, returns false if the name is malformed
+bool skipName(const QByteArray &arr, int &offset)
+{
+    while (offset < arr.size()) {
+        const quint8 len = (quint8)arr[offset];
+        if (len == 0) {
+            offset++;
+            return true;
+        }
+        if ((len & 0xC0) == 0xC0) {
+            // the compression pointer ends the name
+            if (offset + 2 > arr.size())
+                return false;
+            offset += 2;
+            return true;
+        }
+        if (len > kMaxLabelSize)
+            return false;
+        offset += len + 1;
+    }
+    return false;
+}
+
+} // namespace
+
+namespace DnsWireFormat
+{
+
+QByteArray makeQuery(const QString &hostname, quint16 type)
+{
+    QByteArray name = QUrl::toAce(hostname);
+    if (name.endsWith('.'))
+        name.chop(1);
+    if (name.isEmpty() || name.size() + 2 > kMaxNameSize)
+        return QByteArray();
+
+    QByteArray query;
+    query.reserve(kHeaderSize + name.size() + 6);
+    appendUInt16(query, 0);         // id
+    appendUInt16(query, 0x0100);    // flags: RD
+    appendUInt16(query, 1);         // QDCOUNT
+    appendUInt16(query, 0);         // ANCOUNT
+    appendUInt16(query, 0);         // NSCOUNT
+    appendUInt16(query, 0);         // ARCOUNT
+
+    const QList<QByteArray> labels = name.split('.');
+    for (const QByteArray &label : labels) {
+        if (label.isEmpty() || label.size() > kMaxLabelSize)
+            return QByteArray();
+        query.append((char)label.size());
+        query.append(label);
+    }
+    query.append('\0');
+    appendUInt16(query, type);
+    appendUInt16(query, kClassIN);
+    return query;
+}
+
+bool parseResponse(const QByteArray &message, quint16 type, Response &outResponse)
+{
+    quint16 flags, qdCount, anCount;
+    if (message.size() < kHeaderSize || !readUInt16(message, 2, flags) || !readUInt16(message, 4, qdCount) || !readUInt16(message, 6, anCount))
+        return false;
+    // QR bit
+    if (!(flags & 0x8000))
+        return false;
+
+    outResponse = Response();
+    outResponse.responseCode = flags & 0x000F;
+
+    int offset = kHeaderSize;
+    for (int i = 0; i < qdCount; ++i) {
+        if (!skipName(message, offset))
+            return false;
+        offset += 4;    // QTYPE and QCLASS
+    }
+
+    for (int i = 0; i < anCount; ++i) {
+        quint16 recordType, recordClass, rdLength;
+        quint32 ttl;
+        if (!skipName(message, offset) || !readUInt16(message, offset, recordType) || !readUInt16(message, offset + 2, recordClass) ||
+            !readUInt32(message, offset + 4, ttl) || !readUInt16(message, offset + 8, rdLength))
+            return false;
+        offset += 10;
+        if (offset + rdLength > message.size())
+            return false;
+
+        if (recordType == type && recordClass == kClassIN) {
+            QHostAddress address;
+            if (type == kTypeA && rdLength == 4) {
+                quint32 ipv4;
+                readUInt32(message, offset, ipv4);
+                address.setAddress(ipv4);
+            } else if (type == kTypeAAAA && rdLength == 16) {
+                address.setAddress(reinterpret_cast<const quint8 *>(message.constData() + offset));
+            } else {
+                return false;
+            }
+            outResponse.ips << address.toString();
+            outResponse.ttl = outResponse.ips.size() == 1 ? ttl : qMin(outResponse.ttl, ttl);
+        }
+        offset += rdLength;
+    }
+    return true;
+}
+
+} // namespace DnsWireFormat
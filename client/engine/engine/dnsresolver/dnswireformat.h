@@ -0,0 +1,24 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+// Minimal DNS message encoding/decoding (RFC 1035) for the resolvers that don't use cares, e.g. DNS over HTTPS (RFC 8484)
+namespace DnsWireFormat
+{
+    enum RecordType { kTypeA = 1, kTypeAAAA = 28 };
+    enum ResponseCode { kNoError = 0, kServFail = 2, kNxDomain = 3, kRefused = 5 };
+
+    struct Response
+    {
+        int responseCode = kNoError;
+        QStringList ips;        // the addresses of the requested type, the other records (CNAME, etc) are skipped
+        quint32 ttl = 0;        // the smallest TTL of the addresses in seconds, 0 if there are none
+    };
+
+    // A recursive query with the id 0 (RFC 8484 recommends it for the HTTP caches). Returns an empty array if the hostname is invalid.
+    QByteArray makeQuery(const QString &hostname, quint16 type);
+    // returns false if the message is not a well-formed response
+    bool parseResponse(const QByteArray &message, quint16 type, Response &outResponse);
+}
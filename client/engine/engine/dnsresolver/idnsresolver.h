@@ -10,7 +10,8 @@ class IDnsResolver
 public:
     virtual ~IDnsResolver() {};
 
-    virtual void lookup(const QString &hostname, QSharedPointer<QObject> object, const QStringList &dnsServers, int timeoutMs) = 0;
+    // if isDualStack is true, the AAAA records are queried in parallel with the A records (if supported by the implementation)
+    virtual void lookup(const QString &hostname, QSharedPointer<QObject> object, const QStringList &dnsServers, int timeoutMs, bool isDualStack) = 0;
     virtual QStringList lookupBlocked(const QString &hostname, const QStringList &dnsServers, int timeoutMs, QString *outError) = 0;
 };
 
@@ -0,0 +1,313 @@
+#include <QtTest>
+#include <QCoreApplication>
+
+#include "engine/dnsresolver/dnsrequest.h"
+#include "engine/dnsresolver/dnsresolver_doh.h"
+#include "engine/dnsresolver/dnswireformat.h"
+#include "engine/networkaccessmanager/dnscache.h"
+#include "testdnsserver.h"
+#include "testdohserver.h"
+
+// DnsResolver_doh against the local DoH stand-ins, which forward the queries to the local DNS server:
+// the wire format, the connection reuse, the ordering of the upstreams by latency and the failover.
+class TestDnsOverHttps : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void cleanup();
+
+    void test_wire_format();
+    void test_lookup();
+    void test_dual_stack();
+    void test_nxdomain();
+    void test_connection_reuse();
+    void test_latency_ordering();
+    void test_failover_data();
+    void test_failover();
+    void test_all_upstreams_down();
+    void test_disabled();
+    void test_dns_cache();
+
+private:
+    static constexpr int kSlowDelayMs = 200;
+
+    TestDnsServer *dnsServer_ = nullptr;
+    TestDohServer *fastUpstream_ = nullptr;
+    TestDohServer *slowUpstream_ = nullptr;
+
+    static DnsResolver_doh::Upstream upstream(const TestDohServer *server);
+    void setUpstreams(const QVector<TestDohServer *> &servers);
+    DnsRequest *lookup(const QString &hostname, bool isDualStack = false, const QStringList &dnsServers = QStringList());
+};
+
+void TestDnsOverHttps::initTestCase()
+{
+    dnsServer_ = new TestDnsServer(this);
+    TestDnsServer::Record record;
+    record.ipv4 << "10.0.0.1" << "10.0.0.2";
+    record.ttl = 300;
+    dnsServer_->setDefaultRecord(record);
+
+    record.ipv6 << "2001:db8::1";
+    dnsServer_->setRecord("dual.test", record);
+
+    record = TestDnsServer::Record();
+    record.responseCode = TestDnsServer::kNxDomain;
+    dnsServer_->setRecord("nx.test", record);
+    QVERIFY(dnsServer_->startServer());
+
+    fastUpstream_ = new TestDohServer(this, dnsServer_->address());
+    QVERIFY(fastUpstream_->start());
+    slowUpstream_ = new TestDohServer(this, dnsServer_->address());
+    slowUpstream_->setResponseDelayMs(kSlowDelayMs);
+    QVERIFY(slowUpstream_->start());
+}
+
+void TestDnsOverHttps::cleanupTestCase()
+{
+    DnsResolver_doh::instance().setUpstreams(QVector<DnsResolver_doh::Upstream>());
+    DnsResolver_doh::instance().shutdown();
+    // the lookups after the shutdown fail right away
+    QString error;
+    QVERIFY(DnsResolver_doh::instance().lookupBlocked("example.com", QStringList(), 1000, &error).isEmpty());
+    QVERIFY(!error.isEmpty());
+    QVERIFY(!DnsResolver_doh::instance().isEnabled());
+}
+
+void TestDnsOverHttps::cleanup()
+{
+    dnsServer_->resetCounters();
+    fastUpstream_->resetCounters();
+    fastUpstream_->setFailureStatusCode(0);
+    slowUpstream_->resetCounters();
+}
+
+void TestDnsOverHttps::test_wire_format()
+{
+    const QByteArray query = DnsWireFormat::makeQuery("www.example.com", DnsWireFormat::kTypeAAAA);
+    // header, 3 labels, QTYPE and QCLASS
+    QCOMPARE(query.size(), 12 + 17 + 4);
+    QCOMPARE(query.left(2), QByteArray(2, '\0'));
+    QVERIFY(DnsWireFormat::makeQuery("bad..name", DnsWireFormat::kTypeA).isEmpty());
+    QVERIFY(DnsWireFormat::makeQuery(QString(64, 'a') + ".com", DnsWireFormat::kTypeA).isEmpty());
+
+    DnsWireFormat::Response response;
+    // a query is not a response
+    QVERIFY(!DnsWireFormat::parseResponse(query, DnsWireFormat::kTypeAAAA, response));
+    QVERIFY(!DnsWireFormat::parseResponse(QByteArray(5, '\x80'), DnsWireFormat::kTypeA, response));
+
+    QByteArray answer = query;
+    answer[2] = (char)0x81;     // QR + RD
+    answer[7] = 1;              // ANCOUNT
+    answer.append("\xC0\x0C\x00\x1C\x00\x01\x00\x00\x00\x3C\x00\x10", 12);
+    answer.append("\x20\x01\x0d\xb8\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x01", 16);
+    QVERIFY(DnsWireFormat::parseResponse(answer, DnsWireFormat::kTypeAAAA, response));
+    QCOMPARE(response.responseCode, (int)DnsWireFormat::kNoError);
+    QCOMPARE(response.ips, QStringList() << "2001:db8::1");
+    QCOMPARE(response.ttl, (quint32)60);
+
+    // the record goes beyond the message
+    QVERIFY(!DnsWireFormat::parseResponse(answer.left(answer.size() - 1), DnsWireFormat::kTypeAAAA, response));
+}
+
+void TestDnsOverHttps::test_lookup()
+{
+    setUpstreams({ fastUpstream_ });
+    // the DNS servers of the request are ignored
+    DnsRequest *request = lookup("host.test", false, QStringList() << "192.0.2.1");
+    QVERIFY(!request->isError());
+    QCOMPARE(request->ips(), QStringList() << "10.0.0.1" << "10.0.0.2");
+    QCOMPARE(request->ttl(), (quint32)300);
+    QCOMPARE(fastUpstream_->queriesCount(), 1);
+    QCOMPARE(dnsServer_->queriesCount("host.test"), 1);
+    delete request;
+}
+
+void TestDnsOverHttps::test_dual_stack()
+{
+    setUpstreams({ fastUpstream_ });
+    DnsRequest *request = lookup("dual.test", true);
+    QVERIFY(!request->isError());
+    QCOMPARE(request->ips(), QStringList() << "10.0.0.1" << "10.0.0.2" << "2001:db8::1");
+    // A and AAAA
+    QCOMPARE(fastUpstream_->queriesCount(), 2);
+    delete request;
+}
+
+void TestDnsOverHttps::test_nxdomain()
+{
+    setUpstreams({ fastUpstream_, slowUpstream_ });
+    DnsRequest *request = lookup("nx.test");
+    QVERIFY(request->isError());
+    QVERIFY(request->isNegativeAnswer());
+    // a definitive answer, the other upstream is not asked
+    QCOMPARE(fastUpstream_->queriesCount() + slowUpstream_->queriesCount(), 1);
+    delete request;
+}
+
+void TestDnsOverHttps::test_connection_reuse()
+{
+    setUpstreams({ fastUpstream_ });
+    for (int i = 0; i < 20; ++i) {
+        DnsRequest *request = lookup(QString("host%1.test").arg(i));
+        QVERIFY(!request->isError());
+        delete request;
+    }
+    QCOMPARE(fastUpstream_->queriesCount(), 20);
+    QCOMPARE(fastUpstream_->connectionsCount(), 1);
+
+    // the concurrent lookups, the stand-in has no HTTP/2, so curl may open a few parallel HTTP/1.1 connections
+    QVector<DnsRequest *> requests;
+    int finished = 0;
+    for (int i = 0; i < 50; ++i) {
+        DnsRequest *request = new DnsRequest(this, QString("concurrent%1.test").arg(i), QStringList(), 5000);
+        request->setDnsOverHttps(true);
+        connect(request, &DnsRequest::finished, this, [&finished]() { finished++; });
+        request->lookup();
+        requests << request;
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(finished, 50, 10000);
+    for (DnsRequest *request : qAsConst(requests))
+        QVERIFY(!request->isError());
+    qDeleteAll(requests);
+    qDebug() << "connections for 70 lookups:" << fastUpstream_->connectionsCount();
+    QVERIFY(fastUpstream_->connectionsCount() < 50);
+}
+
+void TestDnsOverHttps::test_latency_ordering()
+{
+    // the slow one is configured first
+    setUpstreams({ slowUpstream_, fastUpstream_ });
+    for (int i = 0; i < 10; ++i) {
+        DnsRequest *request = lookup(QString("order%1.test").arg(i));
+        QVERIFY(!request->isError());
+        delete request;
+    }
+    // both are measured once, then the fast one is preferred
+    QCOMPARE(slowUpstream_->queriesCount(), 1);
+    QCOMPARE(fastUpstream_->queriesCount(), 9);
+
+    const QVector<DnsResolver_doh::UpstreamStatistics> statistics = DnsResolver_doh::instance().statistics();
+    QCOMPARE(statistics.size(), 2);
+    qDebug() << "smoothed response time, slow:" << statistics[0].srttMs << "ms, fast:" << statistics[1].srttMs << "ms";
+    QVERIFY(statistics[0].srttMs > statistics[1].srttMs);
+    QCOMPARE(statistics[0].failures + statistics[1].failures, (quint64)0);
+}
+
+void TestDnsOverHttps::test_failover_data()
+{
+    QTest::addColumn<bool>("isRefused");
+    QTest::newRow("HTTP 500") << false;
+    QTest::newRow("connection refused") << true;
+}
+
+void TestDnsOverHttps::test_failover()
+{
+    QFETCH(bool, isRefused);
+
+    DnsResolver_doh::Upstream brokenUpstream = upstream(fastUpstream_);
+    if (isRefused) {
+        // nothing listens on the port 1
+        brokenUpstream.url.setPort(1);
+    } else {
+        fastUpstream_->setFailureStatusCode(500);
+    }
+    QVector<DnsResolver_doh::Upstream> upstreams;
+    upstreams << brokenUpstream << upstream(slowUpstream_);
+    DnsResolver_doh::instance().setUpstreams(upstreams);
+
+    DnsRequest *request = lookup("failover.test");
+    QVERIFY(!request->isError());
+    QCOMPARE(request->ips(), QStringList() << "10.0.0.1" << "10.0.0.2");
+    QCOMPARE(slowUpstream_->queriesCount(), 1);
+    delete request;
+
+    // the broken one is penalized, the next lookup goes to the working one right away
+    request = lookup("failover2.test");
+    QVERIFY(!request->isError());
+    QCOMPARE(slowUpstream_->queriesCount(), 2);
+    delete request;
+
+    const QVector<DnsResolver_doh::UpstreamStatistics> statistics = DnsResolver_doh::instance().statistics();
+    QCOMPARE(statistics[0].failures, (quint64)1);
+    QCOMPARE(statistics[0].queries, (quint64)1);
+    QCOMPARE(statistics[1].failures, (quint64)0);
+    if (!isRefused)
+        QCOMPARE(fastUpstream_->queriesCount(), 1);
+}
+
+void TestDnsOverHttps::test_all_upstreams_down()
+{
+    setUpstreams({ fastUpstream_ });
+    fastUpstream_->setFailureStatusCode(503);
+    DnsRequest *request = lookup("down.test");
+    QVERIFY(request->isError());
+    // not an answer of DNS, so it's not cached as negative
+    QVERIFY(!request->isNegativeAnswer());
+    QVERIFY(request->errorString().contains("503"));
+    QCOMPARE(dnsServer_->queriesCount(), 0);
+    delete request;
+}
+
+void TestDnsOverHttps::test_disabled()
+{
+    DnsResolver_doh::instance().setUpstreams(QVector<DnsResolver_doh::Upstream>());
+    QVERIFY(!DnsResolver_doh::instance().isEnabled());
+
+    // the system resolver with the DNS servers of the request
+    DnsRequest *request = lookup("plain.test", false, QStringList() << dnsServer_->address());
+    QVERIFY(!request->isError());
+    QCOMPARE(dnsServer_->queriesCount("plain.test"), 1);
+    QCOMPARE(fastUpstream_->queriesCount(), 0);
+    delete request;
+}
+
+void TestDnsOverHttps::test_dns_cache()
+{
+    setUpstreams({ fastUpstream_ });
+    DnsCache dnsCache(nullptr);
+    dnsCache.setDnsOverHttps(true);
+
+    for (int i = 0; i < 3; ++i) {
+        QSignalSpy spy(&dnsCache, &DnsCache::resolved);
+        dnsCache.resolve("cached.test", i);
+        if (spy.isEmpty())
+            QVERIFY(spy.wait(5000));
+        QCOMPARE(spy.first().at(0).toBool(), true);
+        QCOMPARE(spy.first().at(1).toStringList(), QStringList() << "10.0.0.1" << "10.0.0.2");
+    }
+    QCOMPARE(fastUpstream_->queriesCount(), 1);
+    QCOMPARE(dnsCache.statistics().cacheHits, (quint64)2);
+}
+
+DnsResolver_doh::Upstream TestDnsOverHttps::upstream(const TestDohServer *server)
+{
+    DnsResolver_doh::Upstream upstream;
+    upstream.url = server->url();
+    return upstream;
+}
+
+void TestDnsOverHttps::setUpstreams(const QVector<TestDohServer *> &servers)
+{
+    QVector<DnsResolver_doh::Upstream> upstreams;
+    for (const TestDohServer *server : servers)
+        upstreams << upstream(server);
+    DnsResolver_doh::instance().setUpstreams(upstreams);
+}
+
+DnsRequest *TestDnsOverHttps::lookup(const QString &hostname, bool isDualStack, const QStringList &dnsServers)
+{
+    DnsRequest *request = new DnsRequest(this, hostname, dnsServers, 5000);
+    request->setDualStack(isDualStack);
+    request->setDnsOverHttps(true);
+    QSignalSpy spy(request, &DnsRequest::finished);
+    request->lookup();
+    spy.wait(10000);
+    return request;
+}
+
+QTEST_MAIN(TestDnsOverHttps)
+#include "dnsoverhttps.test.moc"
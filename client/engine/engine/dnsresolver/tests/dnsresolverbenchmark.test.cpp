@@ -0,0 +1,274 @@
+#include <QtTest>
+#include <QCoreApplication>
+#include <QRandomGenerator>
+#include <functional>
+
+#include "engine/dnsresolver/dnsrequest.h"
+#include "engine/dnsresolver/dnsresolver_posix.h"
+#include "engine/networkaccessmanager/dnscache.h"
+#include "processstats.h"
+#include "testdnsserver.h"
+
+// Benchmark of DnsResolver and DnsCache against the local DNS stub, works offline.
+// The resolver is measured in both modes (thread pool and shared channel) with the network profiles of the stub
+// (latency, loss, truncated UDP answers). DnsCache is measured with the request mixes of the application:
+// a burst of concurrent lookups of a few API hostnames at startup and a skewed mix of many hostnames with some NXDOMAIN answers.
+// Every row reports the queries per second, the p50/p99 latency of a lookup, the peak thread count and the memory.
+class TestDnsResolverBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void cleanup();
+
+    void benchmark_resolver_data();
+    void benchmark_resolver();
+    void benchmark_cache_data();
+    void benchmark_cache();
+
+private:
+    static constexpr int kTimeoutMs = 10000;
+
+    struct Results
+    {
+        int succeeded = 0;
+        int failed = 0;
+        qint64 elapsedMs = 0;
+        QVector<qint64> latencies;
+        int peakThreads = 0;
+        qint64 rssBeforeKb = 0;
+        qint64 rssAfterKb = 0;
+    };
+
+    TestDnsServer *server_ = nullptr;
+
+    // Keeps up to maxInFlight lookups started by startLookup(index, onFinished) in flight until count of them are finished.
+    // startLookup must call onFinished(isSuccess) exactly once, the latency is measured from the start to this call.
+    Results runLookups(int count, int maxInFlight, std::function<void(int, std::function<void(bool)>)> startLookup);
+    static void printResults(const QString &name, int count, const Results &results);
+    static qint64 percentile(QVector<qint64> values, int percent);
+};
+
+void TestDnsResolverBenchmark::initTestCase()
+{
+    server_ = new TestDnsServer(this);
+    TestDnsServer::Record record;
+    record.ipv4 << "10.0.0.1" << "10.0.0.2";
+    server_->setDefaultRecord(record);
+    QVERIFY(server_->startServer());
+}
+
+void TestDnsResolverBenchmark::cleanupTestCase()
+{
+    DnsResolver_posix::instance().setUseSharedChannel(false);
+}
+
+void TestDnsResolverBenchmark::cleanup()
+{
+    server_->setDelayMs(0);
+    server_->setLossPercent(0);
+    server_->setTruncateUdp(false);
+    server_->resetCounters();
+}
+
+void TestDnsResolverBenchmark::benchmark_resolver_data()
+{
+    QTest::addColumn<bool>("isSharedChannel");
+    QTest::addColumn<int>("delayMs");
+    QTest::addColumn<int>("lossPercent");
+    QTest::addColumn<bool>("isTruncateUdp");
+    QTest::addColumn<int>("lookups");
+
+    for (bool isSharedChannel : { false, true }) {
+        const QString mode = isSharedChannel ? "shared channel" : "thread pool";
+        QTest::newRow(qPrintable(mode + ", local")) << isSharedChannel << 0 << 0 << false << 2000;
+        QTest::newRow(qPrintable(mode + ", 20 ms latency")) << isSharedChannel << 20 << 0 << false << 2000;
+        // every lost query costs the retransmission timeout of cares (2 s), so fewer lookups
+        QTest::newRow(qPrintable(mode + ", 2% loss")) << isSharedChannel << 5 << 2 << false << 500;
+        QTest::newRow(qPrintable(mode + ", truncated UDP")) << isSharedChannel << 5 << 0 << true << 500;
+    }
+}
+
+void TestDnsResolverBenchmark::benchmark_resolver()
+{
+    QFETCH(bool, isSharedChannel);
+    QFETCH(int, delayMs);
+    QFETCH(int, lossPercent);
+    QFETCH(bool, isTruncateUdp);
+    QFETCH(int, lookups);
+
+    DnsResolver_posix::instance().setUseSharedChannel(isSharedChannel);
+    server_->setDelayMs(delayMs);
+    server_->setLossPercent(lossPercent);
+    server_->setTruncateUdp(isTruncateUdp);
+
+    const QString tag = QString(QTest::currentDataTag()).toLower().replace(QRegularExpression("[^a-z0-9]+"), "-");
+    const Results results = runLookups(lookups, 64, [this, &tag](int index, std::function<void(bool)> onFinished) {
+        // distinct hostnames, so nothing can be answered from a cache
+        DnsRequest *request = new DnsRequest(this, QString("host%1.%2.example").arg(index).arg(tag), QStringList() << server_->address(), kTimeoutMs);
+        connect(request, &DnsRequest::finished, this, [request, onFinished]() {
+            onFinished(!request->isError() && request->ips().size() == 2);
+            request->deleteLater();
+        });
+        request->lookup();
+    });
+    printResults(QTest::currentDataTag(), lookups, results);
+
+    QCOMPARE(results.succeeded, lookups);
+    if (isTruncateUdp)
+        QVERIFY(server_->tcpQueriesCount() >= lookups);
+}
+
+void TestDnsResolverBenchmark::benchmark_cache_data()
+{
+    QTest::addColumn<int>("hostnames");
+    QTest::addColumn<int>("lookups");
+    QTest::addColumn<int>("maxInFlight");
+    QTest::addColumn<int>("nxPercent");
+    QTest::addColumn<bool>("isHonorTtl");
+
+    // the engine start: every API and assets request resolves one of a few hostnames at once
+    QTest::newRow("startup burst") << 20 << 1000 << 1000 << 0 << false;
+    // the lookups concentrated on the popular hostnames (roughly Zipf-like), 10% of the hostnames don't exist
+    QTest::newRow("skewed mix") << 500 << 5000 << 64 << 10 << false;
+    QTest::newRow("skewed mix, negative cache") << 500 << 5000 << 64 << 10 << true;
+}
+
+void TestDnsResolverBenchmark::benchmark_cache()
+{
+    QFETCH(int, hostnames);
+    QFETCH(int, lookups);
+    QFETCH(int, maxInFlight);
+    QFETCH(int, nxPercent);
+    QFETCH(bool, isHonorTtl);
+
+    DnsResolver_posix::instance().setUseSharedChannel(true);
+    server_->setDelayMs(20);
+
+    const QString tag = QString(QTest::currentDataTag()).toLower().replace(QRegularExpression("[^a-z0-9]+"), "-");
+    QStringList hostnamesList;
+    for (int i = 0; i < hostnames; ++i) {
+        // not the most popular ones
+        const bool isNx = i % 100 >= 100 - nxPercent;
+        hostnamesList << QString("%1%2.%3.example").arg(isNx ? "nx" : "host").arg(i).arg(tag);
+        if (isNx) {
+            TestDnsServer::Record record;
+            record.responseCode = TestDnsServer::kNxDomain;
+            server_->setRecord(hostnamesList.last(), record);
+        }
+    }
+
+    // the same sequence on every run
+    QRandomGenerator random(12345);
+    QStringList sequence;
+    int expectedFailures = 0;
+    for (int i = 0; i < lookups; ++i) {
+        const double r = random.generateDouble();
+        sequence << hostnamesList[qMin(hostnames - 1, (int)(hostnames * r * r * r))];
+        if (sequence.last().startsWith("nx"))
+            expectedFailures++;
+    }
+
+    DnsCache dnsCache(nullptr);
+    if (isHonorTtl) {
+        DnsCache::TtlPolicy ttlPolicy;
+        ttlPolicy.isHonorTtl = true;
+        ttlPolicy.negativeTtlMs = 5000;
+        dnsCache.setTtlPolicy(ttlPolicy);
+    }
+
+    QHash<quint64, std::function<void(bool)> > callbacks;
+    connect(&dnsCache, &DnsCache::resolved, this, [&callbacks](bool success, const QStringList &ips, quint64 id, bool bFromCache, int timeMs) {
+        Q_UNUSED(ips);
+        Q_UNUSED(bFromCache);
+        Q_UNUSED(timeMs);
+        // the cache hits are emitted synchronously from resolve(), so the callback is registered before the call
+        std::function<void(bool)> onFinished = callbacks.take(id);
+        if (onFinished)
+            onFinished(success);
+    });
+
+    const Results results = runLookups(lookups, maxInFlight, [this, &dnsCache, &callbacks, &sequence](int index, std::function<void(bool)> onFinished) {
+        callbacks[index] = onFinished;
+        dnsCache.resolve(sequence[index], index, false, QStringList() << server_->address(), kTimeoutMs);
+    });
+    printResults(QTest::currentDataTag(), lookups, results);
+
+    const DnsCache::Statistics statistics = dnsCache.statistics();
+    qDebug() << "  cache hits:" << statistics.cacheHits << ", negative hits:" << statistics.negativeHits
+             << ", coalesced:" << statistics.coalescedLookups << ", resolver jobs:" << statistics.resolverJobs
+             << ", DNS queries:" << server_->queriesCount();
+
+    QCOMPARE(results.failed, expectedFailures);
+    QCOMPARE(statistics.lookups, (quint64)lookups);
+    QVERIFY(statistics.resolverJobs <= (quint64)lookups / 2);
+    if (isHonorTtl)
+        QVERIFY(statistics.negativeHits > 0);
+}
+
+TestDnsResolverBenchmark::Results TestDnsResolverBenchmark::runLookups(int count, int maxInFlight,
+                                                                      std::function<void(int, std::function<void(bool)>)> startLookup)
+{
+    Results results;
+    results.latencies.reserve(count);
+    results.rssBeforeKb = ProcessStats::residentMemoryKb();
+    results.peakThreads = ProcessStats::threadsCount();
+
+    QElapsedTimer timer;
+    timer.start();
+    int started = 0;
+    int finished = 0;
+    std::function<void()> startNext;
+    startNext = [&]() {
+        while (started < count && started - finished < maxInFlight) {
+            const int index = started++;
+            const qint64 startTime = timer.nsecsElapsed();
+            startLookup(index, [&, startTime](bool isSuccess) {
+                results.latencies << (timer.nsecsElapsed() - startTime) / 1000;
+                if (isSuccess)
+                    results.succeeded++;
+                else
+                    results.failed++;
+                finished++;
+                QMetaObject::invokeMethod(this, startNext, Qt::QueuedConnection);
+            });
+        }
+    };
+    startNext();
+
+    while (finished < count && timer.elapsed() < 120000) {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 1);
+        results.peakThreads = qMax(results.peakThreads, ProcessStats::threadsCount());
+    }
+    results.elapsedMs = timer.elapsed();
+    // let the pending queued calls run before the captured locals go away
+    QCoreApplication::processEvents();
+    results.rssAfterKb = ProcessStats::residentMemoryKb();
+    return results;
+}
+
+void TestDnsResolverBenchmark::printResults(const QString &name, int count, const Results &results)
+{
+    qDebug().noquote() << QString("%1: %2 lookups (%3 failed) in %4 ms, %5 qps, p50 %6 ms, p99 %7 ms, peak threads %8, "
+                                  "RSS %9 -> %10 KB (peak %11 KB)")
+        .arg(name).arg(count).arg(results.failed).arg(results.elapsedMs)
+        .arg(count * 1000 / qMax(results.elapsedMs, (qint64)1))
+        .arg(percentile(results.latencies, 50) / 1000.0, 0, 'f', 2)
+        .arg(percentile(results.latencies, 99) / 1000.0, 0, 'f', 2)
+        .arg(results.peakThreads).arg(results.rssBeforeKb).arg(results.rssAfterKb)
+        .arg(ProcessStats::peakResidentMemoryKb());
+}
+
+qint64 TestDnsResolverBenchmark::percentile(QVector<qint64> values, int percent)
+{
+    if (values.isEmpty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    const int index = qMin((int)values.size() - 1, (int)((values.size() * percent + 99) / 100) - 1);
+    return values[qMax(index, 0)];
+}
+
+QTEST_MAIN(TestDnsResolverBenchmark)
+#include "dnsresolverbenchmark.test.moc"
@@ -0,0 +1,205 @@
+#include <QtTest>
+#include <QCoreApplication>
+
+#include "engine/dnsresolver/dnsrequest.h"
+#include "engine/dnsresolver/dnsresolver_posix.h"
+#include "processstats.h"
+#include "testdnsserver.h"
+
+// Throughput of the asynchronous lookups against the local DNS stub:
+// the thread pool mode (a channel and a thread per lookup) versus the shared channel mode.
+class TestDnsResolverThroughput : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestDnsResolverThroughput();
+    ~TestDnsResolverThroughput();
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void test_shared_channel_lookup();
+    void test_shared_channel_timeout();
+    void test_shared_channel_nxdomain();
+    void test_thread_pool_nxdomain();
+    void test_shared_channel_servfail_backoff();
+    void benchmark_thread_pool();
+    void benchmark_shared_channel();
+
+private:
+    TestDnsServer *server_;
+
+    // returns the count of the successful lookups
+    int runLookups(int count, qint64 &outElapsedMs, int &outPeakThreads);
+};
+
+
+TestDnsResolverThroughput::TestDnsResolverThroughput() : server_(nullptr)
+{
+}
+
+TestDnsResolverThroughput::~TestDnsResolverThroughput()
+{
+}
+
+void TestDnsResolverThroughput::initTestCase()
+{
+    server_ = new TestDnsServer(this);
+    TestDnsServer::Record record;
+    record.ipv4 << "10.0.0.1" << "10.0.0.2";
+    server_->setDefaultRecord(record);
+    server_->setDelayMs(10);
+    QVERIFY(server_->startServer());
+}
+
+void TestDnsResolverThroughput::cleanupTestCase()
+{
+    DnsResolver_posix::instance().setUseSharedChannel(false);
+}
+
+void TestDnsResolverThroughput::test_shared_channel_lookup()
+{
+    DnsResolver_posix::instance().setUseSharedChannel(true);
+    DnsRequest *request = new DnsRequest(this, "host.example", QStringList() << server_->address());
+    QSignalSpy spy(request, SIGNAL(finished()));
+    request->lookup();
+    spy.wait(5000);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(request->isError(), false);
+    QCOMPARE(request->ips(), QStringList() << "10.0.0.1" << "10.0.0.2");
+    request->deleteLater();
+}
+
+void TestDnsResolverThroughput::test_shared_channel_timeout()
+{
+    DnsResolver_posix::instance().setUseSharedChannel(true);
+    TestDnsServer::Record record;
+    record.isNoResponse = true;
+    server_->setRecord("timeout.example", record);
+
+    QElapsedTimer timer;
+    timer.start();
+    DnsRequest *request = new DnsRequest(this, "timeout.example", QStringList() << server_->address(), 1000);
+    QSignalSpy spy(request, SIGNAL(finished()));
+    request->lookup();
+    spy.wait(5000);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(request->isError(), true);
+    QVERIFY(timer.elapsed() >= 900 && timer.elapsed() <= 1500);
+    request->deleteLater();
+}
+
+void TestDnsResolverThroughput::test_shared_channel_nxdomain()
+{
+    DnsResolver_posix::instance().setUseSharedChannel(true);
+    TestDnsServer::Record record;
+    record.responseCode = TestDnsServer::kNxDomain;
+    server_->setRecord("nxdomain.example", record);
+
+    DnsRequest *request = new DnsRequest(this, "nxdomain.example", QStringList() << server_->address(), 5000);
+    QSignalSpy spy(request, SIGNAL(finished()));
+    request->lookup();
+    spy.wait(5000);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(request->isError(), true);
+    // a definitive answer is not retried until the timeout
+    QVERIFY(request->elapsedMs() < 1000);
+    request->deleteLater();
+}
+
+void TestDnsResolverThroughput::test_thread_pool_nxdomain()
+{
+    DnsResolver_posix::instance().setUseSharedChannel(false);
+    TestDnsServer::Record record;
+    record.responseCode = TestDnsServer::kNxDomain;
+    server_->setRecord("nxdomain-pool.example", record);
+    server_->resetCounters();
+
+    DnsRequest *request = new DnsRequest(this, "nxdomain-pool.example", QStringList() << server_->address(), 5000);
+    QSignalSpy spy(request, SIGNAL(finished()));
+    request->lookup();
+    spy.wait(5000);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(request->isError(), true);
+    QCOMPARE(request->isNegativeAnswer(), true);
+    // the definitive answer is not queried again until the timeout
+    QVERIFY(request->elapsedMs() < 1000);
+    QCOMPARE(server_->queriesCount("nxdomain-pool.example"), 1);
+    request->deleteLater();
+}
+
+void TestDnsResolverThroughput::test_shared_channel_servfail_backoff()
+{
+    DnsResolver_posix::instance().setUseSharedChannel(true);
+    TestDnsServer::Record record;
+    record.responseCode = TestDnsServer::kServFail;
+    server_->setRecord("servfail.example", record);
+    server_->resetCounters();
+
+    DnsRequest *request = new DnsRequest(this, "servfail.example", QStringList() << server_->address(), 1500);
+    QSignalSpy spy(request, SIGNAL(finished()));
+    request->lookup();
+    spy.wait(5000);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(request->isError(), true);
+    // retried until the timeout, but with a backoff instead of a resend every server round trip
+    QVERIFY(server_->queriesCount("servfail.example") >= 2);
+    QVERIFY(server_->queriesCount("servfail.example") <= 8);
+    request->deleteLater();
+}
+
+void TestDnsResolverThroughput::benchmark_thread_pool()
+{
+    DnsResolver_posix::instance().setUseSharedChannel(false);
+    const int kLookups = 1000;
+    qint64 elapsedMs;
+    int peakThreads;
+    int succeeded = runLookups(kLookups, elapsedMs, peakThreads);
+    qDebug() << "thread pool:" << kLookups << "lookups in" << elapsedMs << "ms," << (kLookups * 1000 / qMax(elapsedMs, (qint64)1))
+             << "qps, peak threads:" << peakThreads << ", succeeded:" << succeeded;
+    QCOMPARE(succeeded, kLookups);
+}
+
+void TestDnsResolverThroughput::benchmark_shared_channel()
+{
+    DnsResolver_posix::instance().setUseSharedChannel(true);
+    const int kLookups = 1000;
+    qint64 elapsedMs;
+    int peakThreads;
+    int succeeded = runLookups(kLookups, elapsedMs, peakThreads);
+    qDebug() << "shared channel:" << kLookups << "lookups in" << elapsedMs << "ms," << (kLookups * 1000 / qMax(elapsedMs, (qint64)1))
+             << "qps, peak threads:" << peakThreads << ", succeeded:" << succeeded;
+    QCOMPARE(succeeded, kLookups);
+}
+
+int TestDnsResolverThroughput::runLookups(int count, qint64 &outElapsedMs, int &outPeakThreads)
+{
+    int finished = 0;
+    int succeeded = 0;
+    outPeakThreads = ProcessStats::threadsCount();
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < count; ++i) {
+        // distinct hostnames, so the resolver can't answer from its own cache
+        DnsRequest *request = new DnsRequest(this, QString("host%1.example").arg(i), QStringList() << server_->address(), 10000);
+        connect(request, &DnsRequest::finished, this, [&finished, &succeeded, request]() {
+            finished++;
+            if (!request->isError())
+                succeeded++;
+            request->deleteLater();
+        });
+        request->lookup();
+    }
+
+    while (finished < count && timer.elapsed() < 60000) {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 1);
+        outPeakThreads = qMax(outPeakThreads, ProcessStats::threadsCount());
+    }
+    outElapsedMs = timer.elapsed();
+    return succeeded;
+}
+
+QTEST_MAIN(TestDnsResolverThroughput)
+#include "dnsresolverthroughput.test.moc"
@@ -0,0 +1,47 @@
+#include "processstats.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+
+namespace {
+
+qint64 readStatusValue(const QByteArray &name)
+{
+#ifdef Q_OS_LINUX
+    QFile file("/proc/self/status");
+    if (file.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> lines = file.readAll().split('\n');
+        for (const QByteArray &line : lines) {
+            if (line.startsWith(name + ':')) {
+                // "VmRSS:     12345 kB"
+                return line.mid(name.size() + 1).trimmed().split(' ').first().toLongLong();
+            }
+        }
+    }
+#else
+    Q_UNUSED(name);
+#endif
+    return 0;
+}
+
+} // namespace
+
+namespace ProcessStats {
+
+int threadsCount()
+{
+    return (int)readStatusValue("Threads");
+}
+
+qint64 residentMemoryKb()
+{
+    return readStatusValue("VmRSS");
+}
+
+qint64 peakResidentMemoryKb()
+{
+    return readStatusValue("VmHWM");
+}
+
+} // namespace ProcessStats
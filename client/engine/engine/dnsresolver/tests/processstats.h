@@ -0,0 +1,13 @@
+#pragma once
+
+#include <QtGlobal>
+
+// Resource usage of the current process for the benchmarks (Linux only, 0 on the other platforms)
+namespace ProcessStats {
+
+int threadsCount();
+// the current and the peak resident set size
+qint64 residentMemoryKb();
+qint64 peakResidentMemoryKb();
+
+} // namespace ProcessStats
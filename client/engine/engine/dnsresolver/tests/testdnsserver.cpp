@@ -0,0 +1,283 @@
+#include "testdnsserver.h"
+
+#include <QHostAddress>
+#include <QNetworkDatagram>
+#include <QRandomGenerator>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QUdpSocket>
+
+namespace {
+
+const quint16 kTypeA = 1;
+const quint16 kTypeAAAA = 28;
+
+void appendUInt16(QByteArray &arr, quint16 value)
+{
+    arr.append((char)(value >> 8));
+    arr.append((char)(value & 0xFF));
+}
+
+void appendUInt32(QByteArray &arr, quint32 value)
+{
+    appendUInt16(arr, value >> 16);
+    appendUInt16(arr, value & 0xFFFF);
+}
+
+quint16 readUInt16(const QByteArray &arr, int offset)
+{
+    return ((quint8)arr[offset] << 8) | (quint8)arr[offset + 1];
+}
+
+} // namespace
+
+TestDnsServer::TestDnsServer(QObject *parent) : QThread(parent),
+    delayMs_(0),
+    lossPercent_(0),
+    isTruncateUdp_(false),
+    queriesCount_(0),
+    tcpQueriesCount_(0),
+    port_(0),
+    isStarted_(false)
+{
+    defaultRecord_.responseCode = kNxDomain;
+}
+
+TestDnsServer::~TestDnsServer()
+{
+    quit();
+    wait();
+}
+
+bool TestDnsServer::startServer()
+{
+    QMutexLocker locker(&startMutex_);
+    start();
+    while (!isStarted_)
+        startCondition_.wait(&startMutex_);
+    return port_ != 0;
+}
+
+quint16 TestDnsServer::port() const
+{
+    return port_;
+}
+
+QString TestDnsServer::address() const
+{
+    return "127.0.0.1:" + QString::number(port_);
+}
+
+void TestDnsServer::setRecord(const QString &hostname, const Record &record)
+{
+    QMutexLocker locker(&mutex_);
+    records_[hostname.toLower()] = record;
+}
+
+void TestDnsServer::setDefaultRecord(const Record &record)
+{
+    QMutexLocker locker(&mutex_);
+    defaultRecord_ = record;
+}
+
+void TestDnsServer::setDelayMs(int delayMs)
+{
+    QMutexLocker locker(&mutex_);
+    delayMs_ = delayMs;
+}
+
+void TestDnsServer::setLossPercent(int lossPercent)
+{
+    QMutexLocker locker(&mutex_);
+    lossPercent_ = lossPercent;
+}
+
+void TestDnsServer::setTruncateUdp(bool isTruncate)
+{
+    QMutexLocker locker(&mutex_);
+    isTruncateUdp_ = isTruncate;
+}
+
+int TestDnsServer::queriesCount() const
+{
+    QMutexLocker locker(&mutex_);
+    return queriesCount_;
+}
+
+int TestDnsServer::queriesCount(const QString &hostname) const
+{
+    QMutexLocker locker(&mutex_);
+    return queriesPerHostname_.value(hostname.toLower(), 0);
+}
+
+int TestDnsServer::tcpQueriesCount() const
+{
+    QMutexLocker locker(&mutex_);
+    return tcpQueriesCount_;
+}
+
+void TestDnsServer::resetCounters()
+{
+    QMutexLocker locker(&mutex_);
+    queriesCount_ = 0;
+    tcpQueriesCount_ = 0;
+    queriesPerHostname_.clear();
+}
+
+void TestDnsServer::run()
+{
+    QUdpSocket udpSocket;
+    QTcpServer tcpServer;
+    QHash<QTcpSocket *, QByteArray> tcpBuffers;
+
+    // UDP and TCP must share the port number
+    bool isBound = false;
+    for (int i = 0; i < 10 && !isBound; ++i) {
+        if (udpSocket.bind(QHostAddress::LocalHost, 0)) {
+            if (tcpServer.listen(QHostAddress::LocalHost, udpSocket.localPort()))
+                isBound = true;
+            else
+                udpSocket.close();
+        }
+    }
+
+    {
+        QMutexLocker locker(&startMutex_);
+        port_ = isBound ? udpSocket.localPort() : 0;
+        isStarted_ = true;
+        startCondition_.wakeAll();
+    }
+    if (!isBound)
+        return;
+
+    connect(&udpSocket, &QUdpSocket::readyRead, &udpSocket, [this, &udpSocket]() {
+        while (udpSocket.hasPendingDatagrams()) {
+            QNetworkDatagram datagram = udpSocket.receiveDatagram();
+            int delayMs = 0;
+            QByteArray response = makeResponse(datagram.data(), true, delayMs);
+            if (response.isEmpty())
+                continue;
+            QHostAddress address = datagram.senderAddress();
+            quint16 port = datagram.senderPort();
+            if (delayMs > 0) {
+                QTimer::singleShot(delayMs, &udpSocket, [&udpSocket, response, address, port]() {
+                    udpSocket.writeDatagram(response, address, port);
+                });
+            } else {
+                udpSocket.writeDatagram(response, address, port);
+            }
+        }
+    });
+
+    connect(&tcpServer, &QTcpServer::newConnection, &tcpServer, [this, &tcpServer, &tcpBuffers]() {
+        while (QTcpSocket *socket = tcpServer.nextPendingConnection()) {
+            tcpBuffers[socket] = QByteArray();
+            connect(socket, &QTcpSocket::disconnected, socket, [socket, &tcpBuffers]() {
+                tcpBuffers.remove(socket);
+                socket->deleteLater();
+            });
+            connect(socket, &QTcpSocket::readyRead, socket, [this, socket, &tcpBuffers]() {
+                QByteArray &buffer = tcpBuffers[socket];
+                buffer.append(socket->readAll());
+                // every message is prefixed by the two-byte length
+                while (buffer.size() >= 2 && buffer.size() >= 2 + readUInt16(buffer, 0)) {
+                    const int length = readUInt16(buffer, 0);
+                    const QByteArray query = buffer.mid(2, length);
+                    buffer.remove(0, 2 + length);
+
+                    int delayMs = 0;
+                    QByteArray response = makeResponse(query, false, delayMs);
+                    if (response.isEmpty())
+                        continue;
+                    QByteArray message;
+                    appendUInt16(message, response.size());
+                    message.append(response);
+                    if (delayMs > 0)
+                        QTimer::singleShot(delayMs, socket, [socket, message]() { socket->write(message); });
+                    else
+                        socket->write(message);
+                }
+            });
+        }
+    });
+
+    exec();
+}
+
+QByteArray TestDnsServer::makeResponse(const QByteArray &query, bool isUdp, int &outDelayMs)
+{
+    if (query.size() < 12 || readUInt16(query, 4) != 1)
+        return QByteArray();
+
+    // parse the question
+    QStringList labels;
+    int offset = 12;
+    while (offset < query.size() && query[offset] != 0) {
+        const int length = (quint8)query[offset];
+        labels << QString::fromLatin1(query.mid(offset + 1, length)).toLower();
+        offset += length + 1;
+    }
+    offset++;
+    if (offset + 4 > query.size())
+        return QByteArray();
+    const QString hostname = labels.join('.');
+    const quint16 qtype = readUInt16(query, offset);
+    const int questionEnd = offset + 4;
+
+    Record record;
+    bool isTruncate;
+    {
+        QMutexLocker locker(&mutex_);
+        queriesCount_++;
+        if (!isUdp)
+            tcpQueriesCount_++;
+        queriesPerHostname_[hostname]++;
+        record = records_.value(hostname, defaultRecord_);
+        if (isUdp && lossPercent_ > 0 && (int)QRandomGenerator::global()->bounded(100) < lossPercent_)
+            return QByteArray();
+        outDelayMs = record.delayMs >= 0 ? record.delayMs : delayMs_;
+        isTruncate = isUdp && isTruncateUdp_;
+    }
+    if (record.isNoResponse)
+        return QByteArray();
+
+    QStringList answers;
+    if (record.responseCode == kNoError && !isTruncate) {
+        if (qtype == kTypeA)
+            answers = record.ipv4;
+        else if (qtype == kTypeAAAA)
+            answers = record.ipv6;
+    }
+
+    // flags: response, copy of recursion desired, recursion available, truncation, response code
+    quint16 flags = 0x8000 | (readUInt16(query, 2) & 0x0100) | 0x0080 | record.responseCode;
+    if (isTruncate)
+        flags |= 0x0200;
+
+    QByteArray response;
+    response.append(query.left(2));     // id
+    appendUInt16(response, flags);
+    appendUInt16(response, 1);          // questions
+    appendUInt16(response, answers.size());
+    appendUInt16(response, 0);          // authority records
+    appendUInt16(response, 0);          // additional records
+    response.append(query.mid(12, questionEnd - 12));
+
+    for (const QString &ip : qAsConst(answers)) {
+        appendUInt16(response, 0xC00C);     // pointer to the name in the question
+        appendUInt16(response, qtype);
+        appendUInt16(response, 1);          // class IN
+        appendUInt32(response, record.ttl);
+        QHostAddress address(ip);
+        if (qtype == kTypeA) {
+            appendUInt16(response, 4);
+            appendUInt32(response, address.toIPv4Address());
+        } else {
+            Q_IPV6ADDR ipv6 = address.toIPv6Address();
+            appendUInt16(response, 16);
+            response.append((const char *)ipv6.c, 16);
+        }
+    }
+    return response;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+
+// Local DNS stub server (UDP and TCP on 127.0.0.1 with the same random port) for the resolver tests and benchmarks.
+// Answers A and AAAA queries from the configured records with configurable latency, loss and truncation.
+// Runs its own event loop in a separate thread, so the tests are free to block.
+class TestDnsServer : public QThread
+{
+    Q_OBJECT
+public:
+    enum ResponseCode { kNoError = 0, kServFail = 2, kNxDomain = 3 };
+
+    struct Record
+    {
+        QStringList ipv4;
+        QStringList ipv6;
+        quint32 ttl = 60;
+        ResponseCode responseCode = kNoError;
+        bool isNoResponse = false;      // simulates the timeout
+        int delayMs = -1;               // if -1 use the server's delay
+    };
+
+    explicit TestDnsServer(QObject *parent = nullptr);
+    ~TestDnsServer();
+
+    // binds the sockets and starts the thread, blocks until the server is ready
+    bool startServer();
+    quint16 port() const;
+    // "127.0.0.1:port", suitable for the dnsServers list of DnsRequest
+    QString address() const;
+
+    void setRecord(const QString &hostname, const Record &record);
+    // the answer for the hostnames without their own record, by default NXDOMAIN
+    void setDefaultRecord(const Record &record);
+    void setDelayMs(int delayMs);
+    void setLossPercent(int lossPercent);
+    // UDP answers are sent with the TC flag and without records, so the client has to retry over TCP
+    void setTruncateUdp(bool isTruncate);
+
+    int queriesCount() const;
+    int queriesCount(const QString &hostname) const;
+    int tcpQueriesCount() const;
+    void resetCounters();
+
+protected:
+    void run() override;
+
+private:
+    mutable QMutex mutex_;
+    QHash<QString, Record> records_;
+    Record defaultRecord_;
+    int delayMs_;
+    int lossPercent_;
+    bool isTruncateUdp_;
+    int queriesCount_;
+    int tcpQueriesCount_;
+    QHash<QString, int> queriesPerHostname_;
+
+    quint16 port_;
+    QMutex startMutex_;
+    QWaitCondition startCondition_;
+    bool isStarted_;
+
+    // returns an empty array if the query must be dropped
+    QByteArray makeResponse(const QByteArray &query, bool isUdp, int &outDelayMs);
+};
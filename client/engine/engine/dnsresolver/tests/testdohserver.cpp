@@ -0,0 +1,103 @@
+#include "testdohserver.h"
+
+#include <QHostAddress>
+#include <QUdpSocket>
+#include <QUrlQuery>
+
+TestDohServer::TestDohServer(QObject *parent, const QString &dnsServerAddress) : QObject(parent),
+    httpServer_(new TestHttpServer(this, false)),
+    dnsServerAddress_(dnsServerAddress),
+    failureStatusCode_(0),
+    queriesCount_(0)
+{
+    httpServer_->setHandler([this](const TestHttpServer::Request &request) {
+        return handleRequest(request);
+    });
+}
+
+bool TestDohServer::start()
+{
+    return httpServer_->start();
+}
+
+QUrl TestDohServer::url() const
+{
+    return httpServer_->url("/dns-query");
+}
+
+void TestDohServer::setFailureStatusCode(int statusCode)
+{
+    failureStatusCode_ = statusCode;
+}
+
+void TestDohServer::setResponseDelayMs(int delayMs)
+{
+    httpServer_->setResponseDelayMs(delayMs);
+}
+
+int TestDohServer::queriesCount() const
+{
+    return queriesCount_;
+}
+
+int TestDohServer::connectionsCount() const
+{
+    return httpServer_->connectionsCount();
+}
+
+void TestDohServer::resetCounters()
+{
+    queriesCount_ = 0;
+    httpServer_->resetCounters();
+}
+
+TestHttpServer::Response TestDohServer::handleRequest(const TestHttpServer::Request &request)
+{
+    TestHttpServer::Response response;
+    queriesCount_++;
+    if (failureStatusCode_ != 0) {
+        response.statusCode = failureStatusCode_;
+        return response;
+    }
+
+    const QUrl url("http://localhost" + QString::fromLatin1(request.path));
+    QByteArray message;
+    if (request.method == "POST") {
+        if (request.headers.value("content-type") != "application/dns-message") {
+            response.statusCode = 415;
+            return response;
+        }
+        message = request.body;
+    } else if (request.method == "GET") {
+        message = QByteArray::fromBase64(QUrlQuery(url).queryItemValue("dns").toLatin1(),
+                                         QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals);
+    }
+    if (url.path() != "/dns-query" || message.size() < 12) {
+        response.statusCode = 400;
+        return response;
+    }
+
+    response.body = forwardQuery(message);
+    if (response.body.isEmpty()) {
+        response.statusCode = 504;
+        return response;
+    }
+    response.headers << qMakePair(QByteArray("Content-Type"), QByteArray("application/dns-message"));
+    return response;
+}
+
+QByteArray TestDohServer::forwardQuery(const QByteArray &message) const
+{
+    const int ind = dnsServerAddress_.lastIndexOf(':');
+    const QHostAddress address(dnsServerAddress_.left(ind));
+    const quint16 port = dnsServerAddress_.mid(ind + 1).toUShort();
+
+    // the server runs in its own thread, so it's fine to block here
+    QUdpSocket socket;
+    socket.writeDatagram(message, address, port);
+    if (!socket.waitForReadyRead(3000))
+        return QByteArray();
+    QByteArray answer(socket.pendingDatagramSize(), Qt::Uninitialized);
+    socket.readDatagram(answer.data(), answer.size());
+    return answer;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <QUrl>
+#include "../../networkaccessmanager/tests/common/testhttpserver.h"
+
+// Local DNS over HTTPS stand-in (RFC 8484 over plain HTTP/1.1 keep-alive) for the DnsResolver_doh tests.
+// The DNS messages of the POST and GET requests are forwarded over UDP to a DNS server (usually TestDnsServer),
+// so the records, the delays and the response codes are configured there. Runs in the thread where it was created.
+class TestDohServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TestDohServer(QObject *parent, const QString &dnsServerAddress);
+
+    bool start();
+    // the URL of the /dns-query endpoint
+    QUrl url() const;
+
+    // if not 0, every request fails with this HTTP status code, e.g. 500 for a broken upstream
+    void setFailureStatusCode(int statusCode);
+    void setResponseDelayMs(int delayMs);
+
+    int queriesCount() const;
+    int connectionsCount() const;
+    void resetCounters();
+
+private:
+    TestHttpServer *httpServer_;
+    QString dnsServerAddress_;
+    int failureStatusCode_;
+    int queriesCount_;
+
+    TestHttpServer::Response handleRequest(const TestHttpServer::Request &request);
+    QByteArray forwardQuery(const QByteArray &message) const;
+};
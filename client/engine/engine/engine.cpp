@@ -16,6 +16,7 @@
 #include "connectstatecontroller/connectstatecontroller.h"
 #include "dnsresolver/dnsserversconfiguration.h"
 #include "dnsresolver/dnsrequest.h"
+#include "dnsresolver/dnsresolver_doh.h"
 #include "crossplatformobjectfactory.h"
 #include "openvpnversioncontroller.h"
 #include "types/global_consts.h"
@@ -288,6 +289,15 @@ bool Engine::isBlockConnect() const
     return isBlockConnect_;
 }
 
+void Engine::setFavoriteLocations(const QSet<LocationID> &favoriteLocations)
+{
+    QMetaObject::invokeMethod(this, [this, favoriteLocations]() {
+        favoriteLocations_ = favoriteLocations;
+        if (locationsModel_)
+            locationsModel_->setFavoriteLocations(favoriteLocations_);
+    }, Qt::QueuedConnection);
+}
+
 void Engine::setBlockConnect(bool isBlockConnect)
 {
     isBlockConnect_ = isBlockConnect;
@@ -418,6 +428,19 @@ QString Engine::getProxySharingAddress()
     }
 }
 
+RequestTimingStats::Percentiles Engine::getRequestTimingPercentiles(const QString &endpoint, const QString &domain)
+{
+    QMutexLocker locker(&mutex_);
+    if (bInitialized_)
+    {
+        return networkAccessManager_->timingStats().percentiles(endpoint, domain);
+    }
+    else
+    {
+        return RequestTimingStats::Percentiles();
+    }
+}
+
 QString Engine::getSharingCaption()
 {
     QMutexLocker locker(&mutex_);
@@ -574,6 +597,8 @@ void Engine::initPart2()
 
     networkAccessManager_ = new NetworkAccessManager(this);
     connect(networkAccessManager_, &NetworkAccessManager::whitelistIpsChanged, this, &Engine::onHostIPsChanged);
+    connect(this, &Engine::firewallStateChanged, this, &Engine::updateIPv6Policy);
+    updateIPv6Policy();
 
     // Ownership of the failover passes to the serverAPI object (in the ServerAPI ctor)
     failover::IFailoverContainer *failoverContainer = new failover::FailoverContainer(nullptr, networkAccessManager_);
@@ -611,6 +636,7 @@ void Engine::initPart2()
     locationsModel_ = new locationsmodel::LocationsModel(this, connectStateController_, networkDetectionManager_, networkAccessManager_);
     connect(locationsModel_, SIGNAL(whitelistLocationsIpsChanged(QStringList)), SLOT(onLocationsModelWhitelistIpsChanged(QStringList)));
     connect(locationsModel_, SIGNAL(whitelistCustomConfigsIpsChanged(QStringList)), SLOT(onLocationsModelWhitelistCustomConfigIpsChanged(QStringList)));
+    locationsModel_->setFavoriteLocations(favoriteLocations_);
 
     vpnShareController_ = new VpnShareController(this, helper_);
     connect(vpnShareController_, &VpnShareController::connectedWifiUsersChanged, this, &Engine::wifiSharingStateChanged);
@@ -856,6 +882,8 @@ void Engine::cleanupImpl(bool isExitWithRestart, bool isFirewallChecked, bool is
     SAFE_DELETE(networkDetectionManager_);
     SAFE_DELETE(downloadHelper_);
     SAFE_DELETE(networkAccessManager_);
+    // stop its thread while the app is still alive, the instance is destroyed with the statics
+    DnsResolver_doh::instance().shutdown();
     isCleanupFinished_ = true;
     Q_EMIT cleanupFinished();
     qCDebug(LOG_BASIC) << "Cleanup finished";
@@ -903,6 +931,7 @@ void Engine::connectClickImpl(const LocationID &locationId, const types::Connect
 {
     locationId_ = locationId;
     connectionSettingsOverride_ = connectionSettings;
+    locationsModel_->setCurrentLocation(locationId);
 
     // if connected, then first disconnect
     if (!connectionManager_->isDisconnected())
@@ -2419,6 +2448,8 @@ void Engine::stopPacketDetectionImpl()
 
 void Engine::onConnectStateChanged(CONNECT_STATE state, DISCONNECT_REASON /*reason*/, CONNECT_ERROR /*err*/, const LocationID & /*location*/)
 {
+    updateIPv6Policy();
+
     if (helper_) {
         if (state != CONNECT_STATE_CONNECTED) {
             helper_->sendConnectStatus(false, engineSettings_.isTerminateSockets(), engineSettings_.isAllowLanTraffic(), AdapterGatewayInfo::detectAndCreateDefaultAdapterInfo(), AdapterGatewayInfo(), QString(), types::Protocol());
@@ -2426,6 +2457,16 @@ void Engine::onConnectStateChanged(CONNECT_STATE state, DISCONNECT_REASON /*reas
     }
 }
 
+void Engine::updateIPv6Policy()
+{
+    // the firewall rules drop IPv6 and IPv6 is disabled while connecting and connected,
+    // so the network requests are allowed to use IPv6 only in the disconnected state without the firewall
+    if (networkAccessManager_ && firewallController_) {
+        networkAccessManager_->setIPv6Allowed(connectStateController_->currentState() == CONNECT_STATE_DISCONNECTED &&
+                                              !firewallController_->firewallActualState());
+    }
+}
+
 void Engine::updateProxySettings()
 {
     if (ProxyServerController::instance().updateProxySettings(engineSettings_.proxySettings())) {
@@ -79,6 +79,8 @@ public:
 
     void connectClick(const LocationID &locationId, const types::ConnectionSettings &connectionSettings);
     void disconnectClick();
+    // the favorite locations are pinged before the rest
+    void setFavoriteLocations(const QSet<LocationID> &favoriteLocations);
 
     bool isBlockConnect() const;
     void setBlockConnect(bool isBlockConnect);
@@ -118,6 +120,9 @@ public:
 
     void makeHostsFileWritableWin();
 
+    // the rolling percentiles of the API request phases, over all the domains if the domain is empty (see RequestTimingStats)
+    RequestTimingStats::Percentiles getRequestTimingPercentiles(const QString &endpoint, const QString &domain = QString());
+
 public slots:
     void init();
     void stopPacketDetection();
@@ -352,6 +357,7 @@ private:
     std::atomic<bool> isCleanupFinished_;
 
     LocationID locationId_;
+    QSet<LocationID> favoriteLocations_;
     QString locationName_;
 
     QString lastConnectingHostname_;
@@ -369,6 +375,7 @@ private:
     void loginImpl(bool isUseAuthHash, const QString &username, const QString &password, const QString &code2fa);
     void updateServerLocations();
     void updateFirewallSettings();
+    void updateIPv6Policy();
 
     void addCustomRemoteIpToFirewallIfNeed();
     void doConnect(bool bEmitAuthError);
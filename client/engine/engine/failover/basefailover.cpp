@@ -0,0 +1,37 @@
+#include "basefailover.h"
+
+#include "engine/networkaccessmanager/networkreply.h"
+
+namespace failover {
+
+BaseFailover::~BaseFailover()
+{
+    cancel();
+}
+
+void BaseFailover::cancel()
+{
+    curRun_++;
+    if (reply_) {
+        // no signals are emitted after the abort, so the reply is not deleted by its finished handler
+        reply_->abort();
+        reply_->deleteLater();
+        reply_ = nullptr;
+    }
+}
+
+quint64 BaseFailover::startRun(NetworkReply *reply)
+{
+    reply_ = reply;
+    return ++curRun_;
+}
+
+void BaseFailover::emitFinished(quint64 run, const QVector<FailoverData> &data)
+{
+    if (run != curRun_)
+        return;
+    reply_ = nullptr;
+    emit finished(data);
+}
+
+} // namespace failover
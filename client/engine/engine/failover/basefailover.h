@@ -3,9 +3,11 @@
 #include <QDateTime>
 #include <QElapsedTimer>
 #include <QObject>
+#include <QPointer>
 #include "utils/ws_assert.h"
 
 class NetworkAccessManager;
+class NetworkReply;
 
 namespace failover {
 
@@ -52,8 +54,12 @@ public:
         uniqueId_(uniqueId), QObject(parent), networkAccessManager_(networkAccessManager)
     {
     }
+    virtual ~BaseFailover();
 
     virtual void getData(bool bIgnoreSslErrors) = 0;
+    // Cancels the getData() in progress: its network request is aborted and the finished signal is not emitted for it.
+    // Does nothing if there is no getData() in progress, the failover can be used again right after it.
+    void cancel();
     virtual QString name() const = 0;
     QString uniqueId() const { return uniqueId_; }
 signals:
@@ -62,6 +68,15 @@ signals:
 protected:
      NetworkAccessManager *networkAccessManager_;
      QString uniqueId_;
+
+     // The asynchronous getData() implementations tag the run with startRun() and emit the result with emitFinished(),
+     // so the result of a cancelled run is dropped. The reply, if any, is aborted by cancel().
+     quint64 startRun(NetworkReply *reply = nullptr);
+     void emitFinished(quint64 run, const QVector<FailoverData> &data);
+
+private:
+     quint64 curRun_ = 0;
+     QPointer<NetworkReply> reply_;
 };
 
 
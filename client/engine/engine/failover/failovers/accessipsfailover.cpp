@@ -24,8 +24,8 @@ void AccessIpsFailover::getData(bool bIgnoreSslErrors)
 
     NetworkRequest networkRequest(url.toString(), kTimeout, true, DnsServersConfiguration::instance().getCurrentDnsServers(), bIgnoreSslErrors);
     NetworkReply *reply = networkAccessManager_->get(networkRequest);
-
-    connect(reply, &NetworkReply::finished, this, &AccessIpsFailover::onNetworkRequestFinished);
+    const quint64 run = startRun(reply);
+    connect(reply, &NetworkReply::finished, this, [this, reply, run]() { onNetworkRequestFinished(reply, run); });
 }
 
 QString AccessIpsFailover::name() const
@@ -34,13 +34,12 @@ QString AccessIpsFailover::name() const
     return "acc: " + ip_.left(3);
 }
 
-void AccessIpsFailover::onNetworkRequestFinished()
+void AccessIpsFailover::onNetworkRequestFinished(NetworkReply *reply, quint64 run)
 {
-    NetworkReply *reply = static_cast<NetworkReply *>(sender());
     QSharedPointer<NetworkReply> obj = QSharedPointer<NetworkReply>(reply, &QObject::deleteLater);
 
     if (!reply->isSuccess()) {
-        emit finished(QVector<FailoverData>());
+        emitFinished(run, QVector<FailoverData>());
     }
     else {
         QStringList hosts = handleRequest(reply->readAll());
@@ -49,7 +48,7 @@ void AccessIpsFailover::onNetworkRequestFinished()
             data << FailoverData(s);
 
         data = Utils::randomizeList<QVector<FailoverData> >(data);
-        emit finished(data);
+        emitFinished(run, data);
     }
 }
 
@@ -15,12 +15,10 @@ public:
     void getData(bool bIgnoreSslErrors) override;
     QString name() const override;
 
-private slots:
-    void onNetworkRequestFinished();
-
 private:
     static constexpr int kTimeout = 5000;          // timeout 5 sec by default
     QString ip_;
+    void onNetworkRequestFinished(NetworkReply *reply, quint64 run);
     QStringList handleRequest(const QByteArray &arr);
 };
 
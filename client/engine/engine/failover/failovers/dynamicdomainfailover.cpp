@@ -22,15 +22,16 @@ void DynamicDomainFailover::getData(bool bIgnoreSslErrors)
     NetworkRequest networkRequest(url, 5000, true, DnsServersConfiguration::instance().getCurrentDnsServers(), bIgnoreSslErrors);
     networkRequest.setContentTypeHeader("accept: application/dns-json");
     NetworkReply *reply = networkAccessManager_->get(networkRequest);
-    connect(reply, &NetworkReply::finished, [=]() {
+    const quint64 run = startRun(reply);
+    connect(reply, &NetworkReply::finished, this, [=]() {
         if (!reply->isSuccess()) {
-            emit finished(QVector<FailoverData>());
+            emitFinished(run, QVector<FailoverData>());
         } else {
             QString hostname = parseHostnameFromJson(reply->readAll());
             if (!hostname.isEmpty())
-                emit finished(QVector<FailoverData>() << FailoverData(hostname));
+                emitFinished(run, QVector<FailoverData>() << FailoverData(hostname));
             else
-                emit finished(QVector<FailoverData>());
+                emitFinished(run, QVector<FailoverData>());
         }
         reply->deleteLater();
     });
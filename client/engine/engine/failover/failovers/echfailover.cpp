@@ -25,13 +25,14 @@ void EchFailover::getData(bool bIgnoreSslErrors)
     NetworkRequest networkRequest(url, 5000, true, DnsServersConfiguration::instance().getCurrentDnsServers(), bIgnoreSslErrors);
     networkRequest.setContentTypeHeader("accept: application/dns-json");
     NetworkReply *reply = networkAccessManager_->get(networkRequest);
-    connect(reply, &NetworkReply::finished, [=]() {
+    const quint64 run = startRun(reply);
+    connect(reply, &NetworkReply::finished, this, [=]() {
         if (!reply->isSuccess()) {
-            emit finished(QVector<FailoverData>());
+            emitFinished(run, QVector<FailoverData>());
         } else {
             QVector<FailoverData> data = parseDataFromJson(reply->readAll());
             data = Utils::randomizeList<QVector<FailoverData> >(data);
-            emit finished(data);
+            emitFinished(run, data);
         }
         reply->deleteLater();
     });
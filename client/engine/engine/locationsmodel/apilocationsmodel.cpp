@@ -2,20 +2,42 @@
 
 #include <QFile>
 #include <QTextStream>
+#include <algorithm>
 
 #include "mutablelocationinfo.h"
-#include "nodeselectionalgorithm.h"
+#include "utils/extraconfig.h"
 #include "utils/logger.h"
 
 namespace locationsmodel {
 
 ApiLocationsModel::ApiLocationsModel(QObject *parent, IConnectStateController *stateController, INetworkDetectionManager *networkDetectionManager, PingHost *pingHost) : QObject(parent),
+    nodeHealth_(new NodeHealth()),
     pingIpsController_(this, stateController, networkDetectionManager, pingHost, "ping_log.txt")
 {
     connect(&pingIpsController_, &PingIpsController::pingInfoChanged, this, &ApiLocationsModel::onPingInfoChanged);
     connect(&pingIpsController_, &PingIpsController::needIncrementPingIteration, this, &ApiLocationsModel::onNeedIncrementPingIteration);
     pingStorage_.incIteration();
 
+    if (ExtraConfig::instance().getUsePingStatistics())
+    {
+        PingStatistics::ScoreWeights weights;
+        bool success;
+        // the jitter weight is in percent
+        int jitterWeight = ExtraConfig::instance().getPingScoreJitterWeight(success);
+        if (success)
+        {
+            weights.jitterWeight = jitterWeight / 100.0;
+        }
+        int lossWeight = ExtraConfig::instance().getPingScoreLossWeight(success);
+        if (success)
+        {
+            weights.lossWeight = lossWeight;
+        }
+        pingStorage_.setStatisticsMode(true);
+        pingStorage_.setScoreWeights(weights);
+        qCDebug(LOG_BEST_LOCATION) << "Ping statistics mode enabled, jitter weight:" << weights.jitterWeight << ", loss weight:" << weights.lossWeight;
+    }
+
     if (bestLocation_.isValid())
     {
         qCDebug(LOG_BEST_LOCATION) << "Best location loaded from settings: " << bestLocation_.getId().getHashString();
@@ -34,6 +56,7 @@ void ApiLocationsModel::setLocations(const QVector<apiinfo::Location> &locations
 
     locations_ = locations;
     staticIps_ = staticIps;
+    nodeSelectors_.clear();
 
     whitelistIps();
 
@@ -57,6 +80,7 @@ void ApiLocationsModel::setLocations(const QVector<apiinfo::Location> &locations
         }
     }
 
+    updatePingPriorities();
     pingIpsController_.updateIps(ips);
     sendLocationsUpdated();
 }
@@ -65,11 +89,26 @@ void ApiLocationsModel::clear()
 {
     locations_.clear();
     staticIps_ = apiinfo::StaticIps();
+    nodeSelectors_.clear();
     pingIpsController_.updateIps(QVector<PingIpInfo>());
     QSharedPointer<QVector<types::Location> > empty(new QVector<types::Location>());
     Q_EMIT locationsUpdated(LocationID(), QString(),  empty);
 }
 
+void ApiLocationsModel::setCurrentLocation(const LocationID &locationId)
+{
+    currentLocation_ = locationId.isBestLocation() ? locationId.bestLocationToApiLocation() : locationId;
+    updatePingPriorities();
+}
+
+void ApiLocationsModel::setFavoriteLocations(const QSet<LocationID> &favoriteLocations)
+{
+    if (favoriteLocations_ != favoriteLocations) {
+        favoriteLocations_ = favoriteLocations;
+        updatePingPriorities();
+    }
+}
+
 QSharedPointer<BaseLocationInfo> ApiLocationsModel::getMutableLocationInfoById(const LocationID &locationId)
 {
     LocationID modifiedLocationId = locationId;
@@ -135,8 +174,13 @@ QSharedPointer<BaseLocationInfo> ApiLocationsModel::getMutableLocationInfoById(c
                         dnsHostname =  l.getDnsHostName();
                     }
 
-                    int selectedNode = NodeSelectionAlgorithm::selectRandomNodeBasedOnWeight(nodes);
-                    QSharedPointer<BaseLocationInfo> bli(new MutableLocationInfo(modifiedLocationId, group.getCity() + " - " + group.getNick(), nodes, selectedNode,dnsHostname, group.getOvpnX509()));
+                    auto selectorIt = nodeSelectors_.find(group.getId());
+                    if (selectorIt == nodeSelectors_.end())
+                    {
+                        selectorIt = nodeSelectors_.insert(group.getId(), WeightedNodeSelector(nodes));
+                    }
+                    int selectedNode = selectorIt.value().select(*nodeHealth_);
+                    QSharedPointer<BaseLocationInfo> bli(new MutableLocationInfo(modifiedLocationId, group.getCity() + " - " + group.getNick(), nodes, selectedNode,dnsHostname, group.getOvpnX509(), nodeHealth_));
                     return bli;
                 }
             }
@@ -213,7 +257,8 @@ void ApiLocationsModel::detectBestLocation(bool isAllNodesInDisconnectedState)
             }
 
             LocationID lid = LocationID::createApiLocationId(l.getId(), group.getCity(), group.getNick());
-            int latency = pingStorage_.getPing(group.getId()).toInt();
+            // the last ping or the statistics score, depending on the storage mode
+            int latency = pingStorage_.getScore(group.getId());
 
             // we assume a maximum ping time for three bars when no ping info
             if (latency == PingTime::NO_PING_INFO)
@@ -430,4 +475,49 @@ bool ApiLocationsModel::isChanged(const QVector<apiinfo::Location> &locations, c
 }
 
 
+void ApiLocationsModel::updatePingPriorities()
+{
+    QSet<QString> currentAndFavoriteIds;
+    QSet<QString> candidateIds;
+    QVector< QPair<int, int> > scores;     // score, group id
+
+    for (const apiinfo::Location &l : locations_) {
+        for (int i = 0; i < l.groupsCount(); ++i) {
+            const apiinfo::Group group = l.getGroup(i);
+            const LocationID lid = LocationID::createApiLocationId(l.getId(), group.getCity(), group.getNick());
+            const QString id = QString::number(group.getId());
+
+            if ((currentLocation_.isValid() && lid == currentLocation_) || favoriteLocations_.contains(lid)) {
+                currentAndFavoriteIds << id;
+            }
+            if (group.isDisabled()) {
+                continue;
+            }
+            if (bestLocation_.isValid() && lid == bestLocation_.getId()) {
+                candidateIds << id;
+            }
+            const int score = pingStorage_.getScore(group.getId());
+            if (score != PingTime::NO_PING_INFO && score != PingTime::PING_FAILED) {
+                scores << qMakePair(score, group.getId());
+            }
+        }
+    }
+
+    for (int i = 0; i < staticIps_.getIpsCount(); ++i) {
+        const apiinfo::StaticIpDescr &sid = staticIps_.getIp(i);
+        const LocationID lid = LocationID::createStaticIpsLocationId(sid.cityName, sid.staticIp);
+        if ((currentLocation_.isValid() && lid == currentLocation_) || favoriteLocations_.contains(lid)) {
+            currentAndFavoriteIds << QString::number(sid.id);
+        }
+    }
+
+    const int candidatesCount = qMin((int)scores.size(), BEST_LOCATION_CANDIDATES_COUNT);
+    std::partial_sort(scores.begin(), scores.begin() + candidatesCount, scores.end());
+    for (int i = 0; i < candidatesCount; ++i) {
+        candidateIds << QString::number(scores[i].second);
+    }
+
+    pingIpsController_.setPriorities(currentAndFavoriteIds, candidateIds);
+}
+
 } //namespace locationsmodel
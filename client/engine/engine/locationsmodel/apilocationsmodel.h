@@ -2,16 +2,19 @@
 
 #include <QObject>
 #include <QHash>
+#include <QSet>
 
 #include "baselocationinfo.h"
 #include "bestlocation.h"
 #include "engine/apiinfo/location.h"
 #include "engine/apiinfo/staticips.h"
 #include "engine/networkdetectionmanager/inetworkdetectionmanager.h"
+#include "nodehealth.h"
 #include "pingipscontroller.h"
 #include "pingstorage.h"
 #include "types/location.h"
 #include "types/locationid.h"
+#include "weightednodeselector.h"
 
 namespace locationsmodel {
 
@@ -31,6 +34,10 @@ public:
 
     void setLocations(const QVector<apiinfo::Location> &locations, const apiinfo::StaticIps &staticIps);
     void clear();
+    // the location of the latest connection, it's pinged first
+    void setCurrentLocation(const LocationID &locationId);
+    // the favorite cities of the user, they are pinged first too
+    void setFavoriteLocations(const QSet<LocationID> &favoriteLocations);
 
     QSharedPointer<BaseLocationInfo> getMutableLocationInfoById(const LocationID &locationId);
 
@@ -49,11 +56,21 @@ private slots:
     void onNeedIncrementPingIteration();
 
 private:
+    // the locations with the best scores of the previous pings are pinged before the rest
+    static constexpr int BEST_LOCATION_CANDIDATES_COUNT = 10;
+
     ApiPingStorage pingStorage_;
     QVector<apiinfo::Location> locations_;
     apiinfo::StaticIps staticIps_;
 
     BestLocation bestLocation_;
+    LocationID currentLocation_;
+    QSet<LocationID> favoriteLocations_;
+
+    // alias tables for the groups (by group id), rebuilt when the locations change
+    QHash<int, WeightedNodeSelector> nodeSelectors_;
+    // shared with the MutableLocationInfo instances, which report the failed nodes
+    QSharedPointer<NodeHealth> nodeHealth_;
 
     PingIpsController pingIpsController_;
 
@@ -62,6 +79,7 @@ private:
     BestAndAllLocations generateLocationsUpdated();
     void sendLocationsUpdated();
     void whitelistIps();
+    void updatePingPriorities();
 
     bool isChanged(const QVector<apiinfo::Location> &locations, const apiinfo::StaticIps &staticIps);
 };
@@ -44,6 +44,18 @@ void LocationsModel::clear()
     customConfigLocationsModel_->clear();
 }
 
+void LocationsModel::setCurrentLocation(const LocationID &locationId)
+{
+    if (!locationId.isCustomConfigsLocation()) {
+        apiLocationsModel_->setCurrentLocation(locationId);
+    }
+}
+
+void LocationsModel::setFavoriteLocations(const QSet<LocationID> &favoriteLocations)
+{
+    apiLocationsModel_->setFavoriteLocations(favoriteLocations);
+}
+
 void LocationsModel::setProxySettings(const types::ProxySettings &proxySettings)
 {
     pingHost_->setProxySettings(proxySettings);
@@ -22,6 +22,10 @@ public:
     void setApiLocations(const QVector<apiinfo::Location> &locations, const apiinfo::StaticIps &staticIps);
     void setCustomConfigLocations(const QVector<QSharedPointer<const customconfigs::ICustomConfig>> &customConfigs);
     void clear();
+    // the location of the latest connection, it's pinged first
+    void setCurrentLocation(const LocationID &locationId);
+    // the favorite locations of the user, they are pinged first too
+    void setFavoriteLocations(const QSet<LocationID> &favoriteLocations);
 
     void setProxySettings(const types::ProxySettings &proxySettings);
     void disableProxy();
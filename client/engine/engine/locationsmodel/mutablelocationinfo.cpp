@@ -9,12 +9,14 @@
 namespace locationsmodel {
 
 MutableLocationInfo::MutableLocationInfo(const LocationID &locationId, const QString &name, const QVector< QSharedPointer<const BaseNode> > &nodes, int selectedNode,
-                                         const QString &dnsHostName, const QString &verifyX509name)
+                                         const QString &dnsHostName, const QString &verifyX509name,
+                                         const QSharedPointer<NodeHealth> &nodeHealth)
     : BaseLocationInfo(locationId, name)
     , nodes_(nodes)
     , selectedNode_(selectedNode)
     , dnsHostName_(dnsHostName)
     , verifyX509name_(verifyX509name)
+    , nodeHealth_(nodeHealth)
 {
 
     QString strNodes;
@@ -85,6 +87,11 @@ QString MutableLocationInfo::getIpForNode(int indNode, int indIp) const
 // goto next node or to first (if current selected last or incorrect)
 void MutableLocationInfo::selectNextNode()
 {
+    if (nodeHealth_ && selectedNode_ >= 0 && selectedNode_ < nodes_.count())
+    {
+        nodeHealth_->markFailed(nodes_[selectedNode_]->getHostname());
+    }
+
     selectedNode_ ++;
     if (selectedNode_ >= nodes_.count())
     {
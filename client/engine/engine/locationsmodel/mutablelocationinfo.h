@@ -6,6 +6,7 @@
 
 #include "locationnode.h"
 #include "baselocationinfo.h"
+#include "nodehealth.h"
 
 
 namespace locationsmodel {
@@ -19,7 +20,8 @@ class MutableLocationInfo : public BaseLocationInfo
 public:
     explicit MutableLocationInfo(const LocationID &locationId, const QString &name,
                                  const QVector< QSharedPointer<const BaseNode> > &nodes, int selectedNode,
-                                 const QString &dnsHostName, const QString &verifyX509name);
+                                 const QString &dnsHostName, const QString &verifyX509name,
+                                 const QSharedPointer<NodeHealth> &nodeHealth = QSharedPointer<NodeHealth>());
 
 
     QString getDnsName() const;
@@ -30,6 +32,7 @@ public:
     int nodesCount() const;
     QString getIpForNode(int indNode, int indIp) const;
 
+    // called after a failed connection, the selected node is reported to the NodeHealth (if set)
     void selectNextNode();
 
     QString getIpForSelectedNode(int indIp) const;
@@ -49,6 +52,7 @@ private:
     int selectedNode_;
     QString dnsHostName_;
     QString verifyX509name_;
+    QSharedPointer<NodeHealth> nodeHealth_;
 
     QString getLogForNode(int ind) const;
 
@@ -0,0 +1,74 @@
+#include "nodehealth.h"
+
+#include <QtMath>
+
+namespace locationsmodel {
+
+NodeHealth::NodeHealth()
+{
+    clock_.start();
+}
+
+void NodeHealth::markFailed(const QString &hostname)
+{
+    markFailed(hostname, nowMs());
+}
+
+void NodeHealth::markFailed(const QString &hostname, qint64 nowMs)
+{
+    QMutexLocker locker(&mutex_);
+    auto it = failures_.find(hostname);
+    if (it == failures_.end()) {
+        failures_[hostname] = FailureInfo{ nowMs, 1 };
+        return;
+    }
+
+    // the failures are counted as consecutive only while the previous penalty is still significant
+    if (penalty(it.value(), nowMs) < 0.1) {
+        it->failuresCount = 0;
+    }
+    it->failuresCount++;
+    it->lastFailureMs = nowMs;
+}
+
+void NodeHealth::clear()
+{
+    QMutexLocker locker(&mutex_);
+    failures_.clear();
+}
+
+double NodeHealth::factor(const QString &hostname) const
+{
+    return factor(hostname, nowMs());
+}
+
+double NodeHealth::factor(const QString &hostname, qint64 nowMs) const
+{
+    QMutexLocker locker(&mutex_);
+    auto it = failures_.constFind(hostname);
+    if (it == failures_.constEnd()) {
+        return 1.0;
+    }
+    return qMax(MIN_FACTOR, 1.0 - penalty(it.value(), nowMs));
+}
+
+bool NodeHealth::isEmpty() const
+{
+    QMutexLocker locker(&mutex_);
+    return failures_.isEmpty();
+}
+
+qint64 NodeHealth::nowMs() const
+{
+    return clock_.elapsed();
+}
+
+double NodeHealth::penalty(const FailureInfo &fi, qint64 nowMs)
+{
+    // 0.5 after the first failure, 0.75 after the second one, etc.
+    const double strength = 1.0 - qPow(0.5, fi.failuresCount);
+    const qint64 elapsed = qMax((qint64)0, nowMs - fi.lastFailureMs);
+    return strength * qExp(-(double)elapsed / DECAY_TIME_MS);
+}
+
+} //namespace locationsmodel
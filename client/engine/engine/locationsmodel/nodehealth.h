@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+namespace locationsmodel {
+
+// Remembers the nodes (by hostname) that recently failed to connect and gives a health factor in (0, 1]
+// to temporarily down-weight them in the node selection. The penalty grows with consecutive failures
+// and decays exponentially over time. Thread safe.
+class NodeHealth
+{
+public:
+    static constexpr qint64 DECAY_TIME_MS = 5 * 60 * 1000;    // the time constant of the exponential decay
+    static constexpr double MIN_FACTOR = 0.05;
+
+    NodeHealth();
+
+    void markFailed(const QString &hostname);
+    void markFailed(const QString &hostname, qint64 nowMs);
+    void clear();
+
+    // 1.0 for a healthy node
+    double factor(const QString &hostname) const;
+    double factor(const QString &hostname, qint64 nowMs) const;
+    bool isEmpty() const;
+
+    // monotonic time used by the overloads without nowMs
+    qint64 nowMs() const;
+
+private:
+    struct FailureInfo
+    {
+        qint64 lastFailureMs;
+        int failuresCount;
+    };
+
+    mutable QMutex mutex_;
+    QElapsedTimer clock_;
+    QHash<QString, FailureInfo> failures_;
+
+    static double penalty(const FailureInfo &fi, qint64 nowMs);
+};
+
+} //namespace locationsmodel
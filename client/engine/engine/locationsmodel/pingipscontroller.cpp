@@ -13,8 +13,10 @@ PingIpsController::PingIpsController(QObject *parent, IConnectStateController *s
     connectStateController_(stateController), networkDetectionManager_(networkDetectionManager),
     pingLog_(log_filename), pingHost_(pingHost)
 {
+    connect(pingHost_, &PingHost::pingStarted, this, &PingIpsController::onPingStarted);
     connect(pingHost_, &PingHost::pingFinished, this, &PingIpsController::onPingFinished);
     connect(&pingTimer_, &QTimer::timeout, this, &PingIpsController::onPingTimer);
+    clock_.start();
 
     int pingHour = Utils::generateIntegerRandom(0, 23);
     int pingMinute = Utils::generateIntegerRandom(0, 59);
@@ -42,13 +44,29 @@ void PingIpsController::updateIps(const QVector<PingIpInfo> &ips)
         it.value().existThisIp = false;
     }
 
+    // only the new nodes and the nodes with the changed address are pinged, the others keep their measurements
+    int addedCount = 0;
+    int changedCount = 0;
     for (const PingIpInfo &ip_info : ips) {
         auto it = ips_.find(ip_info.id_);
         if (it == ips_.end()) {
             ips_[ip_info.id_] = PingNodeInfo(ip_info);
+            addedCount++;
         }
         else {
-            it.value().existThisIp = true;
+            PingNodeInfo &pni = it.value();
+            pni.existThisIp = true;
+            if (pni.ipInfo_.ip_ != ip_info.ip_ || pni.ipInfo_.hostname_ != ip_info.hostname_ || pni.ipInfo_.pingType_ != ip_info.pingType_) {
+                pingLog_.addLog("PingIpsController::updateIps", tr("ip changed: %1 -> %2 (%3 - %4)").arg(pni.ipInfo_.ip_, ip_info.ip_, ip_info.city_, ip_info.nick_));
+                pni.isExistPingAttempt_ = false;
+                pni.latestPingFailed_ = false;
+                pni.failedPingsInRow_ = 0;
+                pni.nextTimeForFailedPing_ = 0;
+                // a queued ping goes to the new address, the result of a ping in flight is discarded
+                pni.isIpChangedWhilePinging_ = scheduler_.isInFlight(ip_info.id_);
+                changedCount++;
+            }
+            pni.ipInfo_ = ip_info;
         }
     }
 
@@ -57,6 +75,7 @@ void PingIpsController::updateIps(const QVector<PingIpInfo> &ips)
     while (it != ips_.end()) {
         if (!it.value().existThisIp) {
             pingLog_.addLog("PingIpsController::updateIps", "removed unused ip: " + it.key());
+            scheduler_.remove(it.key());
             it = ips_.erase(it);
         }
         else {
@@ -65,15 +84,28 @@ void PingIpsController::updateIps(const QVector<PingIpInfo> &ips)
     }
 
     failedPingLogController_.clear();
+    pingLog_.addLog("PingIpsController::updateIps", tr("%1 nodes, %2 new, %3 changed").arg(ips_.count()).arg(addedCount).arg(changedCount));
 
     onPingTimer();
+    reportProgress();
     pingTimer_.start(PING_TIMER_INTERVAL);
 }
 
+void PingIpsController::setPriorities(const QSet<QString> &currentAndFavoriteIds, const QSet<QString> &bestLocationCandidateIds)
+{
+    currentAndFavoriteIds_ = currentAndFavoriteIds;
+    bestLocationCandidateIds_ = bestLocationCandidateIds;
+
+    for (auto it = ips_.cbegin(); it != ips_.cend(); ++it) {
+        if (scheduler_.isQueued(it.key())) {
+            scheduler_.enqueue(it.key(), priority(it.key()), true);
+        }
+    }
+}
+
 void PingIpsController::onPingTimer()
 {
-    // We don't attempt to issue a ping request when state is CONNECT_STATE_CONNECTING, as the firewall will block it.
-    if (!networkDetectionManager_->isOnline() || connectStateController_->currentState() != CONNECT_STATE_DISCONNECTED) {
+    if (!isPingAllowed()) {
         return;
     }
 
@@ -84,6 +116,7 @@ void PingIpsController::onPingTimer()
         qCDebug(LOG_BASIC) << "Ping all nodes by time";
         pingLog_.addLog("PingIpsController::onPingTimer", "it's ping time, set next ping time to:" + dtNextPingTime_.toString("ddMMyyyy HH:mm:ss"));
         Q_EMIT needIncrementPingIteration();
+        scheduler_.startRound();
     }
 
     for (auto it = ips_.begin(); it != ips_.end(); ++it) {
@@ -95,26 +128,42 @@ void PingIpsController::onPingTimer()
 
         if (bNeedPingByTime) {
             pingLog_.addLog("PingNodesController::onPingTimer", tr("start ping by time for: %1 (%2 - %3)").arg(pni.ipInfo_.ip_, pni.ipInfo_.city_, pni.ipInfo_.nick_));
-            pni.nowPinging_ = true;
-            pingHost_->addHostForPing(pni.ipInfo_.id_, pni.ipInfo_.ip_, pni.ipInfo_.pingType_, pni.ipInfo_.hostname_);
+            enqueue(pni, false);
         }
         else if (!pni.isExistPingAttempt_) {
             pingLog_.addLog("PingNodesController::onPingTimer", tr("ping new node: %1 (%2 - %3)").arg(pni.ipInfo_.ip_, pni.ipInfo_.city_, pni.ipInfo_.nick_));
-            pni.nowPinging_ = true;
-            pingHost_->addHostForPing(pni.ipInfo_.id_, pni.ipInfo_.ip_, pni.ipInfo_.pingType_, pni.ipInfo_.hostname_);
+            enqueue(pni, false);
         }
         else if (pni.latestPingFailed_) {
             if (pni.nextTimeForFailedPing_ == 0 || QDateTime::currentMSecsSinceEpoch() >= pni.nextTimeForFailedPing_) {
                 //pingLog_.addLog("PingNodesController::onPingTimer", "start ping because latest ping failed: " + it.key());
-                pni.nowPinging_ = true;
-                pingHost_->addHostForPing(pni.ipInfo_.id_, pni.ipInfo_.ip_, pni.ipInfo_.pingType_, pni.ipInfo_.hostname_);
+                enqueue(pni, true);
             }
         }
     }
+
+    dispatchPings();
+    reportProgress();
+}
+
+void PingIpsController::onPingStarted(const QString &id)
+{
+    // PingHost queues the pings over the parallel limit of its backend, that time is not a part of the round trip
+    scheduler_.onPingStarted(id, clock_.elapsed());
 }
 
 void PingIpsController::onPingFinished(bool success, int timems, const QString &id, bool isFromDisconnectedState)
 {
+    // PingHost is shared with the other controllers, the ids of their pings are not known here
+    if (!scheduler_.isInFlight(id)) {
+        return;
+    }
+    scheduler_.onPingFinished(id, success, clock_.elapsed());
+    // refill the window, the queued pings don't wait for the timer
+    if (isPingAllowed()) {
+        dispatchPings();
+    }
+
     auto itNode = ips_.find(id);
     if (itNode == ips_.end()) {
         return;
@@ -126,6 +175,13 @@ void PingIpsController::onPingFinished(bool success, int timems, const QString &
     PingNodeInfo &pni = itNode.value();
     pni.nowPinging_ = false;
 
+    if (pni.isIpChangedWhilePinging_) {
+        // the ping of the old address, the node is pinged again on the next timer tick
+        pni.isIpChangedWhilePinging_ = false;
+        reportProgress();
+        return;
+    }
+
     if (success) {
         // If the ping was executed in the connected state, we'll mark it as never happening and reissue it when
         // we're back in the disconnected state.
@@ -134,6 +190,7 @@ void PingIpsController::onPingFinished(bool success, int timems, const QString &
         pni.failedPingsInRow_ = 0;
 
         if (isFromDisconnectedState) {
+            scheduler_.setMeasured(id);
             Q_EMIT pingInfoChanged(id, timems);
             pingLog_.addLog("PingIpsController::onPingFinished", tr("ping successful: %1 (%2 - %3) %4ms").arg(pni.ipInfo_.ip_, pni.ipInfo_.city_, pni.ipInfo_.nick_).arg(timems));
         }
@@ -151,6 +208,7 @@ void PingIpsController::onPingFinished(bool success, int timems, const QString &
             pni.nextTimeForFailedPing_ = QDateTime::currentMSecsSinceEpoch() + 1000 * 60;
 
             if (isFromDisconnectedState) {
+                scheduler_.setMeasured(id);
                 Q_EMIT pingInfoChanged(id, PingTime::PING_FAILED);
             }
 
@@ -162,6 +220,55 @@ void PingIpsController::onPingFinished(bool success, int timems, const QString &
             pni.nextTimeForFailedPing_ = 0;
         }
     }
+
+    reportProgress();
+}
+
+bool PingIpsController::isPingAllowed() const
+{
+    // We don't attempt to issue a ping request when state is CONNECT_STATE_CONNECTING, as the firewall will block it.
+    return networkDetectionManager_->isOnline() && connectStateController_->currentState() == CONNECT_STATE_DISCONNECTED;
+}
+
+PingScheduler::Priority PingIpsController::priority(const QString &id) const
+{
+    if (currentAndFavoriteIds_.contains(id)) {
+        return PingScheduler::PRIORITY_CURRENT;
+    }
+    if (bestLocationCandidateIds_.contains(id)) {
+        return PingScheduler::PRIORITY_BEST_LOCATION_CANDIDATE;
+    }
+    return PingScheduler::PRIORITY_NORMAL;
+}
+
+void PingIpsController::enqueue(PingNodeInfo &pni, bool isRetry)
+{
+    pni.nowPinging_ = true;
+    scheduler_.enqueue(pni.ipInfo_.id_, priority(pni.ipInfo_.id_), isRetry);
+}
+
+void PingIpsController::dispatchPings()
+{
+    const QStringList ids = scheduler_.takeReady(clock_.elapsed());
+    for (const QString &id : ids) {
+        const PingIpInfo &ipInfo = ips_.find(id).value().ipInfo_;
+        pingHost_->addHostForPing(ipInfo.id_, ipInfo.ip_, ipInfo.pingType_, ipInfo.hostname_);
+    }
+}
+
+void PingIpsController::reportProgress()
+{
+    if (scheduler_.measuredCount() == reportedMeasuredCount_ && scheduler_.totalCount() == reportedTotalCount_) {
+        return;
+    }
+    reportedMeasuredCount_ = scheduler_.measuredCount();
+    reportedTotalCount_ = scheduler_.totalCount();
+
+    if (scheduler_.isRoundComplete() && reportedTotalCount_ > 0) {
+        pingLog_.addLog("PingIpsController::reportProgress", tr("%1 of %2 nodes measured, concurrency %3")
+                        .arg(reportedMeasuredCount_).arg(reportedTotalCount_).arg(scheduler_.concurrency()));
+    }
+    Q_EMIT pingProgressChanged(reportedMeasuredCount_, reportedTotalCount_);
 }
 
 } //namespace locationsmodel
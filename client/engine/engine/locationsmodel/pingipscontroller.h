@@ -1,13 +1,16 @@
 #pragma once
 
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QHash>
 #include <QObject>
+#include <QSet>
 
 #include "engine/networkdetectionmanager/inetworkdetectionmanager.h"
 #include "engine/ping/pinghost.h"
 #include "failedpinglogcontroller.h"
 #include "pinglog.h"
+#include "pingscheduler.h"
 
 namespace locationsmodel {
 
@@ -28,20 +31,30 @@ struct PingIpInfo
 
 // logic of ping all nodes (taken into account connected/disconnected state, latest ping time, repeat failed pings)
 // starts ping on updateIps(...) and repeat ping every 24 hours
+// the pings go through PingScheduler: the current and the favorite locations first, then the best location candidates, with the concurrency adapted to the link
 class PingIpsController : public QObject
 {
     Q_OBJECT
 public:
     explicit PingIpsController(QObject *parent, IConnectStateController *stateController, INetworkDetectionManager *networkDetectionManager, PingHost *pingHost, const QString &log_filename);
 
+    // pings only the new nodes and the nodes whose address changed, the others keep their state
     void updateIps(const QVector<PingIpInfo> &ips);
+    // the ids not in the sets are pinged with the normal priority, the queued pings are reordered
+    void setPriorities(const QSet<QString> &currentAndFavoriteIds, const QSet<QString> &bestLocationCandidateIds);
+
+    // progress of the current round of the pings
+    int measuredCount() const { return scheduler_.measuredCount(); }
+    int totalCount() const { return scheduler_.totalCount(); }
 
 signals:
     void pingInfoChanged(const QString &id, int timems);
     void needIncrementPingIteration();
+    void pingProgressChanged(int measuredCount, int totalCount);
 
 private slots:
     void onPingTimer();
+    void onPingStarted(const QString &id);
     void onPingFinished(bool success, int timems, const QString &id, bool isFromDisconnectedState);
 
 private:
@@ -60,10 +73,11 @@ private:
         PingIpInfo ipInfo_;
         bool isExistPingAttempt_ = false;
         bool latestPingFailed_ = false;
-        bool nowPinging_ = false;
+        bool nowPinging_ = false;     // queued in scheduler_ or in flight
         int failedPingsInRow_ = 0;
         qint64 nextTimeForFailedPing_ = 0;
         bool existThisIp = false;
+        bool isIpChangedWhilePinging_ = false;
 
         PingNodeInfo() {}
         PingNodeInfo(const PingIpInfo &ipInfo) : ipInfo_(ipInfo), existThisIp(true) {}
@@ -73,6 +87,19 @@ private:
 
     QTimer pingTimer_;
     QDateTime dtNextPingTime_;
+
+    PingScheduler scheduler_;
+    QElapsedTimer clock_;
+    QSet<QString> currentAndFavoriteIds_;
+    QSet<QString> bestLocationCandidateIds_;
+    int reportedMeasuredCount_ = -1;
+    int reportedTotalCount_ = -1;
+
+    bool isPingAllowed() const;
+    PingScheduler::Priority priority(const QString &id) const;
+    void enqueue(PingNodeInfo &pni, bool isRetry);
+    void dispatchPings();
+    void reportProgress();
 };
 
 } //namespace locationsmodel
@@ -0,0 +1,129 @@
+#include "pingscheduler.h"
+
+#include <limits>
+
+namespace locationsmodel {
+
+PingScheduler::PingScheduler() : PingScheduler(Settings())
+{
+}
+
+PingScheduler::PingScheduler(const Settings &settings) : settings_(settings),
+    window_(settings.initialConcurrency), slowStartThreshold_(settings.maxConcurrency),
+    lastDecreaseMs_(std::numeric_limits<qint64>::min())
+{
+}
+
+void PingScheduler::enqueue(const QString &id, Priority priority, bool isRetry)
+{
+    if (!isRetry && !round_.contains(id)) {
+        if (isRoundComplete()) {
+            startRound();
+        }
+        round_.insert(id);
+    }
+
+    if (inFlight_.contains(id)) {
+        return;
+    }
+
+    auto it = queued_.find(id);
+    if (it != queued_.end()) {
+        if (it.value() == priority) {
+            return;
+        }
+        queues_[it.value()].removeOne(id);
+        it.value() = priority;
+    }
+    else {
+        queued_.insert(id, priority);
+    }
+    queues_[priority].enqueue(id);
+}
+
+void PingScheduler::remove(const QString &id)
+{
+    auto it = queued_.find(id);
+    if (it != queued_.end()) {
+        queues_[it.value()].removeOne(id);
+        queued_.erase(it);
+    }
+    inFlight_.remove(id);
+    round_.remove(id);
+    measured_.remove(id);
+}
+
+void PingScheduler::clear()
+{
+    for (QQueue<QString> &queue : queues_) {
+        queue.clear();
+    }
+    queued_.clear();
+    inFlight_.clear();
+    startRound();
+}
+
+QStringList PingScheduler::takeReady(qint64 nowMs)
+{
+    QStringList ids;
+    for (QQueue<QString> &queue : queues_) {
+        while (!queue.isEmpty() && inFlight_.count() < (int)window_) {
+            const QString id = queue.dequeue();
+            queued_.remove(id);
+            inFlight_.insert(id, nowMs);
+            ids << id;
+        }
+    }
+    return ids;
+}
+
+void PingScheduler::onPingStarted(const QString &id, qint64 nowMs)
+{
+    auto it = inFlight_.find(id);
+    if (it != inFlight_.end()) {
+        it.value() = nowMs;
+    }
+}
+
+void PingScheduler::onPingFinished(const QString &id, bool success, qint64 nowMs)
+{
+    auto it = inFlight_.find(id);
+    if (it == inFlight_.end()) {
+        return;
+    }
+    const qint64 startMs = it.value();
+    inFlight_.erase(it);
+
+    // PingHost doesn't tell a timeout from a node that is down, so a dead node costs at most one decrease per round trip
+    const bool isCongestion = !success || nowMs - startMs > settings_.slowPingMs;
+    if (isCongestion) {
+        if (startMs >= lastDecreaseMs_) {
+            window_ = qMax((double)settings_.minConcurrency, window_ / 2);
+            slowStartThreshold_ = window_;
+            lastDecreaseMs_ = nowMs;
+        }
+    }
+    else if (window_ < slowStartThreshold_) {
+        // slow start, doubles the window every round trip
+        window_ = qMin((double)settings_.maxConcurrency, window_ + 1);
+    }
+    else {
+        // congestion avoidance, +1 every round trip
+        window_ = qMin((double)settings_.maxConcurrency, window_ + 1 / window_);
+    }
+}
+
+void PingScheduler::startRound()
+{
+    round_.clear();
+    measured_.clear();
+}
+
+void PingScheduler::setMeasured(const QString &id)
+{
+    if (round_.contains(id)) {
+        measured_.insert(id);
+    }
+}
+
+} //namespace locationsmodel
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QHash>
+#include <QQueue>
+#include <QSet>
+#include <QStringList>
+
+namespace locationsmodel {
+
+// Queue of the pings of PingIpsController. The nodes are dispatched in the order of their priority and the number of the pings
+// in flight is adapted to the link (AIMD, as the TCP congestion window): the window grows while the pings come back fast and is
+// halved on a failed ping or a ping that took longer than slowPingMs, so a slow or lossy link is not flooded with pings that
+// would time out and be reported as failed nodes. The congestion signals of the pings started before the latest decrease are
+// ignored, so a burst of timeouts halves the window once. The round trip is measured from the moment the backend actually sent
+// the ping (onPingStarted()), the time in the queue of the backend over its own parallel limit is not a sign of congestion.
+// Also counts the progress of the current round of the pings ("X of Y nodes measured").
+// The time is passed explicitly, so the scheduler can be driven by a fake clock.
+class PingScheduler
+{
+public:
+    // PRIORITY_CURRENT is for the current and the favorite locations
+    enum Priority { PRIORITY_CURRENT, PRIORITY_BEST_LOCATION_CANDIDATE, PRIORITY_NORMAL, PRIORITIES_COUNT };
+
+    struct Settings
+    {
+        int minConcurrency = 2;
+        int maxConcurrency = 64;
+        int initialConcurrency = 8;
+        // a ping that took longer is a sign of the queueing on the link (the pings time out after 2 s)
+        int slowPingMs = 1000;
+    };
+
+    PingScheduler();
+    explicit PingScheduler(const Settings &settings);
+
+    // Adds the node to the queue, a node already in the queue is moved to the new priority, a node in flight is not affected.
+    // A retry of a failed ping doesn't change the progress of the round.
+    void enqueue(const QString &id, Priority priority, bool isRetry = false);
+    // forgets the node, the result of its ping in flight is ignored
+    void remove(const QString &id);
+    void clear();
+
+    // Returns the nodes to ping now (the highest priority first) and marks them as in flight.
+    QStringList takeReady(qint64 nowMs);
+    // The backend sent the ping, the round trip is measured from now on. Without this call it's measured from takeReady().
+    void onPingStarted(const QString &id, qint64 nowMs);
+    // Must be called for every node returned by takeReady(), adapts the concurrency.
+    void onPingFinished(const QString &id, bool success, qint64 nowMs);
+
+    bool isQueued(const QString &id) const { return queued_.contains(id); }
+    bool isInFlight(const QString &id) const { return inFlight_.contains(id); }
+    int queuedCount() const { return queued_.count(); }
+    int inFlightCount() const { return inFlight_.count(); }
+    int concurrency() const { return (int)window_; }
+
+    // The progress of the round: the nodes enqueued (not as a retry) since the round started and the ones of them that
+    // got the final result (a successful ping or the last failed one), reported by setMeasured().
+    // A new round starts with startRound() or with the first node enqueued after the round was complete.
+    void startRound();
+    void setMeasured(const QString &id);
+    int measuredCount() const { return measured_.count(); }
+    int totalCount() const { return round_.count(); }
+    bool isRoundComplete() const { return measured_.count() == round_.count(); }
+
+private:
+    const Settings settings_;
+
+    QQueue<QString> queues_[PRIORITIES_COUNT];
+    QHash<QString, Priority> queued_;
+    QHash<QString, qint64> inFlight_;      // the time the ping was taken or sent by the backend
+
+    double window_;
+    double slowStartThreshold_;
+    qint64 lastDecreaseMs_;
+
+    QSet<QString> round_;
+    QSet<QString> measured_;
+};
+
+} //namespace locationsmodel
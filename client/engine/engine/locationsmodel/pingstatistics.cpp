@@ -0,0 +1,192 @@
+#include "pingstatistics.h"
+
+#include <QtMath>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+namespace locationsmodel {
+
+PingStatistics::PingStatistics() : count_(0), next_(0), ewma_(-1.0f)
+{
+    std::fill(samples_, samples_ + WINDOW_SIZE, (qint16)PingTime::NO_PING_INFO);
+}
+
+void PingStatistics::addSample(PingTime timeMs)
+{
+    const int value = timeMs.toInt();
+    if (value == PingTime::NO_PING_INFO) {
+        return;
+    }
+
+    samples_[next_] = (qint16)qBound(PingTime::PING_FAILED, value, (int)SHRT_MAX);
+    next_ = (next_ + 1) % WINDOW_SIZE;
+    if (count_ < WINDOW_SIZE) {
+        count_++;
+    }
+
+    if (value >= 0) {
+        if (ewma_ < 0) {
+            ewma_ = value;
+        } else {
+            ewma_ = EWMA_ALPHA * value + (1.0 - EWMA_ALPHA) * ewma_;
+        }
+    }
+}
+
+int PingStatistics::successCount() const
+{
+    int success = 0;
+    for (int i = 0; i < count_; ++i) {
+        if (sampleAt(i) >= 0) {
+            success++;
+        }
+    }
+    return success;
+}
+
+int PingStatistics::minMs() const
+{
+    int result = PingTime::PING_FAILED;
+    for (int i = 0; i < count_; ++i) {
+        const int sample = sampleAt(i);
+        if (sample >= 0 && (result == PingTime::PING_FAILED || sample < result)) {
+            result = sample;
+        }
+    }
+    return result;
+}
+
+int PingStatistics::avgMs() const
+{
+    int sum = 0;
+    int success = 0;
+    for (int i = 0; i < count_; ++i) {
+        const int sample = sampleAt(i);
+        if (sample >= 0) {
+            sum += sample;
+            success++;
+        }
+    }
+    return success > 0 ? qRound((double)sum / success) : PingTime::PING_FAILED;
+}
+
+int PingStatistics::ewmaMs() const
+{
+    return (successCount() > 0 && ewma_ >= 0) ? qRound(ewma_) : PingTime::PING_FAILED;
+}
+
+int PingStatistics::jitterMs() const
+{
+    int sum = 0;
+    int pairs = 0;
+    int prev = -1;
+    for (int i = 0; i < count_; ++i) {
+        const int sample = sampleAt(i);
+        if (sample < 0) {
+            continue;
+        }
+        if (prev >= 0) {
+            sum += qAbs(sample - prev);
+            pairs++;
+        }
+        prev = sample;
+    }
+
+    if (pairs > 0) {
+        return qRound((double)sum / pairs);
+    }
+    return successCount() > 0 ? 0 : PingTime::PING_FAILED;
+}
+
+int PingStatistics::lossPercent() const
+{
+    if (count_ == 0) {
+        return 0;
+    }
+    return qRound(100.0 * (count_ - successCount()) / count_);
+}
+
+PingTime PingStatistics::pingTime() const
+{
+    if (count_ == 0) {
+        return PingTime::NO_PING_INFO;
+    }
+    return ewmaMs();
+}
+
+int PingStatistics::score(const ScoreWeights &weights) const
+{
+    if (count_ == 0) {
+        return PingTime::NO_PING_INFO;
+    }
+    const int ewma = ewmaMs();
+    if (ewma == PingTime::PING_FAILED) {
+        return PingTime::PING_FAILED;
+    }
+    return qRound(ewma + jitterMs() * weights.jitterWeight + lossPercent() * weights.lossWeight);
+}
+
+PingStatistics::Packed PingStatistics::pack() const
+{
+    Packed packed;
+    memset(&packed, 0, sizeof(packed));
+    for (int i = 0; i < WINDOW_SIZE; ++i) {
+        packed.samples[i] = i < count_ ? sampleAt(i) : (qint16)PingTime::NO_PING_INFO;
+    }
+    packed.count = count_;
+    packed.ewma = ewma_;
+    return packed;
+}
+
+bool PingStatistics::unpack(const Packed &packed)
+{
+    *this = PingStatistics();
+    if (packed.count > WINDOW_SIZE) {
+        return false;
+    }
+    for (int i = 0; i < packed.count; ++i) {
+        samples_[i] = packed.samples[i];
+    }
+    count_ = packed.count;
+    next_ = count_ % WINDOW_SIZE;
+    ewma_ = packed.ewma;
+    return true;
+}
+
+qint16 PingStatistics::sampleAt(int ind) const
+{
+    return samples_[(next_ + WINDOW_SIZE - count_ + ind) % WINDOW_SIZE];
+}
+
+QDataStream& operator <<(QDataStream& stream, const PingStatistics& s)
+{
+    stream << s.count_;
+    for (int i = 0; i < s.count_; ++i) {
+        stream << s.sampleAt(i);
+    }
+    stream << s.ewma_;
+    return stream;
+}
+
+QDataStream& operator >>(QDataStream& stream, PingStatistics& s)
+{
+    s = PingStatistics();
+    quint8 count;
+    stream >> count;
+    if (count > PingStatistics::WINDOW_SIZE) {
+        stream.setStatus(QDataStream::ReadCorruptData);
+        return stream;
+    }
+    for (int i = 0; i < count; ++i) {
+        qint16 sample;
+        stream >> sample;
+        s.samples_[i] = sample;
+    }
+    s.count_ = count;
+    s.next_ = count % PingStatistics::WINDOW_SIZE;
+    stream >> s.ewma_;
+    return stream;
+}
+
+} //namespace locationsmodel
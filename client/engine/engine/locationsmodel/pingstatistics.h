@@ -0,0 +1,76 @@
+#pragma once
+
+#include <QDataStream>
+
+#include "types/pingtime.h"
+
+namespace locationsmodel {
+
+// Latency statistics of a node over a small fixed-size window of the last ping samples (failed pings included).
+// Gives min/avg/EWMA RTT, jitter (mean difference between consecutive successful samples) and loss percentage,
+// so a single lucky or unlucky sample doesn't decide the displayed latency and the best location.
+// Takes at most 25 bytes when serialized.
+class PingStatistics
+{
+public:
+    static constexpr int WINDOW_SIZE = 8;
+
+    // the score is in milliseconds: EWMA + jitter * jitterWeight + lossPercent * lossWeight
+    struct ScoreWeights
+    {
+        double jitterWeight = 1.0;
+        double lossWeight = 20.0;       // ms per one percent of the loss
+    };
+
+    // the fixed-size layout for PingStorageFile, the samples from the oldest one
+    struct Packed
+    {
+        qint16 samples[WINDOW_SIZE];
+        quint8 count;
+        quint8 reserved[3];
+        float ewma;
+    };
+
+    PingStatistics();
+
+    // NO_PING_INFO is ignored, PING_FAILED counts as a loss
+    void addSample(PingTime timeMs);
+
+    bool isEmpty() const { return count_ == 0; }
+    int samplesCount() const { return count_; }
+    int successCount() const;
+
+    // these return PingTime::PING_FAILED if there are no successful samples in the window
+    int minMs() const;
+    int avgMs() const;
+    int ewmaMs() const;
+    int jitterMs() const;
+
+    int lossPercent() const;
+
+    // the latency for display: EWMA RTT, PING_FAILED if all the samples in the window failed, NO_PING_INFO if empty
+    PingTime pingTime() const;
+
+    // NO_PING_INFO if empty, PING_FAILED if all the samples in the window failed
+    int score(const ScoreWeights &weights) const;
+
+    Packed pack() const;
+    // returns false if the packed data is out of range
+    bool unpack(const Packed &packed);
+
+    friend QDataStream& operator <<(QDataStream& stream, const PingStatistics& s);
+    friend QDataStream& operator >>(QDataStream& stream, PingStatistics& s);
+
+private:
+    static constexpr double EWMA_ALPHA = 0.3;
+
+    qint16 samples_[WINDOW_SIZE];   // a ring buffer, PING_FAILED for the failed pings
+    quint8 count_;
+    quint8 next_;
+    float ewma_;                    // negative until the first successful sample
+
+    // the sample by age, 0 is the oldest one
+    qint16 sampleAt(int ind) const;
+};
+
+} //namespace locationsmodel
@@ -3,7 +3,10 @@
 #include <QDataStream>
 #include <QIODevice>
 #include <QSettings>
+#include <QStandardPaths>
 
+#include "pingstoragefile.h"
+#include "utils/logger.h"
 #include "utils/simplecrypt.h"
 #include "types/global_consts.h"
 
@@ -16,13 +19,19 @@ public:
     explicit PingData(PingTime timeMs, quint32 iteration) : timeMs_(timeMs), iteration_(iteration)
     {
     }
+    explicit PingData(PingTime timeMs, quint32 iteration, const PingStatistics &statistics) : timeMs_(timeMs), iteration_(iteration),
+        statistics_(statistics)
+    {
+    }
 
     PingTime pingTime() const { return timeMs_; }
     quint32 iteration() const { return iteration_; }
+    const PingStatistics &statistics() const { return statistics_; }
 
 private:
     PingTime timeMs_;
     quint32 iteration_;
+    PingStatistics statistics_;
 };
 
 PingStorage::PingStorage(const QString &settingsKey) : settingsKey_(settingsKey)
@@ -54,31 +63,103 @@ void PingStorage::setCurrentIteration(quint32 iteration)
 }
 
 
-ApiPingStorage::ApiPingStorage() : PingStorage("pingStorage")
+ApiPingStorage::ApiPingStorage(const QString &filePath) : PingStorage("pingStorage"), isStatisticsMode_(false),
+    file_(new PingStorageFile(filePath.isEmpty() ? defaultFilePath() : filePath))
 {
-    loadFromSettings();
+    bool isNew;
+    if (!file_->open(&isNew)) {
+        qCDebug(LOG_BASIC) << "Can't open the ping storage file, the settings are used";
+        file_.reset();
+        loadFromSettings();
+        return;
+    }
+
+    if (isNew) {
+        migrateToFile();
+    }
+    else {
+        loadFromFile();
+    }
 }
 
 ApiPingStorage::~ApiPingStorage()
 {
-    saveToSettings();
+    if (file_) {
+        file_->setIteration(getCurrentIteration());
+    }
+    else {
+        saveToSettings();
+    }
+}
+
+QString ApiPingStorage::defaultFilePath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/pingstorage.bin";
 }
 
 void ApiPingStorage::setPing(int id, PingTime timeMs)
 {
-    pingDataDB_[id] = PingData(timeMs, getCurrentIteration());
+    PingStatistics statistics = getStatistics(id);
+    statistics.addSample(timeMs);
+    pingDataDB_[id] = PingData(timeMs, getCurrentIteration(), statistics);
+
+    if (file_) {
+        file_->setIteration(getCurrentIteration());
+        file_->setRecord((quint32)id, timeMs.toInt(), getCurrentIteration(), statistics);
+    }
 }
 
 PingTime ApiPingStorage::getPing(int id) const
 {
     auto it = pingDataDB_.constFind(id);
     if (it != pingDataDB_.constEnd()) {
+        if (isStatisticsMode_ && !it.value().statistics().isEmpty()) {
+            return it.value().statistics().pingTime();
+        }
         return it.value().pingTime();
     }
 
     return PingTime::NO_PING_INFO;
 }
 
+PingStatistics ApiPingStorage::getStatistics(int id) const
+{
+    auto it = pingDataDB_.constFind(id);
+    if (it != pingDataDB_.constEnd()) {
+        return it.value().statistics();
+    }
+
+    return PingStatistics();
+}
+
+int ApiPingStorage::getScore(int id) const
+{
+    auto it = pingDataDB_.constFind(id);
+    if (it != pingDataDB_.constEnd()) {
+        if (isStatisticsMode_ && !it.value().statistics().isEmpty()) {
+            return it.value().statistics().score(scoreWeights_);
+        }
+        return it.value().pingTime().toInt();
+    }
+
+    return PingTime::NO_PING_INFO;
+}
+
+void ApiPingStorage::setStatisticsMode(bool isEnabled)
+{
+    isStatisticsMode_ = isEnabled;
+}
+
+bool ApiPingStorage::isStatisticsMode() const
+{
+    return isStatisticsMode_;
+}
+
+void ApiPingStorage::setScoreWeights(const PingStatistics::ScoreWeights &weights)
+{
+    scoreWeights_ = weights;
+}
+
 void ApiPingStorage::getState(bool &isAllNodesHaveCurIteration)
 {
     isAllNodesHaveCurIteration = true;
@@ -101,7 +182,7 @@ void ApiPingStorage::saveToSettings()
         ds << getCurrentIteration();
         ds << pingDataDB_.size();
         for (auto it = pingDataDB_.begin(); it != pingDataDB_.end(); ++it) {
-            ds << it.key() << it.value().pingTime().toInt() << it.value().iteration();
+            ds << it.key() << it.value().pingTime().toInt() << it.value().iteration() << it.value().statistics();
         }
     }
 
@@ -110,6 +191,36 @@ void ApiPingStorage::saveToSettings()
     settings.setValue(settingsKey(), simpleCrypt.encryptToString(arr));
 }
 
+void ApiPingStorage::loadFromFile()
+{
+    pingDataDB_.clear();
+    const QVector<PingStorageFile::Record> records = file_->records();
+    pingDataDB_.reserve(records.size());
+    for (const PingStorageFile::Record &r : records) {
+        PingStatistics statistics;
+        if (statistics.unpack(r.statistics)) {
+            pingDataDB_[(int)r.key] = PingData(r.timeMs, r.iteration, statistics);
+        }
+    }
+    setCurrentIteration(file_->iteration());
+}
+
+void ApiPingStorage::migrateToFile()
+{
+    QSettings settings;
+    if (!settings.contains(settingsKey())) {
+        return;
+    }
+
+    loadFromSettings();
+    file_->setIteration(getCurrentIteration());
+    for (auto it = pingDataDB_.cbegin(); it != pingDataDB_.cend(); ++it) {
+        file_->setRecord((quint32)it.key(), it.value().pingTime().toInt(), it.value().iteration(), it.value().statistics());
+    }
+    settings.remove(settingsKey());
+    qCDebug(LOG_BASIC) << "Ping storage migrated from the settings," << pingDataDB_.size() << "nodes";
+}
+
 void ApiPingStorage::loadFromSettings()
 {
     pingDataDB_.clear();
@@ -145,7 +256,15 @@ void ApiPingStorage::loadFromSettings()
                 int timeMs;
                 quint32 iteration;
                 ds >> locationID >> timeMs >> iteration;
-                pingDataDB_[locationID] = PingData(timeMs, iteration);
+
+                PingStatistics statistics;
+                if (version >= 3) {
+                    ds >> statistics;
+                } else {
+                    // seed the statistics with the single ping stored by the older versions
+                    statistics.addSample(timeMs);
+                }
+                pingDataDB_[locationID] = PingData(timeMs, iteration, statistics);
             }
 
             if (ds.status() != QDataStream::Ok) {
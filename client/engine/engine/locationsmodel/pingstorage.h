@@ -1,12 +1,15 @@
 #pragma once
 
 #include <QHash>
+#include <QScopedPointer>
 
+#include "pingstatistics.h"
 #include "types/pingtime.h"
 
 namespace locationsmodel {
 
 class PingData;
+class PingStorageFile;
 
 class PingStorage
 {
@@ -26,26 +29,45 @@ private:
     quint32 curIteration_ = 0;
 };
 
+// The data is kept in PingStorageFile (updated in place on every ping), the data of the settings format of the previous versions
+// is migrated to it once. The settings are still used if the file can't be opened.
 class ApiPingStorage : public PingStorage
 {
 public:
-    explicit ApiPingStorage();
+    // the default file is in the app data location
+    explicit ApiPingStorage(const QString &filePath = QString());
     virtual ~ApiPingStorage();
 
+    static QString defaultFilePath();
+
     void setPing(int id, PingTime timeMs);
+    // in the statistics mode returns the EWMA latency over the last samples, otherwise the last ping
     PingTime getPing(int id) const;
+    PingStatistics getStatistics(int id) const;
+    // the ranking value for the best location: the statistics score in the statistics mode, otherwise the last ping
+    int getScore(int id) const;
+
+    // the samples are always collected, the mode affects only getPing() and getScore()
+    void setStatisticsMode(bool isEnabled);
+    bool isStatisticsMode() const;
+    void setScoreWeights(const PingStatistics::ScoreWeights &weights);
 
     void getState(bool &isAllNodesHaveCurIteration);
 
 private:
     // Maps the immutable location (data center) identifier, or static IP identifier, to its ping data.
     QHash<int, PingData> pingDataDB_;
+    bool isStatisticsMode_;
+    PingStatistics::ScoreWeights scoreWeights_;
+    QScopedPointer<PingStorageFile> file_;
 
     static constexpr quint32 magic_ = 0x734AB2AE;
-    static constexpr int versionForSerialization_ = 2;  // should increment the version if the data format is changed
+    static constexpr int versionForSerialization_ = 3;  // should increment the version if the data format is changed
 
     void saveToSettings();
     void loadFromSettings();
+    void loadFromFile();
+    void migrateToFile();
 };
 
 class CustomConfigPingStorage : public PingStorage
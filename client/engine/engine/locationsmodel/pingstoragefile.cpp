@@ -0,0 +1,263 @@
+#include "pingstoragefile.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <cstddef>
+#include <cstring>
+
+#include "utils/logger.h"
+
+namespace locationsmodel {
+
+static_assert(sizeof(PingStorageFile::Record) == 48, "the record layout is a part of the file format");
+
+PingStorageFile::PingStorageFile(const QString &path) : path_(path), data_(nullptr), slotsCount_(0)
+{
+}
+
+PingStorageFile::~PingStorageFile()
+{
+    close();
+}
+
+bool PingStorageFile::open(bool *outIsNew)
+{
+    close();
+    if (outIsNew) {
+        *outIsNew = false;
+    }
+
+    QDir().mkpath(QFileInfo(path_).absolutePath());
+    file_.setFileName(path_);
+    if (!file_.open(QIODevice::ReadWrite)) {
+        qCDebug(LOG_BASIC) << "PingStorageFile: can't open" << path_ << file_.errorString();
+        return false;
+    }
+
+    bool isValid = false;
+    if (file_.size() >= (qint64)sizeof(Header) && map(file_.size())) {
+        const Header h = header();
+        isValid = h.magic == kMagic && h.version == kVersion && h.recordSize == sizeof(Record) && h.checksum == headerChecksum(h) &&
+                  h.capacity > 0 && h.count <= h.capacity && file_.size() >= (qint64)sizeof(Header) + (qint64)h.capacity * (qint64)sizeof(Record);
+        if (isValid) {
+            slotsCount_ = h.count;
+            index_.reserve(slotsCount_);
+            int droppedCount = 0;
+            for (quint32 i = 0; i < slotsCount_; ++i) {
+                Record r;
+                memcpy(&r, slot(i), sizeof(r));
+                if (r.checksum == recordChecksum(r)) {
+                    index_.insert(r.key, i);
+                }
+                else {
+                    droppedCount++;
+                }
+            }
+            if (droppedCount > 0) {
+                qCDebug(LOG_BASIC) << "PingStorageFile: dropped" << droppedCount << "records with a wrong checksum";
+            }
+        }
+        else {
+            qCDebug(LOG_BASIC) << "PingStorageFile: incorrect header, the file is recreated";
+        }
+    }
+
+    if (!isValid) {
+        if (outIsNew) {
+            *outIsNew = true;
+        }
+        if (!initFile(kInitialCapacity)) {
+            qCDebug(LOG_BASIC) << "PingStorageFile: can't create" << path_ << file_.errorString();
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void PingStorageFile::close()
+{
+    if (data_) {
+        file_.unmap(data_);
+        data_ = nullptr;
+    }
+    if (file_.isOpen()) {
+        file_.close();
+    }
+    index_.clear();
+    slotsCount_ = 0;
+}
+
+quint32 PingStorageFile::iteration() const
+{
+    return data_ ? header().iteration : 0;
+}
+
+void PingStorageFile::setIteration(quint32 iteration)
+{
+    if (!data_) {
+        return;
+    }
+    Header h = header();
+    if (h.iteration != iteration) {
+        h.iteration = iteration;
+        writeHeader(h);
+    }
+}
+
+QVector<PingStorageFile::Record> PingStorageFile::records() const
+{
+    QVector<Record> records;
+    records.reserve(index_.count());
+    for (quint32 i = 0; i < slotsCount_; ++i) {
+        Record r;
+        memcpy(&r, slot(i), sizeof(r));
+        // skips the broken records and the slots of the keys written again after them
+        auto it = index_.constFind(r.key);
+        if (it != index_.constEnd() && it.value() == i) {
+            records << r;
+        }
+    }
+    return records;
+}
+
+bool PingStorageFile::record(quint64 key, Record &outRecord) const
+{
+    auto it = index_.constFind(key);
+    if (it == index_.constEnd()) {
+        return false;
+    }
+    memcpy(&outRecord, slot(it.value()), sizeof(outRecord));
+    return true;
+}
+
+bool PingStorageFile::setRecord(quint64 key, qint32 timeMs, quint32 iteration, const PingStatistics &statistics)
+{
+    if (!data_) {
+        return false;
+    }
+
+    Record r;
+    memset(&r, 0, sizeof(r));
+    r.key = key;
+    r.timeMs = timeMs;
+    r.iteration = iteration;
+    r.statistics = statistics.pack();
+    r.checksum = recordChecksum(r);
+
+    auto it = index_.constFind(key);
+    if (it != index_.constEnd()) {
+        memcpy(slot(it.value()), &r, sizeof(r));
+        return true;
+    }
+
+    if (slotsCount_ >= header().capacity && !grow()) {
+        return false;
+    }
+    // the record first, so a crash in between leaves the header consistent
+    memcpy(slot(slotsCount_), &r, sizeof(r));
+    index_.insert(key, slotsCount_);
+    slotsCount_++;
+
+    Header h = header();
+    h.count = slotsCount_;
+    writeHeader(h);
+    return true;
+}
+
+void PingStorageFile::clear()
+{
+    if (data_) {
+        initFile(kInitialCapacity);
+    }
+}
+
+quint64 PingStorageFile::hashKey(const QString &str)
+{
+    quint64 hash = 14695981039346656037ULL;
+    const QByteArray utf8 = str.toUtf8();
+    for (char c : utf8) {
+        hash ^= (quint8)c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+PingStorageFile::Header PingStorageFile::header() const
+{
+    Header h;
+    memcpy(&h, data_, sizeof(h));
+    return h;
+}
+
+void PingStorageFile::writeHeader(const Header &header)
+{
+    Header h = header;
+    h.checksum = headerChecksum(h);
+    memcpy(data_, &h, sizeof(h));
+}
+
+bool PingStorageFile::initFile(quint32 capacity)
+{
+    if (data_) {
+        file_.unmap(data_);
+        data_ = nullptr;
+    }
+    index_.clear();
+    slotsCount_ = 0;
+
+    // resizing to 0 first zeroes the old content
+    if (!file_.resize(0) || !file_.resize((qint64)sizeof(Header) + (qint64)capacity * (qint64)sizeof(Record)) || !map(file_.size())) {
+        return false;
+    }
+
+    Header h;
+    memset(&h, 0, sizeof(h));
+    h.magic = kMagic;
+    h.version = kVersion;
+    h.recordSize = sizeof(Record);
+    h.capacity = capacity;
+    writeHeader(h);
+    return true;
+}
+
+bool PingStorageFile::grow()
+{
+    Header h = header();
+    const quint32 capacity = qMax(h.capacity * 2, kInitialCapacity);
+
+    file_.unmap(data_);
+    data_ = nullptr;
+    if (!file_.resize((qint64)sizeof(Header) + (qint64)capacity * (qint64)sizeof(Record)) || !map(file_.size())) {
+        qCDebug(LOG_BASIC) << "PingStorageFile: can't grow" << path_ << file_.errorString();
+        close();
+        return false;
+    }
+
+    h.capacity = capacity;
+    writeHeader(h);
+    return true;
+}
+
+bool PingStorageFile::map(qint64 size)
+{
+    data_ = file_.map(0, size);
+    return data_ != nullptr;
+}
+
+uchar *PingStorageFile::slot(quint32 ind) const
+{
+    return data_ + sizeof(Header) + (size_t)ind * sizeof(Record);
+}
+
+quint32 PingStorageFile::headerChecksum(const Header &header)
+{
+    return qChecksum(QByteArrayView((const char *)&header, offsetof(Header, checksum)));
+}
+
+quint32 PingStorageFile::recordChecksum(const Record &record)
+{
+    return qChecksum(QByteArrayView((const char *)&record, offsetof(Record, checksum)));
+}
+
+} //namespace locationsmodel
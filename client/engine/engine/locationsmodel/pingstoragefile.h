@@ -0,0 +1,87 @@
+#pragma once
+
+#include <QFile>
+#include <QHash>
+
+#include "pingstatistics.h"
+
+namespace locationsmodel {
+
+// Compact binary storage of the ping data, memory-mapped and updated in place: setting the ping of a node writes its record only,
+// so there is no serialization of the whole storage on save and no parsing on load (the records are just indexed).
+// The file is a header (magic, version, record size, count, capacity, iteration, header checksum) followed by the fixed-size
+// records keyed by the node hash, each with its own checksum. A record with a wrong checksum (e.g. a torn write) is dropped on load,
+// a file with a wrong header or of another version is recreated empty. The data is in the native byte order, the file is local.
+class PingStorageFile
+{
+public:
+    struct Record
+    {
+        quint64 key;
+        qint32 timeMs;
+        quint32 iteration;
+        PingStatistics::Packed statistics;
+        quint32 checksum;
+        quint32 reserved;
+    };
+
+    explicit PingStorageFile(const QString &path);
+    ~PingStorageFile();
+
+    // Opens the existing file or creates a new one. Returns false if the file can't be created or mapped.
+    // outIsNew is set to true if there was no valid file.
+    bool open(bool *outIsNew = nullptr);
+    void close();
+    bool isOpen() const { return data_ != nullptr; }
+    const QString &path() const { return path_; }
+
+    quint32 iteration() const;
+    void setIteration(quint32 iteration);
+
+    int count() const { return index_.count(); }
+    bool contains(quint64 key) const { return index_.contains(key); }
+    // the valid records, in the order of the slots
+    QVector<Record> records() const;
+    bool record(quint64 key, Record &outRecord) const;
+    // updates the record of the key in place or adds a new one, grows the file if needed
+    bool setRecord(quint64 key, qint32 timeMs, quint32 iteration, const PingStatistics &statistics);
+    void clear();
+
+    // the stable hash of a string key (FNV-1a), the numeric ids are used as is
+    static quint64 hashKey(const QString &str);
+
+private:
+    struct Header
+    {
+        quint32 magic;
+        quint16 version;
+        quint16 recordSize;
+        quint32 count;          // the used slots, including the ones with a wrong checksum
+        quint32 capacity;
+        quint32 iteration;
+        quint32 reserved[2];
+        quint32 checksum;
+    };
+
+    static constexpr quint32 kMagic = 0x5053574B;
+    static constexpr quint16 kVersion = 1;
+    static constexpr quint32 kInitialCapacity = 256;
+
+    const QString path_;
+    QFile file_;
+    uchar *data_;
+    QHash<quint64, quint32> index_;     // the key -> the slot
+    quint32 slotsCount_;                // the used slots
+
+    Header header() const;
+    void writeHeader(const Header &header);
+    bool initFile(quint32 capacity);
+    bool grow();
+    bool map(qint64 size);
+    uchar *slot(quint32 ind) const;
+
+    static quint32 headerChecksum(const Header &header);
+    static quint32 recordChecksum(const Record &record);
+};
+
+} //namespace locationsmodel
@@ -0,0 +1,200 @@
+#include <QtTest>
+#include <QCoreApplication>
+#include <QSettings>
+
+#include "engine/apiinfo/serverlistparser.h"
+#include "engine/connectstatecontroller/iconnectstatecontroller.h"
+#include "engine/locationsmodel/apilocationsmodel.h"
+#include "engine/networkaccessmanager/networkaccessmanager.h"
+#include "engine/networkdetectionmanager/inetworkdetectionmanager.h"
+#include "engine/ping/pinghost.h"
+#include "../../networkaccessmanager/tests/common/testhttpserver.h"
+
+using namespace locationsmodel;
+
+class ConnectStateController_moc : public IConnectStateController
+{
+    Q_OBJECT
+public:
+    explicit ConnectStateController_moc(QObject *parent) : IConnectStateController(parent) {}
+
+    CONNECT_STATE currentState() override { return CONNECT_STATE_DISCONNECTED; }
+    CONNECT_STATE prevState() override { return CONNECT_STATE_DISCONNECTED; }
+    DISCONNECT_REASON disconnectReason() override { return DISCONNECTED_ITSELF; }
+    CONNECT_ERROR connectionError() override { return NO_CONNECT_ERROR; }
+    const LocationID& locationId() override { return lid_; }
+
+private:
+    LocationID lid_;
+};
+
+class NetworkDetectionManager_moc : public INetworkDetectionManager
+{
+    Q_OBJECT
+public:
+    explicit NetworkDetectionManager_moc(QObject *parent) : INetworkDetectionManager(parent) {}
+
+    void getCurrentNetworkInterface(types::NetworkInterface &networkInterface) override { Q_UNUSED(networkInterface); }
+    bool isOnline() override { return true; }
+};
+
+// Feeds ApiLocationsModel two synthetic server lists that differ by 1% and counts the pings that reach the local ping server.
+// The server answers the curl pings of all the groups (ping_host is http://ping<id>.test:<port>/latency, ping_ip is a loopback address).
+class TestIncrementalPing : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void test_ping_changed_nodes_only();
+
+private:
+    static constexpr int kGroupsCount = 1000;
+    static constexpr int kPingRttUs = 20000;
+
+    TestHttpServer *server_ = nullptr;
+    QHash<QByteArray, int> pingsByHost_;
+
+    // 10 groups per location, the groups in changedIpIds have another ping IP
+    QVector<apiinfo::Location> makeLocations(const QVector<int> &groupIds, const QSet<int> &changedIpIds) const;
+    static QByteArray pingHost(int groupId);
+    static void cleanupSettings();
+};
+
+void TestIncrementalPing::initTestCase()
+{
+    // don't touch the real settings of the app
+    QCoreApplication::setOrganizationName("Windscribe-tests");
+    QCoreApplication::setApplicationName("incrementalping.test");
+    cleanupSettings();
+
+    server_ = new TestHttpServer(this, false);
+    server_->setHandler([this](const TestHttpServer::Request &request) {
+        pingsByHost_[request.headers.value("host").split(':').first()]++;
+        TestHttpServer::Response response;
+        response.body = QString("{\"rtt\": \"%1\"}").arg(kPingRttUs).toUtf8();
+        return response;
+    });
+    // any IPv4 address, so the pings to 127.0.0.2 reach the server too
+    QVERIFY(server_->start(QHostAddress::AnyIPv4));
+}
+
+void TestIncrementalPing::cleanupTestCase()
+{
+    cleanupSettings();
+}
+
+void TestIncrementalPing::test_ping_changed_nodes_only()
+{
+    ConnectStateController_moc stateController(this);
+    NetworkDetectionManager_moc networkDetectionManager(this);
+    NetworkAccessManager networkAccessManager;
+    PingHost pingHost(nullptr, &stateController, &networkAccessManager);
+    ApiLocationsModel model(nullptr, &stateController, &networkDetectionManager, &pingHost);
+
+    int pingsChanged = 0;
+    connect(&model, &ApiLocationsModel::locationPingTimeChanged, this, [&pingsChanged]() { pingsChanged++; });
+    QSharedPointer<QVector<types::Location> > updatedLocations;
+    connect(&model, &ApiLocationsModel::locationsUpdated, this,
+            [&updatedLocations](const LocationID &, const QString &, QSharedPointer<QVector<types::Location> > locations) {
+        updatedLocations = locations;
+    });
+
+    QVector<int> groupIds;
+    for (int i = 0; i < kGroupsCount; ++i) {
+        groupIds << i;
+    }
+
+    // the first list, every node is pinged once
+    model.setLocations(makeLocations(groupIds, QSet<int>()), apiinfo::StaticIps());
+    QTRY_COMPARE_WITH_TIMEOUT(pingsChanged, kGroupsCount, 60000);
+    QCOMPARE(server_->requestsCount(), kGroupsCount);
+    QCOMPARE(pingsByHost_.size(), kGroupsCount);
+
+    // the second list differs by 1%: 5 groups replaced by the new ones and 5 groups with a new ping IP
+    server_->resetCounters();
+    pingsByHost_.clear();
+    pingsChanged = 0;
+    QSet<int> expectedIds;
+    for (int i = 0; i < 5; ++i) {
+        groupIds[i] = kGroupsCount + i;
+        expectedIds << kGroupsCount + i;
+    }
+    const QSet<int> changedIpIds = { 100, 200, 300, 400, 500 };
+    expectedIds.unite(changedIpIds);
+
+    model.setLocations(makeLocations(groupIds, changedIpIds), apiinfo::StaticIps());
+
+    // the measurements of the unchanged nodes are kept
+    QVERIFY(!updatedLocations.isNull());
+    int withPing = 0;
+    int withoutPing = 0;
+    for (const types::Location &location : *updatedLocations) {
+        for (const types::City &city : location.cities) {
+            if (city.pingTimeMs == PingTime(kPingRttUs / 1000)) {
+                withPing++;
+            }
+            else if (city.pingTimeMs == PingTime(PingTime::NO_PING_INFO)) {
+                withoutPing++;
+            }
+        }
+    }
+    QCOMPARE(withPing, kGroupsCount - 5);
+    QCOMPARE(withoutPing, 5);
+
+    QTRY_COMPARE_WITH_TIMEOUT(pingsChanged, expectedIds.size(), 20000);
+    // a few more ticks of the ping timer, nothing else is pinged
+    QTest::qWait(3000);
+    QCOMPARE(server_->requestsCount(), expectedIds.size());
+    QSet<QByteArray> expectedHosts;
+    for (int id : expectedIds) {
+        expectedHosts << pingHost(id);
+    }
+    const QList<QByteArray> pingedHosts = pingsByHost_.keys();
+    QCOMPARE(QSet<QByteArray>(pingedHosts.begin(), pingedHosts.end()), expectedHosts);
+}
+
+QVector<apiinfo::Location> TestIncrementalPing::makeLocations(const QVector<int> &groupIds, const QSet<int> &changedIpIds) const
+{
+    const int kGroupsPerLocation = 10;
+
+    QByteArray json = "{\"data\": [";
+    for (int l = 0; l * kGroupsPerLocation < groupIds.size(); ++l) {
+        if (l > 0) json += ",";
+        json += QString("{\"id\": %1, \"name\": \"Location %1\", \"country_code\": \"C%1\", \"premium_only\": 0, \"p2p\": 1, "
+                        "\"dns_hostname\": \"loc%1.example.com\", \"groups\": [").arg(l).toUtf8();
+        for (int g = 0; g < kGroupsPerLocation && l * kGroupsPerLocation + g < groupIds.size(); ++g) {
+            if (g > 0) json += ",";
+            const int groupId = groupIds[l * kGroupsPerLocation + g];
+            json += QString("{\"id\": %1, \"city\": \"City %1\", \"nick\": \"Nick %1\", \"pro\": 0, \"ping_ip\": \"%2\", "
+                            "\"ping_host\": \"http://%3:%4/latency\", \"wg_pubkey\": \"key%1=\", \"nodes\": ["
+                            "{\"ip\": \"10.0.0.1\", \"ip2\": \"10.0.0.2\", \"ip3\": \"10.0.0.3\", \"hostname\": \"node%1.example.com\", \"weight\": 1}]}")
+                        .arg(groupId).arg(changedIpIds.contains(groupId) ? "127.0.0.2" : "127.0.0.1")
+                        .arg(QString(pingHost(groupId))).arg(server_->serverPort()).toUtf8();
+        }
+        json += "]}";
+    }
+    json += "], \"info\": {\"changed\": 1, \"revision\": 1, \"revision_hash\": \"hash\"}}";
+
+    apiinfo::ServerListParser parser;
+    if (parser.parse(json) != apiinfo::ServerListParser::Result::kSuccess) {
+        return QVector<apiinfo::Location>();
+    }
+    return parser.locations();
+}
+
+QByteArray TestIncrementalPing::pingHost(int groupId)
+{
+    return QString("ping%1.test").arg(groupId).toUtf8();
+}
+
+void TestIncrementalPing::cleanupSettings()
+{
+    QSettings settings;
+    settings.clear();
+    QFile::remove(ApiPingStorage::defaultFilePath());
+}
+
+QTEST_MAIN(TestIncrementalPing)
+#include "incrementalping.test.moc"
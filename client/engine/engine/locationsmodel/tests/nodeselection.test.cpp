@@ -0,0 +1,229 @@
+#include <QtTest>
+
+#include "engine/locationsmodel/nodehealth.h"
+#include "engine/locationsmodel/nodeselectionalgorithm.h"
+#include "engine/locationsmodel/weightednodeselector.h"
+
+using namespace locationsmodel;
+
+// Checks that the sampled distributions match the weights (the chi-squared goodness of fit test)
+// and compares the alias method with the linear pass of NodeSelectionAlgorithm for large groups.
+class TestNodeSelection : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void test_empty_and_single();
+    void test_distribution();
+    void test_zero_weights();
+    void test_health_distribution();
+    void test_health_decay();
+    void benchmark_linear_data();
+    void benchmark_linear();
+    void benchmark_alias_data();
+    void benchmark_alias();
+    void benchmark_alias_with_health_data();
+    void benchmark_alias_with_health();
+
+private:
+    static QVector< QSharedPointer<const BaseNode> > makeNodes(const QVector<int> &weights);
+    // the chi-squared statistic of the observed counts against the expected probabilities
+    static double chiSquared(const QVector<int> &counts, const QVector<double> &probabilities, int samples);
+    static QVector<int> makeWeights(int count);
+};
+
+void TestNodeSelection::test_empty_and_single()
+{
+    WeightedNodeSelector empty;
+    QCOMPARE(empty.select(), -1);
+    QCOMPARE(empty.select(NodeHealth()), -1);
+
+    WeightedNodeSelector single(makeNodes({ 5 }));
+    for (int i = 0; i < 100; ++i) {
+        QCOMPARE(single.select(), 0);
+    }
+}
+
+void TestNodeSelection::test_distribution()
+{
+    const QVector<int> weights = { 1, 2, 3, 4, 10, 20, 5, 55 };
+    WeightedNodeSelector selector(makeNodes(weights));
+
+    const int kSamples = 200000;
+    QVector<int> counts(weights.size(), 0);
+    for (int i = 0; i < kSamples; ++i) {
+        counts[selector.select()]++;
+    }
+
+    QVector<double> probabilities;
+    for (int w : weights) {
+        probabilities << w / 100.0;
+    }
+    // the critical value for 7 degrees of freedom at p = 0.001
+    const double chi2 = chiSquared(counts, probabilities, kSamples);
+    QVERIFY2(chi2 < 24.32, qPrintable(QString("chi2 = %1").arg(chi2)));
+}
+
+void TestNodeSelection::test_zero_weights()
+{
+    WeightedNodeSelector selector(makeNodes({ 0, 3, 0, 1 }));
+    QVector<int> counts(4, 0);
+    for (int i = 0; i < 10000; ++i) {
+        counts[selector.select()]++;
+    }
+    QCOMPARE(counts[0], 0);
+    QCOMPARE(counts[2], 0);
+    QVERIFY(counts[1] > counts[3]);
+
+    // all zero weights, uniform selection
+    WeightedNodeSelector zero(makeNodes({ 0, 0, 0 }));
+    QVector<int> zeroCounts(3, 0);
+    for (int i = 0; i < 3000; ++i) {
+        zeroCounts[zero.select()]++;
+    }
+    QVERIFY(zeroCounts[0] > 0 && zeroCounts[1] > 0 && zeroCounts[2] > 0);
+}
+
+void TestNodeSelection::test_health_distribution()
+{
+    const QVector<int> weights = { 10, 10, 10, 10 };
+    WeightedNodeSelector selector(makeNodes(weights));
+
+    NodeHealth health;
+    health.markFailed("node0.example", 0);          // factor 0.5
+    health.markFailed("node1.example", 0);
+    health.markFailed("node1.example", 0);          // factor 0.25
+    QCOMPARE(health.factor("node0.example", 0), 0.5);
+    QCOMPARE(health.factor("node1.example", 0), 0.25);
+    QCOMPARE(health.factor("node2.example", 0), 1.0);
+
+    const int kSamples = 100000;
+    QVector<int> counts(weights.size(), 0);
+    for (int i = 0; i < kSamples; ++i) {
+        counts[selector.select(health, 0)]++;
+    }
+
+    const double sum = 0.5 + 0.25 + 1.0 + 1.0;
+    const QVector<double> probabilities = { 0.5 / sum, 0.25 / sum, 1.0 / sum, 1.0 / sum };
+    // the critical value for 3 degrees of freedom at p = 0.001
+    const double chi2 = chiSquared(counts, probabilities, kSamples);
+    QVERIFY2(chi2 < 16.27, qPrintable(QString("chi2 = %1").arg(chi2)));
+}
+
+void TestNodeSelection::test_health_decay()
+{
+    NodeHealth health;
+    health.markFailed("node0.example", 0);
+    const double atFailure = health.factor("node0.example", 0);
+    const double afterDecayTime = health.factor("node0.example", NodeHealth::DECAY_TIME_MS);
+    const double muchLater = health.factor("node0.example", NodeHealth::DECAY_TIME_MS * 10);
+    QVERIFY(atFailure < afterDecayTime);
+    QVERIFY(afterDecayTime < muchLater);
+    QVERIFY(muchLater > 0.999);
+
+    // many failures in a row bottom out at the minimum factor
+    for (int i = 0; i < 20; ++i) {
+        health.markFailed("node1.example", 1000);
+    }
+    QCOMPARE(health.factor("node1.example", 1000), NodeHealth::MIN_FACTOR);
+
+    // after the penalty decayed the failures count starts over
+    health.markFailed("node1.example", 1000 + NodeHealth::DECAY_TIME_MS * 10);
+    QCOMPARE(health.factor("node1.example", 1000 + NodeHealth::DECAY_TIME_MS * 10), 0.5);
+}
+
+void TestNodeSelection::benchmark_linear_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::newRow("10") << 10;
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("10000") << 10000;
+}
+
+void TestNodeSelection::benchmark_linear()
+{
+    QFETCH(int, count);
+    const auto nodes = makeNodes(makeWeights(count));
+    int result = 0;
+    QBENCHMARK {
+        for (int i = 0; i < 1000; ++i) {
+            result += NodeSelectionAlgorithm::selectRandomNodeBasedOnWeight(nodes);
+        }
+    }
+    QVERIFY(result >= 0);
+}
+
+void TestNodeSelection::benchmark_alias_data()
+{
+    benchmark_linear_data();
+}
+
+void TestNodeSelection::benchmark_alias()
+{
+    QFETCH(int, count);
+    // the table is built once per node list change
+    WeightedNodeSelector selector(makeNodes(makeWeights(count)));
+    int result = 0;
+    QBENCHMARK {
+        for (int i = 0; i < 1000; ++i) {
+            result += selector.select();
+        }
+    }
+    QVERIFY(result >= 0);
+}
+
+void TestNodeSelection::benchmark_alias_with_health_data()
+{
+    benchmark_linear_data();
+}
+
+void TestNodeSelection::benchmark_alias_with_health()
+{
+    QFETCH(int, count);
+    WeightedNodeSelector selector(makeNodes(makeWeights(count)));
+    // every tenth node recently failed
+    NodeHealth health;
+    for (int i = 0; i < count; i += 10) {
+        health.markFailed(QString("node%1.example").arg(i), 0);
+    }
+    int result = 0;
+    QBENCHMARK {
+        for (int i = 0; i < 1000; ++i) {
+            result += selector.select(health, 0);
+        }
+    }
+    QVERIFY(result >= 0);
+}
+
+QVector< QSharedPointer<const BaseNode> > TestNodeSelection::makeNodes(const QVector<int> &weights)
+{
+    QVector< QSharedPointer<const BaseNode> > nodes;
+    for (int i = 0; i < weights.size(); ++i) {
+        const QStringList ips = { "10.0.0.1", "10.0.0.2", "10.0.0.3" };
+        nodes << QSharedPointer<const BaseNode>(new ApiLocationNode(ips, QString("node%1.example").arg(i), weights[i], ""));
+    }
+    return nodes;
+}
+
+double TestNodeSelection::chiSquared(const QVector<int> &counts, const QVector<double> &probabilities, int samples)
+{
+    double chi2 = 0;
+    for (int i = 0; i < counts.size(); ++i) {
+        const double expected = probabilities[i] * samples;
+        chi2 += (counts[i] - expected) * (counts[i] - expected) / expected;
+    }
+    return chi2;
+}
+
+QVector<int> TestNodeSelection::makeWeights(int count)
+{
+    QVector<int> weights;
+    for (int i = 0; i < count; ++i) {
+        weights << 1 + (i * 7) % 20;
+    }
+    return weights;
+}
+
+QTEST_MAIN(TestNodeSelection)
+#include "nodeselection.test.moc"
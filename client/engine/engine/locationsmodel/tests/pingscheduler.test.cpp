@@ -0,0 +1,343 @@
+#include <QtTest>
+#include <QMultiMap>
+#include <QRandomGenerator>
+
+#include "engine/locationsmodel/pingscheduler.h"
+
+using namespace locationsmodel;
+
+// PingScheduler driven by a fake clock and a fake ping backend. The backend simulates a link that sends one ping
+// at a time (serviceMs per ping, as a narrow uplink) plus the RTT of the node, the pings time out after 2 s as in PingHost.
+// The failed pings are retried as PingIpsController does, a node is failed after 3 failed pings in a row.
+class TestPingScheduler : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void test_priority_order();
+    void test_progress();
+    void test_decrease_once_per_burst();
+    void test_rtt_from_send();
+    void simulate_fast_link();
+    void simulate_slow_link_data();
+    void simulate_slow_link();
+
+private:
+    static constexpr int kPingTimeoutMs = 2000;
+    static constexpr int kMaxFailedPingsInRow = 3;
+
+    struct SimulationResults
+    {
+        QStringList dispatchOrder;
+        int measured = 0;
+        int total = 0;
+        int deadNodes = 0;
+        int succeeded = 0;
+        int failed = 0;         // the nodes failed after the retries
+        int timeouts = 0;       // the timed out pings of the alive nodes
+        int peakConcurrency = 0;
+        qint64 durationMs = 0;
+    };
+
+    // the node "0" is the current location, "1".."10" are the best location candidates
+    static SimulationResults simulate(PingScheduler &scheduler, int nodesCount, int serviceMs, int deadPercent);
+};
+
+void TestPingScheduler::test_priority_order()
+{
+    PingScheduler::Settings settings;
+    settings.initialConcurrency = 4;
+    PingScheduler scheduler(settings);
+
+    scheduler.enqueue("n1", PingScheduler::PRIORITY_NORMAL);
+    scheduler.enqueue("n2", PingScheduler::PRIORITY_NORMAL);
+    scheduler.enqueue("c1", PingScheduler::PRIORITY_BEST_LOCATION_CANDIDATE);
+    scheduler.enqueue("n3", PingScheduler::PRIORITY_NORMAL);
+    scheduler.enqueue("cur", PingScheduler::PRIORITY_CURRENT);
+    scheduler.enqueue("c2", PingScheduler::PRIORITY_BEST_LOCATION_CANDIDATE);
+    // moved to the front
+    scheduler.enqueue("n3", PingScheduler::PRIORITY_CURRENT);
+    QCOMPARE(scheduler.queuedCount(), 6);
+
+    QCOMPARE(scheduler.takeReady(0), QStringList() << "cur" << "n3" << "c1" << "c2");
+    QCOMPARE(scheduler.inFlightCount(), 4);
+    QVERIFY(scheduler.takeReady(0).isEmpty());
+
+    // a node in flight is not queued again
+    scheduler.enqueue("cur", PingScheduler::PRIORITY_CURRENT);
+    QCOMPARE(scheduler.queuedCount(), 2);
+
+    scheduler.onPingFinished("cur", true, 50);
+    QCOMPARE(scheduler.takeReady(50), QStringList() << "n1" << "n2");
+
+    // the removed node is forgotten, its result is ignored
+    scheduler.remove("n3");
+    QVERIFY(!scheduler.isInFlight("n3"));
+    scheduler.onPingFinished("n3", false, 60);
+    QVERIFY(scheduler.concurrency() > settings.initialConcurrency);
+}
+
+void TestPingScheduler::test_progress()
+{
+    PingScheduler scheduler;
+    QCOMPARE(scheduler.totalCount(), 0);
+    QVERIFY(scheduler.isRoundComplete());
+
+    scheduler.enqueue("a", PingScheduler::PRIORITY_NORMAL);
+    scheduler.enqueue("b", PingScheduler::PRIORITY_NORMAL);
+    scheduler.enqueue("c", PingScheduler::PRIORITY_NORMAL);
+    QCOMPARE(scheduler.totalCount(), 3);
+    QCOMPARE(scheduler.measuredCount(), 0);
+
+    scheduler.takeReady(0);
+    scheduler.onPingFinished("a", true, 10);
+    scheduler.setMeasured("a");
+    scheduler.onPingFinished("b", false, 10);
+    // the retry doesn't change the total
+    scheduler.enqueue("b", PingScheduler::PRIORITY_NORMAL, true);
+    QCOMPARE(scheduler.totalCount(), 3);
+    QCOMPARE(scheduler.measuredCount(), 1);
+
+    // the removed node leaves the round
+    scheduler.remove("c");
+    QCOMPARE(scheduler.totalCount(), 2);
+
+    scheduler.takeReady(20);
+    scheduler.onPingFinished("b", true, 30);
+    scheduler.setMeasured("b");
+    scheduler.setMeasured("unknown");
+    QCOMPARE(scheduler.measuredCount(), 2);
+    QVERIFY(scheduler.isRoundComplete());
+
+    // the next node starts a new round
+    scheduler.enqueue("d", PingScheduler::PRIORITY_NORMAL);
+    QCOMPARE(scheduler.totalCount(), 1);
+    QCOMPARE(scheduler.measuredCount(), 0);
+
+    scheduler.startRound();
+    QCOMPARE(scheduler.totalCount(), 0);
+}
+
+void TestPingScheduler::test_decrease_once_per_burst()
+{
+    PingScheduler::Settings settings;
+    settings.initialConcurrency = 16;
+    PingScheduler scheduler(settings);
+
+    for (int i = 0; i < 64; ++i) {
+        scheduler.enqueue(QString::number(i), PingScheduler::PRIORITY_NORMAL);
+    }
+    const QStringList first = scheduler.takeReady(0);
+    QCOMPARE(first.size(), 16);
+
+    // all the pings of the window time out, the window is halved once
+    for (const QString &id : first) {
+        scheduler.onPingFinished(id, false, kPingTimeoutMs);
+    }
+    QCOMPARE(scheduler.concurrency(), 8);
+
+    // the pings started after the decrease are the new signals
+    const QStringList second = scheduler.takeReady(kPingTimeoutMs);
+    QCOMPARE(second.size(), 8);
+    scheduler.onPingFinished(second[0], true, kPingTimeoutMs + 1500);
+    QCOMPARE(scheduler.concurrency(), 4);
+    for (int i = 1; i < second.size(); ++i) {
+        scheduler.onPingFinished(second[i], true, kPingTimeoutMs + 1500);
+    }
+    QCOMPARE(scheduler.concurrency(), 4);
+
+    // the fast pings grow the window by about one per round trip
+    for (int i = 0; i < 2; ++i) {
+        const QStringList ids = scheduler.takeReady(4000 + i * 100);
+        QCOMPARE(ids.size(), 4);
+        for (const QString &id : ids) {
+            scheduler.onPingFinished(id, true, 4100 + i * 100);
+        }
+    }
+    QCOMPARE(scheduler.concurrency(), 5);
+
+    // never below the minimum
+    for (int i = 0; i < 10; ++i) {
+        const QStringList ids = scheduler.takeReady(5000 + i * 3000);
+        for (const QString &id : ids) {
+            scheduler.onPingFinished(id, false, 5000 + i * 3000 + kPingTimeoutMs);
+        }
+    }
+    QCOMPARE(scheduler.concurrency(), settings.minConcurrency);
+}
+
+void TestPingScheduler::test_rtt_from_send()
+{
+    PingScheduler::Settings settings;
+    settings.initialConcurrency = 8;
+    PingScheduler scheduler(settings);
+
+    for (int i = 0; i < 16; ++i) {
+        scheduler.enqueue(QString::number(i), PingScheduler::PRIORITY_NORMAL);
+    }
+    const QStringList ids = scheduler.takeReady(0);
+    QCOMPARE(ids.size(), 8);
+
+    // the pings waited 1.5 s in the queue of the backend, then came back in 100 ms: not a congestion
+    for (const QString &id : ids) {
+        scheduler.onPingStarted(id, 1500);
+    }
+    for (const QString &id : ids) {
+        scheduler.onPingFinished(id, true, 1600);
+    }
+    QCOMPARE(scheduler.concurrency(), 16);
+
+    // the same round trip without the send reported is measured from takeReady()
+    const QStringList next = scheduler.takeReady(2000);
+    scheduler.onPingFinished(next[0], true, 3600);
+    QCOMPARE(scheduler.concurrency(), 8);
+
+    // unknown ids are ignored
+    scheduler.onPingStarted("unknown", 4000);
+    QVERIFY(!scheduler.isInFlight("unknown"));
+}
+
+void TestPingScheduler::simulate_fast_link()
+{
+    PingScheduler::Settings settings;
+    PingScheduler scheduler(settings);
+    const SimulationResults results = simulate(scheduler, 1000, 1, 0);
+
+    QCOMPARE(results.total, 1000);
+    QCOMPARE(results.measured, 1000);
+    QCOMPARE(results.succeeded, 1000);
+    QCOMPARE(results.timeouts, 0);
+    QCOMPARE(results.peakConcurrency, settings.maxConcurrency);
+
+    QCOMPARE(results.dispatchOrder.first(), QString("0"));
+    QStringList candidates = results.dispatchOrder.mid(1, 10);
+    std::sort(candidates.begin(), candidates.end(), [](const QString &a, const QString &b) { return a.toInt() < b.toInt(); });
+    QCOMPARE(candidates, QStringList() << "1" << "2" << "3" << "4" << "5" << "6" << "7" << "8" << "9" << "10");
+}
+
+void TestPingScheduler::simulate_slow_link_data()
+{
+    QTest::addColumn<int>("serviceMs");
+    QTest::addColumn<int>("deadPercent");
+
+    QTest::newRow("50 ms per ping") << 50 << 0;
+    QTest::newRow("50 ms per ping, dead nodes") << 50 << 2;
+    QTest::newRow("200 ms per ping") << 200 << 0;
+}
+
+void TestPingScheduler::simulate_slow_link()
+{
+    QFETCH(int, serviceMs);
+    QFETCH(int, deadPercent);
+    const int nodesCount = 500;
+
+    PingScheduler adaptive;
+    const SimulationResults adaptiveResults = simulate(adaptive, nodesCount, serviceMs, deadPercent);
+
+    // all the pings at once, as before the scheduler
+    PingScheduler::Settings fixedSettings;
+    fixedSettings.minConcurrency = fixedSettings.maxConcurrency = fixedSettings.initialConcurrency = nodesCount;
+    PingScheduler fixed(fixedSettings);
+    const SimulationResults fixedResults = simulate(fixed, nodesCount, serviceMs, deadPercent);
+
+    qDebug().noquote() << QString("%1: adaptive %2 failed nodes, %3 timeouts, peak concurrency %4, %5 s; all at once %6 failed nodes, %7 timeouts, %8 s")
+        .arg(QTest::currentDataTag())
+        .arg(adaptiveResults.failed).arg(adaptiveResults.timeouts).arg(adaptiveResults.peakConcurrency).arg(adaptiveResults.durationMs / 1000)
+        .arg(fixedResults.failed).arg(fixedResults.timeouts).arg(fixedResults.durationMs / 1000);
+
+    QCOMPARE(adaptiveResults.total, nodesCount);
+    QCOMPARE(adaptiveResults.measured, nodesCount);
+    // only the dead nodes are reported as failed
+    QCOMPARE(adaptiveResults.failed, adaptiveResults.deadNodes);
+    QVERIFY(adaptiveResults.timeouts < nodesCount / 10);
+    QVERIFY(fixedResults.failed > nodesCount / 2);
+
+    // the current location and the candidates are measured first even on the slow link
+    QCOMPARE(adaptiveResults.dispatchOrder.first(), QString("0"));
+}
+
+TestPingScheduler::SimulationResults TestPingScheduler::simulate(PingScheduler &scheduler, int nodesCount, int serviceMs, int deadPercent)
+{
+    struct Finish
+    {
+        QString id;
+        bool success;
+    };
+
+    SimulationResults results;
+    QRandomGenerator random(42);
+    QHash<QString, int> rtts;
+    QSet<QString> deadNodes;
+    QHash<QString, int> failedInRow;
+
+    // in the reverse order, so the priority nodes are enqueued last
+    for (int i = nodesCount - 1; i >= 0; --i) {
+        const QString id = QString::number(i);
+        rtts[id] = random.bounded(20, 250);
+        // not the priority ones
+        if (i > 10 && i % 100 < deadPercent) {
+            deadNodes << id;
+        }
+        PingScheduler::Priority priority = PingScheduler::PRIORITY_NORMAL;
+        if (i == 0) {
+            priority = PingScheduler::PRIORITY_CURRENT;
+        }
+        else if (i <= 10) {
+            priority = PingScheduler::PRIORITY_BEST_LOCATION_CANDIDATE;
+        }
+        scheduler.enqueue(id, priority);
+    }
+    results.deadNodes = deadNodes.count();
+
+    qint64 nowMs = 0;
+    qint64 linkFreeMs = 0;      // the link sends one ping at a time
+    QMultiMap<qint64, Finish> events;
+
+    while (true) {
+        const QStringList ids = scheduler.takeReady(nowMs);
+        for (const QString &id : ids) {
+            results.dispatchOrder << id;
+            linkFreeMs = qMax(linkFreeMs, nowMs) + serviceMs;
+            const qint64 answerMs = linkFreeMs + rtts[id];
+            if (deadNodes.contains(id) || answerMs - nowMs > kPingTimeoutMs) {
+                if (!deadNodes.contains(id)) {
+                    results.timeouts++;
+                }
+                events.insert(nowMs + kPingTimeoutMs, Finish{ id, false });
+            }
+            else {
+                events.insert(answerMs, Finish{ id, true });
+            }
+        }
+        results.peakConcurrency = qMax(results.peakConcurrency, scheduler.concurrency());
+
+        if (events.isEmpty()) {
+            break;
+        }
+        auto it = events.begin();
+        nowMs = it.key();
+        const Finish finish = it.value();
+        events.erase(it);
+
+        scheduler.onPingFinished(finish.id, finish.success, nowMs);
+        if (finish.success) {
+            scheduler.setMeasured(finish.id);
+            results.succeeded++;
+        }
+        else if (++failedInRow[finish.id] >= kMaxFailedPingsInRow) {
+            scheduler.setMeasured(finish.id);
+            results.failed++;
+        }
+        else {
+            scheduler.enqueue(finish.id, PingScheduler::PRIORITY_NORMAL, true);
+        }
+    }
+
+    results.measured = scheduler.measuredCount();
+    results.total = scheduler.totalCount();
+    results.durationMs = nowMs;
+    return results;
+}
+
+QTEST_MAIN(TestPingScheduler)
+#include "pingscheduler.test.moc"
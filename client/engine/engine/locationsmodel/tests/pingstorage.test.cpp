@@ -0,0 +1,520 @@
+#include <QtTest>
+#include <QCoreApplication>
+#include <QSettings>
+#include <QTemporaryDir>
+
+#include "engine/locationsmodel/pingstatistics.h"
+#include "engine/locationsmodel/pingstorage.h"
+#include "engine/locationsmodel/pingstoragefile.h"
+#include "types/global_consts.h"
+#include "utils/simplecrypt.h"
+
+using namespace locationsmodel;
+
+class TestPingStorage : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanup();
+    void test_statistics();
+    void test_statistics_window();
+    void test_statistics_all_failed();
+    void test_statistics_serialization();
+    void test_score();
+    void test_storage_modes();
+    void test_save_load();
+    void test_load_version_2();
+    void test_migration();
+    void test_file_in_place_update();
+    void test_file_grow();
+    void test_file_corrupted_record();
+    void test_file_corrupted_header();
+    void test_file_zero_capacity();
+    void benchmark_load_data();
+    void benchmark_load();
+    void benchmark_save_data();
+    void benchmark_save();
+
+private:
+    static constexpr int kBenchmarkNodesCount = 50000;
+
+    QTemporaryDir tempDir_;
+
+    // the settings format of the previous versions (version 3), as the storage wrote it on every save
+    static void writeSettingsFormat(int nodesCount);
+    static int readSettingsFormat();
+    static PingStatistics makeStatistics(int seed);
+};
+
+void TestPingStorage::initTestCase()
+{
+    // don't touch the real settings of the app
+    QCoreApplication::setOrganizationName("Windscribe-tests");
+    QCoreApplication::setApplicationName("pingstorage.test");
+}
+
+void TestPingStorage::cleanup()
+{
+    QSettings settings;
+    settings.remove("pingStorage");
+    QFile::remove(ApiPingStorage::defaultFilePath());
+}
+
+void TestPingStorage::test_statistics()
+{
+    PingStatistics statistics;
+    QVERIFY(statistics.isEmpty());
+    QCOMPARE(statistics.pingTime(), PingTime(PingTime::NO_PING_INFO));
+
+    statistics.addSample(100);
+    statistics.addSample(PingTime::NO_PING_INFO);     // ignored
+    statistics.addSample(120);
+    statistics.addSample(PingTime::PING_FAILED);
+    statistics.addSample(110);
+
+    QCOMPARE(statistics.samplesCount(), 4);
+    QCOMPARE(statistics.successCount(), 3);
+    QCOMPARE(statistics.minMs(), 100);
+    QCOMPARE(statistics.avgMs(), 110);
+    QCOMPARE(statistics.jitterMs(), 15);             // (|120 - 100| + |110 - 120|) / 2
+    QCOMPARE(statistics.lossPercent(), 25);
+    // 100 -> 0.3 * 120 + 0.7 * 100 = 106 -> 0.3 * 110 + 0.7 * 106 = 107.2
+    QCOMPARE(statistics.ewmaMs(), 107);
+    QCOMPARE(statistics.pingTime(), PingTime(107));
+}
+
+void TestPingStorage::test_statistics_window()
+{
+    PingStatistics statistics;
+    for (int i = 0; i < PingStatistics::WINDOW_SIZE; ++i) {
+        statistics.addSample(PingTime::PING_FAILED);
+    }
+    QCOMPARE(statistics.lossPercent(), 100);
+
+    // the failed samples are pushed out of the window
+    for (int i = 0; i < PingStatistics::WINDOW_SIZE; ++i) {
+        statistics.addSample(50);
+    }
+    QCOMPARE(statistics.samplesCount(), PingStatistics::WINDOW_SIZE);
+    QCOMPARE(statistics.lossPercent(), 0);
+    QCOMPARE(statistics.minMs(), 50);
+    QCOMPARE(statistics.jitterMs(), 0);
+}
+
+void TestPingStorage::test_statistics_all_failed()
+{
+    PingStatistics statistics;
+    statistics.addSample(40);
+    for (int i = 0; i < PingStatistics::WINDOW_SIZE; ++i) {
+        statistics.addSample(PingTime::PING_FAILED);
+    }
+    QCOMPARE(statistics.minMs(), (int)PingTime::PING_FAILED);
+    QCOMPARE(statistics.ewmaMs(), (int)PingTime::PING_FAILED);
+    QCOMPARE(statistics.pingTime(), PingTime(PingTime::PING_FAILED));
+    QCOMPARE(statistics.score(PingStatistics::ScoreWeights()), (int)PingTime::PING_FAILED);
+}
+
+void TestPingStorage::test_statistics_serialization()
+{
+    PingStatistics statistics;
+    for (int i = 0; i < PingStatistics::WINDOW_SIZE + 3; ++i) {
+        statistics.addSample(i % 4 == 0 ? PingTime::PING_FAILED : 30 + i);
+    }
+
+    QByteArray arr;
+    {
+        QDataStream ds(&arr, QIODevice::WriteOnly);
+        ds << statistics;
+    }
+    QVERIFY(arr.size() <= 25);
+
+    PingStatistics loaded;
+    QDataStream ds(&arr, QIODevice::ReadOnly);
+    ds >> loaded;
+    QCOMPARE(ds.status(), QDataStream::Ok);
+    QCOMPARE(loaded.samplesCount(), statistics.samplesCount());
+    QCOMPARE(loaded.minMs(), statistics.minMs());
+    QCOMPARE(loaded.avgMs(), statistics.avgMs());
+    QCOMPARE(loaded.ewmaMs(), statistics.ewmaMs());
+    QCOMPARE(loaded.jitterMs(), statistics.jitterMs());
+    QCOMPARE(loaded.lossPercent(), statistics.lossPercent());
+
+    // the window continues after loading
+    loaded.addSample(PingTime::PING_FAILED);
+    statistics.addSample(PingTime::PING_FAILED);
+    QCOMPARE(loaded.lossPercent(), statistics.lossPercent());
+}
+
+void TestPingStorage::test_score()
+{
+    PingStatistics stable;
+    PingStatistics jittery;
+    PingStatistics lossy;
+    for (int i = 0; i < PingStatistics::WINDOW_SIZE; ++i) {
+        stable.addSample(60);
+        jittery.addSample(i % 2 ? 20 : 80);
+        lossy.addSample(i == 0 ? PingTime::PING_FAILED : 40);
+    }
+
+    PingStatistics::ScoreWeights weights;
+    QCOMPARE(stable.score(weights), 60);
+    QVERIFY(jittery.score(weights) > stable.score(weights));
+    QVERIFY(lossy.score(weights) > stable.score(weights));
+
+    // without the penalties only the EWMA matters
+    weights.jitterWeight = 0;
+    weights.lossWeight = 0;
+    QVERIFY(lossy.score(weights) < stable.score(weights));
+}
+
+void TestPingStorage::test_storage_modes()
+{
+    ApiPingStorage storage;
+    storage.setPing(1, 100);
+    storage.setPing(1, PingTime::PING_FAILED);
+    storage.setPing(1, 200);
+
+    QCOMPARE(storage.getStatistics(1).samplesCount(), 3);
+    QCOMPARE(storage.getStatistics(2).samplesCount(), 0);
+
+    // by default, the last ping
+    QVERIFY(!storage.isStatisticsMode());
+    QCOMPARE(storage.getPing(1), PingTime(200));
+    QCOMPARE(storage.getScore(1), 200);
+
+    storage.setStatisticsMode(true);
+    QCOMPARE(storage.getPing(1), PingTime(130));    // 0.3 * 200 + 0.7 * 100
+    QVERIFY(storage.getScore(1) > 130);             // the jitter and loss penalties
+    QCOMPARE(storage.getPing(2), PingTime(PingTime::NO_PING_INFO));
+    QCOMPARE(storage.getScore(2), (int)PingTime::NO_PING_INFO);
+}
+
+void TestPingStorage::test_save_load()
+{
+    {
+        ApiPingStorage storage;
+        storage.setPing(1, 100);
+        storage.setPing(1, 110);
+        storage.setPing(2, PingTime::PING_FAILED);
+    }
+
+    ApiPingStorage storage;
+    QCOMPARE(storage.getPing(1), PingTime(110));
+    QCOMPARE(storage.getStatistics(1).samplesCount(), 2);
+    QCOMPARE(storage.getStatistics(1).minMs(), 100);
+    QCOMPARE(storage.getStatistics(2).lossPercent(), 100);
+}
+
+void TestPingStorage::test_load_version_2()
+{
+    // the format written by the versions without the statistics
+    QByteArray arr;
+    {
+        QDataStream ds(&arr, QIODevice::WriteOnly);
+        ds << (quint32)0x734AB2AE << 2 << (quint32)5;
+        ds << (qsizetype)2;
+        ds << 10 << 75 << (quint32)5;
+        ds << 11 << (int)PingTime::PING_FAILED << (quint32)4;
+    }
+    QSettings settings;
+    SimpleCrypt simpleCrypt(SIMPLE_CRYPT_KEY);
+    settings.setValue("pingStorage", simpleCrypt.encryptToString(arr));
+
+    ApiPingStorage storage;
+    QCOMPARE(storage.getCurrentIteration(), (quint32)5);
+    QCOMPARE(storage.getPing(10), PingTime(75));
+    QCOMPARE(storage.getPing(11), PingTime(PingTime::PING_FAILED));
+    // the statistics are seeded with the stored ping
+    QCOMPARE(storage.getStatistics(10).samplesCount(), 1);
+    QCOMPARE(storage.getStatistics(10).ewmaMs(), 75);
+    QCOMPARE(storage.getStatistics(11).lossPercent(), 100);
+}
+
+void TestPingStorage::test_migration()
+{
+    writeSettingsFormat(100);
+
+    {
+        ApiPingStorage storage;
+        QCOMPARE(storage.getCurrentIteration(), (quint32)7);
+        QCOMPARE(storage.getStatistics(10).samplesCount(), makeStatistics(10).samplesCount());
+        QCOMPARE(storage.getStatistics(10).ewmaMs(), makeStatistics(10).ewmaMs());
+        QCOMPARE(storage.getPing(99), PingTime(99 % 300));
+        // migrated once, the settings are removed
+        QVERIFY(!QSettings().contains("pingStorage"));
+        QVERIFY(QFile::exists(ApiPingStorage::defaultFilePath()));
+        storage.incIteration();
+    }
+
+    ApiPingStorage storage;
+    QCOMPARE(storage.getCurrentIteration(), (quint32)8);
+    QCOMPARE(storage.getPing(99), PingTime(99 % 300));
+    QCOMPARE(storage.getStatistics(10).jitterMs(), makeStatistics(10).jitterMs());
+    QCOMPARE(storage.getStatistics(10).lossPercent(), makeStatistics(10).lossPercent());
+}
+
+void TestPingStorage::test_file_in_place_update()
+{
+    const QString path = tempDir_.filePath("in_place.bin");
+    PingStorageFile file(path);
+    bool isNew = false;
+    QVERIFY(file.open(&isNew));
+    QVERIFY(isNew);
+
+    QVERIFY(file.setRecord(1, 100, 1, makeStatistics(1)));
+    QVERIFY(file.setRecord(2, 200, 1, makeStatistics(2)));
+    const qint64 size = QFileInfo(path).size();
+    QVERIFY(file.setRecord(1, 150, 2, makeStatistics(3)));
+    QCOMPARE(file.count(), 2);
+    QCOMPARE(QFileInfo(path).size(), size);
+
+    file.setIteration(2);
+    file.close();
+
+    QVERIFY(file.open(&isNew));
+    QVERIFY(!isNew);
+    QCOMPARE(file.count(), 2);
+    QCOMPARE(file.iteration(), (quint32)2);
+    PingStorageFile::Record record;
+    QVERIFY(file.record(1, record));
+    QCOMPARE(record.timeMs, 150);
+    QCOMPARE(record.iteration, (quint32)2);
+    PingStatistics statistics;
+    QVERIFY(statistics.unpack(record.statistics));
+    QCOMPARE(statistics.ewmaMs(), makeStatistics(3).ewmaMs());
+    QVERIFY(!file.record(3, record));
+
+    QCOMPARE(PingStorageFile::hashKey("10.0.0.1"), PingStorageFile::hashKey("10.0.0.1"));
+    QVERIFY(PingStorageFile::hashKey("10.0.0.1") != PingStorageFile::hashKey("10.0.0.2"));
+}
+
+void TestPingStorage::test_file_grow()
+{
+    const QString path = tempDir_.filePath("grow.bin");
+    {
+        PingStorageFile file(path);
+        QVERIFY(file.open());
+        for (int i = 0; i < 5000; ++i) {
+            QVERIFY(file.setRecord(i, i % 300, 1, makeStatistics(i)));
+        }
+    }
+
+    PingStorageFile file(path);
+    QVERIFY(file.open());
+    QCOMPARE(file.count(), 5000);
+    const QVector<PingStorageFile::Record> records = file.records();
+    QCOMPARE(records.size(), 5000);
+    for (int i = 0; i < records.size(); ++i) {
+        QCOMPARE(records[i].key, (quint64)i);
+        QCOMPARE(records[i].timeMs, i % 300);
+    }
+}
+
+void TestPingStorage::test_file_corrupted_record()
+{
+    const QString path = tempDir_.filePath("corrupted_record.bin");
+    {
+        PingStorageFile file(path);
+        QVERIFY(file.open());
+        for (int i = 0; i < 3; ++i) {
+            QVERIFY(file.setRecord(i, 100 + i, 1, makeStatistics(i)));
+        }
+    }
+
+    // damage the time of the second record
+    {
+        QFile f(path);
+        QVERIFY(f.open(QIODevice::ReadWrite));
+        QVERIFY(f.seek(32 + sizeof(PingStorageFile::Record) + 8));
+        f.write("\xff", 1);
+    }
+
+    PingStorageFile file(path);
+    bool isNew = true;
+    QVERIFY(file.open(&isNew));
+    QVERIFY(!isNew);
+    QCOMPARE(file.count(), 2);
+    QVERIFY(!file.contains(1));
+
+    // written again to a new slot
+    QVERIFY(file.setRecord(1, 111, 2, makeStatistics(1)));
+    file.close();
+    QVERIFY(file.open());
+    QCOMPARE(file.count(), 3);
+    QCOMPARE(file.records().size(), 3);
+    PingStorageFile::Record record;
+    QVERIFY(file.record(1, record));
+    QCOMPARE(record.timeMs, 111);
+}
+
+void TestPingStorage::test_file_corrupted_header()
+{
+    const QString path = tempDir_.filePath("corrupted_header.bin");
+    {
+        PingStorageFile file(path);
+        QVERIFY(file.open());
+        QVERIFY(file.setRecord(1, 100, 1, makeStatistics(1)));
+    }
+    {
+        QFile f(path);
+        QVERIFY(f.open(QIODevice::ReadWrite));
+        QVERIFY(f.seek(8));
+        f.write("\x01\x02", 2);
+    }
+
+    PingStorageFile file(path);
+    bool isNew = false;
+    QVERIFY(file.open(&isNew));
+    QVERIFY(isNew);
+    QCOMPARE(file.count(), 0);
+}
+
+void TestPingStorage::test_file_zero_capacity()
+{
+    const QString path = tempDir_.filePath("zero_capacity.bin");
+    {
+        PingStorageFile file(path);
+        QVERIFY(file.open());
+    }
+    // an empty file with the capacity of 0 and a valid header checksum
+    {
+        QFile f(path);
+        QVERIFY(f.open(QIODevice::ReadWrite));
+        QByteArray header = f.read(32);
+        QCOMPARE(header.size(), 32);
+        const quint32 zero = 0;
+        header.replace(8, 4, (const char *)&zero, 4);
+        header.replace(12, 4, (const char *)&zero, 4);
+        const quint32 checksum = qChecksum(QByteArrayView(header.constData(), 28));
+        header.replace(28, 4, (const char *)&checksum, 4);
+        QVERIFY(f.seek(0));
+        f.write(header);
+        QVERIFY(f.resize(32));
+    }
+
+    PingStorageFile file(path);
+    bool isNew = false;
+    QVERIFY(file.open(&isNew));
+    QVERIFY(isNew);
+    for (int i = 0; i < 300; ++i) {
+        QVERIFY(file.setRecord(i, 100, 1, makeStatistics(i)));
+    }
+    QCOMPARE(file.count(), 300);
+}
+
+void TestPingStorage::benchmark_load_data()
+{
+    QTest::addColumn<bool>("isFile");
+    QTest::newRow("settings, 50k nodes") << false;
+    QTest::newRow("mapped file, 50k nodes") << true;
+}
+
+void TestPingStorage::benchmark_load()
+{
+    QFETCH(bool, isFile);
+
+    writeSettingsFormat(kBenchmarkNodesCount);
+    if (isFile) {
+        {
+            // migrates the settings
+            ApiPingStorage storage;
+        }
+        QBENCHMARK {
+            ApiPingStorage loaded;
+            QCOMPARE(loaded.getPing(kBenchmarkNodesCount - 1), PingTime((kBenchmarkNodesCount - 1) % 300));
+        }
+    }
+    else {
+        QBENCHMARK {
+            QCOMPARE(readSettingsFormat(), kBenchmarkNodesCount);
+        }
+    }
+}
+
+void TestPingStorage::benchmark_save_data()
+{
+    QTest::addColumn<bool>("isFile");
+    QTest::addColumn<int>("updatedCount");
+    // the settings format is written as a whole on every save
+    QTest::newRow("settings, 50k nodes") << false << kBenchmarkNodesCount;
+    QTest::newRow("mapped file, 1 of 50k nodes updated") << true << 1;
+    QTest::newRow("mapped file, 50k of 50k nodes updated") << true << kBenchmarkNodesCount;
+}
+
+void TestPingStorage::benchmark_save()
+{
+    QFETCH(bool, isFile);
+    QFETCH(int, updatedCount);
+
+    if (isFile) {
+        writeSettingsFormat(kBenchmarkNodesCount);
+        ApiPingStorage storage;
+        int sample = 0;
+        QBENCHMARK {
+            for (int i = 0; i < updatedCount; ++i) {
+                storage.setPing(i, 10 + sample++ % 200);
+            }
+        }
+        QCOMPARE(QFileInfo(ApiPingStorage::defaultFilePath()).size(),
+                 (qint64)(32 + 65536 * sizeof(PingStorageFile::Record)));
+    }
+    else {
+        QBENCHMARK {
+            writeSettingsFormat(kBenchmarkNodesCount);
+        }
+    }
+}
+
+void TestPingStorage::writeSettingsFormat(int nodesCount)
+{
+    QByteArray arr;
+    {
+        QDataStream ds(&arr, QIODevice::WriteOnly);
+        ds << (quint32)0x734AB2AE << 3 << (quint32)7;
+        ds << (qsizetype)nodesCount;
+        for (int i = 0; i < nodesCount; ++i) {
+            ds << i << i % 300 << (quint32)7 << makeStatistics(i);
+        }
+    }
+    QSettings settings;
+    SimpleCrypt simpleCrypt(SIMPLE_CRYPT_KEY);
+    settings.setValue("pingStorage", simpleCrypt.encryptToString(arr));
+    settings.sync();
+}
+
+int TestPingStorage::readSettingsFormat()
+{
+    QSettings settings;
+    SimpleCrypt simpleCrypt(SIMPLE_CRYPT_KEY);
+    QByteArray arr = simpleCrypt.decryptToByteArray(settings.value("pingStorage").toString());
+    QDataStream ds(&arr, QIODevice::ReadOnly);
+    quint32 magic;
+    int version;
+    quint32 iteration;
+    qsizetype count;
+    ds >> magic >> version >> iteration >> count;
+
+    QHash<int, QPair<int, PingStatistics> > data;
+    for (qsizetype i = 0; i < count; ++i) {
+        int id;
+        int timeMs;
+        PingStatistics statistics;
+        ds >> id >> timeMs >> iteration >> statistics;
+        data[id] = qMakePair(timeMs, statistics);
+    }
+    return ds.status() == QDataStream::Ok ? data.size() : -1;
+}
+
+PingStatistics TestPingStorage::makeStatistics(int seed)
+{
+    PingStatistics statistics;
+    for (int i = 0; i < 1 + seed % PingStatistics::WINDOW_SIZE; ++i) {
+        statistics.addSample((seed + i) % 7 == 0 ? PingTime::PING_FAILED : 20 + (seed * 13 + i * 7) % 200);
+    }
+    return statistics;
+}
+
+QTEST_MAIN(TestPingStorage)
+#include "pingstorage.test.moc"
@@ -0,0 +1,148 @@
+#include "weightednodeselector.h"
+
+#include "nodehealth.h"
+#include "utils/utils.h"
+#include "utils/ws_assert.h"
+
+namespace locationsmodel {
+
+WeightedNodeSelector::WeightedNodeSelector()
+{
+}
+
+WeightedNodeSelector::WeightedNodeSelector(const QVector<QSharedPointer<const BaseNode> > &nodes)
+{
+    QVector<double> weights;
+    QStringList hostnames;
+    weights.reserve(nodes.size());
+    for (const auto &node : nodes) {
+        weights << node->getWeight();
+        hostnames << node->getHostname();
+    }
+    setWeights(weights, hostnames);
+}
+
+void WeightedNodeSelector::setWeights(const QVector<double> &weights, const QStringList &hostnames)
+{
+    WS_ASSERT(hostnames.isEmpty() || hostnames.size() == weights.size());
+    const int n = weights.size();
+    weights_ = weights;
+    hostnames_ = hostnames;
+    prob_.fill(1.0, n);
+    alias_.fill(0, n);
+    if (n == 0) {
+        return;
+    }
+
+    double sum = 0;
+    for (double w : weights) {
+        sum += qMax(0.0, w);
+    }
+    if (sum <= 0) {
+        // all zero weights, select uniformly
+        for (int i = 0; i < n; ++i) {
+            alias_[i] = i;
+        }
+        return;
+    }
+
+    // Vose's alias method: split the scaled probabilities into the small (< 1) and large (>= 1) ones,
+    // then fill every small column up to 1 with a piece of a large one
+    QVector<double> scaled(n);
+    QVector<int> small;
+    QVector<int> large;
+    for (int i = 0; i < n; ++i) {
+        scaled[i] = qMax(0.0, weights[i]) * n / sum;
+        if (scaled[i] < 1.0) {
+            small << i;
+        } else {
+            large << i;
+        }
+    }
+
+    while (!small.isEmpty() && !large.isEmpty()) {
+        const int s = small.takeLast();
+        const int l = large.last();
+        prob_[s] = scaled[s];
+        alias_[s] = l;
+        scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+        if (scaled[l] < 1.0) {
+            large.removeLast();
+            small << l;
+        }
+    }
+    // the rest are 1 up to the rounding errors
+    for (int i : qAsConst(large)) {
+        prob_[i] = 1.0;
+        alias_[i] = i;
+    }
+    for (int i : qAsConst(small)) {
+        prob_[i] = 1.0;
+        alias_[i] = i;
+    }
+}
+
+int WeightedNodeSelector::select() const
+{
+    if (prob_.isEmpty()) {
+        return -1;
+    }
+    return sample();
+}
+
+int WeightedNodeSelector::select(const NodeHealth &health) const
+{
+    return select(health, health.nowMs());
+}
+
+int WeightedNodeSelector::select(const NodeHealth &health, qint64 nowMs) const
+{
+    if (prob_.isEmpty()) {
+        return -1;
+    }
+    if (hostnames_.isEmpty() || health.isEmpty()) {
+        return sample();
+    }
+
+    // accept the sampled node with the probability of its health factor
+    for (int i = 0; i < MAX_REJECTIONS; ++i) {
+        const int ind = sample();
+        const double factor = health.factor(hostnames_[ind], nowMs);
+        if (factor >= 1.0 || Utils::generateDoubleRandom(0.0, 1.0) < factor) {
+            return ind;
+        }
+    }
+    return selectLinear(health, nowMs);
+}
+
+int WeightedNodeSelector::sample() const
+{
+    const int n = prob_.size();
+    const double r = Utils::generateDoubleRandom(0.0, 1.0) * n;
+    const int column = qMin((int)r, n - 1);
+    return (r - column) < prob_[column] ? column : alias_[column];
+}
+
+int WeightedNodeSelector::selectLinear(const NodeHealth &health, qint64 nowMs) const
+{
+    QVector<double> weights(weights_.size());
+    double sum = 0;
+    for (int i = 0; i < weights_.size(); ++i) {
+        weights[i] = qMax(0.0, weights_[i]) * health.factor(hostnames_[i], nowMs);
+        sum += weights[i];
+    }
+    if (sum <= 0) {
+        return sample();
+    }
+
+    double r = Utils::generateDoubleRandom(0.0, sum);
+    for (int i = 0; i < weights.size(); ++i) {
+        r -= weights[i];
+        if (r < 0) {
+            return i;
+        }
+    }
+    return weights.size() - 1;
+}
+
+} //namespace locationsmodel
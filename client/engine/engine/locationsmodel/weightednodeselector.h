@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+
+#include "locationnode.h"
+
+namespace locationsmodel {
+
+class NodeHealth;
+
+// Weighted random node selection with O(1) sampling by the alias method (Vose).
+// The alias table is built once when the node list changes. The health factors of the recently failed nodes
+// are applied by rejection sampling on top of the table, so decaying penalties don't require rebuilding it
+// and the resulting distribution is proportional to weight * factor.
+class WeightedNodeSelector
+{
+public:
+    WeightedNodeSelector();
+    explicit WeightedNodeSelector(const QVector< QSharedPointer<const BaseNode> > &nodes);
+
+    // the hostnames are used to look up the health factors, may be empty
+    void setWeights(const QVector<double> &weights, const QStringList &hostnames = QStringList());
+
+    int count() const { return prob_.size(); }
+    // returns -1 if there are no nodes
+    int select() const;
+    int select(const NodeHealth &health) const;
+    int select(const NodeHealth &health, qint64 nowMs) const;
+
+private:
+    // the rejection sampling gives up after this many attempts and falls back to a linear pass
+    static constexpr int MAX_REJECTIONS = 16;
+
+    QVector<double> prob_;
+    QVector<int> alias_;
+    QVector<double> weights_;
+    QStringList hostnames_;
+
+    int sample() const;
+    int selectLinear(const NodeHealth &health, qint64 nowMs) const;
+};
+
+} //namespace locationsmodel
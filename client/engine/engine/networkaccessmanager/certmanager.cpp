@@ -2,7 +2,7 @@
 #include <QFile>
 #include "utils/logger.h"
 
-CertManager::CertManager()
+CertManager::CertManager() : trustStore_(NULL), isTrustStoreOutdated_(true)
 {
     // load certificates from bundle
     {
@@ -38,6 +38,10 @@ CertManager::CertManager()
 CertManager::~CertManager()
 {
     cleanCerts();
+    if (trustStore_)
+    {
+        X509_STORE_free(trustStore_);
+    }
 }
 
 int CertManager::count()
@@ -50,6 +54,30 @@ X509 *CertManager::getCert(int ind)
     return certs_[ind].cert;
 }
 
+X509_STORE *CertManager::trustStore()
+{
+    QMutexLocker locker(&mutex_);
+    if (isTrustStoreOutdated_)
+    {
+        // SSL contexts that still reference the previous store keep it alive until they are freed
+        if (trustStore_)
+        {
+            X509_STORE_free(trustStore_);
+        }
+        trustStore_ = X509_STORE_new();
+        for (int i = 0; i < certs_.count(); ++i)
+        {
+            if (certs_[i].cert != NULL)
+            {
+                X509_STORE_add_cert(trustStore_, certs_[i].cert);
+            }
+        }
+        isTrustStoreOutdated_ = false;
+    }
+    X509_STORE_up_ref(trustStore_);
+    return trustStore_;
+}
+
 void CertManager::parseCertsBundle(QByteArray &arr)
 {
     QString s = arr;
@@ -64,6 +92,7 @@ void CertManager::parseCertsBundle(QByteArray &arr)
         {
             QString cert = s.mid(indStart, indEnd - indStart + QString("-----END CERTIFICATE-----").length());
             certs_ << loadCert(cert);
+            isTrustStoreOutdated_ = true;
             curOffs = indEnd + QString("-----END CERTIFICATE-----").length();
         }
         else
@@ -99,4 +128,5 @@ void CertManager::cleanCerts()
         BIO_free(certs_[i].bio);
     }
     certs_.clear();
+    isTrustStoreOutdated_ = true;
 }
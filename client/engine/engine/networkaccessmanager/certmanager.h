@@ -2,6 +2,7 @@
 #define CERTMANAGER_H
 
 #include <QByteArray>
+#include <QMutex>
 #include <QStringList>
 #include <QVector>
 #include <openssl/ssl.h>
@@ -15,6 +16,10 @@ public:
     int count();
     X509 *getCert(int ind);
 
+    // Returns the trust store with all certificates, built once and rebuilt only if the set of certificates changed.
+    // Thread safe. The caller gets its own reference to the shared store (pass it to SSL_CTX_set_cert_store or free with X509_STORE_free).
+    X509_STORE *trustStore();
+
 private:
     struct CertDescr
     {
@@ -27,6 +32,10 @@ private:
     void cleanCerts();
 
     QVector<CertDescr> certs_;
+
+    QMutex mutex_;
+    X509_STORE *trustStore_;
+    bool isTrustStoreOutdated_;
 };
 
 #endif // CERTMANAGER_H
@@ -1,14 +1,19 @@
 #include "curlnetworkmanager.h"
 
 #include "curlnetworkmanager_impl.h"
+#include "utils/extraconfig.h"
 
+CurlNetworkManager::CurlNetworkManager(QObject *parent) : CurlNetworkManager(parent, ExtraConfig::instance().getUseCurlEventLoop())
+{
+}
 
-CurlNetworkManager::CurlNetworkManager(QObject *parent) : QObject(parent)
+CurlNetworkManager::CurlNetworkManager(QObject *parent, bool bEventDrivenLoop) : QObject(parent)
 {
-    curlNetworkManagerImpl_ = new CurlNetworkManagerImpl(nullptr);
+    curlNetworkManagerImpl_ = new CurlNetworkManagerImpl(nullptr, bEventDrivenLoop);
     connect(curlNetworkManagerImpl_, &CurlNetworkManagerImpl::requestFinished, this, &CurlNetworkManager::onRequestFinished, Qt::QueuedConnection);
     connect(curlNetworkManagerImpl_, &CurlNetworkManagerImpl::requestProgress, this, &CurlNetworkManager::onRequestProgress, Qt::QueuedConnection);
     connect(curlNetworkManagerImpl_, &CurlNetworkManagerImpl::requestNewData, this, &CurlNetworkManager::onRequestNewData, Qt::QueuedConnection);
+    connect(curlNetworkManagerImpl_, &CurlNetworkManagerImpl::requestResponseHeaders, this, &CurlNetworkManager::onRequestResponseHeaders, Qt::QueuedConnection);
 }
 
 CurlNetworkManager::~CurlNetworkManager()
@@ -59,12 +64,18 @@ void CurlNetworkManager::abort(CurlReply *reply)
     curlNetworkManagerImpl_->abort(reply->id());
 }
 
-void CurlNetworkManager::onRequestFinished(quint64 requestId, CURLcode curlErrorCode, qint64 elapsedMs)
+bool CurlNetworkManager::isEventDrivenLoop() const
+{
+    return curlNetworkManagerImpl_->isEventDrivenLoop();
+}
+
+void CurlNetworkManager::onRequestFinished(quint64 requestId, CURLcode curlErrorCode, const RequestTimings &timings)
 {
     auto it = activeRequests_.find(requestId);
     if (it != activeRequests_.end()) {
         it.value()->setCurlErrorCode(curlErrorCode);
-        emit it.value()->finished(elapsedMs);
+        it.value()->setTimings(timings);
+        emit it.value()->finished(timings.totalUs / 1000);  // convert total time to ms
     }
 }
 
@@ -78,9 +89,14 @@ void CurlNetworkManager::onRequestProgress(quint64 requestId, qint64 bytesReceiv
 void CurlNetworkManager::onRequestNewData(quint64 requestId, const QByteArray &newData)
 {
     auto it = activeRequests_.find(requestId);
-    if (it != activeRequests_.end()) {
-        it.value()->appendNewData(newData);
-        emit it.value()->readyRead();
-    }
+    if (it != activeRequests_.end())
+        it.value()->appendNewData(newData);     // emits readyRead
 }
 
+
+void CurlNetworkManager::onRequestResponseHeaders(quint64 requestId, int httpCode, const QMap<QByteArray, QByteArray> &headers)
+{
+    auto it = activeRequests_.find(requestId);
+    if (it != activeRequests_.end())
+        it.value()->setResponseHeaders(httpCode, headers);
+}
@@ -12,7 +12,9 @@ class CurlNetworkManager : public QObject
 {
     Q_OBJECT
 public:
+    // the loop mode is taken from the extra config option ws-curl-event-loop
     explicit CurlNetworkManager(QObject *parent = 0);
+    CurlNetworkManager(QObject *parent, bool bEventDrivenLoop);
     virtual ~CurlNetworkManager();
     CurlReply *get(const NetworkRequest &request, const QStringList &ips, const types::ProxySettings &proxySettings = types::ProxySettings());
     CurlReply *post(const NetworkRequest &request, const QByteArray &data, const QStringList &ips, const types::ProxySettings &proxySettings = types::ProxySettings());
@@ -21,11 +23,15 @@ public:
 
     void abort(CurlReply *reply);
 
+    // false if the event driven loop was not requested or is not supported
+    bool isEventDrivenLoop() const;
+
 private slots:
     // this slots must be queued connected
-    void onRequestFinished(quint64 requestId, CURLcode curlErrorCode, qint64 elapsedMs);
+    void onRequestFinished(quint64 requestId, CURLcode curlErrorCode, const RequestTimings &timings);
     void onRequestProgress(quint64 requestId, qint64 bytesReceived, qint64 bytesTotal);
     void onRequestNewData(quint64 requestId, const QByteArray &newData);
+    void onRequestResponseHeaders(quint64 requestId, int httpCode, const QMap<QByteArray, QByteArray> &headers);
 
 private:
     QHash<quint64, CurlReply *> activeRequests_;
@@ -1,23 +1,35 @@
 #include "curlnetworkmanager_impl.h"
 
+#include <climits>
+#include <utility>
 #include <QCoreApplication>
 #include <QDebug>
 #include <QMap>
 #include <QStandardPaths>
 
+#ifdef Q_OS_LINUX
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
 #include "utils/crashhandler.h"
 #include "utils/logger.h"
 #include "utils/ws_assert.h"
 
-CurlNetworkManagerImpl *g_this = nullptr;
-
-CurlNetworkManagerImpl::CurlNetworkManagerImpl(QObject *parent) : QThread(parent),
-    bNeedFinish_(false)
+CurlNetworkManagerImpl::CurlNetworkManagerImpl(QObject *parent, bool bEventDrivenLoop) : QThread(parent),
+    bNeedFinish_(false),
+    bEventDrivenLoop_(false)
   #if defined(Q_OS_MAC)
     , certPath_(QCoreApplication::applicationDirPath() + "/../resources/cert.pem")
   #elif defined (Q_OS_LINUX)
     , certPath_("/etc/windscribe/cert.pem")
   #endif
+  #ifdef Q_OS_LINUX
+    , epoll_(-1)
+    , wakeupFd_(-1)
+    , timerDeadline_(-1)
+  #endif
 {
 
 #ifdef MAKE_CURL_LOG_FILE
@@ -28,8 +40,26 @@ CurlNetworkManagerImpl::CurlNetworkManagerImpl(QObject *parent) : QThread(parent
 #endif
 
     multiHandle_ = curl_multi_init();
+
+    shareHandle_ = curl_share_init();
+    curl_share_setopt(shareHandle_, CURLSHOPT_LOCKFUNC, shareLockCallback);
+    curl_share_setopt(shareHandle_, CURLSHOPT_UNLOCKFUNC, shareUnlockCallback);
+    curl_share_setopt(shareHandle_, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(shareHandle_, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    curl_share_setopt(shareHandle_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    // not CURL_LOCK_DATA_DNS: every request pins its own IPs with CURLOPT_RESOLVE, the shared cache would let concurrent
+    // requests to the same host overwrite each other's pinned (and whitelisted) IPs
+    pinnedIpsClock_.start();
+
+    if (bEventDrivenLoop) {
+#ifdef Q_OS_LINUX
+        bEventDrivenLoop_ = initEventDrivenLoop();
+#else
+        qCDebug(LOG_BASIC) << "CurlNetworkManagerImpl: the event driven loop is not supported on this platform, using the poll loop";
+#endif
+    }
+
     nextId_ = 0;
-    g_this = this;
     start(LowPriority);
 }
 
@@ -41,35 +71,129 @@ CurlNetworkManagerImpl::~CurlNetworkManagerImpl()
         waitCondition_.wakeAll();
     }
     curl_multi_wakeup(multiHandle_);
+#ifdef Q_OS_LINUX
+    if (bEventDrivenLoop_)
+        wakeupEventDrivenLoop();
+#endif
     wait();
     curl_multi_cleanup(multiHandle_);
+    // all easy handles are already deleted at this point, so the share handle is no longer in use
+    curl_share_cleanup(shareHandle_);
+#ifdef Q_OS_LINUX
+    // after curl_multi_cleanup(), since it may still call the socket callback
+    if (wakeupFd_ != -1)
+        close(wakeupFd_);
+    if (epoll_ != -1)
+        close(epoll_);
+#endif
 }
 
 size_t CurlNetworkManagerImpl::writeDataCallback(void *ptr, size_t size, size_t count, void *ri)
 {
     RequestInfo *requestInfo = static_cast<RequestInfo *>(ri);
-    QByteArray arr;
-    arr.append((char*)ptr, size*count);
-    emit g_this->requestNewData(requestInfo->id, arr);
+    if (!requestInfo->isCoalesceBody) {
+        QByteArray arr;
+        arr.append((char*)ptr, size*count);
+        emit requestInfo->owner->requestNewData(requestInfo->id, arr);
+        return size*count;
+    }
+
+    if (!requestInfo->lastFlush.isValid()) {
+        // the headers are received at this point
+        curl_off_t contentLength;
+        if (curl_easy_getinfo(requestInfo->curlEasyHandle, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &contentLength) == CURLE_OK && contentLength > 0)
+            requestInfo->contentLength = contentLength;
+        requestInfo->lastFlush.start();
+    }
+    if (requestInfo->body.isEmpty())
+        reserveBody(requestInfo);
+    requestInfo->body.append((char*)ptr, size*count);
+
+    if (requestInfo->body.size() >= kBodyFlushBytes || requestInfo->lastFlush.elapsed() >= kBodyFlushIntervalMs)
+        flushBody(requestInfo);
+    return size*count;
+}
+
+size_t CurlNetworkManagerImpl::headerCallback(char *buffer, size_t size, size_t count, void *ri)
+{
+    RequestInfo *requestInfo = static_cast<RequestInfo *>(ri);
+    const QByteArray line = QByteArray(buffer, size*count).trimmed();
+    // the status line of the next response (a redirect or 100 Continue was before)
+    if (line.startsWith("HTTP/")) {
+        requestInfo->responseHeaders.clear();
+    } else {
+        const int ind = line.indexOf(':');
+        if (ind > 0)
+            requestInfo->responseHeaders[line.left(ind).trimmed().toLower()] = line.mid(ind + 1).trimmed();
+    }
     return size*count;
 }
 
 int CurlNetworkManagerImpl::progressCallback(void *ri,   curl_off_t dltotal,   curl_off_t dlnow,   curl_off_t ultotal,   curl_off_t ulnow)
 {
     RequestInfo *requestInfo = static_cast<RequestInfo *>(ri);
-    if (dltotal > 0)
-        emit g_this->requestProgress(requestInfo->id, dlnow, dltotal);
+    // the coalesced mode signals the progress along with the body in flushBody()
+    if (dltotal > 0 && !requestInfo->isCoalesceBody)
+        emit requestInfo->owner->requestProgress(requestInfo->id, dlnow, dltotal);
     return 0;
 }
 
+void CurlNetworkManagerImpl::flushBody(RequestInfo *requestInfo)
+{
+    requestInfo->lastFlush.restart();
+    if (requestInfo->body.isEmpty())
+        return;
+
+    requestInfo->bodyDelivered += requestInfo->body.size();
+    // the receiver gets the buffer itself, the next data goes to a new buffer
+    emit requestInfo->owner->requestNewData(requestInfo->id, std::exchange(requestInfo->body, QByteArray()));
+
+    curl_off_t dltotal, dlnow;
+    if (curl_easy_getinfo(requestInfo->curlEasyHandle, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &dltotal) == CURLE_OK && dltotal > 0 &&
+        curl_easy_getinfo(requestInfo->curlEasyHandle, CURLINFO_SIZE_DOWNLOAD_T, &dlnow) == CURLE_OK) {
+        emit requestInfo->owner->requestProgress(requestInfo->id, dlnow, dltotal);
+    }
+}
+
+void CurlNetworkManagerImpl::reserveBody(RequestInfo *requestInfo)
+{
+    // the content length is the compressed size if the encoding is used, so it's only a hint, the buffer grows if needed
+    qint64 capacity = kBodyInitialCapacity;
+    if (requestInfo->contentLength > 0)
+        capacity = requestInfo->contentLength - requestInfo->bodyDelivered;
+    // a bit more than the flush size, since the last chunk is appended before the size check
+    capacity = qBound<qint64>(CURL_MAX_WRITE_SIZE, capacity, kBodyFlushBytes + CURL_MAX_WRITE_SIZE);
+    requestInfo->body.reserve(capacity);
+}
+
+void CurlNetworkManagerImpl::shareLockCallback(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr)
+{
+    Q_UNUSED(handle);
+    Q_UNUSED(access);
+    CurlNetworkManagerImpl *this_ = static_cast<CurlNetworkManagerImpl *>(userptr);
+    this_->shareMutexes_[data].lock();
+}
+
+void CurlNetworkManagerImpl::shareUnlockCallback(CURL *handle, curl_lock_data data, void *userptr)
+{
+    Q_UNUSED(handle);
+    CurlNetworkManagerImpl *this_ = static_cast<CurlNetworkManagerImpl *>(userptr);
+    this_->shareMutexes_[data].unlock();
+}
+
 bool CurlNetworkManagerImpl::setupBasicOptions(RequestInfo *requestInfo, const NetworkRequest &request, const QStringList &ips, const types::ProxySettings &proxySettings)
 {
+    requestInfo->owner = this;
+    requestInfo->isCoalesceBody = request.isCoalesceBody();
+
     if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_WRITEFUNCTION, writeDataCallback) != CURLE_OK) return false;
     if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_WRITEDATA, requestInfo) != CURLE_OK) return false;
+    if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_HEADERFUNCTION, headerCallback) != CURLE_OK) return false;
+    if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_HEADERDATA, requestInfo) != CURLE_OK) return false;
     if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_ACCEPT_ENCODING, "") != CURLE_OK) return false;
     if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_URL, request.url().toString().toStdString().c_str()) != CURLE_OK) return false;
 
-    if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_FRESH_CONNECT, 1) != CURLE_OK) return false;
+    if (!setupConnectionReuse(requestInfo, request, ips)) return false;
     if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_CONNECTTIMEOUT_MS , request.timeout()) != CURLE_OK) return false;
 
     if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_XFERINFOFUNCTION, progressCallback) != CURLE_OK) return false;
@@ -79,6 +203,14 @@ bool CurlNetworkManagerImpl::setupBasicOptions(RequestInfo *requestInfo, const N
     struct curl_slist *list = NULL;
     list = curl_slist_append(list, request.contentTypeHeader().toStdString().c_str());
     if (list == NULL) return false;
+    for (const auto &header : request.rawHeaders()) {
+        struct curl_slist *newList = curl_slist_append(list, (header.first + ": " + header.second).constData());
+        if (newList == NULL) {
+            curl_slist_free_all(list);
+            return false;
+        }
+        list = newList;
+    }
     requestInfo->curlLists << list;
     if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_HTTPHEADER, list) != CURLE_OK) return false;
 
@@ -101,14 +233,9 @@ CURLcode CurlNetworkManagerImpl::sslctx_function(CURL *curl, void *sslctx, void
 {
     Q_UNUSED(curl);
 
-    X509_STORE *store = X509_STORE_new();
-    SSL_CTX_set_cert_store((SSL_CTX *)sslctx, store);
-
+    // the cached store is shared by all handshakes, SSL_CTX takes ownership of the returned reference
     CertManager *certManager = static_cast<CertManager *>(parm);
-    for (int i = 0; i < certManager->count(); ++i)
-    {
-        X509_STORE_add_cert(store, certManager->getCert(i));
-    }
+    SSL_CTX_set_cert_store((SSL_CTX *)sslctx, certManager->trustStore());
 
     return CURLE_OK;
 }
@@ -122,10 +249,7 @@ quint64 CurlNetworkManagerImpl::get(const NetworkRequest &request, const QString
 
     if (requestInfo->curlEasyHandle)  {
         if (setupBasicOptions(requestInfo, request, ips, proxySettings)) {
-            QMutexLocker locker(&mutex_);
-            activeRequests_[id] = requestInfo;
-            waitCondition_.wakeAll();
-            curl_multi_wakeup(multiHandle_);
+            submitRequest(requestInfo);
             return id;
         }
     }
@@ -133,7 +257,7 @@ quint64 CurlNetworkManagerImpl::get(const NetworkRequest &request, const QString
     // here if something failed
     WS_ASSERT(false);
     delete requestInfo;
-    emit requestFinished(id, CURLE_FAILED_INIT, 0);       // this signal must be queued
+    emit requestFinished(id, CURLE_FAILED_INIT, RequestTimings());       // this signal must be queued
     return id;
 }
 
@@ -149,10 +273,7 @@ quint64 CurlNetworkManagerImpl::post(const NetworkRequest &request, const QByteA
             // set additional post request options
             if ((curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_POSTFIELDSIZE, data.size()) == CURLE_OK) &&
                (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_COPYPOSTFIELDS, data.data()) == CURLE_OK)) {
-                QMutexLocker locker(&mutex_);
-                activeRequests_[id] = requestInfo;
-                waitCondition_.wakeAll();
-                curl_multi_wakeup(multiHandle_);
+                submitRequest(requestInfo);
                 return id;
             }
         }
@@ -160,7 +281,7 @@ quint64 CurlNetworkManagerImpl::post(const NetworkRequest &request, const QByteA
     // here if something failed
     WS_ASSERT(false);
     delete requestInfo;
-    emit requestFinished(id, CURLE_FAILED_INIT, 0);       // this signal must be queued
+    emit requestFinished(id, CURLE_FAILED_INIT, RequestTimings());       // this signal must be queued
     return id;
 }
 
@@ -177,10 +298,7 @@ quint64 CurlNetworkManagerImpl::put(const NetworkRequest &request, const QByteAr
             if ((curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_POSTFIELDSIZE, data.size()) == CURLE_OK) &&
                (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_COPYPOSTFIELDS, data.data()) == CURLE_OK) &&
                (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_CUSTOMREQUEST, "PUT") == CURLE_OK)) {
-                QMutexLocker locker(&mutex_);
-                activeRequests_[id] = requestInfo;
-                waitCondition_.wakeAll();
-                curl_multi_wakeup(multiHandle_);
+                submitRequest(requestInfo);
                 return id;
             }
         }
@@ -188,7 +306,7 @@ quint64 CurlNetworkManagerImpl::put(const NetworkRequest &request, const QByteAr
     // here if something failed
     WS_ASSERT(false);
     delete requestInfo;
-    emit requestFinished(id, CURLE_FAILED_INIT, 0);       // this signal must be queued
+    emit requestFinished(id, CURLE_FAILED_INIT, RequestTimings());       // this signal must be queued
     return id;
 }
 
@@ -203,10 +321,7 @@ quint64 CurlNetworkManagerImpl::deleteResource(const NetworkRequest &request, co
         if (setupBasicOptions(requestInfo, request, ips, proxySettings)) {
             // set additional delete request options
             if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_CUSTOMREQUEST, "DELETE") == CURLE_OK) {
-                QMutexLocker locker(&mutex_);
-                activeRequests_[id] = requestInfo;
-                waitCondition_.wakeAll();
-                curl_multi_wakeup(multiHandle_);
+                submitRequest(requestInfo);
                 return id;
             }
         }
@@ -214,19 +329,45 @@ quint64 CurlNetworkManagerImpl::deleteResource(const NetworkRequest &request, co
     // here if something failed
     WS_ASSERT(false);
     delete requestInfo;
-    emit requestFinished(id, CURLE_FAILED_INIT, 0);       // this signal must be queued
+    emit requestFinished(id, CURLE_FAILED_INIT, RequestTimings());       // this signal must be queued
     return id;
 }
 
 void CurlNetworkManagerImpl::abort(quint64 replyId)
 {
     QMutexLocker locker(&mutex_);
+    if (bEventDrivenLoop_) {
+#ifdef Q_OS_LINUX
+        pendingAborts_ << replyId;
+        locker.unlock();
+        wakeupEventDrivenLoop();
+#endif
+        return;
+    }
+
     auto it = activeRequests_.find(replyId);
     if (it != activeRequests_.end()) {
         it.value()->isNeedRemoveFromMultiHandle = true;
     }
 }
 
+void CurlNetworkManagerImpl::submitRequest(RequestInfo *requestInfo)
+{
+    QMutexLocker locker(&mutex_);
+    if (bEventDrivenLoop_) {
+#ifdef Q_OS_LINUX
+        pendingRequests_ << requestInfo;
+        locker.unlock();
+        wakeupEventDrivenLoop();
+#endif
+        return;
+    }
+
+    activeRequests_[requestInfo->id] = requestInfo;
+    waitCondition_.wakeAll();
+    curl_multi_wakeup(multiHandle_);
+}
+
 void CurlNetworkManagerImpl::run()
 {
     BIND_CRASH_HANDLER_FOR_THREAD();
@@ -235,6 +376,24 @@ void CurlNetworkManagerImpl::run()
     logFile_ = fopen(logFilePath_.toStdString().c_str(), "w+");
 #endif
 
+#ifdef Q_OS_LINUX
+    if (bEventDrivenLoop_)
+        runEventDrivenLoop();
+    else
+        runPollLoop();
+#else
+    runPollLoop();
+#endif
+
+    deleteAllRequests();
+
+#ifdef MAKE_CURL_LOG_FILE
+    fclose(logFile_);
+#endif
+}
+
+void CurlNetworkManagerImpl::runPollLoop()
+{
     while (!bNeedFinish_) {
 
         {
@@ -271,63 +430,320 @@ void CurlNetworkManagerImpl::run()
 
             int still_running;
             curl_multi_perform(multiHandle_, &still_running);
-            // check finished requests
-            struct CURLMsg *curlMsg = nullptr;
-            do {
-              int msgq = 0;
-              curlMsg = curl_multi_info_read(multiHandle_, &msgq);
-              if (curlMsg && (curlMsg->msg == CURLMSG_DONE)) {
-                  CURL *curlEasyHandle = curlMsg->easy_handle;
-                  quint64 *pointerId;
-                  curl_easy_getinfo(curlEasyHandle, CURLINFO_PRIVATE, &pointerId);
-                  WS_ASSERT(pointerId != nullptr);
-
-                  curl_off_t totalTime;
-                  curl_easy_getinfo(curlEasyHandle, CURLINFO_TOTAL_TIME_T, &totalTime);
-
-                  quint64 id = *pointerId;
-                  auto it = activeRequests_.find(id);
-                  WS_ASSERT(it != activeRequests_.end());
-                  WS_ASSERT(it.value()->curlEasyHandle == curlEasyHandle);
-                  emit requestFinished(id, curlMsg->data.result, totalTime / 1000); // convert total time to ms
-
-                  //remove request from activeRequests
-                  curl_multi_remove_handle(multiHandle_, curlEasyHandle);
-                  delete it.value();
-                  activeRequests_.remove(id);
-              }
-            } while(curlMsg);
+            processFinishedRequests();
         }
 
         // wait for activity or timeout
         int numfds;
         curl_multi_poll(multiHandle_, NULL, 0, 1000, &numfds);
     }
+}
 
+void CurlNetworkManagerImpl::processFinishedRequests()
+{
+    struct CURLMsg *curlMsg = nullptr;
+    do {
+      int msgq = 0;
+      curlMsg = curl_multi_info_read(multiHandle_, &msgq);
+      if (curlMsg && (curlMsg->msg == CURLMSG_DONE)) {
+          CURL *curlEasyHandle = curlMsg->easy_handle;
+          quint64 *pointerId;
+          curl_easy_getinfo(curlEasyHandle, CURLINFO_PRIVATE, &pointerId);
+          WS_ASSERT(pointerId != nullptr);
+
+          const RequestTimings timings = getTimings(curlEasyHandle);
+
+          quint64 id = *pointerId;
+          auto it = activeRequests_.find(id);
+          WS_ASSERT(it != activeRequests_.end());
+          WS_ASSERT(it.value()->curlEasyHandle == curlEasyHandle);
+          if (it.value()->isCoalesceBody)
+              flushBody(it.value());
+          long httpCode = 0;
+          if (curl_easy_getinfo(curlEasyHandle, CURLINFO_RESPONSE_CODE, &httpCode) == CURLE_OK && httpCode != 0)
+              emit requestResponseHeaders(id, static_cast<int>(httpCode), it.value()->responseHeaders);
+          emit requestFinished(id, curlMsg->data.result, timings);
+          // the connection stays in the pool from now on
+          if (!it.value()->pinnedHostPort.isEmpty())
+              updatePinnedIps(it.value()->pinnedHostPort, it.value()->pinnedIps);
+
+          //remove request from activeRequests
+          curl_multi_remove_handle(multiHandle_, curlEasyHandle);
+          delete it.value();
+          activeRequests_.remove(id);
+      }
+    } while(curlMsg);
+}
+
+RequestTimings CurlNetworkManagerImpl::getTimings(CURL *curlEasyHandle)
+{
+    // the curl times are in microseconds since the start of the transfer, the phases not reached are 0
+    curl_off_t nameLookup = 0, connect = 0, appConnect = 0, preTransfer = 0, startTransfer = 0, total = 0;
+    curl_easy_getinfo(curlEasyHandle, CURLINFO_NAMELOOKUP_TIME_T, &nameLookup);
+    curl_easy_getinfo(curlEasyHandle, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(curlEasyHandle, CURLINFO_APPCONNECT_TIME_T, &appConnect);
+    curl_easy_getinfo(curlEasyHandle, CURLINFO_PRETRANSFER_TIME_T, &preTransfer);
+    curl_easy_getinfo(curlEasyHandle, CURLINFO_STARTTRANSFER_TIME_T, &startTransfer);
+    curl_easy_getinfo(curlEasyHandle, CURLINFO_TOTAL_TIME_T, &total);
+
+    RequestTimings timings;
+    if (connect > 0)
+        timings.connectUs = qMax<qint64>(0, connect - nameLookup);
+    if (appConnect > 0)
+        timings.tlsUs = qMax<qint64>(0, appConnect - connect);
+    if (startTransfer > 0)
+        timings.firstByteUs = qMax<qint64>(0, startTransfer - preTransfer);
+    timings.totalUs = total;
+    return timings;
+}
+
+void CurlNetworkManagerImpl::deleteAllRequests()
+{
     for (auto it = activeRequests_.begin(); it != activeRequests_.end(); ++it)
         delete it.value();
     activeRequests_.clear();
 
-#ifdef MAKE_CURL_LOG_FILE
-    fclose(logFile_);
-#endif
+    QMutexLocker locker(&mutex_);
+    for (RequestInfo *ri : qAsConst(pendingRequests_))
+        delete ri;
+    pendingRequests_.clear();
+    pendingAborts_.clear();
+}
+
+#ifdef Q_OS_LINUX
+bool CurlNetworkManagerImpl::initEventDrivenLoop()
+{
+    epoll_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_ == -1) {
+        qCDebug(LOG_BASIC) << "CurlNetworkManagerImpl: epoll_create1 failed:" << errno << ", using the poll loop";
+        return false;
+    }
+    wakeupFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakeupFd_ == -1) {
+        qCDebug(LOG_BASIC) << "CurlNetworkManagerImpl: eventfd failed:" << errno << ", using the poll loop";
+        close(epoll_);
+        epoll_ = -1;
+        return false;
+    }
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = wakeupFd_;
+    if (epoll_ctl(epoll_, EPOLL_CTL_ADD, wakeupFd_, &event) != 0) {
+        qCDebug(LOG_BASIC) << "CurlNetworkManagerImpl: epoll_ctl failed:" << errno << ", using the poll loop";
+        close(wakeupFd_);
+        close(epoll_);
+        wakeupFd_ = -1;
+        epoll_ = -1;
+        return false;
+    }
+
+    curl_multi_setopt(multiHandle_, CURLMOPT_SOCKETFUNCTION, socketCallback);
+    curl_multi_setopt(multiHandle_, CURLMOPT_SOCKETDATA, this);
+    curl_multi_setopt(multiHandle_, CURLMOPT_TIMERFUNCTION, timerCallback);
+    curl_multi_setopt(multiHandle_, CURLMOPT_TIMERDATA, this);
+    clock_.start();
+    return true;
+}
+
+void CurlNetworkManagerImpl::runEventDrivenLoop()
+{
+    const int kMaxEvents = 64;
+    epoll_event events[kMaxEvents];
+    int stillRunning;
+
+    while (!bNeedFinish_) {
+        processPendingRequests();
+
+        int timeout = -1;
+        if (timerDeadline_ != -1)
+            timeout = static_cast<int>(qBound<qint64>(0, timerDeadline_ - clock_.elapsed(), INT_MAX));
+
+        int count = epoll_wait(epoll_, events, kMaxEvents, timeout);
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            qCDebug(LOG_BASIC) << "CurlNetworkManagerImpl: epoll_wait failed:" << errno;
+            break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            if (events[i].data.fd == wakeupFd_) {
+                quint64 value;
+                while (read(wakeupFd_, &value, sizeof(value)) > 0) {}
+                continue;
+            }
+            int flags = 0;
+            if (events[i].events & EPOLLIN)
+                flags |= CURL_CSELECT_IN;
+            if (events[i].events & EPOLLOUT)
+                flags |= CURL_CSELECT_OUT;
+            if (events[i].events & (EPOLLERR | EPOLLHUP))
+                flags |= CURL_CSELECT_ERR;
+            curl_multi_socket_action(multiHandle_, events[i].data.fd, flags, &stillRunning);
+        }
+
+        if (timerDeadline_ != -1 && clock_.elapsed() >= timerDeadline_) {
+            timerDeadline_ = -1;
+            curl_multi_socket_action(multiHandle_, CURL_SOCKET_TIMEOUT, 0, &stillRunning);
+        }
+
+        processFinishedRequests();
+    }
 }
 
+void CurlNetworkManagerImpl::wakeupEventDrivenLoop()
+{
+    quint64 value = 1;
+    // can only fail with EAGAIN if the counter overflows, the loop is woken up anyway in this case
+    ssize_t ret = write(wakeupFd_, &value, sizeof(value));
+    Q_UNUSED(ret);
+}
+
+void CurlNetworkManagerImpl::processPendingRequests()
+{
+    QVector<RequestInfo *> requests;
+    QVector<quint64> aborts;
+    {
+        QMutexLocker locker(&mutex_);
+        requests.swap(pendingRequests_);
+        aborts.swap(pendingAborts_);
+    }
+
+    // curl_multi_add_handle() only sets a zero timeout, the transfers are started on the next curl_multi_socket_action()
+    for (RequestInfo *ri : qAsConst(requests)) {
+        activeRequests_[ri->id] = ri;
+        curl_multi_add_handle(multiHandle_, ri->curlEasyHandle);
+        ri->isAddedToMultiHandle = true;
+    }
+
+    // the request may be finished already, in this case the abort is ignored
+    for (quint64 id : qAsConst(aborts)) {
+        RequestInfo *ri = activeRequests_.take(id);
+        if (ri) {
+            curl_multi_remove_handle(multiHandle_, ri->curlEasyHandle);
+            delete ri;
+        }
+    }
+}
+
+int CurlNetworkManagerImpl::socketCallback(CURL *easy, curl_socket_t s, int what, void *userp, void *socketp)
+{
+    Q_UNUSED(easy);
+    CurlNetworkManagerImpl *this_ = static_cast<CurlNetworkManagerImpl *>(userp);
+
+    if (what == CURL_POLL_REMOVE) {
+        // the socket may be already closed, ignore the errors
+        epoll_ctl(this_->epoll_, EPOLL_CTL_DEL, s, nullptr);
+        return 0;
+    }
+
+    epoll_event event;
+    event.events = 0;
+    if (what & CURL_POLL_IN)
+        event.events |= EPOLLIN;
+    if (what & CURL_POLL_OUT)
+        event.events |= EPOLLOUT;
+    event.data.fd = s;
+
+    // socketp is set with curl_multi_assign() once the socket is added to the epoll set
+    if (socketp) {
+        if (epoll_ctl(this_->epoll_, EPOLL_CTL_MOD, s, &event) == 0 || errno != ENOENT)
+            return 0;
+    }
+    if (epoll_ctl(this_->epoll_, EPOLL_CTL_ADD, s, &event) != 0) {
+        if (errno != EEXIST || epoll_ctl(this_->epoll_, EPOLL_CTL_MOD, s, &event) != 0) {
+            qCDebug(LOG_BASIC) << "CurlNetworkManagerImpl: epoll_ctl failed:" << errno;
+            return -1;
+        }
+    }
+    curl_multi_assign(this_->multiHandle_, s, this_);
+    return 0;
+}
+
+int CurlNetworkManagerImpl::timerCallback(CURLM *multi, long timeoutMs, void *userp)
+{
+    Q_UNUSED(multi);
+    CurlNetworkManagerImpl *this_ = static_cast<CurlNetworkManagerImpl *>(userp);
+    // called from the curl thread only (inside curl_multi_add_handle/curl_multi_socket_action)
+    this_->timerDeadline_ = timeoutMs < 0 ? -1 : this_->clock_.elapsed() + timeoutMs;
+    return 0;
+}
+#endif
+
 bool CurlNetworkManagerImpl::setupResolveHosts(RequestInfo *requestInfo, const NetworkRequest &request, const QStringList &ips)
 {
     if (!ips.isEmpty()) {
+        // curl connects to the family of the first address and starts racing the other family after the Happy Eyeballs delay,
+        // so IPv6 goes first (RFC 8305). The IPv6 addresses must be in brackets.
+        QStringList ipv6, ipv4;
+        for (const QString &ip : ips) {
+            if (ip.contains(':'))
+                ipv6 << "[" + ip + "]";
+            else
+                ipv4 << ip;
+        }
         uint port = request.url().port(443);    //  use 443 by default
-        QString strResolve = request.url().host() + ":" + QString::number(port) + ":" + ips.join(",");
+        QString strResolve = request.url().host() + ":" + QString::number(port) + ":" + (ipv6 + ipv4).join(",");
         struct curl_slist *hosts = curl_slist_append(NULL, strResolve.toStdString().c_str());
         if (hosts == NULL) return false;
         requestInfo->curlLists << hosts;
         if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_RESOLVE, hosts) != CURLE_OK) return false;
+        if (!ipv6.isEmpty() && !ipv4.isEmpty()) {
+            if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_HAPPY_EYEBALLS_TIMEOUT_MS, (long)kHappyEyeballsDelayMs) != CURLE_OK) return false;
+        }
     } else {
         WS_ASSERT(false);
     }
     return true;
 }
 
+bool CurlNetworkManagerImpl::setupConnectionReuse(RequestInfo *requestInfo, const NetworkRequest &request, const QStringList &ips)
+{
+    // ECH requests must not share connections and TLS sessions with regular requests to the same host.
+    // Also don't keep connections to the IPs that will be removed from the firewall exceptions right after the request.
+    if (request.isUseFreshConnection() || !request.echConfig().isEmpty() || request.isRemoveFromWhitelistIpsAfterFinish()) {
+        if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_FRESH_CONNECT, 1) != CURLE_OK) return false;
+        if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_FORBID_REUSE, 1) != CURLE_OK) return false;
+    } else {
+        if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_SHARE, shareHandle_) != CURLE_OK) return false;
+        if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_MAXAGE_CONN, (long)(kConnectionMaxAgeMs / 1000)) != CURLE_OK) return false;
+        // the pool matches connections by host:port only, a connection opened to the IPs pinned by another request may not
+        // have been resolved or whitelisted for this one
+        QStringList sortedIps = ips;
+        sortedIps.sort();
+        requestInfo->pinnedHostPort = request.url().host() + ":" + QString::number(request.url().port(443));
+        requestInfo->pinnedIps = sortedIps.join(",");
+        if (updatePinnedIps(requestInfo->pinnedHostPort, requestInfo->pinnedIps)) {
+            if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_FRESH_CONNECT, 1) != CURLE_OK) return false;
+        }
+        if (request.isMultiplexed()) {
+            if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS) != CURLE_OK) return false;
+            if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_PIPEWAIT, 1L) != CURLE_OK) return false;
+        }
+    }
+    return true;
+}
+
+bool CurlNetworkManagerImpl::updatePinnedIps(const QString &hostPort, const QString &ips)
+{
+    QMutexLocker locker(&pinnedIpsMutex_);
+    const qint64 now = pinnedIpsClock_.elapsed();
+    QHash<QString, qint64> &lists = pinnedIps_[hostPort];
+    bool isOtherListPooled = false;
+    for (auto it = lists.begin(); it != lists.end(); /*++it*/) {
+        // curl has closed the idle connections of this list by now
+        if (now - it.value() > kConnectionMaxAgeMs) {
+            it = lists.erase(it);
+            continue;
+        }
+        if (it.key() != ips)
+            isOtherListPooled = true;
+        ++it;
+    }
+    lists[ips] = now;
+    return isOtherListPooled;
+}
+
 bool CurlNetworkManagerImpl::setupSslVerification(RequestInfo *requestInfo, const NetworkRequest &request)
 {
 #if defined(Q_OS_MAC) || defined (Q_OS_LINUX)
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <QElapsedTimer>
+#include <QMap>
 #include <QMutex>
 #include <QThread>
 #include <QWaitCondition>
@@ -9,6 +11,7 @@
 #include "certmanager.h"
 #include "curlinitcontroller.h"
 #include "networkrequest.h"
+#include "requesttimings.h"
 #include "types/proxysettings.h"
 
 
@@ -16,11 +19,16 @@
 //#define MAKE_CURL_LOG_FILE      1
 
 // Implementing queries with curl library. Don't use it directly, use NetworkAccessManager instead.
+// Two loop modes are supported:
+//  - poll (default): curl_multi_perform() for all the transfers, then curl_multi_poll() with a 1 sec timeout;
+//  - event driven (Linux only): curl_multi_socket_action() for the sockets reported ready by epoll, curl timeouts
+//    are tracked with the timer callback. Submissions and aborts are queued under a short lock and wake the loop via eventfd,
+//    the curl calls are made without holding the mutex. Falls back to the poll mode on other platforms.
 class CurlNetworkManagerImpl : public QThread
 {
     Q_OBJECT
 public:
-    explicit CurlNetworkManagerImpl(QObject *parent = 0);
+    explicit CurlNetworkManagerImpl(QObject *parent = 0, bool bEventDrivenLoop = false);
     virtual ~CurlNetworkManagerImpl();
 
     // return unique request id which can be used for the abort function and in processing slots
@@ -31,14 +39,18 @@ public:
 
     void abort(quint64 requestId);
 
+    bool isEventDrivenLoop() const { return bEventDrivenLoop_; }
+
 protected:
     virtual void run();
 
 signals:
     // this signal must be queued connected
-    void requestFinished(quint64 requestId, CURLcode curlErrorCode, qint64 elapsedMs);
+    void requestFinished(quint64 requestId, CURLcode curlErrorCode, const RequestTimings &timings);
     void requestProgress(quint64 requestId, qint64 bytesReceived, qint64 bytesTotal);
     void requestNewData(quint64 requestId, const QByteArray &newData);
+    // emitted right before requestFinished if the response was received, the header names are lower-cased
+    void requestResponseHeaders(quint64 requestId, int httpCode, const QMap<QByteArray, QByteArray> &headers);
 
 private:
     CurlInitController curlInit_;
@@ -47,6 +59,7 @@ private:
     QMutex mutex_;
     QWaitCondition waitCondition_;
     std::atomic<quint64> nextId_;
+    bool bEventDrivenLoop_;
 
 #if defined(Q_OS_MAC) || defined (Q_OS_LINUX)
     QString certPath_;
@@ -59,11 +72,26 @@ private:
 
     struct RequestInfo {
         quint64 id;
+        CurlNetworkManagerImpl *owner = nullptr;
         CURL *curlEasyHandle = nullptr;
         QVector<struct curl_slist *> curlLists;
         bool isAddedToMultiHandle = false;
         bool isNeedRemoveFromMultiHandle = false;
 
+        // the coalesced body delivery (NetworkRequest::isCoalesceBody()), accessed from the curl thread only
+        bool isCoalesceBody = false;
+        QByteArray body;            // received but not delivered yet
+        qint64 contentLength = -1;  // the size hint from the headers, -1 if unknown
+        qint64 bodyDelivered = 0;
+        QElapsedTimer lastFlush;
+
+        // the headers of the final response (of the last one if redirected), accessed from the curl thread only
+        QMap<QByteArray, QByteArray> responseHeaders;
+
+        // the host:port and the sorted pinned IPs of a request using the shared connection pool, empty otherwise
+        QString pinnedHostPort;
+        QString pinnedIps;
+
         // free all curl handles and data
         ~RequestInfo() {
             if (curlEasyHandle) {
@@ -79,15 +107,73 @@ private:
     };
 
     CURLM *multiHandle_;
+    // guarded by mutex_ in the poll mode, owned by the curl thread in the event driven mode
     QHash<quint64, RequestInfo *> activeRequests_;
 
+    // the event driven mode only, guarded by mutex_
+    QVector<RequestInfo *> pendingRequests_;
+    QVector<quint64> pendingAborts_;
+
+#ifdef Q_OS_LINUX
+    int epoll_;
+    int wakeupFd_;
+    // the curl thread only
+    QElapsedTimer clock_;
+    qint64 timerDeadline_;      // in clock_ ms, -1 if curl doesn't need the timeout
+#endif
+
+    // Connection pool and TLS sessions shared by all easy handles (except those requested a fresh connection).
+    // Easy handles are configured in the caller threads, so the access to the share handle is guarded by the mutexes.
+    CURLSH *shareHandle_;
+    QMutex shareMutexes_[CURL_LOCK_DATA_LAST];
+
+    // the pinned IP lists the pooled connections may have been opened with: host:port -> (sorted IPs -> last use in pinnedIpsClock_ ms)
+    QMutex pinnedIpsMutex_;
+    QElapsedTimer pinnedIpsClock_;
+    QHash<QString, QHash<QString, qint64> > pinnedIps_;
+
     bool setupBasicOptions(RequestInfo *requestInfo, const NetworkRequest &request, const QStringList &ips, const types::ProxySettings &proxySettings);
     bool setupResolveHosts(RequestInfo *requestInfo, const NetworkRequest &request, const QStringList &ips);
     bool setupSslVerification(RequestInfo *requestInfo, const NetworkRequest &request);
     bool setupProxy(RequestInfo *requestInfo, const types::ProxySettings &proxySettings);
+    bool setupConnectionReuse(RequestInfo *requestInfo, const NetworkRequest &request, const QStringList &ips);
+    // records the use of the pinned IPs, returns true if a pooled connection to the host may have been opened with other IPs
+    bool updatePinnedIps(const QString &hostPort, const QString &ips);
+
+    // the coalesced body is flushed when it reaches this size or when this time has passed since the previous flush
+    static constexpr int kBodyFlushBytes = 4 * 1024 * 1024;
+    static constexpr int kBodyFlushIntervalMs = 100;
+    // the initial buffer if the size of the body is unknown
+    static constexpr int kBodyInitialCapacity = 16 * 1024;
+    // the Connection Attempt Delay of RFC 8305
+    static constexpr int kHappyEyeballsDelayMs = 250;
+    // CURLOPT_MAXAGE_CONN of the pooled connections (the curl default)
+    static constexpr int kConnectionMaxAgeMs = 118 * 1000;
+
+    void submitRequest(RequestInfo *requestInfo);
+    // hands the accumulated body over to the receiver (moved, not copied) and signals the progress
+    static void flushBody(RequestInfo *requestInfo);
+    static void reserveBody(RequestInfo *requestInfo);
+    // emits requestFinished for the completed transfers and deletes them
+    void processFinishedRequests();
+    static RequestTimings getTimings(CURL *curlEasyHandle);
+    void runPollLoop();
+    void deleteAllRequests();
+
+#ifdef Q_OS_LINUX
+    bool initEventDrivenLoop();
+    void runEventDrivenLoop();
+    void wakeupEventDrivenLoop();
+    void processPendingRequests();
+    static int socketCallback(CURL *easy, curl_socket_t s, int what, void *userp, void *socketp);
+    static int timerCallback(CURLM *multi, long timeoutMs, void *userp);
+#endif
 
     static CURLcode sslctx_function(CURL *curl, void *sslctx, void *parm);
     static size_t writeDataCallback(void *ptr, size_t size, size_t count, void *ri);
+    static size_t headerCallback(char *buffer, size_t size, size_t count, void *ri);
     static int progressCallback(void *ri,   curl_off_t dltotal,   curl_off_t dlnow,   curl_off_t ultotal,   curl_off_t ulnow);
+    static void shareLockCallback(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr);
+    static void shareUnlockCallback(CURL *handle, curl_lock_data data, void *userptr);
 };
 
@@ -3,8 +3,9 @@
 
 CurlReply::CurlReply(CurlNetworkManager *manager, quint64 id)
     : QObject(manager),
-      manager_(manager),
-      id_(id)
+      httpCode_(0),
+      id_(id),
+      manager_(manager)
 {
 }
 
@@ -75,3 +76,33 @@ QString CurlReply::errorString() const
     return str;
 }
 
+RequestTimings CurlReply::timings() const
+{
+    QMutexLocker locker(&mutex_);
+    return timings_;
+}
+
+void CurlReply::setTimings(const RequestTimings &timings)
+{
+    QMutexLocker locker(&mutex_);
+    timings_ = timings;
+}
+
+int CurlReply::httpCode() const
+{
+    QMutexLocker locker(&mutex_);
+    return httpCode_;
+}
+
+QMap<QByteArray, QByteArray> CurlReply::responseHeaders() const
+{
+    QMutexLocker locker(&mutex_);
+    return responseHeaders_;
+}
+
+void CurlReply::setResponseHeaders(int httpCode, const QMap<QByteArray, QByteArray> &headers)
+{
+    QMutexLocker locker(&mutex_);
+    httpCode_ = httpCode;
+    responseHeaders_ = headers;
+}
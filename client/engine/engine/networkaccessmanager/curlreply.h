@@ -1,8 +1,10 @@
 #pragma once
 
+#include <QMap>
 #include <QObject>
 #include <QMutex>
 #include <curl/curl.h>
+#include "requesttimings.h"
 
 class CurlNetworkManager;
 
@@ -18,6 +20,11 @@ public:
     bool isSSLError() const;
     bool isSuccess() const;
     QString errorString() const;
+    // valid after finished
+    RequestTimings timings() const;
+    // valid after finished, 0 if no response was received
+    int httpCode() const;
+    QMap<QByteArray, QByteArray> responseHeaders() const;
 
 signals:
     void finished(qint64 elapsedMs);
@@ -32,11 +39,16 @@ private:
     void appendNewData(const QByteArray &newData);
     void setCurlErrorCode(CURLcode curlErrorCode);
     void setElapsedMs(qint64 elapsedMs);
+    void setTimings(const RequestTimings &timings);
+    void setResponseHeaders(int httpCode, const QMap<QByteArray, QByteArray> &headers);
     quint64 id() const;
 
     QByteArray data_;
     mutable QRecursiveMutex mutex_;
     CURLcode curlErrorCode_;
+    RequestTimings timings_;
+    int httpCode_;
+    QMap<QByteArray, QByteArray> responseHeaders_;
     quint64 id_;
     CurlNetworkManager *manager_;
 
@@ -1,12 +1,24 @@
 #include "dnscache.h"
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHostAddress>
+#include <QSaveFile>
 #include <QTimer>
+#include <algorithm>
+#include "utils/logger.h"
 #include "utils/ws_assert.h"
 #include "engine/dnsresolver/dnsrequest.h"
 
 DnsCache::DnsCache(QObject *parent, int cacheTimeoutMs /*= 60000*/, int reviewCacheIntervalMs /*= 1000*/) : QObject(parent),
-    cacheTimeoutMs_(cacheTimeoutMs)
+    cacheTimeoutMs_(cacheTimeoutMs),
+    isDnsOverHttps_(false),
+    isSnapshotDirty_(false)
 {
+    pendingTimer_.start();
     QTimer *timer = new QTimer(this);
     connect(timer, SIGNAL(timeout()), SLOT(onTimer()));
     timer->start(reviewCacheIntervalMs);
@@ -14,22 +26,88 @@ DnsCache::DnsCache(QObject *parent, int cacheTimeoutMs /*= 60000*/, int reviewCa
 
 DnsCache::~DnsCache()
 {
+    if (isSnapshotDirty_)
+        saveSnapshot();
 }
 
-void DnsCache::resolve(const QString &hostname, quint64 id, bool bypassCache /*= false*/, const QStringList &dnsServers /*= QStringList()*/, int timeoutMs /*= 5000*/)
+void DnsCache::setTtlPolicy(const TtlPolicy &ttlPolicy)
 {
+    WS_ASSERT(ttlPolicy.minTtlMs <= ttlPolicy.maxTtlMs);
+    ttlPolicy_ = ttlPolicy;
+}
+
+DnsCache::TtlPolicy DnsCache::ttlPolicy() const
+{
+    return ttlPolicy_;
+}
+
+void DnsCache::setDnsOverHttps(bool isDnsOverHttps)
+{
+    isDnsOverHttps_ = isDnsOverHttps;
+}
+
+void DnsCache::resolve(const QString &hostname, quint64 id, bool bypassCache /*= false*/, const QStringList &dnsServers /*= QStringList()*/, int timeoutMs /*= 5000*/,
+                       bool isDualStack /*= false*/)
+{
+    statistics_.lookups++;
+    const QString itemKey = cacheKey(hostname, isDualStack);
+    const QString key = pendingRequestKey(itemKey, dnsServers);
     if (!bypassCache) {
-        auto it = cache_.find(hostname);
+        auto it = cache_.find(itemKey);
         if (it != cache_.end()) {
-            emit resolved(true, it.value().ips, id, true, 0);
+            const qint64 curTime = QDateTime::currentMSecsSinceEpoch();
+            if (curTime < it.value().expiresAt) {
+                if (it.value().isNegative) {
+                    statistics_.negativeHits++;
+                    emit resolved(false, QStringList(), id, true, 0);
+                    return;
+                }
+                statistics_.cacheHits++;
+                const QStringList ips = it.value().ips;
+                if (it.value().isFromSnapshot) {
+                    // the answer from the previous run, make sure it's still valid
+                    statistics_.snapshotHits++;
+                    it.value().isFromSnapshot = false;
+                    startBackgroundRefresh(hostname, itemKey, key, dnsServers, timeoutMs, isDualStack);
+                }
+                emit resolved(true, ips, id, true, 0);
+                return;
+            }
+            if (curTime < it.value().staleUntil) {
+                // serve the expired answer right away and refresh it
+                statistics_.staleHits++;
+                if (it.value().isFromSnapshot) {
+                    statistics_.snapshotHits++;
+                    it.value().isFromSnapshot = false;
+                }
+                const QStringList ips = it.value().ips;
+                startBackgroundRefresh(hostname, itemKey, key, dnsServers, timeoutMs, isDualStack);
+                emit resolved(true, ips, id, true, 0);
+                return;
+            }
+        }
+    }
+
+    // join the resolution already in progress, it's fresh enough even for the bypassCache case
+    const qint64 now = pendingTimer_.elapsed();
+    const PendingCaller caller = { id, now, now + timeoutMs };
+    for (PendingRequest &pendingRequest : pendingRequests_[key]) {
+        // a resolution with a shorter timeout would fail this lookup too early
+        if (pendingRequest.deadline >= caller.deadline) {
+            statistics_.coalescedLookups++;
+            pendingRequest.callers << caller;
+            if (pendingRequest.deadline > caller.deadline)
+                QTimer::singleShot(timeoutMs, Qt::PreciseTimer, this, [this, key]() { failTimedOutCallers(key); });
             return;
         }
     }
 
-    DnsRequest *dnsRequest = new DnsRequest(this, hostname, dnsServers, timeoutMs);
-    dnsRequest->setProperty("requestId", id);
-    connect(dnsRequest, SIGNAL(finished()), SLOT(onDnsRequestFinished()));
-    dnsRequest->lookup();
+    startDnsRequest(hostname, itemKey, key, dnsServers, timeoutMs, isDualStack, { caller });
+}
+
+DnsCache::Statistics DnsCache::statistics() const
+{
+    return statistics_;
 }
 
 void DnsCache::onDnsRequestFinished()
@@ -37,18 +115,47 @@ void DnsCache::onDnsRequestFinished()
     DnsRequest *dnsRequest = qobject_cast<DnsRequest *>(sender());
     WS_ASSERT(dnsRequest != nullptr);
 
-    bool bOk;
-    quint64 requestId = dnsRequest->property("requestId").toULongLong(&bOk);
-    WS_ASSERT(bOk);
+    const QString key = dnsRequest->property("pendingRequestKey").toString();
+    const QString itemKey = dnsRequest->property("cacheKey").toString();
+    QVector<PendingCaller> callers;
+    auto it = pendingRequests_.find(key);
+    if (it != pendingRequests_.end()) {
+        for (int i = 0; i < it.value().size(); ++i) {
+            if (it.value()[i].dnsRequest == dnsRequest) {
+                callers = it.value().takeAt(i).callers;
+                break;
+            }
+        }
+        if (it.value().isEmpty())
+            pendingRequests_.erase(it);
+    }
 
+    const qint64 curTime = QDateTime::currentMSecsSinceEpoch();
     bool bSuccess = false;
     if (!dnsRequest->isError()) {
-        cache_[dnsRequest->hostname()].ips = dnsRequest->ips();
-        cache_[dnsRequest->hostname()].time = QDateTime::currentMSecsSinceEpoch();
+        CacheItem &item = cache_[itemKey];
+        item.ips = dnsRequest->ips();
+        item.isNegative = false;
+        item.expiresAt = curTime + positiveTtlMs(dnsRequest->ttl());
+        item.staleUntil = item.expiresAt + ttlPolicy_.staleTtlMs;
+        item.isFromSnapshot = false;
+        isSnapshotDirty_ = true;
         bSuccess = true;
+    } else if (dnsRequest->isNegativeAnswer() && ttlPolicy_.negativeTtlMs > 0) {
+        // a failed refresh doesn't replace the stale answer, it's served until the stale window ends
+        auto it = cache_.find(itemKey);
+        if (it == cache_.end() || it.value().isNegative || curTime >= it.value().staleUntil) {
+            CacheItem &item = cache_[itemKey];
+            item.ips.clear();
+            item.isNegative = true;
+            item.expiresAt = curTime + ttlPolicy_.negativeTtlMs;
+            item.staleUntil = item.expiresAt;
+            item.isFromSnapshot = false;
+        }
     }
 
-    emit resolved(bSuccess, dnsRequest->ips(), requestId, false, dnsRequest->elapsedMs());
+    for (const PendingCaller &caller : qAsConst(callers))
+        emit resolved(bSuccess, dnsRequest->ips(), caller.id, false, dnsRequest->elapsedMs());
     dnsRequest->deleteLater();
 }
 
@@ -58,9 +165,179 @@ void DnsCache::onTimer()
     auto it = cache_.begin();
     qint64 curTime = QDateTime::currentMSecsSinceEpoch();
     while (it != cache_.end())
-        if ((curTime - it.value().time) > cacheTimeoutMs_)
+        if (curTime >= it.value().staleUntil)
             it = cache_.erase(it);
         else
             ++it;
+
+    if (isSnapshotDirty_ && snapshotSaveTimer_.isValid() && snapshotSaveTimer_.elapsed() >= kSnapshotSaveIntervalMs)
+        saveSnapshot();
 }
 
+void DnsCache::startDnsRequest(const QString &hostname, const QString &itemKey, const QString &key, const QStringList &dnsServers, int timeoutMs, bool isDualStack,
+                               const QVector<PendingCaller> &callers)
+{
+    statistics_.resolverJobs++;
+    DnsRequest *dnsRequest = new DnsRequest(this, hostname, dnsServers, timeoutMs);
+    dnsRequest->setDualStack(isDualStack);
+    dnsRequest->setDnsOverHttps(isDnsOverHttps_);
+    dnsRequest->setProperty("pendingRequestKey", key);
+    dnsRequest->setProperty("cacheKey", itemKey);
+    connect(dnsRequest, SIGNAL(finished()), SLOT(onDnsRequestFinished()));
+    pendingRequests_[key] << PendingRequest{ dnsRequest, pendingTimer_.elapsed() + timeoutMs, callers };
+    dnsRequest->lookup();
+}
+
+void DnsCache::failTimedOutCallers(const QString &key)
+{
+    auto it = pendingRequests_.find(key);
+    if (it == pendingRequests_.end())
+        return;
+
+    // the resolution goes on for the other callers
+    const qint64 now = pendingTimer_.elapsed();
+    QVector<PendingCaller> timedOutCallers;
+    for (PendingRequest &pendingRequest : it.value()) {
+        auto callerIt = pendingRequest.callers.begin();
+        while (callerIt != pendingRequest.callers.end()) {
+            if (now >= callerIt->deadline) {
+                timedOutCallers << *callerIt;
+                callerIt = pendingRequest.callers.erase(callerIt);
+            } else {
+                ++callerIt;
+            }
+        }
+    }
+    for (const PendingCaller &caller : qAsConst(timedOutCallers))
+        emit resolved(false, QStringList(), caller.id, false, now - caller.startTime);
+}
+
+void DnsCache::startBackgroundRefresh(const QString &hostname, const QString &itemKey, const QString &key, const QStringList &dnsServers, int timeoutMs,
+                                      bool isDualStack)
+{
+    // unless the resolution is already in progress, nobody waits for it
+    if (pendingRequests_.contains(key))
+        return;
+    statistics_.backgroundRefreshes++;
+    startDnsRequest(hostname, itemKey, key, dnsServers, timeoutMs, isDualStack, QVector<PendingCaller>());
+}
+
+qint64 DnsCache::positiveTtlMs(quint32 ttl) const
+{
+    if (!ttlPolicy_.isHonorTtl)
+        return cacheTimeoutMs_;
+    return qBound((qint64)ttlPolicy_.minTtlMs, (qint64)ttl * 1000, (qint64)ttlPolicy_.maxTtlMs);
+}
+
+QString DnsCache::cacheKey(const QString &hostname, bool isDualStack)
+{
+    return isDualStack ? hostname + "|dualstack" : hostname;
+}
+
+QString DnsCache::pendingRequestKey(const QString &itemKey, const QStringList &dnsServers)
+{
+    return itemKey + "|" + dnsServers.join(",");
+}
+
+void DnsCache::setSnapshotFile(const QString &filePath)
+{
+    snapshotFilePath_ = filePath;
+    snapshotSaveTimer_.start();
+    loadSnapshot();
+}
+
+bool DnsCache::saveSnapshot()
+{
+    if (snapshotFilePath_.isEmpty())
+        return false;
+    isSnapshotDirty_ = false;
+    snapshotSaveTimer_.start();
+
+    // the most recent positive answers
+    const qint64 curTime = QDateTime::currentMSecsSinceEpoch();
+    QVector<QMap<QString, CacheItem>::const_iterator> items;
+    for (auto it = cache_.cbegin(); it != cache_.cend(); ++it) {
+        if (!it.value().isNegative && curTime < it.value().staleUntil)
+            items << it;
+    }
+    std::sort(items.begin(), items.end(), [](const auto &a, const auto &b) { return a.value().expiresAt > b.value().expiresAt; });
+    if (items.size() > kMaxSnapshotEntries)
+        items.resize(kMaxSnapshotEntries);
+
+    QByteArray payload;
+    {
+        QDataStream ds(&payload, QIODevice::WriteOnly);
+        ds << static_cast<qint32>(items.size());
+        for (const auto &it : qAsConst(items))
+            ds << it.key() << it.value().ips << it.value().expiresAt << it.value().staleUntil;
+    }
+
+    QDir().mkpath(QFileInfo(snapshotFilePath_).absolutePath());
+    QSaveFile file(snapshotFilePath_);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    QDataStream ds(&file);
+    ds << magic_ << versionForSerialization_ << payload << QCryptographicHash::hash(payload, QCryptographicHash::Sha256);
+    if (!file.commit()) {
+        qCDebug(LOG_NETWORK) << "Can't save the DNS cache snapshot:" << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+void DnsCache::loadSnapshot()
+{
+    QFile file(snapshotFilePath_);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream ds(&file);
+    quint32 magic, version;
+    ds >> magic;
+    if (magic != magic_)
+        return;
+    ds >> version;
+    if (version > versionForSerialization_)
+        return;
+    QByteArray payload, hash;
+    ds >> payload >> hash;
+    if (ds.status() != QDataStream::Ok || hash != QCryptographicHash::hash(payload, QCryptographicHash::Sha256)) {
+        qCDebug(LOG_NETWORK) << "DNS cache snapshot is corrupted, ignored";
+        return;
+    }
+
+    // the items are validated as well, the file could have been written by a buggy version or the clock could have been changed
+    const qint64 curTime = QDateTime::currentMSecsSinceEpoch();
+    const qint64 maxTtlMs = qMax((qint64)cacheTimeoutMs_, (qint64)ttlPolicy_.maxTtlMs) + ttlPolicy_.staleTtlMs;
+    QMap<QString, CacheItem> items;
+    QDataStream payloadStream(payload);
+    qint32 count;
+    payloadStream >> count;
+    if (count < 0 || count > kMaxSnapshotEntries) {
+        qCDebug(LOG_NETWORK) << "DNS cache snapshot is corrupted, ignored";
+        return;
+    }
+    for (qint32 i = 0; i < count; ++i) {
+        QString itemKey;
+        CacheItem item;
+        payloadStream >> itemKey >> item.ips >> item.expiresAt >> item.staleUntil;
+        if (payloadStream.status() != QDataStream::Ok || itemKey.isEmpty() || item.ips.isEmpty() || item.staleUntil < item.expiresAt ||
+            std::any_of(item.ips.cbegin(), item.ips.cend(), [](const QString &ip) { return QHostAddress(ip).isNull(); })) {
+            qCDebug(LOG_NETWORK) << "DNS cache snapshot is corrupted, ignored";
+            return;
+        }
+        if (curTime >= item.staleUntil)
+            continue;
+        item.expiresAt = qMin(item.expiresAt, curTime + maxTtlMs);
+        item.staleUntil = qMin(item.staleUntil, curTime + maxTtlMs);
+        item.isFromSnapshot = true;
+        items[itemKey] = item;
+    }
+
+    // the fresh answers of this run take precedence
+    for (auto it = items.cbegin(); it != items.cend(); ++it) {
+        if (!cache_.contains(it.key()))
+            cache_[it.key()] = it.value();
+    }
+    qCDebug(LOG_NETWORK) << "DNS cache snapshot loaded:" << items.size() << "entries";
+}
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <QElapsedTimer>
+#include <QHash>
 #include <QMap>
 #include <QObject>
+#include <QVector>
+
+class DnsRequest;
 
 class DnsCache : public QObject
 {
@@ -12,7 +17,47 @@ public:
     explicit DnsCache(QObject *parent, int cacheTimeoutMs = 60000, int reviewCacheIntervalMs = 1000);
     virtual ~DnsCache();
 
-    void resolve(const QString &hostname, quint64 id, bool bypassCache = false, const QStringList &dnsServers = QStringList(), int timeoutMs = 5000);
+    // How long the answers live in the cache. By default (isHonorTtl = false) every successful answer lives cacheTimeoutMs
+    // and the failures are not cached.
+    struct TtlPolicy
+    {
+        bool isHonorTtl = false;    // use the TTL of the records clamped to [minTtlMs, maxTtlMs], an unknown TTL (0) gets minTtlMs
+        int minTtlMs = 30000;
+        int maxTtlMs = 3600000;
+        int negativeTtlMs = 0;      // if not 0, NXDOMAIN, no records, SERVFAIL and the timeouts are cached for this time
+        int staleTtlMs = 0;         // if not 0, an expired answer is still returned for this time while it's refreshed in the background
+    };
+    void setTtlPolicy(const TtlPolicy &ttlPolicy);
+    TtlPolicy ttlPolicy() const;
+
+    // resolve with DnsResolver_doh if it's enabled (see DnsRequest::setDnsOverHttps())
+    void setDnsOverHttps(bool isDnsOverHttps);
+
+    // Optional on-disk snapshot of the successful answers, so the lookups after a restart don't wait for the resolver.
+    // The unexpired entries are loaded from the file right away, each of them is returned on its first use and revalidated
+    // in the background. The snapshot is saved periodically and in the destructor. A corrupted file is ignored.
+    void setSnapshotFile(const QString &filePath);
+    bool saveSnapshot();
+
+    // Concurrent lookups of the same hostname (with the same DNS servers) share one in-flight resolution (single-flight),
+    // all callers receive its result via the resolved signal with their own id. A lookup joins a resolution that lasts at least
+    // as long as its own timeout and fails on its own timeout if the resolution takes longer.
+    // The dual-stack (A + AAAA) answers are cached separately from the IPv4-only ones.
+    void resolve(const QString &hostname, quint64 id, bool bypassCache = false, const QStringList &dnsServers = QStringList(), int timeoutMs = 5000,
+                 bool isDualStack = false);
+
+    struct Statistics
+    {
+        quint64 lookups = 0;            // total calls of resolve()
+        quint64 cacheHits = 0;          // answered from the cache
+        quint64 resolverJobs = 0;       // actual DnsRequest lookups started
+        quint64 coalescedLookups = 0;   // joined an already in-flight resolution
+        quint64 negativeHits = 0;       // answered with a failure from the cache
+        quint64 staleHits = 0;          // answered with an expired answer from the cache
+        quint64 backgroundRefreshes = 0;// lookups started to refresh the stale and the snapshot answers
+        quint64 snapshotHits = 0;       // answered from the entries loaded from the snapshot
+    };
+    Statistics statistics() const;
 
 signals:
     void resolved(bool success, const QStringList &ips, quint64 id, bool bFromCache, int timeMs);
@@ -24,20 +69,58 @@ private slots:
 private:
     struct CacheItem
     {
-        qint64 time;
+        qint64 expiresAt;
+        qint64 staleUntil;      // == expiresAt if stale answers are not allowed
         QStringList ips;
+        bool isNegative;
+        bool isFromSnapshot;    // loaded from the snapshot and not revalidated yet
 
-        CacheItem() : time(0) {}
+        CacheItem() : expiresAt(0), staleUntil(0), isNegative(false), isFromSnapshot(false) {}
     };
 
-    struct PendingRequest
+    struct PendingCaller
     {
-        QString hostname;
         quint64 id;
+        qint64 startTime;       // in pendingTimer_ ms
+        qint64 deadline;
+    };
+
+    struct PendingRequest
+    {
+        DnsRequest *dnsRequest;
+        qint64 deadline;        // in pendingTimer_ ms
+        QVector<PendingCaller> callers;     // empty for the background refresh, if nobody joined it
     };
 
+    // the in-flight resolutions, the key is made of the hostname and the DNS servers
+    QHash<QString, QVector<PendingRequest> > pendingRequests_;
+    QElapsedTimer pendingTimer_;
+
     QMap<QString, CacheItem> cache_;
     int cacheTimeoutMs_;
+    TtlPolicy ttlPolicy_;
+    bool isDnsOverHttps_;
+    Statistics statistics_;
+
+    QString snapshotFilePath_;
+    bool isSnapshotDirty_;
+    QElapsedTimer snapshotSaveTimer_;
+
+    static constexpr int kSnapshotSaveIntervalMs = 60000;
+    static constexpr int kMaxSnapshotEntries = 512;
+    // for serialization
+    static constexpr quint32 magic_ = 0x7D2A91C4;
+    static constexpr quint32 versionForSerialization_ = 1;  // should increment the version if the data format is changed
+
+    void startDnsRequest(const QString &hostname, const QString &itemKey, const QString &key, const QStringList &dnsServers, int timeoutMs, bool isDualStack,
+                         const QVector<PendingCaller> &callers);
+    void failTimedOutCallers(const QString &key);
+    void startBackgroundRefresh(const QString &hostname, const QString &itemKey, const QString &key, const QStringList &dnsServers, int timeoutMs,
+                                bool isDualStack);
+    qint64 positiveTtlMs(quint32 ttl) const;
+    void loadSnapshot();
+    static QString cacheKey(const QString &hostname, bool isDualStack);
+    static QString pendingRequestKey(const QString &itemKey, const QStringList &dnsServers);
 
 };
 
@@ -1,8 +1,12 @@
 #include "networkaccessmanager.h"
 
 #include <QSslSocket>
+#include <QStandardPaths>
 #include <QThread>
 
+#include "engine/dnsresolver/dnsresolver_doh.h"
+#include "utils/extraconfig.h"
+#include "utils/logger.h"
 #include "utils/ws_assert.h"
 
 namespace {
@@ -11,7 +15,9 @@ std::atomic<quint64> g_countInstances = 0;
 
 std::atomic<quint64> NetworkAccessManager::nextId_(0);
 
-NetworkAccessManager::NetworkAccessManager(QObject *parent) : QObject(parent)
+NetworkAccessManager::NetworkAccessManager(QObject *parent) : QObject(parent),
+    isLogTimings_(ExtraConfig::instance().getLogRequestTimings()),
+    isHappyEyeballs_(ExtraConfig::instance().getHappyEyeballs())
 {
     //WS_ASSERT(g_countInstances == 0);       // this instance of the class is supposed to be a single instance for the entire program
     g_countInstances++;
@@ -23,63 +29,81 @@ NetworkAccessManager::NetworkAccessManager(QObject *parent) : QObject(parent)
 
     curlNetworkManager_ = new CurlNetworkManager(this);
     dnsCache_ = new DnsCache(this);
+    if (ExtraConfig::instance().getDnsHonorTtl()) {
+        DnsCache::TtlPolicy ttlPolicy;
+        ttlPolicy.isHonorTtl = true;
+        ttlPolicy.minTtlMs = 30 * 1000;
+        ttlPolicy.maxTtlMs = 30 * 60 * 1000;
+        ttlPolicy.negativeTtlMs = 5 * 1000;
+        ttlPolicy.staleTtlMs = 60 * 1000;
+        dnsCache_->setTtlPolicy(ttlPolicy);
+    }
+    if (ExtraConfig::instance().getDnsCacheSnapshot())
+        dnsCache_->setSnapshotFile(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/dnscache.dat");
     connect(dnsCache_, &DnsCache::resolved,  this, &NetworkAccessManager::onResolved);
 
     whitelistIpsManager_ = new WhitelistIpsManager(this);
     connect(whitelistIpsManager_, &WhitelistIpsManager::whitelistIpsChanged, [this](const QSet<QString> &ips) {
         emit whitelistIpsChanged(ips);
     });
+
+    const QString dohUpstreams = ExtraConfig::instance().getDnsOverHttpsUpstreams();
+    if (!dohUpstreams.isEmpty()) {
+        // queued, so the owner has connected whitelistIpsChanged by then, the queued requests are handled after it
+        QMetaObject::invokeMethod(this, [this, dohUpstreams]() {
+            setDnsOverHttpsUpstreams(DnsResolver_doh::parseUpstreams(dohUpstreams));
+        }, Qt::QueuedConnection);
+    }
 }
 
 NetworkAccessManager::~NetworkAccessManager()
 {
+    // don't start the waiting requests when the slots are released by the replies below
+    scheduler_.clear();
     // Delete the NetworkReply children first.
     // This is important since they have access to manager in their destructor.
     const QList<NetworkReply *> replies = findChildren<NetworkReply *>();
     for (auto it : replies)
         delete it;
+    // the replies from the other threads must have been deleted by their owners
+    WS_ASSERT(replies_.isEmpty());
     g_countInstances--;
 }
 
 NetworkReply *NetworkAccessManager::get(const NetworkRequest &request)
 {
-    WS_ASSERT(QThread::currentThread() == this->thread());
     return invokeHandleRequest(REQUEST_GET, request, QByteArray());
 }
 
 NetworkReply *NetworkAccessManager::post(const NetworkRequest &request, const QByteArray &data)
 {
-    WS_ASSERT(QThread::currentThread() == this->thread());
     return invokeHandleRequest(REQUEST_POST, request, data);
 }
 
 NetworkReply *NetworkAccessManager::put(const NetworkRequest &request, const QByteArray &data)
 {
-    WS_ASSERT(QThread::currentThread() == this->thread());
     return invokeHandleRequest(REQUEST_PUT, request, data);
 }
 
 NetworkReply *NetworkAccessManager::deleteResource(const NetworkRequest &request)
 {
-    WS_ASSERT(QThread::currentThread() == this->thread());
     return invokeHandleRequest(REQUEST_DELETE, request, QByteArray());
 }
 
 void NetworkAccessManager::abort(NetworkReply *reply)
 {
-    WS_ASSERT(QThread::currentThread() == this->thread());
-    WS_ASSERT(reply->property("replyId").isValid());
-    quint64 id = reply->property("replyId").toULongLong();
-
-    auto it = activeRequests_.find(id);
-    if (it != activeRequests_.end()) {
-        QSharedPointer<RequestData> requestData = it.value();
-        requestData->reply->abortCurl();
-        activeRequests_.erase(it);
-
-        if (requestData->request.isRemoveFromWhitelistIpsAfterFinish())
-            whitelistIpsManager_->remove(requestData->ips);
+    const quint64 id = reply->id();
+    {
+        QMutexLocker locker(&repliesMutex_);
+        // already finished
+        if (replies_.remove(id) == 0)
+            return;
     }
+
+    if (QThread::currentThread() == this->thread())
+        abortRequest(id);
+    else
+        QMetaObject::invokeMethod(this, [this, id]() { abortRequest(id); }, Qt::QueuedConnection);
 }
 
 void NetworkAccessManager::setProxySettings(const types::ProxySettings &proxySettings)
@@ -97,20 +121,155 @@ void NetworkAccessManager::disableProxy()
     isProxyEnabled_ = false;
 }
 
+void NetworkAccessManager::setSchedulerLimits(const RequestScheduler::Limits &limits)
+{
+    scheduler_.setLimits(limits);
+    startScheduledRequests();
+}
+
+void NetworkAccessManager::setDnsCacheSnapshotFile(const QString &filePath)
+{
+    dnsCache_->setSnapshotFile(filePath);
+}
+
+DnsCache::Statistics NetworkAccessManager::dnsCacheStatistics() const
+{
+    return dnsCache_->statistics();
+}
+
+void NetworkAccessManager::setDnsOverHttpsUpstreams(const QVector<DnsResolver_doh::Upstream> &upstreams)
+{
+    whitelistIpsManager_->remove(dohUpstreamIps_);
+    dohUpstreamIps_.clear();
+    for (const DnsResolver_doh::Upstream &upstream : upstreams) {
+        const QStringList ips = upstream.ips.isEmpty() ? QStringList() << upstream.url.host() : upstream.ips;
+        for (const QString &ip : ips) {
+            // the firewall exceptions are IPv4 only
+            if (!ip.contains(':') && !dohUpstreamIps_.contains(ip))
+                dohUpstreamIps_ << ip;
+        }
+    }
+    // the upstreams must stay reachable while the firewall is on, they are not whitelisted per request as the resolved IPs
+    whitelistIpsManager_->add(dohUpstreamIps_);
+
+    DnsResolver_doh::instance().setUpstreams(upstreams);
+    dnsCache_->setDnsOverHttps(!upstreams.isEmpty());
+    qCDebug(LOG_NETWORK) << "DNS over HTTPS" << (upstreams.isEmpty() ? "disabled" : "enabled with " + QString::number(upstreams.size()) + " upstream(s)");
+}
+
+void NetworkAccessManager::setHappyEyeballs(bool isEnabled)
+{
+    isHappyEyeballs_ = isEnabled;
+}
+
+bool NetworkAccessManager::isHappyEyeballs() const
+{
+    return isHappyEyeballs_;
+}
+
+void NetworkAccessManager::setIPv6Allowed(bool isAllowed)
+{
+    if (isIPv6Allowed_ != isAllowed)
+        qCDebug(LOG_NETWORK) << "IPv6 for the requests is" << (isAllowed ? "allowed" : "blocked");
+    isIPv6Allowed_ = isAllowed;
+}
+
+bool NetworkAccessManager::isIPv6Allowed() const
+{
+    return isIPv6Allowed_;
+}
+
+void NetworkAccessManager::addRequest(QSharedPointer<RequestData> requestData)
+{
+    WS_ASSERT(!activeRequests_.contains(requestData->id));
+    activeRequests_[requestData->id] = requestData;
+}
+
+void NetworkAccessManager::abortRequest(quint64 id)
+{
+    auto it = activeRequests_.find(id);
+    if (it != activeRequests_.end()) {
+        QSharedPointer<RequestData> requestData = it.value();
+        activeRequests_.erase(it);
+        if (requestData->curlReply) {
+            requestData->curlReply->abort();
+            delete requestData->curlReply;
+        }
+
+        if (requestData->request.isRemoveFromWhitelistIpsAfterFinish())
+            whitelistIpsManager_->remove(requestData->ips);
+        releaseRequest(id);
+    }
+}
+
+void NetworkAccessManager::deliverToReply(quint64 id, std::function<void(NetworkReply *)> func, bool isLast)
+{
+    QMutexLocker locker(&repliesMutex_);
+    NetworkReply *reply = isLast ? replies_.take(id) : replies_.value(id);
+    if (!reply)
+        return;
+
+    if (reply->thread() == QThread::currentThread()) {
+        locker.unlock();
+        func(reply);
+    } else {
+        // Posted under the mutex, so the reply can't be deleted before the event is queued. Once queued, the event is
+        // discarded together with the reply if it gets deleted. The abort can't happen in between, since it is done in the reply's thread.
+        QMetaObject::invokeMethod(reply, [reply, func]() {
+            if (!reply->isAborted_)
+                func(reply);
+        }, Qt::QueuedConnection);
+    }
+}
+
 void NetworkAccessManager::handleRequest(quint64 id)
 {
     WS_ASSERT(QThread::currentThread() == this->thread());
 
+    auto it = activeRequests_.find(id);
+    if (it != activeRequests_.end()) {
+        scheduler_.enqueue(id, schedulerHost(it.value()->request), it.value()->request.priority());
+        startScheduledRequests();
+    }
+}
+
+void NetworkAccessManager::startScheduledRequests()
+{
+    const QVector<quint64> ids = scheduler_.takeStartable();
+    for (quint64 id : ids)
+        executeRequest(id);
+}
+
+void NetworkAccessManager::releaseRequest(quint64 id)
+{
+    scheduler_.remove(id);
+    startScheduledRequests();
+}
+
+QString NetworkAccessManager::schedulerHost(const NetworkRequest &request)
+{
+    // the requests with the override IP (e.g. the pings of the nodes sharing the same hostname) go to different servers
+    if (!request.overrideIp().isEmpty())
+        return request.overrideIp();
+    return request.url().host();
+}
+
+void NetworkAccessManager::executeRequest(quint64 id)
+{
     auto it = activeRequests_.find(id);
     if (it != activeRequests_.end()) {
         QSharedPointer<RequestData> requestData = it.value();
+        deliverToReply(id, [](NetworkReply *reply) {
+            emit reply->started();
+        }, false);
 
         // skip DNS-resolution if the overrideIp is settled
         if (!requestData->request.overrideIp().isEmpty()) {
             onResolved(true, QStringList() << requestData->request.overrideIp(), requestData->id, false, 0);
         } else {
             QString hostname = requestData->request.url().host();
-            dnsCache_->resolve(hostname, requestData->id, !requestData->request.isUseDnsCache(), requestData->request.dnsServers(), requestData->request.timeout());
+            dnsCache_->resolve(hostname, requestData->id, !requestData->request.isUseDnsCache(), requestData->request.dnsServers(), requestData->request.timeout(),
+                               isHappyEyeballs_ && isIPv6Allowed_);
         }
     }
 }
@@ -123,20 +282,45 @@ void NetworkAccessManager::onCurlReplyFinished(qint64 elapsedMs)
         QSharedPointer<RequestData> requestData = it.value();
         activeRequests_.erase(it);
         requestData->elapsedMs_ += elapsedMs;
-        requestData->reply->checkForCurlError();
+
+        CurlReply *curlReply = requestData->curlReply;
+        const QByteArray data = curlReply->readAll();
+        const bool isSuccess = curlReply->isSuccess();
+        const QString errorString = isSuccess ? QString() : curlReply->errorString();
+        const int httpCode = curlReply->httpCode();
+        const QMap<QByteArray, QByteArray> responseHeaders = curlReply->responseHeaders();
+        RequestTimings timings = curlReply->timings();
+        timings.dnsUs = requestData->dnsUs;
+        timings.totalUs += requestData->dnsUs;
+        handleTimings(*requestData, timings, isSuccess ? "ok" : "curl error");
+        // we are in the signal handler of the curl reply
+        curlReply->deleteLater();
+        requestData->curlReply = nullptr;
+
         if (requestData->request.isRemoveFromWhitelistIpsAfterFinish())
             whitelistIpsManager_->remove(requestData->ips);
-        emit requestData->reply->finished(requestData->elapsedMs_);
+        releaseRequest(replyId);
+
+        const qint64 elapsed = requestData->elapsedMs_;
+        deliverToReply(replyId, [data, isSuccess, errorString, elapsed, timings, httpCode, responseHeaders](NetworkReply *reply) {
+            if (!data.isEmpty())
+                reply->appendData(data);
+            if (!isSuccess)
+                reply->setCurlError(errorString);
+            reply->setTimings(timings);
+            reply->setResponseHeaders(httpCode, responseHeaders);
+            emit reply->finished(elapsed);
+        }, true);
     }
 }
 
 void NetworkAccessManager::onCurlProgress(qint64 bytesReceived, qint64 bytesTotal)
 {
     quint64 replyId = sender()->property("replyId").toULongLong();
-    auto it = activeRequests_.find(replyId);
-    if (it != activeRequests_.end()) {
-        QSharedPointer<RequestData> requestData = it.value();
-        emit requestData->reply->progress(bytesReceived, bytesTotal);
+    if (activeRequests_.contains(replyId)) {
+        deliverToReply(replyId, [bytesReceived, bytesTotal](NetworkReply *reply) {
+            emit reply->progress(bytesReceived, bytesTotal);
+        }, false);
     }
 }
 
@@ -145,26 +329,47 @@ void NetworkAccessManager::onCurlReadyRead()
     quint64 replyId = sender()->property("replyId").toULongLong();
     auto it = activeRequests_.find(replyId);
     if (it != activeRequests_.end()) {
-        QSharedPointer<RequestData> requestData = it.value();
-        emit requestData->reply->readyRead();
+        const QByteArray data = it.value()->curlReply->readAll();
+        if (data.isEmpty())
+            return;
+        deliverToReply(replyId, [data](NetworkReply *reply) {
+            reply->appendData(data);
+            emit reply->readyRead();
+        }, false);
     }
 }
 
-void NetworkAccessManager::onResolved(bool success, const QStringList &ips, quint64 id, bool bFromCache, int timeMs)
+void NetworkAccessManager::onResolved(bool success, const QStringList &resolvedIps, quint64 id, bool bFromCache, int timeMs)
 {
-    Q_UNUSED(bFromCache);
+    // IPv6 could have been blocked while the hostname was resolving
+    QStringList ips = resolvedIps;
+    if (!isIPv6Allowed_) {
+        ips.removeIf([](const QString &ip) { return ip.contains(':'); });
+        if (ips.isEmpty())
+            success = false;
+    }
+
     auto it = activeRequests_.find(id);
     if (it != activeRequests_.end()) {
         QSharedPointer<RequestData> requestData = it.value();
         requestData->elapsedMs_ += timeMs;
+        // DnsCache measures in ms
+        requestData->dnsUs = bFromCache ? 0 : static_cast<qint64>(timeMs) * 1000;
+        RequestTimings dnsTimings;
+        dnsTimings.dnsUs = requestData->dnsUs;
+        dnsTimings.totalUs = requestData->dnsUs;
 
         if (success) {
             if (requestData->request.timeout() - timeMs > 0) {
                 requestData->request.setTimeout(requestData->request.timeout() - timeMs);
                 requestData->ips = ips;
 
-                if (requestData->request.isWhiteListIps())
-                    whitelistIpsManager_->add(ips);
+                // the firewall exceptions are IPv4 only, IPv6 is blocked entirely while the firewall is on
+                if (requestData->request.isWhiteListIps()) {
+                    QStringList ipv4 = ips;
+                    ipv4.removeIf([](const QString &ip) { return ip.contains(':'); });
+                    whitelistIpsManager_->add(ipv4);
+                }
 
                 CurlReply *curlReply{ nullptr };
 
@@ -180,20 +385,22 @@ void NetworkAccessManager::onResolved(bool success, const QStringList &ips, quin
                     WS_ASSERT(false);
 
                 curlReply->setProperty("replyId", id);
-                requestData->reply->setCurlReply(curlReply);
+                requestData->curlReply = curlReply;
 
                 connect(curlReply, &CurlReply::finished, this, &NetworkAccessManager::onCurlReplyFinished);
                 connect(curlReply, &CurlReply::progress, this, &NetworkAccessManager::onCurlProgress);
                 connect(curlReply, &CurlReply::readyRead, this, &NetworkAccessManager::onCurlReadyRead);
             } else {    // timeout exceed
                 activeRequests_.erase(it);
-                requestData->reply->setError(NetworkReply::TimeoutExceed);
-                emit requestData->reply->finished(requestData->elapsedMs_);
+                releaseRequest(id);
+                handleTimings(*requestData, dnsTimings, "timeout");
+                finishWithError(id, NetworkReply::TimeoutExceed, requestData->elapsedMs_, dnsTimings);
             }
         } else {
             activeRequests_.erase(it);
-            requestData->reply->setError(NetworkReply::DnsResolveError);
-            emit requestData->reply->finished(requestData->elapsedMs_);
+            releaseRequest(id);
+            handleTimings(*requestData, dnsTimings, "dns error");
+            finishWithError(id, NetworkReply::DnsResolveError, requestData->elapsedMs_, dnsTimings);
         }
     }
 }
@@ -206,24 +413,57 @@ types::ProxySettings NetworkAccessManager::currentProxySettings() const
         return types::ProxySettings();
 }
 
+void NetworkAccessManager::finishWithError(quint64 id, NetworkReply::NetworkError error, qint64 elapsedMs, const RequestTimings &timings)
+{
+    deliverToReply(id, [error, elapsedMs, timings](NetworkReply *reply) {
+        reply->setError(error);
+        reply->setTimings(timings);
+        emit reply->finished(elapsedMs);
+    }, true);
+}
+
+void NetworkAccessManager::handleTimings(const RequestData &requestData, const RequestTimings &timings, const QString &result)
+{
+    const QString endpoint = requestData.request.timingEndpoint();
+    const QString domain = requestData.request.url().host();
+    // the failed requests would skew the percentiles, they are only logged
+    if (!endpoint.isEmpty() && result == "ok")
+        timingStats_.add(endpoint, domain, timings);
+
+    if (isLogTimings_) {
+        qCDebug(LOG_NETWORK).noquote() << QString("request timings: endpoint=%1 domain=%2 result=\"%3\" %4")
+                                          .arg(endpoint.isEmpty() ? "-" : endpoint, domain, result, timings.toString());
+    }
+}
+
 NetworkReply *NetworkAccessManager::invokeHandleRequest(NetworkAccessManager::REQUEST_TYPE type, const NetworkRequest &request, const QByteArray &data)
 {
     quint64 id = nextId_++;
 
-    NetworkReply *reply = new NetworkReply(this);
-    reply->setProperty("replyId", id);
+    const bool isManagerThread = (QThread::currentThread() == this->thread());
+    // the reply from another thread can't be a child of the manager, the caller owns it
+    NetworkReply *reply = new NetworkReply(this, id, isManagerThread ? this : nullptr);
+    {
+        QMutexLocker locker(&repliesMutex_);
+        replies_[id] = reply;
+    }
 
     QSharedPointer<RequestData> requestData(new RequestData);
     requestData->id = id;
     requestData->type = type;
     requestData->request = request;
-    requestData->reply = reply;
     requestData->data = data;
 
-    WS_ASSERT(!activeRequests_.contains(id));
-    activeRequests_[id] = requestData;
-
-    QMetaObject::invokeMethod(this, "handleRequest", Qt::QueuedConnection, Q_ARG(quint64, id));
+    if (isManagerThread) {
+        addRequest(requestData);
+        QMetaObject::invokeMethod(this, "handleRequest", Qt::QueuedConnection, Q_ARG(quint64, id));
+    } else {
+        // an abort issued right after this call is queued after this one, so it finds the request
+        QMetaObject::invokeMethod(this, [this, requestData]() {
+            addRequest(requestData);
+            handleRequest(requestData->id);
+        }, Qt::QueuedConnection);
+    }
 
     return reply;
 }
@@ -1,17 +1,33 @@
 #pragma once
 
 #include <QObject>
+#include <QMutex>
 #include <QUrl>
 #include <QElapsedTimer>
+#include <functional>
 #include "curlnetworkmanager.h"
 #include "dnscache.h"
+#include "engine/dnsresolver/dnsresolver_doh.h"
 #include "networkreply.h"
+#include "requestscheduler.h"
+#include "requesttimings.h"
 #include "whitelistipsmanager.h"
 
 // Some simplified implementation of the QNetworkAccessManager class for our needs based on curl and cares(DnsRequest).
 // In particular, it has the functionality to whitelist IP addresses to firewall exceptions.
 // It has an internal DNS cache.
-// Currently not thead safe.
+// The requests are started in the order of their priority within the global and per host concurrency limits (see RequestScheduler).
+// The requests can be issued and aborted from any thread, the reply lives in the caller's thread and its signals are delivered there.
+// The replies issued from the other threads are not children of the manager, the caller must delete them before the manager.
+// The rest of the functions must be called from the manager's thread.
+// The timings of the requests tagged with NetworkRequest::setTimingEndpoint() are collected in timingStats(),
+// the extra config option ws-log-request-timings logs the timings of every request.
+// In the Happy Eyeballs mode (RFC 8305, off by default, the extra config option ws-happy-eyeballs) the hostnames are resolved
+// to both IPv4 and IPv6 addresses and curl races the connections, IPv6 first. IPv6 is used only while it's allowed by
+// setIPv6Allowed() (the firewall and the VPN connection block IPv6), otherwise the IPv6 addresses are dropped.
+// The DNS cache survives the restarts with the extra config option ws-dns-cache-snapshot (see DnsCache::setSnapshotFile()).
+// The hostnames are resolved with DNS over HTTPS if the upstreams are set by the extra config option ws-dns-over-https
+// or setDnsOverHttpsUpstreams() (see DnsResolver_doh).
 class NetworkAccessManager : public QObject
 {
     Q_OBJECT
@@ -19,17 +35,36 @@ public:
     explicit NetworkAccessManager(QObject *parent = nullptr);
     virtual ~NetworkAccessManager();
 
+    // thread safe
     NetworkReply *get(const NetworkRequest &request);
     NetworkReply *post(const NetworkRequest &request, const QByteArray &data);
     NetworkReply *put(const NetworkRequest &request, const QByteArray &data);
     NetworkReply *deleteResource(const NetworkRequest &request);
 
+    // thread safe, called by NetworkReply::abort()
     void abort(NetworkReply *reply);
 
     void setProxySettings(const types::ProxySettings &proxySettings);
     void enableProxy();
     void disableProxy();
 
+    void setSchedulerLimits(const RequestScheduler::Limits &limits);
+
+    // the snapshot file of the DNS cache, must be set before the first request
+    void setDnsCacheSnapshotFile(const QString &filePath);
+    DnsCache::Statistics dnsCacheStatistics() const;
+
+    // the upstreams are global for all the managers (DnsResolver_doh is a singleton), the empty list disables DNS over HTTPS
+    void setDnsOverHttpsUpstreams(const QVector<DnsResolver_doh::Upstream> &upstreams);
+
+    void setHappyEyeballs(bool isEnabled);
+    bool isHappyEyeballs() const;
+    void setIPv6Allowed(bool isAllowed);
+    bool isIPv6Allowed() const;
+
+    // thread safe
+    RequestTimingStats &timingStats() { return timingStats_; }
+
 signals:
     // need for add exception rules to firewall
     // use only direct connection type, because the IPs must be resolved before the HTTP/HTTPS request is actually executed
@@ -42,7 +77,7 @@ private slots:
     void onCurlProgress(qint64 bytesReceived, qint64 bytesTotal);
     void onCurlReadyRead();
 
-    void onResolved(bool success, const QStringList &ips, quint64 id, bool bFromCache, int timeMs);
+    void onResolved(bool success, const QStringList &resolvedIps, quint64 id, bool bFromCache, int timeMs);
 
 private:
     static std::atomic<quint64> nextId_;
@@ -53,20 +88,43 @@ private:
         quint64 id;
         REQUEST_TYPE type;
         NetworkRequest request;
-        NetworkReply *reply;
+        CurlReply *curlReply = nullptr;
         QByteArray data;
         qint64 elapsedMs_ = 0;
+        qint64 dnsUs = 0;
         QStringList ips;
     };
 
     QHash<quint64, QSharedPointer<RequestData> > activeRequests_;
+    // the replies which have not finished and have not been aborted yet, accessed from any thread.
+    // A reply can't be deleted while the mutex is locked, since its destructor goes through abort().
+    QMutex repliesMutex_;
+    QHash<quint64, NetworkReply *> replies_;
     CurlNetworkManager *curlNetworkManager_;
     DnsCache *dnsCache_;
     WhitelistIpsManager *whitelistIpsManager_;
     types::ProxySettings proxySettings_;
     bool isProxyEnabled_ = true;
+    RequestScheduler scheduler_;
+    RequestTimingStats timingStats_;
+    bool isLogTimings_;
+    bool isHappyEyeballs_;
+    bool isIPv6Allowed_ = true;
+    QStringList dohUpstreamIps_;     // whitelisted while DNS over HTTPS is enabled
 
     types::ProxySettings currentProxySettings() const;
+    void startScheduledRequests();
+    void executeRequest(quint64 id);
+    // frees the scheduler slot of the finished or aborted request and starts the waiting ones
+    void releaseRequest(quint64 id);
+    static QString schedulerHost(const NetworkRequest &request);
+    void addRequest(QSharedPointer<RequestData> requestData);
+    void abortRequest(quint64 id);
+    // calls func for the reply in the reply's thread, unless the reply is aborted or deleted by then.
+    // The reply is no longer tracked after the last delivery.
+    void deliverToReply(quint64 id, std::function<void(NetworkReply *)> func, bool isLast);
+    void finishWithError(quint64 id, NetworkReply::NetworkError error, qint64 elapsedMs, const RequestTimings &timings);
+    void handleTimings(const RequestData &requestData, const RequestTimings &timings, const QString &result);
     NetworkReply *invokeHandleRequest(REQUEST_TYPE type, const NetworkRequest &request, const QByteArray &data);
 };
 
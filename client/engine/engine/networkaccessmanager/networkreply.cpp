@@ -1,9 +1,9 @@
 #include "networkreply.h"
-#include "curlreply.h"
 #include "networkaccessmanager.h"
 #include "utils/ws_assert.h"
 
-NetworkReply::NetworkReply(NetworkAccessManager *parent) : QObject(parent), curlReply_(nullptr), manager_(parent), error_(NetworkReply::NoError)
+NetworkReply::NetworkReply(NetworkAccessManager *manager, quint64 id, QObject *parent) : QObject(parent),
+    manager_(manager), id_(id), error_(NetworkReply::NoError), httpCode_(0), isAborted_(false)
 {
 
 }
@@ -15,24 +15,17 @@ NetworkReply::~NetworkReply()
 
 void NetworkReply::abort()
 {
+    if (isAborted_)
+        return;
+    isAborted_ = true;
     manager_->abort(this);
-    if (curlReply_) {
-        delete curlReply_;
-        curlReply_ = nullptr;
-    }
 }
 
 QByteArray NetworkReply::readAll()
 {
-    if (curlReply_)
-    {
-        return curlReply_->readAll();
-    }
-    else
-    {
-        WS_ASSERT(false);
-        return QByteArray();
-    }
+    QByteArray temp;
+    temp.swap(data_);
+    return temp;
 }
 
 NetworkReply::NetworkError NetworkReply::error() const
@@ -50,27 +43,30 @@ bool NetworkReply::isSuccess() const
     return error_ == NoError;
 }
 
+RequestTimings NetworkReply::timings() const
+{
+    return timings_;
+}
 
-void NetworkReply::setCurlReply(CurlReply *curlReply)
+int NetworkReply::httpCode() const
 {
-    curlReply_ = curlReply;
+    return httpCode_;
 }
 
-void NetworkReply::abortCurl()
+QByteArray NetworkReply::rawHeader(const QByteArray &name) const
 {
-    if (curlReply_)
-    {
-        curlReply_->abort();
-    }
+    return responseHeaders_.value(name.toLower());
 }
 
-void NetworkReply::checkForCurlError()
+quint64 NetworkReply::id() const
 {
-    if (curlReply_ && !curlReply_->isSuccess())
-    {
-        error_ = CurlError;
-        errorString_ = curlReply_->errorString();
-    }
+    return id_;
+}
+
+void NetworkReply::appendData(const QByteArray &data)
+{
+    // shares the buffer if nothing is pending
+    data_.append(data);
 }
 
 void NetworkReply::setError(NetworkReply::NetworkError err)
@@ -88,3 +84,20 @@ void NetworkReply::setError(NetworkReply::NetworkError err)
         WS_ASSERT(false);
     }
 }
+
+void NetworkReply::setCurlError(const QString &errorString)
+{
+    error_ = CurlError;
+    errorString_ = errorString;
+}
+
+void NetworkReply::setTimings(const RequestTimings &timings)
+{
+    timings_ = timings;
+}
+
+void NetworkReply::setResponseHeaders(int httpCode, const QMap<QByteArray, QByteArray> &headers)
+{
+    httpCode_ = httpCode;
+    responseHeaders_ = headers;
+}
@@ -1,9 +1,11 @@
 #pragma once
+#include <QMap>
 #include <QObject>
+#include "requesttimings.h"
 
 class NetworkAccessManager;
-class CurlReply;
 
+// Lives in the thread where the request was issued, all the signals are delivered in this thread.
 class NetworkReply : public QObject
 {
     Q_OBJECT
@@ -12,30 +14,46 @@ public:
 
     enum NetworkError { NoError, TimeoutExceed, DnsResolveError, CurlError };
 
+    // no signals are emitted after the abort
     void abort();
     QByteArray readAll();
     NetworkError error() const;
     QString errorString() const;
     bool isSuccess() const;
+    // valid after finished, the phases not reached are 0
+    RequestTimings timings() const;
+    // valid after finished, 0 if no HTTP response was received. Note that the HTTP errors (e.g. 404) are not treated as failures
+    int httpCode() const;
+    // valid after finished, the name is case-insensitive, empty if there is no such header
+    QByteArray rawHeader(const QByteArray &name) const;
 
 signals:
+    // the request left the queue of the manager and is being executed (the DNS resolution and the transfer)
+    void started();
     void finished(int elapsedMs);
     void progress(qint64 bytesReceived, qint64 bytesTotal);
     void readyRead();
 
 private:
-    explicit NetworkReply(NetworkAccessManager *parent);
-
-    void setCurlReply(CurlReply *curlReply);
-    void abortCurl();
-    void checkForCurlError();
+    // parent is nullptr if the request is issued from a thread other than the manager's one
+    explicit NetworkReply(NetworkAccessManager *manager, quint64 id, QObject *parent);
 
+    quint64 id() const;
+    void appendData(const QByteArray &data);
     void setError(NetworkError err);
+    void setCurlError(const QString &errorString);
+    void setTimings(const RequestTimings &timings);
+    void setResponseHeaders(int httpCode, const QMap<QByteArray, QByteArray> &headers);
 
-    CurlReply *curlReply_;
     NetworkAccessManager *manager_;
+    quint64 id_;
+    QByteArray data_;
     NetworkError error_;
     QString errorString_;
+    RequestTimings timings_;
+    int httpCode_;
+    QMap<QByteArray, QByteArray> responseHeaders_;     // lower-cased names
+    bool isAborted_;
 
     friend class NetworkAccessManager;
 };
@@ -1,7 +1,9 @@
 #include "networkrequest.h"
 
 NetworkRequest::NetworkRequest(const QUrl &url, int timeout, bool bUseDnsCache) : url_(url), timeout_(timeout), bUseDnsCache_(bUseDnsCache), bIgnoreSslErrors_(false),
-    bRemoveFromWhitelistIpsAfterFinish_(false), isWhiteListIps_(true)
+    bRemoveFromWhitelistIpsAfterFinish_(false), isWhiteListIps_(true), bUseFreshConnection_(false),
+    bCoalesceBody_(false), bMultiplexed_(false),
+    priority_(Priority::kNormal)
 {
 }
 
@@ -12,7 +14,11 @@ NetworkRequest::NetworkRequest(const QUrl &url, int timeout, bool bUseDnsCache,
     bIgnoreSslErrors_(isIgnoreSslErrors),
     dnsServers_(dnsServers),
     bRemoveFromWhitelistIpsAfterFinish_(false),
-    isWhiteListIps_(true)
+    isWhiteListIps_(true),
+    bUseFreshConnection_(false),
+    bCoalesceBody_(false),
+    bMultiplexed_(false),
+    priority_(Priority::kNormal)
 {
 }
 
@@ -115,3 +121,69 @@ bool NetworkRequest::isWhiteListIps() const
 {
     return isWhiteListIps_;
 }
+
+void NetworkRequest::setUseFreshConnection(bool bUseFreshConnection)
+{
+    bUseFreshConnection_ = bUseFreshConnection;
+}
+
+bool NetworkRequest::isUseFreshConnection() const
+{
+    return bUseFreshConnection_;
+}
+
+void NetworkRequest::setCoalesceBody(bool bCoalesceBody)
+{
+    bCoalesceBody_ = bCoalesceBody;
+}
+
+bool NetworkRequest::isCoalesceBody() const
+{
+    return bCoalesceBody_;
+}
+
+void NetworkRequest::setMultiplexed(bool bMultiplexed)
+{
+    bMultiplexed_ = bMultiplexed;
+}
+
+bool NetworkRequest::isMultiplexed() const
+{
+    return bMultiplexed_;
+}
+
+void NetworkRequest::setPriority(Priority priority)
+{
+    priority_ = priority;
+}
+
+NetworkRequest::Priority NetworkRequest::priority() const
+{
+    return priority_;
+}
+
+void NetworkRequest::setTimingEndpoint(const QString &endpoint)
+{
+    timingEndpoint_ = endpoint;
+}
+
+QString NetworkRequest::timingEndpoint() const
+{
+    return timingEndpoint_;
+}
+
+void NetworkRequest::setRawHeader(const QByteArray &name, const QByteArray &value)
+{
+    for (auto &header : rawHeaders_) {
+        if (header.first.compare(name, Qt::CaseInsensitive) == 0) {
+            header.second = value;
+            return;
+        }
+    }
+    rawHeaders_ << qMakePair(name, value);
+}
+
+QVector<QPair<QByteArray, QByteArray> > NetworkRequest::rawHeaders() const
+{
+    return rawHeaders_;
+}
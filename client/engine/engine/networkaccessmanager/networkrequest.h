@@ -1,10 +1,15 @@
 #pragma once
 
+#include <QPair>
 #include <QUrl>
+#include <QVector>
 
 class NetworkRequest
 {
 public:
+    // the scheduling class in NetworkAccessManager, see RequestScheduler
+    enum class Priority { kInteractive, kNormal, kBackground };
+
     NetworkRequest() {}
     explicit NetworkRequest(const QUrl &url, int timeout, bool bUseDnsCache);
     explicit NetworkRequest(const QUrl &url, int timeout, bool bUseDnsCache, const QStringList &dnsServers, bool isIgnoreSslErrors);
@@ -40,6 +45,32 @@ public:
     void setIsWhiteListIps(bool isWhiteListIps);
     bool isWhiteListIps() const;
 
+    // Don't take a connection from the pool and don't return it to the pool after the request is completed
+    void setUseFreshConnection(bool bUseFreshConnection);
+    bool isUseFreshConnection() const;
+
+    // Accumulate the response body in the curl thread and deliver it in large chunks: readyRead and progress are signaled
+    // at most every 100 ms or 4 MB instead of once per curl chunk. Suitable for large bodies that are read in whole or drained on readyRead.
+    void setCoalesceBody(bool bCoalesceBody);
+    bool isCoalesceBody() const;
+
+    // Use HTTP/2 for the https URLs and wait for a pooled connection that can multiplex the request instead of opening
+    // a parallel one, so many small concurrent requests to the same host share one connection (e.g. DNS over HTTPS)
+    void setMultiplexed(bool bMultiplexed);
+    bool isMultiplexed() const;
+
+    void setPriority(Priority priority);
+    Priority priority() const;
+
+    // If not empty, the timings of the request are collected in NetworkAccessManager::timingStats() under this endpoint name
+    // and the host of the URL as the domain
+    void setTimingEndpoint(const QString &endpoint);
+    QString timingEndpoint() const;
+
+    // Extra header sent with the request, e.g. the conditional request headers (If-None-Match, If-Modified-Since)
+    void setRawHeader(const QByteArray &name, const QByteArray &value);
+    QVector<QPair<QByteArray, QByteArray> > rawHeaders() const;
+
 private:
     QUrl url_;
     int timeout_;
@@ -58,5 +89,21 @@ private:
 
     // default true
     bool isWhiteListIps_;
+
+    // default false, if true then a new TCP/TLS connection is established for this request
+    bool bUseFreshConnection_;
+
+    // default false, if true then the body is delivered in coalesced chunks
+    bool bCoalesceBody_;
+
+    // default false, if true then the request prefers HTTP/2 multiplexing over the pooled connection
+    bool bMultiplexed_;
+
+    // default kNormal
+    Priority priority_;
+
+    QString timingEndpoint_;
+
+    QVector<QPair<QByteArray, QByteArray> > rawHeaders_;
 };
 
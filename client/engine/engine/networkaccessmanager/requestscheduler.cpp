@@ -0,0 +1,88 @@
+#include "requestscheduler.h"
+
+RequestScheduler::RequestScheduler(const Limits &limits) : limits_(limits)
+{
+    clock_.start();
+}
+
+void RequestScheduler::setLimits(const Limits &limits)
+{
+    limits_ = limits;
+}
+
+void RequestScheduler::enqueue(quint64 id, const QString &host, NetworkRequest::Priority priority)
+{
+    waiting_ << Entry{ id, host, priority, clock_.elapsed() };
+}
+
+void RequestScheduler::remove(quint64 id)
+{
+    auto it = running_.find(id);
+    if (it != running_.end()) {
+        auto hostIt = runningPerHost_.find(it->host);
+        if (--hostIt.value() == 0)
+            runningPerHost_.erase(hostIt);
+        running_.erase(it);
+        return;
+    }
+
+    for (auto waitingIt = waiting_.begin(); waitingIt != waiting_.end(); ++waitingIt) {
+        if (waitingIt->id == id) {
+            waiting_.erase(waitingIt);
+            return;
+        }
+    }
+}
+
+void RequestScheduler::clear()
+{
+    waiting_.clear();
+    running_.clear();
+    runningPerHost_.clear();
+}
+
+QVector<quint64> RequestScheduler::takeStartable()
+{
+    QVector<quint64> ids;
+    const qint64 now = clock_.elapsed();
+
+    while (!waiting_.isEmpty()) {
+        // the first of the startable requests with the highest effective priority
+        int best = -1;
+        int bestPriority = 0;
+        for (int i = 0; i < waiting_.size(); ++i) {
+            if (!canStart(waiting_[i]))
+                continue;
+            int priority = effectivePriority(waiting_[i], now);
+            if (best == -1 || priority < bestPriority) {
+                best = i;
+                bestPriority = priority;
+                if (priority == static_cast<int>(NetworkRequest::Priority::kInteractive))
+                    break;
+            }
+        }
+        if (best == -1)
+            break;
+
+        const Entry entry = waiting_.takeAt(best);
+        running_[entry.id] = Running{ entry.host };
+        runningPerHost_[entry.host]++;
+        ids << entry.id;
+    }
+    return ids;
+}
+
+bool RequestScheduler::canStart(const Entry &entry) const
+{
+    const int reserve = entry.priority == NetworkRequest::Priority::kInteractive ? limits_.interactiveReserve : 0;
+    return running_.size() < limits_.maxTotal + reserve &&
+           runningPerHost_.value(entry.host) < limits_.maxPerHost + reserve;
+}
+
+int RequestScheduler::effectivePriority(const Entry &entry, qint64 now) const
+{
+    int priority = static_cast<int>(entry.priority);
+    if (limits_.agingMs > 0)
+        priority -= static_cast<int>(qMin<qint64>((now - entry.enqueueTime) / limits_.agingMs, priority));
+    return qMax(priority, static_cast<int>(NetworkRequest::Priority::kInteractive));
+}
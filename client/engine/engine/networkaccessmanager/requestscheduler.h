@@ -0,0 +1,66 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+#include "networkrequest.h"
+
+// Admission control for the NetworkAccessManager requests: limits the count of the running requests globally and per host,
+// the waiting requests are started in the priority order (FIFO within the same priority).
+// Interactive requests can additionally use the reserved slots, so a storm of background work can't delay them.
+// Starvation protection: a waiting request is raised by one priority class for every agingMs it waits
+// (it doesn't get the interactive reserve though).
+class RequestScheduler
+{
+public:
+    struct Limits
+    {
+        int maxTotal = 32;
+        int maxPerHost = 6;
+        int interactiveReserve = 4;     // added to both limits for the interactive requests
+        int agingMs = 2000;
+    };
+
+    explicit RequestScheduler(const Limits &limits = Limits());
+
+    void setLimits(const Limits &limits);
+    Limits limits() const { return limits_; }
+
+    // the request waits until it's returned by takeStartable()
+    void enqueue(quint64 id, const QString &host, NetworkRequest::Priority priority);
+    // the request is finished or aborted, either running or waiting
+    void remove(quint64 id);
+    // forgets all the running and waiting requests
+    void clear();
+    // returns the waiting requests which can be started now (in the start order) and counts them as running
+    QVector<quint64> takeStartable();
+
+    int runningCount() const { return running_.size(); }
+    int waitingCount() const { return waiting_.size(); }
+
+private:
+    struct Entry
+    {
+        quint64 id;
+        QString host;
+        NetworkRequest::Priority priority;
+        qint64 enqueueTime;     // in clock_ ms
+    };
+
+    struct Running
+    {
+        QString host;
+    };
+
+    Limits limits_;
+    QElapsedTimer clock_;
+    QList<Entry> waiting_;      // in the enqueue order
+    QHash<quint64, Running> running_;
+    QHash<QString, int> runningPerHost_;
+
+    bool canStart(const Entry &entry) const;
+    int effectivePriority(const Entry &entry, qint64 now) const;
+};
@@ -0,0 +1,97 @@
+#include "requesttimings.h"
+
+#include <algorithm>
+
+const int typeIdRequestTimings = qRegisterMetaType<RequestTimings>("RequestTimings");
+
+namespace {
+
+QString formatMs(qint64 us)
+{
+    return QString::number(us / 1000.0, 'f', 1) + "ms";
+}
+
+// nearest-rank percentile of the sorted values
+qint64 percentile(const QVector<qint64> &sorted, int p)
+{
+    const int rank = qMax(1, static_cast<int>((static_cast<qint64>(p) * sorted.size() + 99) / 100));
+    return sorted[rank - 1];
+}
+
+} // namespace
+
+QString RequestTimings::toString() const
+{
+    return QString("dns=%1 connect=%2 tls=%3 ttfb=%4 total=%5")
+        .arg(formatMs(dnsUs), formatMs(connectUs), formatMs(tlsUs), formatMs(firstByteUs), formatMs(totalUs));
+}
+
+RequestTimingStats::RequestTimingStats(int windowSize) : windowSize_(windowSize)
+{
+}
+
+void RequestTimingStats::add(const QString &endpoint, const QString &domain, const RequestTimings &timings)
+{
+    QMutexLocker locker(&mutex_);
+    Window &window = windows_[qMakePair(endpoint, domain)];
+    if (window.samples.size() < windowSize_) {
+        window.samples << timings;
+    } else {
+        window.samples[window.next] = timings;
+        window.next = (window.next + 1) % windowSize_;
+    }
+}
+
+RequestTimingStats::Percentiles RequestTimingStats::percentiles(const QString &endpoint, const QString &domain) const
+{
+    QVector<RequestTimings> samples;
+    {
+        QMutexLocker locker(&mutex_);
+        for (auto it = windows_.cbegin(); it != windows_.cend(); ++it) {
+            if (it.key().first == endpoint && (domain.isEmpty() || it.key().second == domain))
+                samples << it.value().samples;
+        }
+    }
+    return computePercentiles(samples);
+}
+
+QVector<QPair<QString, QString> > RequestTimingStats::keys() const
+{
+    QMutexLocker locker(&mutex_);
+    QVector<QPair<QString, QString> > result;
+    for (auto it = windows_.cbegin(); it != windows_.cend(); ++it)
+        result << it.key();
+    return result;
+}
+
+void RequestTimingStats::clear()
+{
+    QMutexLocker locker(&mutex_);
+    windows_.clear();
+}
+
+RequestTimingStats::Percentiles RequestTimingStats::computePercentiles(const QVector<RequestTimings> &samples)
+{
+    Percentiles result;
+    result.count = samples.size();
+    if (samples.isEmpty())
+        return result;
+
+    // every phase is ranked on its own, so the percentiles of the phases don't have to add up to the total one
+    auto computePhase = [&samples, &result](qint64 RequestTimings::*phase) {
+        QVector<qint64> values;
+        values.reserve(samples.size());
+        for (const RequestTimings &timings : samples)
+            values << timings.*phase;
+        std::sort(values.begin(), values.end());
+        result.p50.*phase = percentile(values, 50);
+        result.p90.*phase = percentile(values, 90);
+        result.p99.*phase = percentile(values, 99);
+    };
+    computePhase(&RequestTimings::dnsUs);
+    computePhase(&RequestTimings::connectUs);
+    computePhase(&RequestTimings::tlsUs);
+    computePhase(&RequestTimings::firstByteUs);
+    computePhase(&RequestTimings::totalUs);
+    return result;
+}
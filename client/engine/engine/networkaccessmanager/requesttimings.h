@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QHash>
+#include <QMetaType>
+#include <QMutex>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+// The phases of an HTTP request in microseconds.
+// The connect and TLS phases are close to 0 if a pooled connection was reused.
+struct RequestTimings
+{
+    qint64 dnsUs = 0;           // the resolution in DnsCache (curl gets the already resolved IPs), 0 for the cached and override IPs
+    qint64 connectUs = 0;       // the TCP connect
+    qint64 tlsUs = 0;           // the TLS handshake
+    qint64 firstByteUs = 0;     // from sending the request to the first byte of the response (the server time)
+    qint64 totalUs = 0;         // the DNS resolution plus the whole transfer
+
+    // "dns=1.2ms connect=0.3ms tls=5.1ms ttfb=40.0ms total=47.0ms"
+    QString toString() const;
+};
+Q_DECLARE_METATYPE(RequestTimings)
+
+// Rolling window of the latest request timings per (endpoint, domain) with the percentiles of each phase.
+// Thread safe.
+class RequestTimingStats
+{
+public:
+    struct Percentiles
+    {
+        int count = 0;      // the number of the samples the percentiles are computed from
+        RequestTimings p50;
+        RequestTimings p90;
+        RequestTimings p99;
+    };
+
+    explicit RequestTimingStats(int windowSize = 256);
+
+    void add(const QString &endpoint, const QString &domain, const RequestTimings &timings);
+    // the percentiles over all the domains of the endpoint if the domain is empty
+    Percentiles percentiles(const QString &endpoint, const QString &domain = QString()) const;
+    // (endpoint, domain) pairs which have samples
+    QVector<QPair<QString, QString> > keys() const;
+    void clear();
+
+private:
+    struct Window
+    {
+        QVector<RequestTimings> samples;
+        int next = 0;       // the slot for the next sample once the window is full
+    };
+
+    const int windowSize_;
+    mutable QMutex mutex_;
+    QHash<QPair<QString, QString>, Window> windows_;
+
+    static Percentiles computePercentiles(const QVector<RequestTimings> &samples);
+};
@@ -0,0 +1,240 @@
+#include <QtTest>
+#include <QCoreApplication>
+#include <atomic>
+#ifdef Q_OS_WIN
+#include <WinSock2.h>
+#endif
+#include "engine/networkaccessmanager/curlnetworkmanager.h"
+#include "../common/testhttpserver.h"
+
+#if defined(Q_OS_LINUX) && defined(__GLIBC__)
+// Counts the heap allocations of the whole process (the server and the test code included) by wrapping the glibc allocator.
+#define HAS_ALLOCATIONS_COUNTER
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+static std::atomic<quint64> g_allocations{0};
+
+extern "C" void *malloc(size_t size) noexcept
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) noexcept
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) noexcept
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+// Compares the per-chunk and the coalesced response body delivery on a 100 MB download and on many small responses,
+// reporting the time, the heap allocations and the count of the readyRead/progress signals.
+class TestBodyDelivery : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestBodyDelivery();
+    ~TestBodyDelivery();
+
+private slots:
+    void initTestCase();
+    void test_coalesced_body();
+    void test_coalesced_read_at_finish();
+    void benchmark_large_body_data();
+    void benchmark_large_body();
+    void benchmark_small_responses_data();
+    void benchmark_small_responses();
+
+private:
+    struct BenchmarkResult
+    {
+        int failed = 0;
+        qint64 bytesReceived = 0;
+        int readyReadSignals = 0;
+        int progressSignals = 0;
+        qint64 allocations = -1;
+        qint64 elapsedMs = 0;
+    };
+
+    static constexpr int kLargeBodySize = 100 * 1024 * 1024;
+    static constexpr int kSmallBodySize = 2 * 1024;
+
+    TestHttpServer *server_;
+    QByteArray largeBody_;
+
+    // drains the replies on readyRead like DownloadHelper does
+    BenchmarkResult runRequests(bool bCoalesceBody, const QString &path, int count, int parallel);
+    NetworkRequest makeRequest(const QString &path, bool bCoalesceBody) const;
+    static void addModes();
+    static void report(const char *workload, bool bCoalesceBody, const BenchmarkResult &result);
+};
+
+
+TestBodyDelivery::TestBodyDelivery() : server_(nullptr)
+{
+#ifdef Q_OS_WIN
+    // Initialize Winsock
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2,2), &wsaData);
+#endif
+}
+
+TestBodyDelivery::~TestBodyDelivery()
+{
+}
+
+void TestBodyDelivery::initTestCase()
+{
+    largeBody_ = QByteArray(kLargeBodySize, 'x');
+    server_ = new TestHttpServer(this, false);
+    server_->setHandler([this](const TestHttpServer::Request &request) {
+        TestHttpServer::Response response;
+        if (request.path == "/large")
+            response.body = largeBody_;
+        else if (request.path == "/small")
+            response.body = QByteArray(kSmallBodySize, 's');
+        else
+            response.body = request.path;
+        return response;
+    });
+    QVERIFY(server_->start());
+}
+
+void TestBodyDelivery::test_coalesced_body()
+{
+    BenchmarkResult result = runRequests(true, "/large", 1, 1);
+    QCOMPARE(result.failed, 0);
+    QCOMPARE(result.bytesReceived, qint64(kLargeBodySize));
+    // at most one signal per flush: every 4 MB or 100 ms, plus the final one
+    const int maxSignals = kLargeBodySize / (4 * 1024 * 1024) + result.elapsedMs / 100 + 2;
+    QVERIFY2(result.readyReadSignals <= maxSignals, qPrintable(QString("readyRead signals = %1").arg(result.readyReadSignals)));
+    QVERIFY(result.progressSignals <= result.readyReadSignals);
+    QVERIFY(result.progressSignals > 0);
+}
+
+void TestBodyDelivery::test_coalesced_read_at_finish()
+{
+    // the small body is delivered in one piece, the whole body is available when finished
+    CurlNetworkManager manager;
+    CurlReply *reply = manager.get(makeRequest("/echo-path", true), QStringList() << "127.0.0.1");
+    int readyReadSignals = 0;
+    connect(reply, &CurlReply::readyRead, this, [&readyReadSignals]() { readyReadSignals++; });
+    QSignalSpy signalFinished(reply, &CurlReply::finished);
+    QVERIFY(signalFinished.wait(10000));
+    QVERIFY(reply->isSuccess());
+    QCOMPARE(readyReadSignals, 1);
+    QCOMPARE(reply->readAll(), QByteArray("/echo-path"));
+    delete reply;
+}
+
+void TestBodyDelivery::addModes()
+{
+    QTest::addColumn<bool>("isCoalesceBody");
+    QTest::newRow("per chunk") << false;
+    QTest::newRow("coalesced") << true;
+}
+
+void TestBodyDelivery::benchmark_large_body_data()
+{
+    addModes();
+}
+
+void TestBodyDelivery::benchmark_large_body()
+{
+    QFETCH(bool, isCoalesceBody);
+    BenchmarkResult result = runRequests(isCoalesceBody, "/large", 1, 1);
+    report("100 MB body", isCoalesceBody, result);
+    QCOMPARE(result.failed, 0);
+    QCOMPARE(result.bytesReceived, qint64(kLargeBodySize));
+}
+
+void TestBodyDelivery::benchmark_small_responses_data()
+{
+    addModes();
+}
+
+void TestBodyDelivery::benchmark_small_responses()
+{
+    QFETCH(bool, isCoalesceBody);
+    const int kRequests = 2000;
+    BenchmarkResult result = runRequests(isCoalesceBody, "/small", kRequests, 20);
+    report("2000 x 2 KB responses", isCoalesceBody, result);
+    QCOMPARE(result.failed, 0);
+    QCOMPARE(result.bytesReceived, qint64(kRequests) * kSmallBodySize);
+}
+
+TestBodyDelivery::BenchmarkResult TestBodyDelivery::runRequests(bool bCoalesceBody, const QString &path, int count, int parallel)
+{
+    CurlNetworkManager manager;
+    BenchmarkResult result;
+    int started = 0;
+    int finished = 0;
+    QEventLoop loop;
+    QElapsedTimer timer;
+    timer.start();
+#ifdef HAS_ALLOCATIONS_COUNTER
+    const quint64 allocationsBefore = g_allocations.load();
+#endif
+
+    std::function<void()> startNext = [&]() {
+        CurlReply *reply = manager.get(makeRequest(path, bCoalesceBody), QStringList() << "127.0.0.1");
+        started++;
+        connect(reply, &CurlReply::readyRead, this, [&, reply]() {
+            result.readyReadSignals++;
+            result.bytesReceived += reply->readAll().size();
+        });
+        connect(reply, &CurlReply::progress, this, [&]() {
+            result.progressSignals++;
+        });
+        connect(reply, &CurlReply::finished, this, [&, reply]() {
+            if (!reply->isSuccess())
+                result.failed++;
+            finished++;
+            reply->deleteLater();
+            if (started < count)
+                startNext();
+            else if (finished == count)
+                loop.quit();
+        });
+    };
+
+    for (int i = 0; i < qMin(parallel, count); ++i)
+        startNext();
+
+    QTimer::singleShot(120000, &loop, &QEventLoop::quit);
+    loop.exec();
+
+    result.elapsedMs = timer.elapsed();
+#ifdef HAS_ALLOCATIONS_COUNTER
+    result.allocations = g_allocations.load() - allocationsBefore;
+#endif
+    result.failed += count - finished;
+    return result;
+}
+
+NetworkRequest TestBodyDelivery::makeRequest(const QString &path, bool bCoalesceBody) const
+{
+    NetworkRequest request(server_->url(path), 60000, false);
+    request.setCoalesceBody(bCoalesceBody);
+    return request;
+}
+
+void TestBodyDelivery::report(const char *workload, bool bCoalesceBody, const BenchmarkResult &result)
+{
+    qDebug().noquote() << QString("%1, %2: %3 ms, readyRead signals: %4, progress signals: %5, allocations: %6")
+                              .arg(workload).arg(bCoalesceBody ? "coalesced" : "per chunk").arg(result.elapsedMs)
+                              .arg(result.readyReadSignals).arg(result.progressSignals)
+                              .arg(result.allocations >= 0 ? QString::number(result.allocations) : QString("n/a"));
+}
+
+QTEST_MAIN(TestBodyDelivery)
+#include "bodydelivery.test.moc"
@@ -0,0 +1,101 @@
+#include <QtTest>
+#include <QCoreApplication>
+#include <QtConcurrent/QtConcurrent>
+#include "engine/networkaccessmanager/certmanager.h"
+
+// Measures the CPU cost of preparing the trust store in the SSL context callback (per TLS handshake).
+class TestCertManager : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestCertManager();
+    ~TestCertManager();
+
+private slots:
+    void test_trust_store_cached();
+    void test_trust_store_concurrent();
+    void benchmark_store_per_handshake();
+    void benchmark_cached_store();
+
+private:
+    CertManager certManager_;
+
+    // how the SSL context callback worked before the cache
+    static void buildStorePerHandshake(SSL_CTX *ctx, CertManager &certManager);
+};
+
+
+TestCertManager::TestCertManager()
+{
+}
+
+TestCertManager::~TestCertManager()
+{
+}
+
+void TestCertManager::test_trust_store_cached()
+{
+    QVERIFY(certManager_.count() > 0);
+
+    X509_STORE *store1 = certManager_.trustStore();
+    X509_STORE *store2 = certManager_.trustStore();
+    QVERIFY(store1 != nullptr);
+    QVERIFY(store1 == store2);
+    // duplicates in the bundle are stored once
+    const int storeSize = sk_X509_OBJECT_num(X509_STORE_get0_objects(store1));
+    QVERIFY(storeSize > 0 && storeSize <= certManager_.count());
+
+    X509_STORE_free(store1);
+    X509_STORE_free(store2);
+}
+
+void TestCertManager::test_trust_store_concurrent()
+{
+    QList<QFuture<void> > futures;
+    for (int i = 0; i < 16; ++i) {
+        futures << QtConcurrent::run([this]() {
+            for (int j = 0; j < 1000; ++j) {
+                SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+                SSL_CTX_set_cert_store(ctx, certManager_.trustStore());
+                SSL_CTX_free(ctx);
+            }
+        });
+    }
+    for (auto &it : futures)
+        it.waitForFinished();
+
+    // the store must still be alive and filled after all contexts have released their references
+    X509_STORE *store = certManager_.trustStore();
+    QVERIFY(sk_X509_OBJECT_num(X509_STORE_get0_objects(store)) > 0);
+    X509_STORE_free(store);
+}
+
+void TestCertManager::benchmark_store_per_handshake()
+{
+    QBENCHMARK {
+        SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+        buildStorePerHandshake(ctx, certManager_);
+        SSL_CTX_free(ctx);
+    }
+}
+
+void TestCertManager::benchmark_cached_store()
+{
+    QBENCHMARK {
+        SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+        SSL_CTX_set_cert_store(ctx, certManager_.trustStore());
+        SSL_CTX_free(ctx);
+    }
+}
+
+void TestCertManager::buildStorePerHandshake(SSL_CTX *ctx, CertManager &certManager)
+{
+    X509_STORE *store = X509_STORE_new();
+    SSL_CTX_set_cert_store(ctx, store);
+    for (int i = 0; i < certManager.count(); ++i)
+        X509_STORE_add_cert(store, certManager.getCert(i));
+}
+
+QTEST_MAIN(TestCertManager)
+#include "certmanager.test.moc"
@@ -0,0 +1,248 @@
+#include "testhttpserver.h"
+
+#include <QFile>
+#include <QSslCertificate>
+#include <QSslKey>
+#include <QSslSocket>
+#include <QTimer>
+
+namespace {
+
+QSslCertificate loadCertificate()
+{
+    QFile file(":localhost.crt");
+    if (!file.open(QIODevice::ReadOnly))
+        return QSslCertificate();
+    return QSslCertificate(file.readAll(), QSsl::Pem);
+}
+
+QSslKey loadPrivateKey()
+{
+    QFile file(":localhost.key");
+    if (!file.open(QIODevice::ReadOnly))
+        return QSslKey();
+    return QSslKey(file.readAll(), QSsl::Rsa, QSsl::Pem);
+}
+
+} // namespace
+
+TestHttpServer::TestHttpServer(QObject *parent, bool isTls) : QTcpServer(parent),
+    isTls_(isTls),
+    responseDelayMs_(0),
+    handshakeDelayMs_(0),
+    connectionsCount_(0),
+    requestsCount_(0),
+    bytesSent_(0)
+{
+    handler_ = [](const Request &) {
+        Response response;
+        response.headers << qMakePair(QByteArray("Content-Type"), QByteArray("application/json"));
+        response.body = "{}";
+        return response;
+    };
+}
+
+bool TestHttpServer::start(const QHostAddress &address)
+{
+    return listen(address, 0);
+}
+
+QUrl TestHttpServer::url(const QString &path) const
+{
+    return QUrl((isTls_ ? "https://localhost:" : "http://localhost:") + QString::number(serverPort()) + path);
+}
+
+void TestHttpServer::setHandler(Handler handler)
+{
+    handler_ = handler;
+}
+
+void TestHttpServer::setResponseDelayMs(int delayMs)
+{
+    responseDelayMs_ = delayMs;
+}
+
+void TestHttpServer::setHandshakeDelayMs(int delayMs)
+{
+    handshakeDelayMs_ = delayMs;
+}
+
+int TestHttpServer::connectionsCount() const
+{
+    return connectionsCount_;
+}
+
+int TestHttpServer::requestsCount() const
+{
+    return requestsCount_;
+}
+
+qint64 TestHttpServer::bytesSent() const
+{
+    return bytesSent_;
+}
+
+void TestHttpServer::resetCounters()
+{
+    connectionsCount_ = 0;
+    requestsCount_ = 0;
+    bytesSent_ = 0;
+}
+
+void TestHttpServer::incomingConnection(qintptr socketDescriptor)
+{
+    // the ClientHello waits in the socket buffer until the socket is taken
+    if (isTls_ && handshakeDelayMs_ > 0)
+        QTimer::singleShot(handshakeDelayMs_, this, [this, socketDescriptor]() { addConnection(socketDescriptor); });
+    else
+        addConnection(socketDescriptor);
+}
+
+void TestHttpServer::addConnection(qintptr socketDescriptor)
+{
+    QTcpSocket *socket;
+    if (isTls_) {
+        static const QSslCertificate certificate = loadCertificate();
+        static const QSslKey privateKey = loadPrivateKey();
+
+        QSslSocket *sslSocket = new QSslSocket(this);
+        if (!sslSocket->setSocketDescriptor(socketDescriptor)) {
+            delete sslSocket;
+            return;
+        }
+        sslSocket->setLocalCertificate(certificate);
+        sslSocket->setPrivateKey(privateKey);
+        sslSocket->startServerEncryption();
+        socket = sslSocket;
+    } else {
+        socket = new QTcpSocket(this);
+        if (!socket->setSocketDescriptor(socketDescriptor)) {
+            delete socket;
+            return;
+        }
+    }
+
+    connectionsCount_++;
+    connections_[socket] = ConnectionState();
+    connect(socket, &QTcpSocket::readyRead, this, &TestHttpServer::onReadyRead);
+    connect(socket, &QTcpSocket::disconnected, this, &TestHttpServer::onDisconnected);
+}
+
+void TestHttpServer::onReadyRead()
+{
+    QTcpSocket *socket = static_cast<QTcpSocket *>(sender());
+    auto it = connections_.find(socket);
+    if (it == connections_.end())
+        return;
+    it.value().buffer.append(socket->readAll());
+    processBuffer(socket);
+}
+
+void TestHttpServer::onDisconnected()
+{
+    QTcpSocket *socket = static_cast<QTcpSocket *>(sender());
+    connections_.remove(socket);
+    socket->deleteLater();
+}
+
+void TestHttpServer::processBuffer(QTcpSocket *socket)
+{
+    auto it = connections_.find(socket);
+    if (it == connections_.end() || it.value().isBusy)
+        return;
+
+    Request request;
+    if (!parseRequest(it.value().buffer, request))
+        return;
+
+    requestsCount_++;
+    Response response = handler_(request);
+    if (request.headers.value("connection").toLower() == "close")
+        response.closeConnection = true;
+
+    const int delayMs = qMax(response.delayMs, responseDelayMs_);
+    if (delayMs > 0) {
+        it.value().isBusy = true;
+        QTimer::singleShot(delayMs, socket, [this, socket, response]() {
+            sendResponse(socket, response);
+        });
+    } else {
+        sendResponse(socket, response);
+    }
+}
+
+bool TestHttpServer::parseRequest(QByteArray &buffer, Request &outRequest)
+{
+    const int headersEnd = buffer.indexOf("\r\n\r\n");
+    if (headersEnd == -1)
+        return false;
+
+    const QList<QByteArray> lines = buffer.left(headersEnd).split('\n');
+    const QList<QByteArray> requestLine = lines.first().trimmed().split(' ');
+    if (requestLine.size() < 2)
+        return false;
+
+    Request request;
+    request.method = requestLine[0];
+    request.path = requestLine[1];
+    for (int i = 1; i < lines.size(); ++i) {
+        const int colon = lines[i].indexOf(':');
+        if (colon > 0)
+            request.headers[lines[i].left(colon).trimmed().toLower()] = lines[i].mid(colon + 1).trimmed();
+    }
+
+    const int contentLength = request.headers.value("content-length", "0").toInt();
+    const int bodyStart = headersEnd + 4;
+    if (buffer.size() < bodyStart + contentLength)
+        return false;
+
+    request.body = buffer.mid(bodyStart, contentLength);
+    buffer.remove(0, bodyStart + contentLength);
+    outRequest = request;
+    return true;
+}
+
+void TestHttpServer::sendResponse(QTcpSocket *socket, const Response &response)
+{
+    QByteArray data = "HTTP/1.1 " + QByteArray::number(response.statusCode) + " " + reasonPhrase(response.statusCode) + "\r\n";
+    for (const auto &header : response.headers)
+        data += header.first + ": " + header.second + "\r\n";
+    // 1xx, 204 and 304 responses have no body
+    if (response.statusCode != 204 && response.statusCode != 304)
+        data += "Content-Length: " + QByteArray::number(response.body.size()) + "\r\n";
+    data += response.closeConnection ? "Connection: close\r\n" : "Connection: keep-alive\r\n";
+    data += "\r\n";
+    if (response.statusCode != 204 && response.statusCode != 304)
+        data += response.body;
+
+    bytesSent_ += data.size();
+    socket->write(data);
+
+    if (response.closeConnection) {
+        socket->disconnectFromHost();
+        return;
+    }
+
+    auto it = connections_.find(socket);
+    if (it != connections_.end()) {
+        it.value().isBusy = false;
+        processBuffer(socket);
+    }
+}
+
+QByteArray TestHttpServer::reasonPhrase(int statusCode)
+{
+    switch (statusCode) {
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 500: return "Internal Server Error";
+    case 502: return "Bad Gateway";
+    case 503: return "Service Unavailable";
+    default: return "Unknown";
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QHash>
+#include <QHostAddress>
+#include <QMap>
+#include <QTcpServer>
+#include <QUrl>
+#include <functional>
+
+class QTcpSocket;
+
+// Minimal local HTTP/1.1 server (optionally over TLS) for the network tests and benchmarks.
+// Supports keep-alive connections, delayed responses and custom request handlers.
+// Runs in the thread where it was created, so the test must spin the event loop (QSignalSpy::wait, QTest::qWait, etc).
+class TestHttpServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    struct Request
+    {
+        QByteArray method;
+        QByteArray path;        // including the query
+        QMap<QByteArray, QByteArray> headers;  // keys are lower-cased
+        QByteArray body;
+    };
+
+    struct Response
+    {
+        int statusCode = 200;
+        QList<QPair<QByteArray, QByteArray> > headers;
+        QByteArray body;
+        int delayMs = 0;
+        bool closeConnection = false;
+    };
+
+    typedef std::function<Response(const Request &request)> Handler;
+
+    // if isTls is true, the server uses the certificate ":localhost.crt" and the key ":localhost.key" from the test resources
+    explicit TestHttpServer(QObject *parent = nullptr, bool isTls = false);
+
+    // listen on 127.0.0.1 (or the given address, e.g. ::1 for an IPv6-only server) with a random port
+    bool start(const QHostAddress &address = QHostAddress::LocalHost);
+    QUrl url(const QString &path = "/") const;
+
+    // by default responds "200 OK" with the body "{}" on any request
+    void setHandler(Handler handler);
+    void setResponseDelayMs(int delayMs);
+    // the TLS server starts the handshake of a new connection after this delay, the TCP connect itself is not delayed
+    void setHandshakeDelayMs(int delayMs);
+
+    // the count of the accepted TCP connections (equal to the count of the TLS handshakes for the TLS server)
+    int connectionsCount() const;
+    int requestsCount() const;
+    qint64 bytesSent() const;
+    void resetCounters();
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private slots:
+    void onReadyRead();
+    void onDisconnected();
+
+private:
+    struct ConnectionState
+    {
+        QByteArray buffer;
+        bool isBusy = false;    // a response is pending, don't parse the next request (no pipelining)
+    };
+
+    bool isTls_;
+    Handler handler_;
+    int responseDelayMs_;
+    int handshakeDelayMs_;
+    int connectionsCount_;
+    int requestsCount_;
+    qint64 bytesSent_;
+    QHash<QTcpSocket *, ConnectionState> connections_;
+
+    void addConnection(qintptr socketDescriptor);
+    void processBuffer(QTcpSocket *socket);
+    bool parseRequest(QByteArray &buffer, Request &outRequest);
+    void sendResponse(QTcpSocket *socket, const Response &response);
+    static QByteArray reasonPhrase(int statusCode);
+};
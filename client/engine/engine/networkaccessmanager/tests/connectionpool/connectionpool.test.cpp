@@ -0,0 +1,180 @@
+#include <QtTest>
+#include <QCoreApplication>
+#include <algorithm>
+#ifdef Q_OS_WIN
+#include <WinSock2.h>
+#endif
+#include "engine/networkaccessmanager/curlnetworkmanager.h"
+#include "../common/testhttpserver.h"
+
+// Compares the pooled connections (default) against the fresh connection per request
+// using the local HTTPS server which counts the TLS handshakes.
+class TestConnectionPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestConnectionPool();
+    ~TestConnectionPool();
+
+private slots:
+    void initTestCase();
+    void test_reuse_connection();
+    void test_fresh_connection();
+    void test_other_pinned_ips();
+    void benchmark_pooled_vs_fresh();
+
+private:
+    struct BenchmarkResult
+    {
+        int handshakes = 0;
+        int failed = 0;
+        qint64 p50Us = 0;
+        qint64 p99Us = 0;
+    };
+
+    TestHttpServer *server_;
+
+    BenchmarkResult runRequests(bool bUseFreshConnection, int count, int parallel);
+    NetworkRequest makeRequest(bool bUseFreshConnection) const;
+    static qint64 percentile(QVector<qint64> values, double p);
+};
+
+
+TestConnectionPool::TestConnectionPool() : server_(nullptr)
+{
+#ifdef Q_OS_WIN
+    // Initialize Winsock
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2,2), &wsaData);
+#endif
+}
+
+TestConnectionPool::~TestConnectionPool()
+{
+}
+
+void TestConnectionPool::initTestCase()
+{
+    server_ = new TestHttpServer(this, true);
+    QVERIFY(server_->start());
+}
+
+void TestConnectionPool::test_reuse_connection()
+{
+    BenchmarkResult result = runRequests(false, 20, 1);
+    QCOMPARE(result.failed, 0);
+    QCOMPARE(result.handshakes, 1);
+}
+
+void TestConnectionPool::test_fresh_connection()
+{
+    BenchmarkResult result = runRequests(true, 20, 1);
+    QCOMPARE(result.failed, 0);
+    QCOMPARE(result.handshakes, 20);
+}
+
+void TestConnectionPool::test_other_pinned_ips()
+{
+    // any IPv4 address, so 127.0.0.2 reaches the server too
+    TestHttpServer server(this, true);
+    QVERIFY(server.start(QHostAddress::AnyIPv4));
+    CurlNetworkManager manager;
+
+    const QStringList ipsList[] = { QStringList() << "127.0.0.1", QStringList() << "127.0.0.1", QStringList() << "127.0.0.2" };
+    const int expectedConnections[] = { 1, 1, 2 };
+    for (int i = 0; i < 3; ++i) {
+        NetworkRequest request(server.url("/get"), 10000, false);
+        request.setIgnoreSslErrors(true);
+        CurlReply *reply = manager.get(request, ipsList[i]);
+        QSignalSpy spy(reply, &CurlReply::finished);
+        QVERIFY(spy.wait(10000));
+        QVERIFY(reply->isSuccess());
+        reply->deleteLater();
+        // the pooled connection to 127.0.0.1 is not reused for the request pinned to 127.0.0.2
+        QCOMPARE(server.connectionsCount(), expectedConnections[i]);
+    }
+}
+
+void TestConnectionPool::benchmark_pooled_vs_fresh()
+{
+    const int kRequests = 1000;
+    const int kParallel = 10;
+
+    BenchmarkResult pooled = runRequests(false, kRequests, kParallel);
+    BenchmarkResult fresh = runRequests(true, kRequests, kParallel);
+
+    qDebug() << "pooled: handshakes per 1000 requests:" << pooled.handshakes * 1000 / kRequests
+             << "p50:" << pooled.p50Us << "us, p99:" << pooled.p99Us << "us";
+    qDebug() << "fresh: handshakes per 1000 requests:" << fresh.handshakes * 1000 / kRequests
+             << "p50:" << fresh.p50Us << "us, p99:" << fresh.p99Us << "us";
+
+    QCOMPARE(pooled.failed, 0);
+    QCOMPARE(fresh.failed, 0);
+    QVERIFY(pooled.handshakes <= kParallel);
+    QCOMPARE(fresh.handshakes, kRequests);
+}
+
+TestConnectionPool::BenchmarkResult TestConnectionPool::runRequests(bool bUseFreshConnection, int count, int parallel)
+{
+    // a separate manager for every run, so the connections of the previous run are not reused
+    CurlNetworkManager manager;
+    server_->resetCounters();
+
+    BenchmarkResult result;
+    QVector<qint64> latencies;
+    latencies.reserve(count);
+    QHash<CurlReply *, qint64> startTimes;
+    QElapsedTimer timer;
+    timer.start();
+    int started = 0;
+    QEventLoop loop;
+
+    std::function<void()> startNext = [&]() {
+        CurlReply *reply = manager.get(makeRequest(bUseFreshConnection), QStringList() << "127.0.0.1");
+        startTimes[reply] = timer.nsecsElapsed() / 1000;
+        started++;
+        connect(reply, &CurlReply::finished, this, [&, reply]() {
+            latencies << timer.nsecsElapsed() / 1000 - startTimes.take(reply);
+            if (!reply->isSuccess())
+                result.failed++;
+            reply->deleteLater();
+            if (started < count)
+                startNext();
+            else if (startTimes.isEmpty())
+                loop.quit();
+        });
+    };
+
+    for (int i = 0; i < qMin(parallel, count); ++i)
+        startNext();
+
+    QTimer::singleShot(120000, &loop, &QEventLoop::quit);
+    loop.exec();
+
+    result.handshakes = server_->connectionsCount();
+    result.p50Us = percentile(latencies, 0.5);
+    result.p99Us = percentile(latencies, 0.99);
+    result.failed += count - latencies.size();
+    return result;
+}
+
+NetworkRequest TestConnectionPool::makeRequest(bool bUseFreshConnection) const
+{
+    NetworkRequest request(server_->url("/get"), 10000, false);
+    request.setIgnoreSslErrors(true);
+    request.setUseFreshConnection(bUseFreshConnection);
+    return request;
+}
+
+qint64 TestConnectionPool::percentile(QVector<qint64> values, double p)
+{
+    if (values.isEmpty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    int ind = qMin(values.size() - 1, static_cast<int>(values.size() * p));
+    return values[ind];
+}
+
+QTEST_MAIN(TestConnectionPool)
+#include "connectionpool.test.moc"
@@ -0,0 +1,247 @@
+#include <QtTest>
+#include <QCoreApplication>
+#include <algorithm>
+#ifdef Q_OS_WIN
+#include <WinSock2.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <sys/resource.h>
+#endif
+#include "engine/networkaccessmanager/curlnetworkmanager.h"
+#include "../common/testhttpserver.h"
+
+// Checks the event driven curl loop and compares the submit-to-first-byte latency of the poll and the event driven loops
+// against the local HTTP server under 1, 100 and 1000 concurrent requests.
+class TestCurlEventLoop : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestCurlEventLoop();
+    ~TestCurlEventLoop();
+
+private slots:
+    void initTestCase();
+    void test_get();
+    void test_abort();
+    void test_delete_manager();
+    void benchmark_first_byte_data();
+    void benchmark_first_byte();
+
+private:
+    struct BenchmarkResult
+    {
+        int failed = 0;
+        qint64 p50Us = 0;
+        qint64 p99Us = 0;
+        qint64 maxUs = 0;
+    };
+
+    static constexpr int kMaxConcurrency = 1000;
+
+    TestHttpServer *server_;
+
+    // starts the rounds of concurrent requests, the next round starts when all the requests of the previous one are finished
+    BenchmarkResult runRequests(CurlNetworkManager *manager, int concurrency, int rounds);
+    NetworkRequest makeRequest(const QString &path = "/get") const;
+    static qint64 percentile(QVector<qint64> values, double p);
+    static void raiseFileDescriptorsLimit();
+};
+
+
+TestCurlEventLoop::TestCurlEventLoop() : server_(nullptr)
+{
+#ifdef Q_OS_WIN
+    // Initialize Winsock
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2,2), &wsaData);
+#endif
+}
+
+TestCurlEventLoop::~TestCurlEventLoop()
+{
+}
+
+void TestCurlEventLoop::initTestCase()
+{
+    // both ends of every concurrent connection are in this process
+    raiseFileDescriptorsLimit();
+
+    server_ = new TestHttpServer(this, false);
+    server_->setListenBacklogSize(kMaxConcurrency);
+    server_->setHandler([](const TestHttpServer::Request &request) {
+        TestHttpServer::Response response;
+        response.body = request.path;
+        if (request.path == "/slow")
+            response.delayMs = 3000;
+        return response;
+    });
+    QVERIFY(server_->start());
+}
+
+void TestCurlEventLoop::test_get()
+{
+    CurlNetworkManager manager(nullptr, true);
+    if (!manager.isEventDrivenLoop())
+        QSKIP("The event driven loop is not supported on this platform");
+
+    QVector<CurlReply *> replies;
+    int finished = 0;
+    for (int i = 0; i < 20; ++i) {
+        CurlReply *reply = manager.get(makeRequest(QString("/get%1").arg(i)), QStringList() << "127.0.0.1");
+        connect(reply, &CurlReply::finished, this, [&finished]() { finished++; });
+        replies << reply;
+    }
+
+    QTRY_COMPARE_WITH_TIMEOUT(finished, replies.size(), 10000);
+    for (int i = 0; i < replies.size(); ++i) {
+        QVERIFY(replies[i]->isSuccess());
+        QCOMPARE(replies[i]->readAll(), QString("/get%1").arg(i).toUtf8());
+    }
+    qDeleteAll(replies);
+}
+
+void TestCurlEventLoop::test_abort()
+{
+    CurlNetworkManager manager(nullptr, true);
+    if (!manager.isEventDrivenLoop())
+        QSKIP("The event driven loop is not supported on this platform");
+
+    CurlReply *slowReply = manager.get(makeRequest("/slow"), QStringList() << "127.0.0.1");
+    QSignalSpy slowFinished(slowReply, &CurlReply::finished);
+    QTest::qWait(100);
+    manager.abort(slowReply);
+
+    // the loop is not blocked by the aborted request, the new one is served right away
+    QElapsedTimer timer;
+    timer.start();
+    CurlReply *reply = manager.get(makeRequest(), QStringList() << "127.0.0.1");
+    QSignalSpy signalFinished(reply, &CurlReply::finished);
+    QVERIFY(signalFinished.wait(10000));
+    QVERIFY(reply->isSuccess());
+    QVERIFY2(timer.elapsed() < 1000, qPrintable(QString("elapsed = %1 ms").arg(timer.elapsed())));
+
+    QTest::qWait(3500);
+    QCOMPARE(slowFinished.count(), 0);
+    delete reply;
+    delete slowReply;
+}
+
+void TestCurlEventLoop::test_delete_manager()
+{
+    // deleting the manager with the requests in progress and in the submission queue must not hang or crash
+    CurlNetworkManager *manager = new CurlNetworkManager(nullptr, true);
+    for (int i = 0; i < 10; ++i)
+        manager->get(makeRequest("/slow"), QStringList() << "127.0.0.1");
+    QTest::qWait(100);
+    for (int i = 0; i < 10; ++i)
+        manager->get(makeRequest(), QStringList() << "127.0.0.1");
+    delete manager;
+}
+
+void TestCurlEventLoop::benchmark_first_byte_data()
+{
+    QTest::addColumn<bool>("isEventDrivenLoop");
+    QTest::addColumn<int>("concurrency");
+    QTest::addColumn<int>("rounds");
+
+    QTest::newRow("poll, 1 concurrent") << false << 1 << 200;
+    QTest::newRow("event driven, 1 concurrent") << true << 1 << 200;
+    QTest::newRow("poll, 100 concurrent") << false << 100 << 5;
+    QTest::newRow("event driven, 100 concurrent") << true << 100 << 5;
+    QTest::newRow("poll, 1000 concurrent") << false << kMaxConcurrency << 1;
+    QTest::newRow("event driven, 1000 concurrent") << true << kMaxConcurrency << 1;
+}
+
+void TestCurlEventLoop::benchmark_first_byte()
+{
+    QFETCH(bool, isEventDrivenLoop);
+    QFETCH(int, concurrency);
+    QFETCH(int, rounds);
+
+    CurlNetworkManager manager(nullptr, isEventDrivenLoop);
+    if (manager.isEventDrivenLoop() != isEventDrivenLoop)
+        QSKIP("The event driven loop is not supported on this platform");
+
+    BenchmarkResult result = runRequests(&manager, concurrency, rounds);
+    qDebug() << (isEventDrivenLoop ? "event driven:" : "poll:") << concurrency << "concurrent, submit to first byte"
+             << "p50:" << result.p50Us << "us, p99:" << result.p99Us << "us, max:" << result.maxUs << "us";
+    QCOMPARE(result.failed, 0);
+}
+
+TestCurlEventLoop::BenchmarkResult TestCurlEventLoop::runRequests(CurlNetworkManager *manager, int concurrency, int rounds)
+{
+    BenchmarkResult result;
+    QVector<qint64> latencies;
+    latencies.reserve(concurrency * rounds);
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int round = 0; round < rounds; ++round) {
+        QHash<CurlReply *, qint64> startTimes;
+        QSet<CurlReply *> inProgress;
+        QEventLoop loop;
+
+        for (int i = 0; i < concurrency; ++i) {
+            const qint64 startUs = timer.nsecsElapsed() / 1000;
+            CurlReply *reply = manager->get(makeRequest(), QStringList() << "127.0.0.1");
+            startTimes[reply] = startUs;
+            inProgress << reply;
+            connect(reply, &CurlReply::readyRead, this, [&, reply]() {
+                if (startTimes.contains(reply))
+                    latencies << timer.nsecsElapsed() / 1000 - startTimes.take(reply);
+            });
+            connect(reply, &CurlReply::finished, this, [&, reply]() {
+                if (!reply->isSuccess())
+                    result.failed++;
+                inProgress.remove(reply);
+                reply->deleteLater();
+                if (inProgress.isEmpty())
+                    loop.quit();
+            });
+        }
+
+        QTimer::singleShot(120000, &loop, &QEventLoop::quit);
+        loop.exec();
+        if (!inProgress.isEmpty()) {
+            // timed out, the replies must not outlive the locals used in the lambdas
+            result.failed += inProgress.size();
+            qDeleteAll(inProgress);
+            break;
+        }
+    }
+
+    result.p50Us = percentile(latencies, 0.5);
+    result.p99Us = percentile(latencies, 0.99);
+    result.maxUs = percentile(latencies, 1.0);
+    return result;
+}
+
+NetworkRequest TestCurlEventLoop::makeRequest(const QString &path) const
+{
+    NetworkRequest request(server_->url(path), 30000, false);
+    return request;
+}
+
+qint64 TestCurlEventLoop::percentile(QVector<qint64> values, double p)
+{
+    if (values.isEmpty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    int ind = qMin(values.size() - 1, static_cast<int>(values.size() * p));
+    return values[ind];
+}
+
+void TestCurlEventLoop::raiseFileDescriptorsLimit()
+{
+#ifdef Q_OS_LINUX
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+#endif
+}
+
+QTEST_MAIN(TestCurlEventLoop)
+#include "curleventloop.test.moc"
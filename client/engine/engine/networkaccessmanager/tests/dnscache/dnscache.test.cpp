@@ -5,6 +5,9 @@
 #include <WinSock2.h>
 #endif
 #include "engine/networkaccessmanager/dnscache.h"
+#ifndef Q_OS_WIN
+#include "../../../dnsresolver/tests/testdnsserver.h"
+#endif
 
 class TestDnsCache : public QObject
 {
@@ -17,9 +20,16 @@ public:
 private slots:
     void basicTest();
     void testCacheTimeout();
+    void testSingleFlight();
+    void testSingleFlightTimeout();
+    void testHonorTtl();
+    void testNegativeCache();
+    void testStaleWhileRevalidate();
 
 private:
     void delay(int ms);
+    // returns the arguments of the resolved signal
+    QList<QVariant> resolveAndWait(DnsCache *dnsCache, const QString &hostname, quint64 id, const QStringList &dnsServers, int timeoutMs = 5000);
 };
 
 
@@ -129,6 +139,271 @@ void TestDnsCache::testCacheTimeout()
      }
 }
 
+void TestDnsCache::testSingleFlight()
+{
+    const int kLookups = 50;
+    DnsCache *dnsCache = new DnsCache(this);
+    QSignalSpy spy(dnsCache, SIGNAL(resolved(bool, QStringList, quint64, bool, int)));
+
+    // all lookups are issued before the event loop runs, so they are concurrent
+    for (int i = 0; i < kLookups; ++i)
+        dnsCache->resolve("localhost", i, false);
+
+    QTRY_COMPARE_WITH_TIMEOUT(spy.count(), kLookups, 10000);
+
+    QSet<quint64> ids;
+    for (const QList<QVariant> &arguments : spy) {
+        QVERIFY(arguments.at(0).toBool() == true);
+        QVERIFY(arguments.at(1).toStringList().size() > 0);
+        QVERIFY(arguments.at(3).toBool() == false);
+        ids << arguments.at(2).toULongLong();
+    }
+    QCOMPARE(ids.size(), kLookups);
+
+    DnsCache::Statistics statistics = dnsCache->statistics();
+    QCOMPARE(statistics.lookups, (quint64)kLookups);
+    QCOMPARE(statistics.resolverJobs, (quint64)1);
+    QCOMPARE(statistics.coalescedLookups, (quint64)(kLookups - 1));
+    QCOMPARE(statistics.cacheHits, (quint64)0);
+
+    // lookups with other DNS servers must not join the in-flight resolution
+    dnsCache->resolve("localhost", kLookups, true);
+    dnsCache->resolve("localhost", kLookups + 1, true, QStringList() << "127.0.0.1");
+    QCOMPARE(dnsCache->statistics().resolverJobs, (quint64)3);
+    QTRY_COMPARE_WITH_TIMEOUT(spy.count(), kLookups + 2, 10000);
+}
+
+void TestDnsCache::testSingleFlightTimeout()
+{
+#ifdef Q_OS_WIN
+    QSKIP("The local DNS server is not supported on Windows");
+#else
+    TestDnsServer dnsServer;
+    QVERIFY(dnsServer.startServer());
+    const QStringList dnsServers = QStringList() << dnsServer.address();
+
+    TestDnsServer::Record record;
+    record.ipv4 << "10.0.0.1";
+    record.delayMs = 2000;
+    dnsServer.setRecord("slow.test", record);
+
+    DnsCache *dnsCache = new DnsCache(this);
+    QSignalSpy spy(dnsCache, SIGNAL(resolved(bool, QStringList, quint64, bool, int)));
+    QElapsedTimer timer;
+    timer.start();
+    dnsCache->resolve("slow.test", 0, false, dnsServers, 5000);
+    // joins the resolution, but fails on its own timeout
+    dnsCache->resolve("slow.test", 1, false, dnsServers, 500);
+    // the resolution with a shorter timeout can't be joined
+    dnsCache->resolve("slow.test", 2, false, dnsServers, 8000);
+    QCOMPARE(dnsCache->statistics().resolverJobs, (quint64)2);
+    QCOMPARE(dnsCache->statistics().coalescedLookups, (quint64)1);
+
+    QVERIFY(spy.wait(5000));
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.first().at(2).toULongLong(), (quint64)1);
+    QVERIFY(spy.first().at(0).toBool() == false);
+    QVERIFY(timer.elapsed() >= 500 && timer.elapsed() < 1500);
+
+    QTRY_COMPARE_WITH_TIMEOUT(spy.count(), 3, 10000);
+    for (int i = 1; i < spy.count(); ++i) {
+        QVERIFY(spy.at(i).at(0).toBool() == true);
+        QCOMPARE(spy.at(i).at(1).toStringList(), QStringList() << "10.0.0.1");
+        QVERIFY(spy.at(i).at(2).toULongLong() != 1);
+    }
+#endif
+}
+
+void TestDnsCache::testHonorTtl()
+{
+#ifdef Q_OS_WIN
+    QSKIP("The local DNS server is not supported on Windows");
+#else
+    TestDnsServer dnsServer;
+    QVERIFY(dnsServer.startServer());
+    const QStringList dnsServers = QStringList() << dnsServer.address();
+
+    TestDnsServer::Record record;
+    record.ipv4 << "10.0.0.1";
+    record.ttl = 0;             // below the floor
+    dnsServer.setRecord("short.test", record);
+    record.ttl = 3;
+    dnsServer.setRecord("medium.test", record);
+    record.ttl = 3600;          // above the ceiling
+    dnsServer.setRecord("long.test", record);
+
+    DnsCache *dnsCache = new DnsCache(this, 60000, 10);
+    DnsCache::TtlPolicy ttlPolicy;
+    ttlPolicy.isHonorTtl = true;
+    ttlPolicy.minTtlMs = 1500;
+    ttlPolicy.maxTtlMs = 4500;
+    dnsCache->setTtlPolicy(ttlPolicy);
+
+    const QStringList hostnames = QStringList() << "short.test" << "medium.test" << "long.test";
+    for (const QString &hostname : hostnames) {
+        QList<QVariant> arguments = resolveAndWait(dnsCache, hostname, 0, dnsServers);
+        QVERIFY(arguments.at(0).toBool() == true);
+        QCOMPARE(arguments.at(1).toStringList(), QStringList() << "10.0.0.1");
+        QVERIFY(arguments.at(3).toBool() == false);
+    }
+
+    // the floor has expired
+    delay(2000);
+    QVERIFY(resolveAndWait(dnsCache, "short.test", 1, dnsServers).at(3).toBool() == false);
+    QVERIFY(resolveAndWait(dnsCache, "medium.test", 1, dnsServers).at(3).toBool() == true);
+    QVERIFY(resolveAndWait(dnsCache, "long.test", 1, dnsServers).at(3).toBool() == true);
+
+    // the record TTL has expired
+    delay(1500);
+    QVERIFY(resolveAndWait(dnsCache, "medium.test", 2, dnsServers).at(3).toBool() == false);
+    QVERIFY(resolveAndWait(dnsCache, "long.test", 2, dnsServers).at(3).toBool() == true);
+
+    // the ceiling has expired
+    delay(1500);
+    QVERIFY(resolveAndWait(dnsCache, "long.test", 3, dnsServers).at(3).toBool() == false);
+#endif
+}
+
+void TestDnsCache::testNegativeCache()
+{
+#ifdef Q_OS_WIN
+    QSKIP("The local DNS server is not supported on Windows");
+#else
+    TestDnsServer dnsServer;
+    QVERIFY(dnsServer.startServer());
+    const QStringList dnsServers = QStringList() << dnsServer.address();
+
+    // NXDOMAIN is the default answer of the server
+    TestDnsServer::Record record;
+    record.isNoResponse = true;
+    dnsServer.setRecord("timeout.test", record);
+
+    // the failures are not cached by default
+    {
+        DnsCache *dnsCache = new DnsCache(this);
+        QVERIFY(resolveAndWait(dnsCache, "nx.test", 0, dnsServers, 1000).at(0).toBool() == false);
+        QList<QVariant> arguments = resolveAndWait(dnsCache, "nx.test", 1, dnsServers, 1000);
+        QVERIFY(arguments.at(0).toBool() == false);
+        QVERIFY(arguments.at(3).toBool() == false);
+        QCOMPARE(dnsCache->statistics().negativeHits, (quint64)0);
+    }
+
+    DnsCache *dnsCache = new DnsCache(this, 60000, 10);
+    DnsCache::TtlPolicy ttlPolicy;
+    ttlPolicy.negativeTtlMs = 2000;
+    dnsCache->setTtlPolicy(ttlPolicy);
+
+    const QStringList hostnames = QStringList() << "nx.test" << "timeout.test";
+    for (const QString &hostname : hostnames) {
+        QList<QVariant> arguments = resolveAndWait(dnsCache, hostname, 0, dnsServers, 1000);
+        QVERIFY(arguments.at(0).toBool() == false);
+        QVERIFY(arguments.at(3).toBool() == false);
+
+        const int queriesCount = dnsServer.queriesCount(hostname);
+        arguments = resolveAndWait(dnsCache, hostname, 1, dnsServers, 1000);
+        QVERIFY(arguments.at(0).toBool() == false);
+        QVERIFY(arguments.at(1).toStringList().isEmpty());
+        QVERIFY(arguments.at(3).toBool() == true);
+        QCOMPARE(dnsServer.queriesCount(hostname), queriesCount);
+    }
+    QCOMPARE(dnsCache->statistics().negativeHits, (quint64)hostnames.size());
+
+    // bypassCache skips the negative answers as well
+    {
+        QSignalSpy spy(dnsCache, SIGNAL(resolved(bool, QStringList, quint64, bool, int)));
+        dnsCache->resolve("nx.test", 2, true, dnsServers, 1000);
+        QVERIFY(spy.wait(6000));
+        QVERIFY(spy.first().at(0).toBool() == false);
+        QVERIFY(spy.first().at(3).toBool() == false);
+        QCOMPARE(dnsCache->statistics().negativeHits, (quint64)hostnames.size());
+    }
+
+    // the domain appears after the negative TTL expires
+    record = TestDnsServer::Record();
+    record.ipv4 << "10.0.0.1";
+    dnsServer.setRecord("nx.test", record);
+    delay(2500);
+    QList<QVariant> arguments = resolveAndWait(dnsCache, "nx.test", 3, dnsServers);
+    QVERIFY(arguments.at(0).toBool() == true);
+    QCOMPARE(arguments.at(1).toStringList(), QStringList() << "10.0.0.1");
+    QVERIFY(arguments.at(3).toBool() == false);
+#endif
+}
+
+void TestDnsCache::testStaleWhileRevalidate()
+{
+#ifdef Q_OS_WIN
+    QSKIP("The local DNS server is not supported on Windows");
+#else
+    TestDnsServer dnsServer;
+    QVERIFY(dnsServer.startServer());
+    const QStringList dnsServers = QStringList() << dnsServer.address();
+
+    TestDnsServer::Record record;
+    record.ipv4 << "10.0.0.1";
+    record.ttl = 1;
+    dnsServer.setRecord("stale.test", record);
+
+    DnsCache *dnsCache = new DnsCache(this, 60000, 10);
+    DnsCache::TtlPolicy ttlPolicy;
+    ttlPolicy.isHonorTtl = true;
+    ttlPolicy.minTtlMs = 1000;
+    ttlPolicy.maxTtlMs = 1000;
+    ttlPolicy.negativeTtlMs = 5000;
+    ttlPolicy.staleTtlMs = 10000;
+    dnsCache->setTtlPolicy(ttlPolicy);
+
+    QVERIFY(resolveAndWait(dnsCache, "stale.test", 0, dnsServers).at(0).toBool() == true);
+
+    // the expired answer is returned right away, the new one arrives with the background refresh
+    record.ipv4 = QStringList() << "10.0.0.2";
+    dnsServer.setRecord("stale.test", record);
+    delay(1200);
+    int queriesCount = dnsServer.queriesCount("stale.test");
+    {
+        QSignalSpy spy(dnsCache, SIGNAL(resolved(bool, QStringList, quint64, bool, int)));
+        dnsCache->resolve("stale.test", 1, false, dnsServers);
+        dnsCache->resolve("stale.test", 2, false, dnsServers);
+        QCOMPARE(spy.count(), 2);
+        for (const QList<QVariant> &arguments : spy) {
+            QVERIFY(arguments.at(0).toBool() == true);
+            QCOMPARE(arguments.at(1).toStringList(), QStringList() << "10.0.0.1");
+            QVERIFY(arguments.at(3).toBool() == true);
+        }
+    }
+    QCOMPARE(dnsCache->statistics().staleHits, (quint64)2);
+    QCOMPARE(dnsCache->statistics().backgroundRefreshes, (quint64)1);
+    QTRY_VERIFY_WITH_TIMEOUT(dnsServer.queriesCount("stale.test") > queriesCount, 5000);
+    QTRY_COMPARE_WITH_TIMEOUT(resolveAndWait(dnsCache, "stale.test", 3, dnsServers).at(1).toStringList(), QStringList() << "10.0.0.2", 5000);
+
+    // a failed refresh keeps the stale answer
+    record = TestDnsServer::Record();
+    record.responseCode = TestDnsServer::kServFail;
+    dnsServer.setRecord("stale.test", record);
+    delay(1200);
+    queriesCount = dnsServer.queriesCount("stale.test");
+    QCOMPARE(resolveAndWait(dnsCache, "stale.test", 4, dnsServers, 500).at(1).toStringList(), QStringList() << "10.0.0.2");
+    QTRY_VERIFY_WITH_TIMEOUT(dnsServer.queriesCount("stale.test") > queriesCount, 5000);
+    delay(1000);
+    QList<QVariant> arguments = resolveAndWait(dnsCache, "stale.test", 5, dnsServers, 500);
+    QVERIFY(arguments.at(0).toBool() == true);
+    QCOMPARE(arguments.at(1).toStringList(), QStringList() << "10.0.0.2");
+    QVERIFY(arguments.at(3).toBool() == true);
+    QCOMPARE(dnsCache->statistics().negativeHits, (quint64)0);
+#endif
+}
+
+QList<QVariant> TestDnsCache::resolveAndWait(DnsCache *dnsCache, const QString &hostname, quint64 id, const QStringList &dnsServers, int timeoutMs)
+{
+    QSignalSpy spy(dnsCache, SIGNAL(resolved(bool, QStringList, quint64, bool, int)));
+    dnsCache->resolve(hostname, id, false, dnsServers, timeoutMs);
+    // the background refreshes don't emit the signal, so the first one is ours
+    if (spy.count() == 0)
+        spy.wait(timeoutMs + 5000);
+    if (spy.count() == 0)
+        return QList<QVariant>() << false << QStringList() << id << false << 0;
+    return spy.takeFirst();
+}
 
 void TestDnsCache::delay(int ms)
 {
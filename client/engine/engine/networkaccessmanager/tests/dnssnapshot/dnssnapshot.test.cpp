@@ -0,0 +1,201 @@
+#include <QtTest>
+#include <QCoreApplication>
+#include <QTemporaryDir>
+#include "engine/networkaccessmanager/dnscache.h"
+#include "engine/networkaccessmanager/networkaccessmanager.h"
+#include "../common/testhttpserver.h"
+#include "../../../dnsresolver/tests/testdnsserver.h"
+
+// The on-disk snapshot of DnsCache: the entries survive the restart and are revalidated in the background,
+// the expired entries and the corrupted files are ignored.
+// The startup benchmark compares the time to the first API response after the restart with the cold and the warm DNS cache,
+// the local DNS server answers with a delay.
+class TestDnsSnapshot : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanup();
+
+    void test_warm_start();
+    void test_expired_entries();
+    void test_corrupted_file_data();
+    void test_corrupted_file();
+    void test_startup_benchmark();
+
+private:
+    static constexpr int kDnsDelayMs = 300;
+    static constexpr int kBenchmarkRounds = 5;
+
+    QTemporaryDir tempDir_;
+    TestDnsServer *dnsServer_ = nullptr;
+    TestHttpServer *httpServer_ = nullptr;
+
+    QString snapshotPath(const QString &name) const;
+    // resolves the hostname and returns the value of bFromCache, -1 on error
+    int resolve(DnsCache &dnsCache, const QString &hostname);
+    // creates the cache, resolves the hostname and saves the snapshot on deletion
+    void makeSnapshot(const QString &filePath, const QString &hostname, int cacheTimeoutMs = 60000);
+    // returns the time to the response of the first request after the restart
+    qint64 firstResponseMs(const QString &snapshotFilePath);
+};
+
+void TestDnsSnapshot::initTestCase()
+{
+    QVERIFY(tempDir_.isValid());
+
+    dnsServer_ = new TestDnsServer(this);
+    TestDnsServer::Record record;
+    record.ipv4 << "127.0.0.1";
+    dnsServer_->setDefaultRecord(record);
+    dnsServer_->setDelayMs(kDnsDelayMs);
+    QVERIFY(dnsServer_->startServer());
+
+    httpServer_ = new TestHttpServer(this, false);
+    QVERIFY(httpServer_->start());
+}
+
+void TestDnsSnapshot::cleanup()
+{
+    dnsServer_->resetCounters();
+}
+
+void TestDnsSnapshot::test_warm_start()
+{
+    const QString filePath = snapshotPath("warm");
+    makeSnapshot(filePath, "api.test");
+    QVERIFY(QFile::exists(filePath));
+    QCOMPARE(dnsServer_->queriesCount("api.test"), 1);
+
+    DnsCache dnsCache(nullptr);
+    dnsCache.setSnapshotFile(filePath);
+    QCOMPARE(resolve(dnsCache, "api.test"), 1);
+    QCOMPARE(dnsCache.statistics().snapshotHits, (quint64)1);
+    QCOMPARE(dnsCache.statistics().backgroundRefreshes, (quint64)1);
+    // revalidated in the background, only once
+    QTRY_COMPARE_WITH_TIMEOUT(dnsServer_->queriesCount("api.test"), 2, 5000);
+    QCOMPARE(resolve(dnsCache, "api.test"), 1);
+    QCOMPARE(dnsCache.statistics().snapshotHits, (quint64)1);
+    QCOMPARE(dnsCache.statistics().backgroundRefreshes, (quint64)1);
+
+    // the other hostnames are resolved as usual
+    QCOMPARE(resolve(dnsCache, "other.test"), 0);
+}
+
+void TestDnsSnapshot::test_expired_entries()
+{
+    const QString filePath = snapshotPath("expired");
+    makeSnapshot(filePath, "api.test", 500);
+    QTest::qWait(700);
+
+    DnsCache dnsCache(nullptr);
+    dnsCache.setSnapshotFile(filePath);
+    QCOMPARE(resolve(dnsCache, "api.test"), 0);
+    QCOMPARE(dnsCache.statistics().snapshotHits, (quint64)0);
+}
+
+void TestDnsSnapshot::test_corrupted_file_data()
+{
+    QTest::addColumn<int>("corruption");
+    QTest::newRow("flipped byte") << 0;
+    QTest::newRow("truncated") << 1;
+    QTest::newRow("garbage") << 2;
+    QTest::newRow("empty") << 3;
+}
+
+void TestDnsSnapshot::test_corrupted_file()
+{
+    QFETCH(int, corruption);
+    const QString filePath = snapshotPath(QString("corrupted%1").arg(corruption));
+    makeSnapshot(filePath, "api.test");
+
+    QFile file(filePath);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QByteArray data = file.readAll();
+    file.close();
+    QVERIFY(data.size() > 32);
+    if (corruption == 0)
+        data[data.size() / 2] = data[data.size() / 2] ^ 0x5A;
+    else if (corruption == 1)
+        data.truncate(data.size() - 10);
+    else if (corruption == 2)
+        data = QByteArray(data.size(), 'x');
+    else
+        data.clear();
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write(data);
+    file.close();
+
+    DnsCache dnsCache(nullptr);
+    dnsCache.setSnapshotFile(filePath);
+    QCOMPARE(resolve(dnsCache, "api.test"), 0);
+    QCOMPARE(dnsCache.statistics().snapshotHits, (quint64)0);
+}
+
+void TestDnsSnapshot::test_startup_benchmark()
+{
+    qint64 coldMs = 0, warmMs = 0;
+    for (int i = 0; i < kBenchmarkRounds; ++i) {
+        const QString filePath = snapshotPath(QString("benchmark%1").arg(i));
+        const qint64 cold = firstResponseMs(filePath);
+        const qint64 warm = firstResponseMs(filePath);
+        QVERIFY(cold >= 0 && warm >= 0);
+        coldMs += cold;
+        warmMs += warm;
+    }
+    coldMs /= kBenchmarkRounds;
+    warmMs /= kBenchmarkRounds;
+    qDebug() << "time to the first API response, DNS delay" << kDnsDelayMs << "ms: cold cache" << coldMs << "ms, warm cache" << warmMs << "ms";
+
+    QVERIFY(coldMs >= kDnsDelayMs * 9 / 10);
+    QVERIFY(warmMs < kDnsDelayMs / 2);
+}
+
+QString TestDnsSnapshot::snapshotPath(const QString &name) const
+{
+    return tempDir_.filePath(name + "/dnscache.dat");
+}
+
+int TestDnsSnapshot::resolve(DnsCache &dnsCache, const QString &hostname)
+{
+    QSignalSpy spy(&dnsCache, &DnsCache::resolved);
+    dnsCache.resolve(hostname, 0, false, QStringList() << dnsServer_->address());
+    if (spy.isEmpty())
+        spy.wait(5000);
+    if (spy.isEmpty() || !spy.first().at(0).toBool())
+        return -1;
+    return spy.first().at(3).toBool() ? 1 : 0;
+}
+
+void TestDnsSnapshot::makeSnapshot(const QString &filePath, const QString &hostname, int cacheTimeoutMs)
+{
+    DnsCache dnsCache(nullptr, cacheTimeoutMs);
+    dnsCache.setSnapshotFile(filePath);
+    QCOMPARE(resolve(dnsCache, hostname), 0);
+}
+
+qint64 TestDnsSnapshot::firstResponseMs(const QString &snapshotFilePath)
+{
+    QUrl url = httpServer_->url("/Session");
+    url.setHost("api.test");
+    NetworkRequest request(url, 5000, true, QStringList() << dnsServer_->address(), false);
+    request.setIsWhiteListIps(false);
+
+    // the manager is recreated as after the restart of the engine, the snapshot is saved on its deletion
+    NetworkAccessManager manager;
+    manager.setDnsCacheSnapshotFile(snapshotFilePath);
+
+    QElapsedTimer elapsedTimer;
+    elapsedTimer.start();
+    NetworkReply *reply = manager.get(request);
+    QSignalSpy signalFinished(reply, &NetworkReply::finished);
+    signalFinished.wait(10000);
+    const qint64 elapsedMs = elapsedTimer.elapsed();
+    const bool isSuccess = !signalFinished.isEmpty() && reply->isSuccess();
+    delete reply;
+    return isSuccess ? elapsedMs : -1;
+}
+
+QTEST_MAIN(TestDnsSnapshot)
+#include "dnssnapshot.test.moc"
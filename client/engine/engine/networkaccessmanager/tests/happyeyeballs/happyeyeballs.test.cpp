@@ -0,0 +1,187 @@
+#include <QtTest>
+#include <QCoreApplication>
+#include "engine/dnsresolver/dnsrequest.h"
+#include "engine/dnsresolver/dnsresolver_posix.h"
+#include "engine/networkaccessmanager/networkaccessmanager.h"
+#include "../common/testhttpserver.h"
+#include "../../../dnsresolver/tests/testdnsserver.h"
+
+// Dual-stack resolution against the local DNS server (the A and AAAA queries in parallel) and the Happy Eyeballs mode
+// of NetworkAccessManager against an HTTP server listening on ::1 only, while the IPv4 address of the hostname is unreachable.
+class TestHappyEyeballs : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanup();
+
+    void test_dual_stack_lookup_data();
+    void test_dual_stack_lookup();
+    void test_parallel_queries();
+    void test_happy_eyeballs();
+    void test_ipv4_only_by_default();
+    void test_ipv6_blocked();
+
+private:
+    static constexpr int kDnsDelayMs = 500;
+    static constexpr int kRequestTimeoutMs = 3000;
+
+    TestDnsServer *dnsServer_ = nullptr;
+    TestHttpServer *ipv6Server_ = nullptr;
+
+    NetworkRequest makeRequest(const QString &hostname) const;
+    // returns the error of the finished reply
+    static NetworkReply::NetworkError execute(NetworkAccessManager &manager, const NetworkRequest &request);
+    QStringList lookup(const QString &hostname, bool isDualStack, qint64 *outElapsedMs = nullptr);
+};
+
+void TestHappyEyeballs::initTestCase()
+{
+    ipv6Server_ = new TestHttpServer(this, false);
+    if (!ipv6Server_->start(QHostAddress::LocalHostIPv6))
+        QSKIP("IPv6 loopback is not available");
+
+    dnsServer_ = new TestDnsServer(this);
+    TestDnsServer::Record record;
+    record.ipv4 << "127.0.0.1";
+    record.ipv6 << "::1";
+    dnsServer_->setRecord("dual.test", record);
+
+    // nothing listens on the IPv4 address (TEST-NET-1, RFC 5737), the connections to it hang or fail
+    record.ipv4 = QStringList() << "192.0.2.1";
+    dnsServer_->setRecord("race.test", record);
+
+    record.ipv4.clear();
+    dnsServer_->setRecord("v6only.test", record);
+
+    record = TestDnsServer::Record();
+    record.ipv4 << "127.0.0.1";
+    record.ipv6 << "::1";
+    record.delayMs = kDnsDelayMs;
+    dnsServer_->setRecord("slow.test", record);
+    QVERIFY(dnsServer_->startServer());
+}
+
+void TestHappyEyeballs::cleanup()
+{
+    DnsResolver_posix::instance().setUseSharedChannel(false);
+    if (dnsServer_)
+        dnsServer_->resetCounters();
+}
+
+void TestHappyEyeballs::test_dual_stack_lookup_data()
+{
+    QTest::addColumn<bool>("isSharedChannel");
+    QTest::newRow("thread pool") << false;
+    QTest::newRow("shared channel") << true;
+}
+
+void TestHappyEyeballs::test_dual_stack_lookup()
+{
+    QFETCH(bool, isSharedChannel);
+    DnsResolver_posix::instance().setUseSharedChannel(isSharedChannel);
+
+    QCOMPARE(lookup("dual.test", false), QStringList() << "127.0.0.1");
+    QCOMPARE(dnsServer_->queriesCount("dual.test"), 1);
+
+    const QStringList ips = lookup("dual.test", true);
+    QCOMPARE(ips.size(), 2);
+    QVERIFY(ips.contains("127.0.0.1"));
+    QVERIFY(ips.contains("::1"));
+    // A and AAAA
+    QCOMPARE(dnsServer_->queriesCount("dual.test"), 3);
+
+    QVERIFY(lookup("v6only.test", false).isEmpty());
+    QCOMPARE(lookup("v6only.test", true), QStringList() << "::1");
+}
+
+void TestHappyEyeballs::test_parallel_queries()
+{
+    qint64 elapsedMs = 0;
+    const QStringList ips = lookup("slow.test", true, &elapsedMs);
+    QCOMPARE(ips.size(), 2);
+    qDebug() << "dual-stack lookup with" << kDnsDelayMs << "ms DNS delay:" << elapsedMs << "ms";
+    // the sequential A and AAAA queries would take twice the delay
+    QVERIFY(elapsedMs < kDnsDelayMs * 2 - 100);
+}
+
+void TestHappyEyeballs::test_happy_eyeballs()
+{
+    NetworkAccessManager manager;
+    manager.setHappyEyeballs(true);
+    QVERIFY(manager.isIPv6Allowed());
+
+    QElapsedTimer elapsedTimer;
+    elapsedTimer.start();
+    QCOMPARE(execute(manager, makeRequest("race.test")), NetworkReply::NoError);
+    qDebug() << "the request over IPv6 with the unreachable IPv4 address:" << elapsedTimer.elapsed() << "ms";
+    QVERIFY(elapsedTimer.elapsed() < kRequestTimeoutMs);
+    QCOMPARE(ipv6Server_->requestsCount(), 1);
+
+    QCOMPARE(execute(manager, makeRequest("v6only.test")), NetworkReply::NoError);
+    QCOMPARE(ipv6Server_->requestsCount(), 2);
+    ipv6Server_->resetCounters();
+}
+
+void TestHappyEyeballs::test_ipv4_only_by_default()
+{
+    NetworkAccessManager manager;
+    QVERIFY(!manager.isHappyEyeballs());
+
+    QCOMPARE(execute(manager, makeRequest("race.test")), NetworkReply::CurlError);
+    QCOMPARE(execute(manager, makeRequest("v6only.test")), NetworkReply::DnsResolveError);
+    QCOMPARE(ipv6Server_->requestsCount(), 0);
+}
+
+void TestHappyEyeballs::test_ipv6_blocked()
+{
+    NetworkAccessManager manager;
+    manager.setHappyEyeballs(true);
+    manager.setIPv6Allowed(false);
+
+    QCOMPARE(execute(manager, makeRequest("race.test")), NetworkReply::CurlError);
+    QCOMPARE(execute(manager, makeRequest("v6only.test")), NetworkReply::DnsResolveError);
+    QCOMPARE(ipv6Server_->requestsCount(), 0);
+
+    // allowed again, e.g. the firewall is off
+    manager.setIPv6Allowed(true);
+    QCOMPARE(execute(manager, makeRequest("v6only.test")), NetworkReply::NoError);
+    QCOMPARE(ipv6Server_->requestsCount(), 1);
+    ipv6Server_->resetCounters();
+}
+
+NetworkRequest TestHappyEyeballs::makeRequest(const QString &hostname) const
+{
+    QUrl url = ipv6Server_->url("/get");
+    url.setHost(hostname);
+    NetworkRequest request(url, kRequestTimeoutMs, false, QStringList() << dnsServer_->address(), false);
+    request.setIsWhiteListIps(false);
+    request.setUseFreshConnection(true);
+    return request;
+}
+
+NetworkReply::NetworkError TestHappyEyeballs::execute(NetworkAccessManager &manager, const NetworkRequest &request)
+{
+    NetworkReply *reply = manager.get(request);
+    QSignalSpy signalFinished(reply, &NetworkReply::finished);
+    signalFinished.wait(kRequestTimeoutMs * 3);
+    const NetworkReply::NetworkError error = signalFinished.isEmpty() ? NetworkReply::TimeoutExceed : reply->error();
+    delete reply;
+    return error;
+}
+
+QStringList TestHappyEyeballs::lookup(const QString &hostname, bool isDualStack, qint64 *outElapsedMs)
+{
+    DnsRequest request(this, hostname, QStringList() << dnsServer_->address(), 2000);
+    request.setDualStack(isDualStack);
+    QSignalSpy signalFinished(&request, &DnsRequest::finished);
+    request.lookup();
+    signalFinished.wait(5000);
+    if (outElapsedMs)
+        *outElapsedMs = request.elapsedMs();
+    return request.isError() ? QStringList() : request.ips();
+}
+
+QTEST_MAIN(TestHappyEyeballs)
+#include "happyeyeballs.test.moc"
@@ -0,0 +1,300 @@
+#include <QtTest>
+#include <QCoreApplication>
+#include <QRandomGenerator>
+#include <QSet>
+#include <QThread>
+#include <algorithm>
+#include <atomic>
+#ifdef Q_OS_WIN
+#include <WinSock2.h>
+#endif
+#include "engine/networkaccessmanager/networkaccessmanager.h"
+#include "../common/testhttpserver.h"
+
+// Issues the requests from its own thread keeping several of them in flight, aborts or deletes some of them
+// right away or after a random delay and checks that the rest are delivered in this thread with the correct body.
+class RequestsWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    RequestsWorker(NetworkAccessManager *manager, const QUrl &baseUrl, int index, int requestsCount, int inFlightCount) :
+        manager_(manager), baseUrl_(baseUrl), index_(index), requestsCount_(requestsCount), inFlightCount_(inFlightCount),
+        issued_(0), finished_(0), aborted_(0), errors_(0), isDone_(false)
+    {}
+
+    int finishedCount() const { return finished_; }
+    int abortedCount() const { return aborted_; }
+    int errorsCount() const { return errors_; }
+    bool isDone() const { return isDone_; }
+
+public slots:
+    void start()
+    {
+        issueRequests();
+    }
+
+private:
+    enum Mode { kAbortImmediately, kDeleteImmediately, kAbortDelayed, kNormal, kModesCount };
+
+    NetworkAccessManager *manager_;
+    QUrl baseUrl_;
+    int index_;
+    int requestsCount_;
+    int inFlightCount_;
+    int issued_;
+    QSet<NetworkReply *> inFlight_;
+
+    std::atomic<int> finished_;
+    std::atomic<int> aborted_;
+    std::atomic<int> errors_;
+    std::atomic<bool> isDone_;
+
+    void issueRequests()
+    {
+        while (issued_ < requestsCount_ && inFlight_.size() < inFlightCount_) {
+            const int i = issued_++;
+            const Mode mode = static_cast<Mode>(i % kModesCount);
+            QUrl url = baseUrl_;
+            // every fifth request is answered with a delay, so the delayed aborts hit the requests in progress
+            url.setPath(QString("/%1/%2/%3").arg(i % 5 == 0 ? "slow" : "fast").arg(index_).arg(i));
+            NetworkRequest request(url, 30000, false);
+            request.setOverrideIp("127.0.0.1");
+            request.setIsWhiteListIps(false);
+
+            NetworkReply *reply = manager_->get(request);
+            if (mode == kAbortImmediately) {
+                reply->abort();
+                delete reply;
+                aborted_++;
+                continue;
+            } else if (mode == kDeleteImmediately) {
+                delete reply;
+                aborted_++;
+                continue;
+            }
+
+            inFlight_.insert(reply);
+            const QByteArray path = url.path().toLatin1();
+            connect(reply, &NetworkReply::readyRead, this, [this]() {
+                checkThread();
+            });
+            connect(reply, &NetworkReply::finished, this, [this, reply, path]() {
+                checkThread();
+                if (!reply->isSuccess() || reply->readAll() != path)
+                    errors_++;
+                finished_++;
+                complete(reply);
+            });
+            if (mode == kAbortDelayed) {
+                QTimer::singleShot(QRandomGenerator::global()->bounded(30), reply, [this, reply]() {
+                    checkThread();
+                    // already finished
+                    if (!inFlight_.contains(reply))
+                        return;
+                    reply->abort();
+                    aborted_++;
+                    complete(reply);
+                });
+            }
+        }
+
+        if (issued_ == requestsCount_ && inFlight_.isEmpty())
+            isDone_ = true;
+    }
+
+    void complete(NetworkReply *reply)
+    {
+        if (!inFlight_.remove(reply))
+            return;
+        reply->deleteLater();
+        // not from the reply's signal handler, so the next requests are issued from the event loop as the real callers do
+        QMetaObject::invokeMethod(this, [this]() { issueRequests(); }, Qt::QueuedConnection);
+    }
+
+    void checkThread()
+    {
+        if (QThread::currentThread() != thread())
+            errors_++;
+    }
+};
+
+// Hammers one NetworkAccessManager from many threads against a local server.
+// Build with -DENABLE_THREAD_SANITIZER=ON to check it under ThreadSanitizer.
+class TestNetworkAccessManagerThreads : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestNetworkAccessManagerThreads();
+    ~TestNetworkAccessManagerThreads();
+
+private slots:
+    void initTestCase();
+
+    void test_reply_thread();
+    void test_abort_from_other_thread();
+    void test_stress();
+
+private:
+    static constexpr int kThreads = 16;
+    static constexpr int kRequestsPerThread = 200;
+    static constexpr int kInFlightPerThread = 8;
+
+    TestHttpServer *server_;
+};
+
+
+TestNetworkAccessManagerThreads::TestNetworkAccessManagerThreads() : server_(nullptr)
+{
+#ifdef Q_OS_WIN
+    // Initialize Winsock
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2,2), &wsaData);
+#endif
+}
+
+TestNetworkAccessManagerThreads::~TestNetworkAccessManagerThreads()
+{
+}
+
+void TestNetworkAccessManagerThreads::initTestCase()
+{
+    server_ = new TestHttpServer(this, false);
+    server_->setHandler([](const TestHttpServer::Request &request) {
+        TestHttpServer::Response response;
+        response.body = request.path;
+        if (request.path.startsWith("/slow"))
+            response.delayMs = 20;
+        else if (request.path.startsWith("/hang"))
+            response.delayMs = 2000;
+        return response;
+    });
+    QVERIFY(server_->start());
+}
+
+void TestNetworkAccessManagerThreads::test_reply_thread()
+{
+    NetworkAccessManager manager;
+    NetworkRequest request(server_->url("/get"), 10000, false);
+    request.setOverrideIp("127.0.0.1");
+    request.setIsWhiteListIps(false);
+
+    QThread thread;
+    thread.start();
+    QObject context;
+    context.moveToThread(&thread);
+
+    std::atomic<bool> isFinished(false);
+    std::atomic<bool> isRightThread(false);
+    bool hasParent = true;
+    QByteArray body;
+    NetworkReply *reply = nullptr;
+    QMetaObject::invokeMethod(&context, [&]() {
+        reply = manager.get(request);
+        hasParent = (reply->parent() != nullptr);
+        connect(reply, &NetworkReply::finished, &context, [&]() {
+            isRightThread = (QThread::currentThread() == &thread);
+            body = reply->readAll();
+            delete reply;
+            isFinished = true;
+        });
+    }, Qt::BlockingQueuedConnection);
+
+    // not owned by the manager, which lives in another thread
+    QVERIFY(!hasParent);
+    QTRY_VERIFY_WITH_TIMEOUT(isFinished, 10000);
+    QVERIFY(isRightThread);
+    QCOMPARE(body, QByteArray("/get"));
+
+    thread.quit();
+    thread.wait();
+}
+
+void TestNetworkAccessManagerThreads::test_abort_from_other_thread()
+{
+    NetworkAccessManager manager;
+    NetworkRequest request(server_->url("/hang"), 10000, false);
+    request.setOverrideIp("127.0.0.1");
+    request.setIsWhiteListIps(false);
+    server_->resetCounters();
+
+    QThread thread;
+    thread.start();
+    QObject context;
+    context.moveToThread(&thread);
+
+    std::atomic<bool> isFinished(false);
+    NetworkReply *reply = nullptr;
+    QMetaObject::invokeMethod(&context, [&]() {
+        reply = manager.get(request);
+        connect(reply, &NetworkReply::finished, &context, [&]() { isFinished = true; });
+    }, Qt::BlockingQueuedConnection);
+
+    // let the request reach the server, then abort and delete it before the delayed response
+    QTRY_VERIFY_WITH_TIMEOUT(server_->requestsCount() > 0, 10000);
+    QMetaObject::invokeMethod(&context, [&]() { delete reply; }, Qt::BlockingQueuedConnection);
+
+    QTest::qWait(200);
+    QVERIFY(!isFinished);
+
+    thread.quit();
+    thread.wait();
+}
+
+void TestNetworkAccessManagerThreads::test_stress()
+{
+    NetworkAccessManager manager;
+    RequestScheduler::Limits limits;
+    limits.maxTotal = 64;
+    limits.maxPerHost = 32;
+    manager.setSchedulerLimits(limits);
+
+    QVector<QThread *> threads;
+    QVector<RequestsWorker *> workers;
+    for (int i = 0; i < kThreads; ++i) {
+        QThread *thread = new QThread();
+        RequestsWorker *worker = new RequestsWorker(&manager, server_->url(), i, kRequestsPerThread, kInFlightPerThread);
+        worker->moveToThread(thread);
+        connect(thread, &QThread::started, worker, &RequestsWorker::start);
+        threads << thread;
+        workers << worker;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    for (QThread *thread : threads)
+        thread->start();
+
+    // the server and the manager live in this thread, so keep the event loop running
+    auto allDone = [&workers]() {
+        return std::all_of(workers.begin(), workers.end(), [](RequestsWorker *worker) { return worker->isDone(); });
+    };
+    QTRY_VERIFY_WITH_TIMEOUT(allDone(), 120000);
+
+    int finished = 0;
+    int aborted = 0;
+    int errors = 0;
+    for (RequestsWorker *worker : workers) {
+        finished += worker->finishedCount();
+        aborted += worker->abortedCount();
+        errors += worker->errorsCount();
+    }
+    qDebug() << kThreads << "threads," << kThreads * kRequestsPerThread << "requests in" << timer.elapsed() << "ms:"
+             << finished << "finished," << aborted << "aborted";
+
+    // the deferred deletions of the replies are processed when the threads finish, before the manager is deleted
+    for (QThread *thread : threads) {
+        thread->quit();
+        thread->wait();
+    }
+    qDeleteAll(workers);
+    qDeleteAll(threads);
+
+    QCOMPARE(errors, 0);
+    QVERIFY(finished > 0);
+    QVERIFY(aborted > 0);
+}
+
+QTEST_MAIN(TestNetworkAccessManagerThreads)
+#include "networkaccessmanagerthreads.test.moc"
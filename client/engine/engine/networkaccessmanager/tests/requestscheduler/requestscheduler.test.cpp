@@ -0,0 +1,247 @@
+#include <QtTest>
+#include <QCoreApplication>
+#include <algorithm>
+#ifdef Q_OS_WIN
+#include <WinSock2.h>
+#endif
+#include "engine/networkaccessmanager/networkaccessmanager.h"
+#include "engine/networkaccessmanager/requestscheduler.h"
+#include "../common/testhttpserver.h"
+
+// Checks the admission rules of RequestScheduler and shows with a local slow server that the interactive requests
+// of NetworkAccessManager keep their latency while hundreds of background requests are queued.
+class TestRequestScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestRequestScheduler();
+    ~TestRequestScheduler();
+
+private slots:
+    void initTestCase();
+
+    void test_priority_order();
+    void test_per_host_limit();
+    void test_interactive_reserve();
+    void test_aging();
+    void test_remove_waiting();
+
+    void test_interactive_latency_under_background_load();
+    void test_background_requests_complete();
+
+private:
+    static constexpr int kSlowResponseMs = 2000;
+    static constexpr int kBackgroundRequests = 500;
+
+    TestHttpServer *server_;
+
+    NetworkRequest makeRequest(const QString &path, NetworkRequest::Priority priority) const;
+    static RequestScheduler::Limits makeLimits(int maxTotal, int maxPerHost, int interactiveReserve, int agingMs);
+};
+
+
+TestRequestScheduler::TestRequestScheduler() : server_(nullptr)
+{
+#ifdef Q_OS_WIN
+    // Initialize Winsock
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2,2), &wsaData);
+#endif
+}
+
+TestRequestScheduler::~TestRequestScheduler()
+{
+}
+
+void TestRequestScheduler::initTestCase()
+{
+    server_ = new TestHttpServer(this, false);
+    server_->setHandler([](const TestHttpServer::Request &request) {
+        TestHttpServer::Response response;
+        response.body = request.path;
+        if (request.path.startsWith("/slow"))
+            response.delayMs = kSlowResponseMs;
+        return response;
+    });
+    QVERIFY(server_->start());
+}
+
+void TestRequestScheduler::test_priority_order()
+{
+    RequestScheduler scheduler(makeLimits(1, 1, 0, 0));
+    scheduler.enqueue(1, "a", NetworkRequest::Priority::kBackground);
+    scheduler.enqueue(2, "a", NetworkRequest::Priority::kNormal);
+    scheduler.enqueue(3, "a", NetworkRequest::Priority::kInteractive);
+    scheduler.enqueue(4, "a", NetworkRequest::Priority::kNormal);
+
+    QCOMPARE(scheduler.takeStartable(), QVector<quint64>({ 3 }));
+    QVERIFY(scheduler.takeStartable().isEmpty());
+    scheduler.remove(3);
+    QCOMPARE(scheduler.takeStartable(), QVector<quint64>({ 2 }));
+    scheduler.remove(2);
+    QCOMPARE(scheduler.takeStartable(), QVector<quint64>({ 4 }));
+    scheduler.remove(4);
+    QCOMPARE(scheduler.takeStartable(), QVector<quint64>({ 1 }));
+    scheduler.remove(1);
+    QCOMPARE(scheduler.runningCount(), 0);
+    QCOMPARE(scheduler.waitingCount(), 0);
+}
+
+void TestRequestScheduler::test_per_host_limit()
+{
+    RequestScheduler scheduler(makeLimits(10, 2, 0, 0));
+    for (quint64 id = 1; id <= 5; ++id)
+        scheduler.enqueue(id, "a", NetworkRequest::Priority::kNormal);
+    scheduler.enqueue(6, "b", NetworkRequest::Priority::kBackground);
+
+    // the blocked host doesn't block the requests to the other hosts
+    QCOMPARE(scheduler.takeStartable(), QVector<quint64>({ 1, 2, 6 }));
+    scheduler.remove(1);
+    QCOMPARE(scheduler.takeStartable(), QVector<quint64>({ 3 }));
+    QCOMPARE(scheduler.runningCount(), 3);
+    QCOMPARE(scheduler.waitingCount(), 2);
+}
+
+void TestRequestScheduler::test_interactive_reserve()
+{
+    RequestScheduler scheduler(makeLimits(2, 2, 1, 0));
+    scheduler.enqueue(1, "a", NetworkRequest::Priority::kBackground);
+    scheduler.enqueue(2, "a", NetworkRequest::Priority::kBackground);
+    scheduler.enqueue(3, "a", NetworkRequest::Priority::kBackground);
+    QCOMPARE(scheduler.takeStartable(), QVector<quint64>({ 1, 2 }));
+
+    // all the regular slots are busy, the interactive request takes the reserved one
+    scheduler.enqueue(4, "a", NetworkRequest::Priority::kInteractive);
+    scheduler.enqueue(5, "a", NetworkRequest::Priority::kInteractive);
+    QCOMPARE(scheduler.takeStartable(), QVector<quint64>({ 4 }));
+
+    // the released regular slot goes to the waiting interactive request, not to the older background one
+    scheduler.remove(1);
+    QCOMPARE(scheduler.takeStartable(), QVector<quint64>({ 5 }));
+}
+
+void TestRequestScheduler::test_aging()
+{
+    RequestScheduler scheduler(makeLimits(1, 1, 0, 100));
+    scheduler.enqueue(1, "a", NetworkRequest::Priority::kInteractive);
+    scheduler.enqueue(2, "a", NetworkRequest::Priority::kBackground);
+    QCOMPARE(scheduler.takeStartable(), QVector<quint64>({ 1 }));
+
+    // a fresh interactive request wins over the background one which has not waited long enough
+    scheduler.enqueue(3, "a", NetworkRequest::Priority::kInteractive);
+    scheduler.remove(1);
+    QCOMPARE(scheduler.takeStartable(), QVector<quint64>({ 3 }));
+
+    // after two aging intervals the background request is raised to the interactive class and wins as the older one
+    QTest::qWait(250);
+    scheduler.enqueue(4, "a", NetworkRequest::Priority::kInteractive);
+    scheduler.remove(3);
+    QCOMPARE(scheduler.takeStartable(), QVector<quint64>({ 2 }));
+}
+
+void TestRequestScheduler::test_remove_waiting()
+{
+    RequestScheduler scheduler(makeLimits(1, 1, 0, 0));
+    scheduler.enqueue(1, "a", NetworkRequest::Priority::kNormal);
+    scheduler.enqueue(2, "a", NetworkRequest::Priority::kNormal);
+    scheduler.enqueue(3, "a", NetworkRequest::Priority::kNormal);
+    QCOMPARE(scheduler.takeStartable(), QVector<quint64>({ 1 }));
+    scheduler.remove(2);
+    scheduler.remove(1);
+    QCOMPARE(scheduler.takeStartable(), QVector<quint64>({ 3 }));
+    // unknown ids are ignored
+    scheduler.remove(100);
+    QCOMPARE(scheduler.runningCount(), 1);
+}
+
+void TestRequestScheduler::test_interactive_latency_under_background_load()
+{
+    NetworkAccessManager manager;
+    QVector<NetworkReply *> backgroundReplies;
+    for (int i = 0; i < kBackgroundRequests; ++i)
+        backgroundReplies << manager.get(makeRequest(QString("/slow/%1").arg(i), NetworkRequest::Priority::kBackground));
+    // let the background requests occupy all the slots for the host
+    QTest::qWait(300);
+
+    const int kInteractiveRequests = 10;
+    QVector<qint64> latencies;
+    for (int i = 0; i < kInteractiveRequests; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        NetworkReply *reply = manager.get(makeRequest(QString("/login/%1").arg(i), NetworkRequest::Priority::kInteractive));
+        QSignalSpy signalFinished(reply, &NetworkReply::finished);
+        QVERIFY(signalFinished.wait(kSlowResponseMs * 5));
+        QVERIFY(reply->isSuccess());
+        latencies << timer.elapsed();
+        delete reply;
+    }
+
+    // the same request with the normal priority has no reserved slots, it waits until a background request releases its slot
+    QElapsedTimer timer;
+    timer.start();
+    NetworkReply *normalReply = manager.get(makeRequest("/normal", NetworkRequest::Priority::kNormal));
+    QSignalSpy normalFinished(normalReply, &NetworkReply::finished);
+    normalFinished.wait(1000);
+    const bool isNormalFinished = !normalFinished.isEmpty();
+
+    std::sort(latencies.begin(), latencies.end());
+    qDebug() << kBackgroundRequests << "background requests queued, interactive latency: median" << latencies[latencies.size() / 2]
+             << "ms, max" << latencies.last() << "ms; normal request" << (isNormalFinished ? "finished in" : "still waiting after") << timer.elapsed() << "ms";
+
+    // well below the slow response time, i.e. the interactive requests were not queued behind the background ones
+    QVERIFY2(latencies.last() < kSlowResponseMs / 2, qPrintable(QString("max latency = %1 ms").arg(latencies.last())));
+    QVERIFY(!isNormalFinished);
+
+    delete normalReply;
+    // the waiting ones first, so the released slots don't start the rest
+    std::reverse(backgroundReplies.begin(), backgroundReplies.end());
+    qDeleteAll(backgroundReplies);
+}
+
+void TestRequestScheduler::test_background_requests_complete()
+{
+    // the queued requests are started as the slots are released, all of them are completed
+    NetworkAccessManager manager;
+    manager.setSchedulerLimits(makeLimits(4, 2, 1, 2000));
+    server_->resetCounters();
+
+    const int kRequests = 20;
+    int finished = 0;
+    int failed = 0;
+    for (int i = 0; i < kRequests; ++i) {
+        NetworkReply *reply = manager.get(makeRequest(QString("/get/%1").arg(i), NetworkRequest::Priority::kBackground));
+        connect(reply, &NetworkReply::finished, this, [&finished, &failed, reply]() {
+            if (!reply->isSuccess())
+                failed++;
+            finished++;
+            reply->deleteLater();
+        });
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(finished, kRequests, 20000);
+    QCOMPARE(failed, 0);
+    // at most 2 requests to the host at once, so the pooled connections are enough
+    QVERIFY2(server_->connectionsCount() <= 2, qPrintable(QString("connections = %1").arg(server_->connectionsCount())));
+}
+
+NetworkRequest TestRequestScheduler::makeRequest(const QString &path, NetworkRequest::Priority priority) const
+{
+    NetworkRequest request(server_->url(path), 60000, false);
+    request.setOverrideIp("127.0.0.1");
+    request.setIsWhiteListIps(false);
+    request.setPriority(priority);
+    return request;
+}
+
+RequestScheduler::Limits TestRequestScheduler::makeLimits(int maxTotal, int maxPerHost, int interactiveReserve, int agingMs)
+{
+    RequestScheduler::Limits limits;
+    limits.maxTotal = maxTotal;
+    limits.maxPerHost = maxPerHost;
+    limits.interactiveReserve = interactiveReserve;
+    limits.agingMs = agingMs;
+    return limits;
+}
+
+QTEST_MAIN(TestRequestScheduler)
+#include "requestscheduler.test.moc"
@@ -0,0 +1,252 @@
+#include <QtTest>
+#include <QCoreApplication>
+#ifdef Q_OS_WIN
+#include <WinSock2.h>
+#else
+#include "../../../dnsresolver/tests/testdnsserver.h"
+#endif
+#include "engine/networkaccessmanager/networkaccessmanager.h"
+#include "engine/networkaccessmanager/requesttimings.h"
+#include "../common/testhttpserver.h"
+
+// Injects a delay into one phase of the request at a time (the DNS answer, the TLS handshake, the server response)
+// and checks that the timings of NetworkReply attribute it to this phase only. Also checks the rolling percentiles.
+class TestRequestTimings : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestRequestTimings();
+    ~TestRequestTimings();
+
+private slots:
+    void initTestCase();
+
+    void test_percentiles();
+    void test_rolling_window();
+
+    void test_first_byte_phase();
+    void test_tls_phase();
+    void test_dns_phase();
+    void test_reused_connection();
+    void test_stats_by_endpoint();
+
+private:
+    static constexpr int kInjectedDelayMs = 300;
+    // the local phases which are not delayed are expected to be well below this
+    static constexpr qint64 kFastPhaseUs = 100 * 1000;
+    static constexpr qint64 kInjectedDelayUs = kInjectedDelayMs * 1000;
+
+    TestHttpServer *httpServer_;
+    TestHttpServer *tlsServer_;
+
+    NetworkRequest makeRequest(const QUrl &url, bool bUseFreshConnection) const;
+    // returns false if the request failed
+    static bool execute(NetworkAccessManager &manager, const NetworkRequest &request, RequestTimings &outTimings);
+    static RequestTimings makeTimings(qint64 totalMs);
+};
+
+
+TestRequestTimings::TestRequestTimings() : httpServer_(nullptr), tlsServer_(nullptr)
+{
+#ifdef Q_OS_WIN
+    // Initialize Winsock
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2,2), &wsaData);
+#endif
+}
+
+TestRequestTimings::~TestRequestTimings()
+{
+}
+
+void TestRequestTimings::initTestCase()
+{
+    httpServer_ = new TestHttpServer(this, false);
+    httpServer_->setHandler([](const TestHttpServer::Request &request) {
+        TestHttpServer::Response response;
+        response.body = "{}";
+        if (request.path.startsWith("/slow"))
+            response.delayMs = kInjectedDelayMs;
+        return response;
+    });
+    QVERIFY(httpServer_->start());
+
+    tlsServer_ = new TestHttpServer(this, true);
+    tlsServer_->setHandshakeDelayMs(kInjectedDelayMs);
+    QVERIFY(tlsServer_->start());
+}
+
+void TestRequestTimings::test_percentiles()
+{
+    RequestTimingStats stats;
+    for (int i = 1; i <= 100; ++i)
+        stats.add("ServerLocations", "api.example.com", makeTimings(i));
+
+    const RequestTimingStats::Percentiles percentiles = stats.percentiles("ServerLocations", "api.example.com");
+    QCOMPARE(percentiles.count, 100);
+    QCOMPARE(percentiles.p50.totalUs, qint64(50 * 1000));
+    QCOMPARE(percentiles.p90.totalUs, qint64(90 * 1000));
+    QCOMPARE(percentiles.p99.totalUs, qint64(99 * 1000));
+    // every phase is ranked on its own
+    QCOMPARE(percentiles.p50.firstByteUs, qint64(50 * 1000 / 2));
+
+    // the empty domain means all the domains of the endpoint
+    stats.add("ServerLocations", "backup.example.com", makeTimings(1000));
+    QCOMPARE(stats.percentiles("ServerLocations").count, 101);
+    QCOMPARE(stats.percentiles("ServerLocations").p99.totalUs, qint64(100 * 1000));
+    QCOMPARE(stats.percentiles("ServerLocations", "backup.example.com").p50.totalUs, qint64(1000 * 1000));
+    QCOMPARE(stats.percentiles("Session").count, 0);
+    QCOMPARE(stats.keys().size(), 2);
+}
+
+void TestRequestTimings::test_rolling_window()
+{
+    RequestTimingStats stats(10);
+    for (int i = 1; i <= 10; ++i)
+        stats.add("Session", "api.example.com", makeTimings(1000));
+    // the newer samples replace the oldest ones
+    for (int i = 1; i <= 10; ++i)
+        stats.add("Session", "api.example.com", makeTimings(i));
+
+    const RequestTimingStats::Percentiles percentiles = stats.percentiles("Session");
+    QCOMPARE(percentiles.count, 10);
+    QCOMPARE(percentiles.p99.totalUs, qint64(10 * 1000));
+    QCOMPARE(percentiles.p50.totalUs, qint64(5 * 1000));
+
+    stats.clear();
+    QCOMPARE(stats.percentiles("Session").count, 0);
+}
+
+void TestRequestTimings::test_first_byte_phase()
+{
+    NetworkAccessManager manager;
+    RequestTimings timings;
+    QVERIFY(execute(manager, makeRequest(httpServer_->url("/slow"), true), timings));
+    qDebug() << "server delay:" << timings.toString();
+
+    QCOMPARE(timings.dnsUs, qint64(0));
+    QCOMPARE(timings.tlsUs, qint64(0));
+    QVERIFY(timings.connectUs < kFastPhaseUs);
+    QVERIFY(timings.firstByteUs >= kInjectedDelayUs * 9 / 10);
+    QVERIFY(timings.firstByteUs < kInjectedDelayUs + kFastPhaseUs);
+    QVERIFY(timings.totalUs >= timings.firstByteUs);
+}
+
+void TestRequestTimings::test_tls_phase()
+{
+    NetworkAccessManager manager;
+    RequestTimings timings;
+    QVERIFY(execute(manager, makeRequest(tlsServer_->url("/get"), true), timings));
+    qDebug() << "handshake delay:" << timings.toString();
+
+    QCOMPARE(timings.dnsUs, qint64(0));
+    // the kernel accepts the TCP connection right away, the server only delays reading the ClientHello
+    QVERIFY(timings.connectUs < kFastPhaseUs);
+    QVERIFY(timings.tlsUs >= kInjectedDelayUs * 9 / 10);
+    QVERIFY(timings.firstByteUs < kFastPhaseUs);
+    QVERIFY(timings.totalUs >= timings.tlsUs);
+}
+
+void TestRequestTimings::test_dns_phase()
+{
+#ifdef Q_OS_WIN
+    QSKIP("The local DNS server is not available on Windows");
+#else
+    TestDnsServer dnsServer;
+    TestDnsServer::Record record;
+    record.ipv4 << "127.0.0.1";
+    record.delayMs = kInjectedDelayMs;
+    dnsServer.setRecord("timings.example", record);
+    QVERIFY(dnsServer.startServer());
+
+    QUrl url = httpServer_->url("/get");
+    url.setHost("timings.example");
+    NetworkRequest request(url, 10000, false, QStringList() << dnsServer.address(), false);
+    request.setIsWhiteListIps(false);
+
+    NetworkAccessManager manager;
+    RequestTimings timings;
+    QVERIFY(execute(manager, request, timings));
+    qDebug() << "DNS delay:" << timings.toString();
+
+    QVERIFY(timings.dnsUs >= kInjectedDelayUs * 9 / 10);
+    QVERIFY(timings.connectUs < kFastPhaseUs);
+    QVERIFY(timings.firstByteUs < kFastPhaseUs);
+    QVERIFY(timings.totalUs >= timings.dnsUs);
+#endif
+}
+
+void TestRequestTimings::test_reused_connection()
+{
+    NetworkAccessManager manager;
+    RequestTimings first;
+    QVERIFY(execute(manager, makeRequest(tlsServer_->url("/get"), false), first));
+    RequestTimings second;
+    QVERIFY(execute(manager, makeRequest(tlsServer_->url("/get"), false), second));
+    qDebug() << "new connection:" << first.toString() << "reused connection:" << second.toString();
+
+    QVERIFY(first.tlsUs >= kInjectedDelayUs * 9 / 10);
+    // the pooled connection skips the handshake
+    QVERIFY(second.connectUs < kFastPhaseUs);
+    QVERIFY(second.tlsUs < kFastPhaseUs);
+    QVERIFY(second.totalUs < kFastPhaseUs);
+}
+
+void TestRequestTimings::test_stats_by_endpoint()
+{
+    NetworkAccessManager manager;
+    const int kRequests = 5;
+    for (int i = 0; i < kRequests; ++i) {
+        NetworkRequest request = makeRequest(httpServer_->url("/slow"), false);
+        request.setTimingEndpoint("Slow");
+        RequestTimings timings;
+        QVERIFY(execute(manager, request, timings));
+    }
+    NetworkRequest request = makeRequest(httpServer_->url("/get"), false);
+    request.setTimingEndpoint("Fast");
+    RequestTimings timings;
+    QVERIFY(execute(manager, request, timings));
+    // not tagged, not collected
+    QVERIFY(execute(manager, makeRequest(httpServer_->url("/get"), false), timings));
+
+    const RequestTimingStats::Percentiles slow = manager.timingStats().percentiles("Slow", "localhost");
+    QCOMPARE(slow.count, kRequests);
+    QVERIFY(slow.p50.firstByteUs >= kInjectedDelayUs * 9 / 10);
+    const RequestTimingStats::Percentiles fast = manager.timingStats().percentiles("Fast");
+    QCOMPARE(fast.count, 1);
+    QVERIFY(fast.p50.firstByteUs < kFastPhaseUs);
+    QCOMPARE(manager.timingStats().keys().size(), 2);
+}
+
+NetworkRequest TestRequestTimings::makeRequest(const QUrl &url, bool bUseFreshConnection) const
+{
+    NetworkRequest request(url, 10000, false);
+    request.setOverrideIp("127.0.0.1");
+    request.setIsWhiteListIps(false);
+    request.setIgnoreSslErrors(true);
+    request.setUseFreshConnection(bUseFreshConnection);
+    return request;
+}
+
+bool TestRequestTimings::execute(NetworkAccessManager &manager, const NetworkRequest &request, RequestTimings &outTimings)
+{
+    NetworkReply *reply = manager.get(request);
+    QSignalSpy signalFinished(reply, &NetworkReply::finished);
+    signalFinished.wait(10000);
+    const bool isSuccess = !signalFinished.isEmpty() && reply->isSuccess();
+    outTimings = reply->timings();
+    delete reply;
+    return isSuccess;
+}
+
+RequestTimings TestRequestTimings::makeTimings(qint64 totalMs)
+{
+    RequestTimings timings;
+    timings.firstByteUs = totalMs * 1000 / 2;
+    timings.totalUs = totalMs * 1000;
+    return timings;
+}
+
+QTEST_MAIN(TestRequestTimings)
+#include "requesttimings.test.moc"
@@ -11,13 +11,26 @@ const int typeIdPingType = qRegisterMetaType<PingHost::PING_TYPE>("PingHost::PIN
 
 PingHost::PingHost(QObject *parent, IConnectStateController *stateController, NetworkAccessManager *networkAccessManager) : QObject(parent),
     pingHostCurl_(this, stateController, networkAccessManager), pingHostTcp_(this, stateController), pingHostIcmp_(this, stateController)
+#ifdef Q_OS_LINUX
+    , pingHostIcmpNative_(this, stateController), pingHostTcpNative_(this, stateController)
+#endif
 {
     connect(&pingHostCurl_, &PingHost_Curl::pingFinished, this, &PingHost::pingFinished);
+    connect(&pingHostCurl_, &PingHost_Curl::pingStarted, this, &PingHost::pingStarted);
     connect(&pingHostTcp_, &PingHost_TCP::pingFinished, this, &PingHost::pingFinished);
+    connect(&pingHostTcp_, &PingHost_TCP::pingStarted, this, &PingHost::pingStarted);
 #if defined(Q_OS_WIN)
     connect(&pingHostIcmp_, &PingHost_ICMP_win::pingFinished, this, &PingHost::pingFinished);
+    connect(&pingHostIcmp_, &PingHost_ICMP_win::pingStarted, this, &PingHost::pingStarted);
 #else
     connect(&pingHostIcmp_, &PingHost_ICMP_mac::pingFinished, this, &PingHost::pingFinished);
+    connect(&pingHostIcmp_, &PingHost_ICMP_mac::pingStarted, this, &PingHost::pingStarted);
+#endif
+#ifdef Q_OS_LINUX
+    connect(&pingHostIcmpNative_, &PingHost_ICMP_linux::pingFinished, this, &PingHost::pingFinished);
+    connect(&pingHostIcmpNative_, &PingHost_ICMP_linux::pingStarted, this, &PingHost::pingStarted);
+    connect(&pingHostTcpNative_, &PingHost_TCP_linux::pingFinished, this, &PingHost::pingFinished);
+    connect(&pingHostTcpNative_, &PingHost_TCP_linux::pingStarted, this, &PingHost::pingStarted);
 #endif
 }
 
@@ -71,9 +84,21 @@ void PingHost::addHostForPingImpl(const QString &id, const QString &ip, PING_TYP
         pingHostCurl_.addHostForPing(id, ip, hostname);
     }
     else if (pingType == PING_TCP) {
+#ifdef Q_OS_LINUX
+        if (!pingHostTcp_.isProxyEnabled() && pingHostTcpNative_.isAvailable()) {
+            pingHostTcpNative_.addHostForPing(id, ip);
+            return;
+        }
+#endif
         pingHostTcp_.addHostForPing(id, ip);
     }
     else if (pingType == PING_ICMP) {
+#ifdef Q_OS_LINUX
+        if (pingHostIcmpNative_.isAvailable()) {
+            pingHostIcmpNative_.addHostForPing(id, ip);
+            return;
+        }
+#endif
         pingHostIcmp_.addHostForPing(id, ip);
     }
     else {
@@ -87,6 +112,10 @@ void PingHost::clearPingsImpl()
     pingHostCurl_.clearPings();
     pingHostTcp_.clearPings();
     pingHostIcmp_.clearPings();
+#ifdef Q_OS_LINUX
+    pingHostIcmpNative_.clearPings();
+    pingHostTcpNative_.clearPings();
+#endif
 }
 
 void PingHost::setProxySettingsImpl(const types::ProxySettings &proxySettings)
@@ -94,6 +123,9 @@ void PingHost::setProxySettingsImpl(const types::ProxySettings &proxySettings)
     pingHostCurl_.setProxySettings(proxySettings);
     pingHostTcp_.setProxySettings(proxySettings);
     pingHostIcmp_.setProxySettings(proxySettings);
+#ifdef Q_OS_LINUX
+    pingHostIcmpNative_.setProxySettings(proxySettings);
+#endif
 }
 
 void PingHost::disableProxyImpl()
@@ -101,6 +133,9 @@ void PingHost::disableProxyImpl()
     pingHostCurl_.disableProxy();
     pingHostTcp_.disableProxy();
     pingHostIcmp_.disableProxy();
+#ifdef Q_OS_LINUX
+    pingHostIcmpNative_.disableProxy();
+#endif
 }
 
 void PingHost::enableProxyImpl()
@@ -108,4 +143,7 @@ void PingHost::enableProxyImpl()
     pingHostCurl_.enableProxy();
     pingHostTcp_.enableProxy();
     pingHostIcmp_.enableProxy();
+#ifdef Q_OS_LINUX
+    pingHostIcmpNative_.enableProxy();
+#endif
 }
@@ -11,6 +11,11 @@
     #include "pinghost_icmp_mac.h"
 #endif
 
+#ifdef Q_OS_LINUX
+    #include "pinghost_icmp_linux.h"
+    #include "pinghost_tcp_linux.h"
+#endif
+
 class NetworkAccessManager;
 
 // wrapper for PingHost_TCP, PingHost_ICMP and PingHost_Curl
@@ -32,6 +37,8 @@ public:
     void enableProxy();
 
 signals:
+    // the ping is actually sent, the pings over the parallel limit of the backend wait in its queue before that
+    void pingStarted(const QString &id);
     void pingFinished(bool success, int timems, const QString &id, bool isFromDisconnectedState);
 
 private slots:
@@ -51,4 +58,10 @@ private:
 #else
     PingHost_ICMP_mac pingHostIcmp_;
 #endif
+#ifdef Q_OS_LINUX
+    // used instead of pingHostIcmp_ if the unprivileged ICMP socket is allowed
+    PingHost_ICMP_linux pingHostIcmpNative_;
+    // used instead of pingHostTcp_ if the proxy is disabled
+    PingHost_TCP_linux pingHostTcpNative_;
+#endif
 };
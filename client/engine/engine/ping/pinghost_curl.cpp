@@ -22,10 +22,15 @@ void PingHost_Curl::addHostForPing(const QString &id, const QString &ip, const Q
     QUrl url(hostame);
     NetworkRequest networkRequest(url.toString(), PING_TIMEOUT, true, DnsServersConfiguration::instance().getCurrentDnsServers(), false);
     networkRequest.setOverrideIp(ip);
+    // nodes share the same hostname, so a pooled connection could lead to another node
+    networkRequest.setUseFreshConnection(true);
     // We add all ips to the firewall exceptions at once in the EngineLocationsModel, so there is no need to do it NetworkAccessManager
     networkRequest.setIsWhiteListIps(false);
+    networkRequest.setPriority(NetworkRequest::Priority::kBackground);
     NetworkReply *reply = networkAccessManager_->get(networkRequest);
     connect(reply, &NetworkReply::finished, this, &PingHost_Curl::onNetworkRequestFinished);
+    // the request may wait in the queue of NetworkAccessManager
+    connect(reply, &NetworkReply::started, this, [this, id]() { emit pingStarted(id); });
     reply->setProperty("id", id);
     if (connectStateController_) {
         reply->setProperty("fromDisconnectedState", connectStateController_->currentState() == CONNECT_STATE_DISCONNECTED);
@@ -0,0 +1,318 @@
+#include "pinghost_icmp_linux.h"
+
+#include <QHostAddress>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "icmp_header.h"
+#include "utils/ipvalidation.h"
+#include "utils/logger.h"
+#include "utils/ws_assert.h"
+
+namespace {
+const int kPayloadSize = 16;
+const int kReceiveBufferSize = 256 * 1024;
+}
+
+PingHost_ICMP_linux::PingHost_ICMP_linux(QObject *parent, IConnectStateController *stateController)
+    : QObject(parent),
+      connectStateController_(stateController),
+      socket_(-1),
+      bSocketInitialized_(false),
+      socketNotifier_(nullptr),
+      timer_(this),
+      nextSequence_(0)
+{
+    timer_.setInterval(TIMER_INTERVAL);
+    connect(&timer_, &QTimer::timeout, this, &PingHost_ICMP_linux::onTimer);
+}
+
+PingHost_ICMP_linux::~PingHost_ICMP_linux()
+{
+    clearPings();
+    closeSocket();
+}
+
+bool PingHost_ICMP_linux::isAvailable()
+{
+    if (!bSocketInitialized_) {
+        bSocketInitialized_ = true;
+        openSocket();
+    }
+    return socket_ != -1;
+}
+
+void PingHost_ICMP_linux::addHostForPing(const QString &id, const QString &ip)
+{
+    if (!hostAlreadyPingingOrInWaitingQueue(id))
+    {
+        QueueJob job;
+        job.id = id;
+        job.ip = ip;
+        waitingPingsQueue_.enqueue(job);
+        processNextPings();
+    }
+}
+
+void PingHost_ICMP_linux::clearPings()
+{
+    qDeleteAll(pingingHosts_);
+    pingingHosts_.clear();
+    pingingSequences_.clear();
+    waitingPingsQueue_.clear();
+    timer_.stop();
+}
+
+void PingHost_ICMP_linux::setProxySettings(const types::ProxySettings &proxySettings)
+{
+    //todo
+    Q_UNUSED(proxySettings);
+}
+
+void PingHost_ICMP_linux::disableProxy()
+{
+    //todo
+}
+
+void PingHost_ICMP_linux::enableProxy()
+{
+    //todo
+}
+
+void PingHost_ICMP_linux::onSocketActivated()
+{
+    char buf[1024];
+    char control[256];
+
+    while (true)
+    {
+        sockaddr_in from;
+        iovec iov;
+        iov.iov_base = buf;
+        iov.iov_len = sizeof(buf);
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &from;
+        msg.msg_namelen = sizeof(from);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        ssize_t len = recvmsg(socket_, &msg, MSG_DONTWAIT);
+        if (len < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                qCDebug(LOG_PING) << "PingHost_ICMP_linux: recvmsg failed:" << errno;
+            break;
+        }
+
+        // the datagram ICMP socket returns the ICMP message without the IP header
+        if (len < 8 || (unsigned char)buf[0] != icmp_header::echo_reply)
+            continue;
+
+        const quint16 sequence = ((quint8)buf[6] << 8) | (quint8)buf[7];
+        auto it = pingingSequences_.find(sequence);
+        if (it == pingingSequences_.end() || it.value()->ip != from.sin_addr.s_addr)
+            continue;
+
+        qint64 receivedTimeNs = 0;
+        for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+            {
+                timespec ts;
+                memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+                receivedTimeNs = (qint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+                break;
+            }
+        }
+        if (receivedTimeNs == 0)
+            receivedTimeNs = currentTimeNs();
+
+        PingInfo *pingInfo = it.value();
+        const int timeMs = (int)qMax((qint64)0, (receivedTimeNs - pingInfo->sentTimeNs) / 1000000);
+        finishPing(pingInfo, true, timeMs);
+    }
+
+    processNextPings();
+}
+
+void PingHost_ICMP_linux::onTimer()
+{
+    // collect the sequences first, the pingFinished handlers may modify the pings
+    QVector<quint16> timedOut;
+    for (PingInfo *pingInfo : qAsConst(pingingHosts_))
+    {
+        if (pingInfo->elapsedTimer.elapsed() >= PING_TIMEOUT)
+            timedOut << pingInfo->sequence;
+    }
+    for (quint16 sequence : qAsConst(timedOut))
+    {
+        PingInfo *pingInfo = pingingSequences_.value(sequence, nullptr);
+        if (pingInfo)
+            finishPing(pingInfo, false, 0);
+    }
+
+    // also retries the sends postponed because the socket send buffer was full
+    processNextPings();
+}
+
+bool PingHost_ICMP_linux::openSocket()
+{
+    WS_ASSERT(socket_ == -1);
+    socket_ = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_ICMP);
+    if (socket_ == -1)
+    {
+        // EACCES if the user's group is not in net.ipv4.ping_group_range
+        qCDebug(LOG_PING) << "PingHost_ICMP_linux: datagram ICMP socket is not available (errno:" << errno << "), using the ping utility";
+        return false;
+    }
+
+    int on = 1;
+    if (setsockopt(socket_, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) != 0)
+        qCDebug(LOG_PING) << "PingHost_ICMP_linux: can't enable SO_TIMESTAMPNS:" << errno;
+    int bufferSize = kReceiveBufferSize;
+    setsockopt(socket_, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+
+    socketNotifier_ = new QSocketNotifier(socket_, QSocketNotifier::Read, this);
+    connect(socketNotifier_, &QSocketNotifier::activated, this, &PingHost_ICMP_linux::onSocketActivated);
+    return true;
+}
+
+void PingHost_ICMP_linux::closeSocket()
+{
+    if (socketNotifier_)
+    {
+        delete socketNotifier_;
+        socketNotifier_ = nullptr;
+    }
+    if (socket_ != -1)
+    {
+        close(socket_);
+        socket_ = -1;
+    }
+}
+
+bool PingHost_ICMP_linux::hostAlreadyPingingOrInWaitingQueue(const QString &id)
+{
+    if (pingingHosts_.contains(id))
+        return true;
+
+    for (const auto &it : waitingPingsQueue_)
+        if (it.id == id)
+            return true;
+
+    return false;
+}
+
+void PingHost_ICMP_linux::processNextPings()
+{
+    if (!isAvailable())
+    {
+        WS_ASSERT(false);
+        return;
+    }
+
+    while (pingingHosts_.count() < MAX_PARALLEL_PINGS && !waitingPingsQueue_.isEmpty())
+    {
+        QueueJob job = waitingPingsQueue_.dequeue();
+        WS_ASSERT(IpValidation::isIp(job.ip));
+
+        PingInfo *pingInfo = new PingInfo();
+        pingInfo->id = job.id;
+        pingInfo->ip = htonl(QHostAddress(job.ip).toIPv4Address());
+        while (pingingSequences_.contains(nextSequence_))
+            nextSequence_++;
+        pingInfo->sequence = nextSequence_++;
+        if (connectStateController_)
+            pingInfo->bFromDisconnectedState = connectStateController_->currentState() == CONNECT_STATE_DISCONNECTED;
+        else
+            pingInfo->bFromDisconnectedState = true;
+
+        pingingHosts_[pingInfo->id] = pingInfo;
+        pingingSequences_[pingInfo->sequence] = pingInfo;
+
+        if (sendEchoRequest(pingInfo))
+        {
+            emit pingStarted(job.id);
+        }
+        else
+        {
+            const int err = errno;
+            if (err == EAGAIN || err == EWOULDBLOCK || err == ENOBUFS)
+            {
+                // try again on the next timer tick
+                pingingHosts_.remove(pingInfo->id);
+                pingingSequences_.remove(pingInfo->sequence);
+                delete pingInfo;
+                waitingPingsQueue_.prepend(job);
+                break;
+            }
+            qCDebug(LOG_PING) << "PingHost_ICMP_linux: sendto failed:" << err;
+            finishPing(pingInfo, false, 0);
+        }
+    }
+
+    if (!pingingHosts_.isEmpty() || !waitingPingsQueue_.isEmpty())
+    {
+        if (!timer_.isActive())
+            timer_.start();
+    }
+    else
+    {
+        timer_.stop();
+    }
+}
+
+bool PingHost_ICMP_linux::sendEchoRequest(PingInfo *pingInfo)
+{
+    // the kernel fills in the identifier and the checksum for the datagram ICMP socket
+    unsigned char packet[8 + kPayloadSize];
+    memset(packet, 0, sizeof(packet));
+    packet[0] = icmp_header::echo_request;
+    packet[6] = pingInfo->sequence >> 8;
+    packet[7] = pingInfo->sequence & 0xFF;
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = pingInfo->ip;
+
+    pingInfo->elapsedTimer.start();
+    pingInfo->sentTimeNs = currentTimeNs();
+    return sendto(socket_, packet, sizeof(packet), 0, (sockaddr *)&addr, sizeof(addr)) == (ssize_t)sizeof(packet);
+}
+
+void PingHost_ICMP_linux::finishPing(PingInfo *pingInfo, bool bSuccess, int timeMs)
+{
+    const QString id = pingInfo->id;
+    const bool bFromDisconnectedState = pingInfo->bFromDisconnectedState;
+    pingingHosts_.remove(id);
+    pingingSequences_.remove(pingInfo->sequence);
+    delete pingInfo;
+
+    removeFromQueue(id);
+    emit pingFinished(bSuccess, timeMs, id, bFromDisconnectedState);
+}
+
+void PingHost_ICMP_linux::removeFromQueue(const QString &id)
+{
+    QMutableListIterator<QueueJob> i(waitingPingsQueue_);
+    while (i.hasNext()) {
+        if (i.next().id == id)
+            i.remove();
+    }
+}
+
+qint64 PingHost_ICMP_linux::currentTimeNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (qint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QQueue>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#include "engine/connectstatecontroller/iconnectstatecontroller.h"
+#include "types/proxysettings.h"
+
+// Native ICMP ping for Linux over the unprivileged datagram ICMP socket (SOCK_DGRAM/IPPROTO_ICMP).
+// All echo requests are sent from one socket, replies are matched by the sequence number (the kernel sets
+// the identifier to the socket's port) and RTT is measured with the kernel receive timestamps (SO_TIMESTAMPNS).
+// The socket is allowed only if the user's group is in net.ipv4.ping_group_range, so check isAvailable()
+// and fall back to PingHost_ICMP_mac (the ping utility) otherwise.
+// todo proxy support for icmp ping
+class PingHost_ICMP_linux : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PingHost_ICMP_linux(QObject *parent, IConnectStateController *stateController);
+    virtual ~PingHost_ICMP_linux();
+
+    // opens the socket on the first call, must be called from the object's thread
+    bool isAvailable();
+
+    void addHostForPing(const QString &id, const QString &ip);
+    void clearPings();
+
+    void setProxySettings(const types::ProxySettings &proxySettings);
+    void disableProxy();
+    void enableProxy();
+
+signals:
+    void pingStarted(const QString &id);
+    void pingFinished(bool bSuccess, int timems, const QString &id, bool isFromDisconnectedState);
+
+private slots:
+    void onSocketActivated();
+    void onTimer();
+
+private:
+    struct QueueJob
+    {
+        QString id;
+        QString ip;
+    };
+
+    struct PingInfo
+    {
+        QString id;
+        quint32 ip;                 // in network byte order
+        quint16 sequence;
+        qint64 sentTimeNs;          // CLOCK_REALTIME, the same clock as the kernel timestamps
+        QElapsedTimer elapsedTimer;
+        bool bFromDisconnectedState;
+    };
+
+    enum { PING_TIMEOUT = 2000 };
+    // limits the burst of echo requests in flight, so the replies don't overflow the socket receive buffer
+    static constexpr int MAX_PARALLEL_PINGS = 256;
+    static constexpr int TIMER_INTERVAL = 50;
+
+    IConnectStateController* const connectStateController_;
+
+    int socket_;
+    bool bSocketInitialized_;
+    QSocketNotifier *socketNotifier_;
+    QTimer timer_;
+    quint16 nextSequence_;
+
+    QHash<QString, PingInfo *> pingingHosts_;
+    QHash<quint16, PingInfo *> pingingSequences_;
+    QQueue<QueueJob> waitingPingsQueue_;
+
+    bool openSocket();
+    void closeSocket();
+    bool hostAlreadyPingingOrInWaitingQueue(const QString &id);
+    void processNextPings();
+    bool sendEchoRequest(PingInfo *pingInfo);
+    void finishPing(PingInfo *pingInfo, bool bSuccess, int timeMs);
+    void removeFromQueue(const QString &id);
+    static qint64 currentTimeNs();
+};
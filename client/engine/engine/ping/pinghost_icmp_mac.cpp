@@ -155,6 +155,7 @@ void PingHost_ICMP_mac::processNextPings()
         pingInfo->process->setProperty("id", job.id);
 
         pingingHosts_[job.id] = pingInfo;
+        emit pingStarted(job.id);
         pingInfo->process->start("ping", QStringList() << "-c" << "1" << "-W" << "2000" << job.ip);
     }
 }
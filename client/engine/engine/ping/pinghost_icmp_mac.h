@@ -25,6 +25,7 @@ public:
     void enableProxy();
 
 signals:
+    void pingStarted(const QString &id);
     void pingFinished(bool bSuccess, int timems, const QString &id, bool isFromDisconnectedState);
 
 private slots:
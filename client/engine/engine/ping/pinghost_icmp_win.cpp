@@ -185,6 +185,7 @@ void PingHost_ICMP_win::sendNextPing()
         }
 
         pingingHosts_[job.id] = request.release();
+        Q_EMIT pingStarted(job.id);
     }
 }
 
@@ -28,6 +28,7 @@ public:
     void enableProxy();
 
 signals:
+    void pingStarted(const QString &id);
     void pingFinished(bool success, int timems, const QString &id, bool isFromDisconnectedState);
 
 private slots:
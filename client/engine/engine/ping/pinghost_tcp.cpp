@@ -142,6 +142,7 @@ void PingHost_TCP::processNextPings()
         pingInfo->timer->setProperty("id", job.id);
         pingingHosts_[job.id] = pingInfo;
 
+        emit pingStarted(job.id);
         pingInfo->elapsedTimer.start();
         pingInfo->timer->start(PING_TIMEOUT);
         pingInfo->tcpSocket->connectToHost(job.ip, 443, QTcpSocket::ReadWrite, QTcpSocket::IPv4Protocol);
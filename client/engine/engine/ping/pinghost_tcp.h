@@ -29,6 +29,7 @@ public:
     bool isProxyEnabled() const;
 
 signals:
+    void pingStarted(const QString &id);
     void pingFinished(bool bSuccess, int timems, const QString &ip, bool isFromDisconnectedState);
 
 private slots:
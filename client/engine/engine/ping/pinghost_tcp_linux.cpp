@@ -0,0 +1,246 @@
+#include "pinghost_tcp_linux.h"
+
+#include <QHostAddress>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "utils/ipvalidation.h"
+#include "utils/logger.h"
+#include "utils/ws_assert.h"
+
+PingHost_TCP_linux::PingHost_TCP_linux(QObject *parent, IConnectStateController *stateController)
+    : QObject(parent),
+      connectStateController_(stateController),
+      epoll_(-1),
+      bEpollInitialized_(false),
+      epollNotifier_(nullptr),
+      timer_(this),
+      bRetryPending_(false),
+      nextSerial_(0)
+{
+    timer_.setSingleShot(true);
+    connect(&timer_, &QTimer::timeout, this, &PingHost_TCP_linux::onTimer);
+    clock_.start();
+}
+
+PingHost_TCP_linux::~PingHost_TCP_linux()
+{
+    clearPings();
+    delete epollNotifier_;
+    if (epoll_ != -1)
+        close(epoll_);
+}
+
+bool PingHost_TCP_linux::isAvailable()
+{
+    if (!bEpollInitialized_) {
+        bEpollInitialized_ = true;
+        epoll_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_ != -1) {
+            epollNotifier_ = new QSocketNotifier(epoll_, QSocketNotifier::Read, this);
+            connect(epollNotifier_, &QSocketNotifier::activated, this, &PingHost_TCP_linux::onEpollActivated);
+        } else {
+            qCDebug(LOG_PING) << "PingHost_TCP_linux: epoll_create1 failed:" << errno;
+        }
+    }
+    return epoll_ != -1;
+}
+
+void PingHost_TCP_linux::addHostForPing(const QString &id, const QString &ip, quint16 port)
+{
+    if (!hostAlreadyPingingOrInWaitingQueue(id)) {
+        QueueJob job;
+        job.id = id;
+        job.ip = ip;
+        job.port = port;
+        waitingPingsQueue_.enqueue(job);
+        processNextPings();
+    }
+}
+
+void PingHost_TCP_linux::clearPings()
+{
+    for (PingInfo *pingInfo : qAsConst(pingingHosts_)) {
+        // closing the socket also removes it from the epoll set
+        close(pingInfo->socket);
+        delete pingInfo;
+    }
+    pingingHosts_.clear();
+    pingingSerials_.clear();
+    deadlines_.clear();
+    waitingPingsQueue_.clear();
+    bRetryPending_ = false;
+    timer_.stop();
+}
+
+void PingHost_TCP_linux::onEpollActivated()
+{
+    const int kMaxEvents = 256;
+    epoll_event events[kMaxEvents];
+
+    while (true) {
+        int count = epoll_wait(epoll_, events, kMaxEvents, 0);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            break;
+
+        for (int i = 0; i < count; ++i) {
+            // the ping may have been finished by a pingFinished handler in the meantime and its fd number reused by a new ping,
+            // so the ping is looked up by its serial rather than by the fd
+            PingInfo *pingInfo = pingingSerials_.value(events[i].data.u64, nullptr);
+            if (!pingInfo)
+                continue;
+
+            int error = 0;
+            socklen_t len = sizeof(error);
+            if (getsockopt(pingInfo->socket, SOL_SOCKET, SO_ERROR, &error, &len) != 0)
+                error = errno;
+            finishPing(pingInfo, error == 0);
+        }
+
+        if (count < kMaxEvents)
+            break;
+    }
+
+    processNextPings();
+}
+
+void PingHost_TCP_linux::onTimer()
+{
+    bRetryPending_ = false;
+    const qint64 now = clock_.elapsed();
+    while (!deadlines_.isEmpty() && deadlines_.firstKey() <= now)
+        finishPing(deadlines_.first(), false);
+
+    processNextPings();
+}
+
+bool PingHost_TCP_linux::hostAlreadyPingingOrInWaitingQueue(const QString &id)
+{
+    if (pingingHosts_.contains(id))
+        return true;
+
+    for (const auto &it : waitingPingsQueue_)
+        if (it.id == id)
+            return true;
+
+    return false;
+}
+
+void PingHost_TCP_linux::processNextPings()
+{
+    if (!isAvailable()) {
+        WS_ASSERT(false);
+        return;
+    }
+
+    while (!bRetryPending_ && pingingHosts_.count() < MAX_PARALLEL_PINGS && !waitingPingsQueue_.isEmpty()) {
+        QueueJob job = waitingPingsQueue_.dequeue();
+        if (!startPing(job)) {
+            waitingPingsQueue_.prepend(job);
+            bRetryPending_ = true;
+        }
+    }
+    updateTimer();
+}
+
+bool PingHost_TCP_linux::startPing(const QueueJob &job)
+{
+    WS_ASSERT(IpValidation::isIp(job.ip));
+
+    bool bFromDisconnectedState = true;
+    if (connectStateController_)
+        bFromDisconnectedState = connectStateController_->currentState() == CONNECT_STATE_DISCONNECTED;
+
+    int sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock == -1) {
+        if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+            return false;
+        qCDebug(LOG_PING) << "PingHost_TCP_linux: socket failed:" << errno;
+        emit pingFinished(false, 0, job.id, bFromDisconnectedState);
+        return true;
+    }
+
+    PingInfo *pingInfo = new PingInfo();
+    pingInfo->id = job.id;
+    pingInfo->socket = sock;
+    pingInfo->serial = nextSerial_++;
+    pingInfo->bFromDisconnectedState = bFromDisconnectedState;
+    pingInfo->deadline = clock_.elapsed() + PING_TIMEOUT;
+    pingingHosts_[pingInfo->id] = pingInfo;
+    pingingSerials_[pingInfo->serial] = pingInfo;
+    deadlines_.insert(pingInfo->deadline, pingInfo);
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(job.port);
+    addr.sin_addr.s_addr = htonl(QHostAddress(job.ip).toIPv4Address());
+
+    emit pingStarted(pingInfo->id);
+    pingInfo->elapsedTimer.start();
+    if (::connect(sock, (sockaddr *)&addr, sizeof(addr)) == 0) {
+        // can happen for the loopback
+        finishPing(pingInfo, true);
+        return true;
+    }
+    if (errno != EINPROGRESS) {
+        finishPing(pingInfo, false);
+        return true;
+    }
+
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLOUT;
+    event.data.u64 = pingInfo->serial;
+    if (epoll_ctl(epoll_, EPOLL_CTL_ADD, sock, &event) != 0) {
+        qCDebug(LOG_PING) << "PingHost_TCP_linux: epoll_ctl failed:" << errno;
+        finishPing(pingInfo, false);
+    }
+    return true;
+}
+
+void PingHost_TCP_linux::finishPing(PingInfo *pingInfo, bool bSuccess)
+{
+    const QString id = pingInfo->id;
+    const bool bFromDisconnectedState = pingInfo->bFromDisconnectedState;
+    const int timeMs = bSuccess ? (int)pingInfo->elapsedTimer.elapsed() : 0;
+
+    close(pingInfo->socket);
+    pingingHosts_.remove(id);
+    pingingSerials_.remove(pingInfo->serial);
+    deadlines_.remove(pingInfo->deadline, pingInfo);
+    delete pingInfo;
+
+    removeFromQueue(id);
+    emit pingFinished(bSuccess, timeMs, id, bFromDisconnectedState);
+}
+
+void PingHost_TCP_linux::updateTimer()
+{
+    qint64 timeoutMs = -1;
+    if (!deadlines_.isEmpty())
+        timeoutMs = qMax((qint64)0, deadlines_.firstKey() - clock_.elapsed());
+    if (bRetryPending_ && (timeoutMs == -1 || timeoutMs > RETRY_INTERVAL))
+        timeoutMs = RETRY_INTERVAL;
+
+    if (timeoutMs == -1)
+        timer_.stop();
+    else
+        timer_.start((int)timeoutMs);
+}
+
+void PingHost_TCP_linux::removeFromQueue(const QString &id)
+{
+    QMutableListIterator<QueueJob> i(waitingPingsQueue_);
+    while (i.hasNext()) {
+        if (i.next().id == id)
+            i.remove();
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMultiMap>
+#include <QObject>
+#include <QQueue>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#include "engine/connectstatecontroller/iconnectstatecontroller.h"
+
+// TCP handshake latency for Linux: non-blocking connect() calls for hundreds of hosts multiplexed over one epoll
+// instance, with a single deadline map and one timer for all the timeouts.
+// The epoll fd is watched by a QSocketNotifier, so everything runs in the object's thread without extra threads.
+// Doesn't support proxies, PingHost uses PingHost_TCP if the proxy is enabled.
+class PingHost_TCP_linux : public QObject
+{
+    Q_OBJECT
+public:
+    // stateController can be NULL, in this case not used
+    explicit PingHost_TCP_linux(QObject *parent, IConnectStateController *stateController);
+    virtual ~PingHost_TCP_linux();
+
+    // creates the epoll instance on the first call, must be called from the object's thread
+    bool isAvailable();
+
+    void addHostForPing(const QString &id, const QString &ip, quint16 port = 443);
+    void clearPings();
+
+signals:
+    void pingStarted(const QString &id);
+    void pingFinished(bool bSuccess, int timems, const QString &ip, bool isFromDisconnectedState);
+
+private slots:
+    void onEpollActivated();
+    void onTimer();
+
+private:
+    struct QueueJob
+    {
+        QString id;
+        QString ip;
+        quint16 port;
+    };
+
+    struct PingInfo
+    {
+        QString id;
+        int socket;
+        quint64 serial;                 // the epoll user data, a reused fd number can't be mistaken for this ping
+        qint64 deadline;                // in clock_ ms
+        QElapsedTimer elapsedTimer;
+        bool bFromDisconnectedState;
+    };
+
+    enum { PING_TIMEOUT = 2000 };
+    // every ping holds a file descriptor, stay well below the default limit of 1024
+    static constexpr int MAX_PARALLEL_PINGS = 512;
+    // retry interval if socket() failed because of the descriptors limit
+    static constexpr int RETRY_INTERVAL = 50;
+
+    IConnectStateController* const connectStateController_;
+
+    int epoll_;
+    bool bEpollInitialized_;
+    QSocketNotifier *epollNotifier_;
+    QTimer timer_;
+    QElapsedTimer clock_;
+    bool bRetryPending_;
+    quint64 nextSerial_;
+
+    QHash<QString, PingInfo *> pingingHosts_;
+    QHash<quint64, PingInfo *> pingingSerials_;
+    QMultiMap<qint64, PingInfo *> deadlines_;
+    QQueue<QueueJob> waitingPingsQueue_;
+
+    bool hostAlreadyPingingOrInWaitingQueue(const QString &id);
+    void processNextPings();
+    // returns false if the job must be retried later
+    bool startPing(const QueueJob &job);
+    void finishPing(PingInfo *pingInfo, bool bSuccess);
+    void updateTimer();
+    void removeFromQueue(const QString &id);
+};
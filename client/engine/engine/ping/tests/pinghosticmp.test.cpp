@@ -0,0 +1,154 @@
+#include <QtTest>
+#include <QCoreApplication>
+
+#include <sys/resource.h>
+
+#include "engine/ping/pinghost_icmp_linux.h"
+#include "engine/ping/pinghost_icmp_mac.h"
+
+// The native ICMP ping over the datagram ICMP socket versus the ping utility process per host.
+// The benchmarks ping a few hundred loopback aliases (the whole 127.0.0.0/8 answers on Linux).
+class TestPingHostIcmp : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestPingHostIcmp();
+    ~TestPingHostIcmp();
+
+private slots:
+    void test_native_ping();
+    void test_native_ping_duplicate_id();
+    void test_native_ping_timeout();
+    void benchmark_ping_utility();
+    void benchmark_native();
+
+private:
+    struct Result
+    {
+        int succeeded = 0;
+        qint64 wallTimeMs = 0;
+        qint64 cpuTimeMs = 0;       // user + system, including the child processes
+    };
+
+    static constexpr int kHostsCount = 300;
+
+    template<typename T> Result runPings(T *pingHost, int count);
+    static qint64 cpuTimeMs();
+};
+
+TestPingHostIcmp::TestPingHostIcmp()
+{
+}
+
+TestPingHostIcmp::~TestPingHostIcmp()
+{
+}
+
+void TestPingHostIcmp::test_native_ping()
+{
+    PingHost_ICMP_linux pingHost(this, nullptr);
+    if (!pingHost.isAvailable())
+        QSKIP("datagram ICMP socket is not allowed by net.ipv4.ping_group_range");
+
+    QSignalSpy spy(&pingHost, &PingHost_ICMP_linux::pingFinished);
+    pingHost.addHostForPing("1", "127.0.0.1");
+    QVERIFY(spy.wait(3000));
+    QCOMPARE(spy.count(), 1);
+    const QList<QVariant> arguments = spy.takeFirst();
+    QCOMPARE(arguments.at(0).toBool(), true);
+    QVERIFY(arguments.at(1).toInt() >= 0 && arguments.at(1).toInt() < 100);
+    QCOMPARE(arguments.at(2).toString(), "1");
+    QCOMPARE(arguments.at(3).toBool(), true);
+}
+
+void TestPingHostIcmp::test_native_ping_duplicate_id()
+{
+    PingHost_ICMP_linux pingHost(this, nullptr);
+    if (!pingHost.isAvailable())
+        QSKIP("datagram ICMP socket is not allowed by net.ipv4.ping_group_range");
+
+    QSignalSpy spy(&pingHost, &PingHost_ICMP_linux::pingFinished);
+    pingHost.addHostForPing("1", "127.0.0.1");
+    pingHost.addHostForPing("1", "127.0.0.1");
+    QVERIFY(spy.wait(3000));
+    QTest::qWait(200);
+    QCOMPARE(spy.count(), 1);
+}
+
+void TestPingHostIcmp::test_native_ping_timeout()
+{
+    PingHost_ICMP_linux pingHost(this, nullptr);
+    if (!pingHost.isAvailable())
+        QSKIP("datagram ICMP socket is not allowed by net.ipv4.ping_group_range");
+
+    // TEST-NET-1 (RFC 5737), nobody answers
+    QSignalSpy spy(&pingHost, &PingHost_ICMP_linux::pingFinished);
+    pingHost.addHostForPing("1", "192.0.2.1");
+    QVERIFY(spy.wait(4000));
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.takeFirst().at(0).toBool(), false);
+}
+
+void TestPingHostIcmp::benchmark_ping_utility()
+{
+    PingHost_ICMP_mac pingHost(this, nullptr);
+    Result result = runPings(&pingHost, kHostsCount);
+    qDebug() << "ping utility:" << kHostsCount << "hosts, wall time" << result.wallTimeMs << "ms, cpu time" << result.cpuTimeMs
+             << "ms, succeeded:" << result.succeeded;
+    QCOMPARE(result.succeeded, kHostsCount);
+}
+
+void TestPingHostIcmp::benchmark_native()
+{
+    PingHost_ICMP_linux pingHost(this, nullptr);
+    if (!pingHost.isAvailable())
+        QSKIP("datagram ICMP socket is not allowed by net.ipv4.ping_group_range");
+
+    Result result = runPings(&pingHost, kHostsCount);
+    qDebug() << "native:" << kHostsCount << "hosts, wall time" << result.wallTimeMs << "ms, cpu time" << result.cpuTimeMs
+             << "ms, succeeded:" << result.succeeded;
+    QCOMPARE(result.succeeded, kHostsCount);
+}
+
+template<typename T>
+TestPingHostIcmp::Result TestPingHostIcmp::runPings(T *pingHost, int count)
+{
+    Result result;
+    int finished = 0;
+    connect(pingHost, &T::pingFinished, this, [&finished, &result](bool bSuccess, int, const QString &, bool) {
+        finished++;
+        if (bSuccess)
+            result.succeeded++;
+    });
+
+    const qint64 cpuTimeStart = cpuTimeMs();
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < count; ++i) {
+        const QString ip = QString("127.0.%1.%2").arg(i / 250).arg(i % 250 + 1);
+        pingHost->addHostForPing(QString::number(i), ip);
+    }
+    while (finished < count && timer.elapsed() < 120000)
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 1);
+
+    result.wallTimeMs = timer.elapsed();
+    result.cpuTimeMs = cpuTimeMs() - cpuTimeStart;
+    return result;
+}
+
+qint64 TestPingHostIcmp::cpuTimeMs()
+{
+    qint64 ms = 0;
+    for (int who : { RUSAGE_SELF, RUSAGE_CHILDREN }) {
+        rusage usage;
+        if (getrusage(who, &usage) == 0) {
+            ms += (qint64)usage.ru_utime.tv_sec * 1000 + usage.ru_utime.tv_usec / 1000;
+            ms += (qint64)usage.ru_stime.tv_sec * 1000 + usage.ru_stime.tv_usec / 1000;
+        }
+    }
+    return ms;
+}
+
+QTEST_MAIN(TestPingHostIcmp)
+#include "pinghosticmp.test.moc"
@@ -0,0 +1,246 @@
+#include <QtTest>
+#include <QCoreApplication>
+#include <QSocketNotifier>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "engine/ping/pinghost_tcp_linux.h"
+
+// The epoll based TCP ping against local listening sockets and blackholed ports.
+// A blackholed port is a listening socket with a full accept queue, the kernel drops SYNs to it.
+class TestPingHostTcp : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestPingHostTcp();
+    ~TestPingHostTcp();
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void test_ping();
+    void test_connection_refused();
+    void test_blackholed_timeout();
+    void test_fd_reused_within_batch();
+    void benchmark_listening_data();
+    void benchmark_listening();
+    void benchmark_blackholed_data();
+    void benchmark_blackholed();
+
+private:
+    struct Result
+    {
+        int succeeded = 0;
+        int failed = 0;
+        qint64 wallTimeMs = 0;
+    };
+
+    int listeningSocket_;
+    quint16 listeningPort_;
+    QSocketNotifier *acceptNotifier_;
+    int blackholedSocket_;
+    int blackholedFillerSocket_;
+    quint16 blackholedPort_;
+
+    static int createListeningSocket(int backlog, quint16 &outPort);
+    Result runPings(quint16 port, int count);
+};
+
+TestPingHostTcp::TestPingHostTcp() : listeningSocket_(-1), listeningPort_(0), acceptNotifier_(nullptr),
+    blackholedSocket_(-1), blackholedFillerSocket_(-1), blackholedPort_(0)
+{
+}
+
+TestPingHostTcp::~TestPingHostTcp()
+{
+}
+
+void TestPingHostTcp::initTestCase()
+{
+    // bound to INADDR_ANY, so every 127.x.x.x alias reaches it
+    listeningSocket_ = createListeningSocket(SOMAXCONN, listeningPort_);
+    QVERIFY(listeningSocket_ != -1);
+    acceptNotifier_ = new QSocketNotifier(listeningSocket_, QSocketNotifier::Read, this);
+    connect(acceptNotifier_, &QSocketNotifier::activated, this, [this]() {
+        int sock;
+        while ((sock = accept4(listeningSocket_, nullptr, nullptr, SOCK_NONBLOCK)) != -1)
+            close(sock);
+    });
+
+    // the backlog 0 accepts one connection into the queue, the filler occupies it and nobody accepts
+    blackholedSocket_ = createListeningSocket(0, blackholedPort_);
+    QVERIFY(blackholedSocket_ != -1);
+    blackholedFillerSocket_ = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(blackholedPort_);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    QVERIFY(::connect(blackholedFillerSocket_, (sockaddr *)&addr, sizeof(addr)) == 0);
+}
+
+void TestPingHostTcp::cleanupTestCase()
+{
+    delete acceptNotifier_;
+    close(listeningSocket_);
+    close(blackholedFillerSocket_);
+    close(blackholedSocket_);
+}
+
+void TestPingHostTcp::test_ping()
+{
+    PingHost_TCP_linux pingHost(this, nullptr);
+    QVERIFY(pingHost.isAvailable());
+    QSignalSpy spy(&pingHost, &PingHost_TCP_linux::pingFinished);
+    pingHost.addHostForPing("1", "127.0.0.1", listeningPort_);
+    QTRY_COMPARE_WITH_TIMEOUT(spy.count(), 1, 3000);
+    const QList<QVariant> arguments = spy.takeFirst();
+    QCOMPARE(arguments.at(0).toBool(), true);
+    QVERIFY(arguments.at(1).toInt() >= 0 && arguments.at(1).toInt() < 100);
+    QCOMPARE(arguments.at(2).toString(), "1");
+}
+
+void TestPingHostTcp::test_connection_refused()
+{
+    // take a free port and release it
+    quint16 closedPort;
+    int sock = createListeningSocket(1, closedPort);
+    QVERIFY(sock != -1);
+    close(sock);
+
+    PingHost_TCP_linux pingHost(this, nullptr);
+    QSignalSpy spy(&pingHost, &PingHost_TCP_linux::pingFinished);
+    QElapsedTimer timer;
+    timer.start();
+    pingHost.addHostForPing("1", "127.0.0.1", closedPort);
+    QTRY_COMPARE_WITH_TIMEOUT(spy.count(), 1, 3000);
+    QCOMPARE(spy.takeFirst().at(0).toBool(), false);
+    QVERIFY(timer.elapsed() < 1000);
+}
+
+void TestPingHostTcp::test_blackholed_timeout()
+{
+    PingHost_TCP_linux pingHost(this, nullptr);
+    QSignalSpy spy(&pingHost, &PingHost_TCP_linux::pingFinished);
+    QElapsedTimer timer;
+    timer.start();
+    pingHost.addHostForPing("1", "127.0.0.1", blackholedPort_);
+    QTRY_COMPARE_WITH_TIMEOUT(spy.count(), 1, 5000);
+    QCOMPARE(spy.takeFirst().at(0).toBool(), false);
+    QVERIFY(timer.elapsed() >= 1900 && timer.elapsed() <= 3000);
+}
+
+void TestPingHostTcp::test_fd_reused_within_batch()
+{
+    // the first result of a batch clears the pings and starts the new ones to the blackholed port, they take the fd numbers
+    // of the cleared pings, whose events are still in the batch. Those events must not finish the new pings.
+    const int kCount = 10;
+    PingHost_TCP_linux pingHost(this, nullptr);
+    int listeningResults = 0;
+    int blackholedSucceeded = 0;
+    int blackholedFailed = 0;
+    connect(&pingHost, &PingHost_TCP_linux::pingFinished, this, [&](bool bSuccess, int, const QString &id, bool) {
+        if (id.startsWith("b")) {
+            if (bSuccess)
+                blackholedSucceeded++;
+            else
+                blackholedFailed++;
+            return;
+        }
+        if (listeningResults++ == 0) {
+            pingHost.clearPings();
+            for (int i = 0; i < kCount; ++i)
+                pingHost.addHostForPing("b" + QString::number(i), "127.0.0.1", blackholedPort_);
+        }
+    });
+
+    for (int i = 0; i < kCount; ++i)
+        pingHost.addHostForPing("l" + QString::number(i), QString("127.0.0.%1").arg(i + 1), listeningPort_);
+    QTRY_COMPARE_WITH_TIMEOUT(blackholedSucceeded + blackholedFailed, kCount, 5000);
+    QCOMPARE(blackholedSucceeded, 0);
+}
+
+void TestPingHostTcp::benchmark_listening_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::newRow("10") << 10;
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+}
+
+void TestPingHostTcp::benchmark_listening()
+{
+    QFETCH(int, count);
+    Result result = runPings(listeningPort_, count);
+    qDebug() << "listening:" << count << "targets in" << result.wallTimeMs << "ms, succeeded:" << result.succeeded;
+    QCOMPARE(result.succeeded, count);
+}
+
+void TestPingHostTcp::benchmark_blackholed_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::newRow("10") << 10;
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+}
+
+void TestPingHostTcp::benchmark_blackholed()
+{
+    // PingHost_TCP (10 parallel pings, 2s timeout) needs count / 10 * 2s here
+    QFETCH(int, count);
+    Result result = runPings(blackholedPort_, count);
+    qDebug() << "blackholed:" << count << "targets in" << result.wallTimeMs << "ms, failed:" << result.failed;
+    QCOMPARE(result.failed, count);
+    QVERIFY(result.wallTimeMs < 10000);
+}
+
+int TestPingHostTcp::createListeningSocket(int backlog, quint16 &outPort)
+{
+    int sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (sock == -1)
+        return -1;
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = 0;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    socklen_t len = sizeof(addr);
+    if (bind(sock, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(sock, backlog) != 0 ||
+        getsockname(sock, (sockaddr *)&addr, &len) != 0) {
+        close(sock);
+        return -1;
+    }
+    outPort = ntohs(addr.sin_port);
+    return sock;
+}
+
+TestPingHostTcp::Result TestPingHostTcp::runPings(quint16 port, int count)
+{
+    Result result;
+    PingHost_TCP_linux pingHost(this, nullptr);
+    connect(&pingHost, &PingHost_TCP_linux::pingFinished, this, [&result](bool bSuccess, int, const QString &, bool) {
+        if (bSuccess)
+            result.succeeded++;
+        else
+            result.failed++;
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < count; ++i) {
+        const QString ip = QString("127.0.%1.%2").arg(i / 250).arg(i % 250 + 1);
+        pingHost.addHostForPing(QString::number(i), ip, port);
+    }
+    while (result.succeeded + result.failed < count && timer.elapsed() < 60000)
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 1);
+
+    result.wallTimeMs = timer.elapsed();
+    return result;
+}
+
+QTEST_MAIN(TestPingHostTcp)
+#include "pinghosttcp.test.moc"
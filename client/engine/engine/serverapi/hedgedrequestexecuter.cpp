@@ -0,0 +1,172 @@
+#include "hedgedrequestexecuter.h"
+
+#include "utils/ws_assert.h"
+#include "utils/logger.h"
+
+namespace server_api {
+
+HedgedRequestExecuter::HedgedRequestExecuter(QObject *parent, IConnectStateController *connectStateController, NetworkAccessManager *networkAccessManager,
+                                             failover::IFailoverContainer *failoverContainer, int hedgeDelayMs, int maxInFlight) : QObject(parent),
+    connectStateController_(connectStateController), networkAccessManager_(networkAccessManager), failoverContainer_(failoverContainer),
+    hedgeDelayMs_(hedgeDelayMs), maxInFlight_(qMax(1, maxInFlight)), bIgnoreSslErrors_(false), elapsedMs_(0),
+    nextCandidateId_(0), startedCount_(0), startFailoverInd_(0), bNoMoreCandidates_(false), bFinished_(false), winnerFailoverInd_(-1)
+{
+    hedgeTimer_.setSingleShot(true);
+    connect(&hedgeTimer_, &QTimer::timeout, this, &HedgedRequestExecuter::onHedgeTimer);
+}
+
+void HedgedRequestExecuter::execute(QPointer<BaseRequest> request, bool bIgnoreSslErrors)
+{
+    WS_ASSERT(request_ == nullptr);
+    WS_ASSERT(request->requestType() == RequestType::kGet);
+    request_ = request;
+    bIgnoreSslErrors_ = bIgnoreSslErrors;
+    elapsedTimer_.start();
+    failoverContainer_->currentFailover(&startFailoverInd_);
+    startNextCandidate();
+}
+
+failover::FailoverData HedgedRequestExecuter::failoverData() const
+{
+    WS_ASSERT(!winnerFailoverData_.isNull());
+    return *winnerFailoverData_;
+}
+
+void HedgedRequestExecuter::onHedgeTimer()
+{
+    if (!bFinished_ && inFlight_.size() < maxInFlight_) {
+        startNextCandidate();
+    }
+}
+
+bool HedgedRequestExecuter::startNextCandidate()
+{
+    if (bNoMoreCandidates_) {
+        return false;
+    }
+
+    // the first candidate is the current failover of the container, the rest are taken by moving forward
+    int failoverInd = -1;
+    if (startedCount_ > 0 && !failoverContainer_->gotoNext()) {
+        bNoMoreCandidates_ = true;
+        hedgeTimer_.stop();
+        return false;
+    }
+    QSharedPointer<failover::BaseFailover> failover = failoverContainer_->currentFailover(&failoverInd);
+    WS_ASSERT(failover);
+    qCDebug(LOG_FAILOVER) << "Trying (hedged):" << failover->name();
+
+    Candidate candidate;
+    candidate.id = nextCandidateId_++;
+    candidate.executer = new RequestExecuterViaFailover(this, connectStateController_, networkAccessManager_);
+    candidate.failoverInd = failoverInd;
+    inFlight_ << candidate;
+    startedCount_++;
+
+    // Queued, because some failovers finish synchronously inside getData().
+    // The candidate is identified by id, since a cancelled executer can still have a queued signal.
+    const int candidateId = candidate.id;
+    connect(candidate.executer, &RequestExecuterViaFailover::finished, this, [this, candidateId](RequestExecuterRetCode retCode) {
+        onExecuterFinished(candidateId, retCode);
+    }, Qt::QueuedConnection);
+    // direct, the rest must be cancelled before the response is handled into the shared request
+    connect(candidate.executer, &RequestExecuterViaFailover::responseReceived, this, [this, candidateId]() {
+        onResponseReceived(candidateId);
+    }, Qt::DirectConnection);
+    candidate.executer->execute(request_, failover, bIgnoreSslErrors_);
+    emit candidateStarted(failoverInd);
+
+    if (inFlight_.size() < maxInFlight_) {
+        hedgeTimer_.start(hedgeDelayMs_);
+    } else {
+        hedgeTimer_.stop();
+    }
+    return true;
+}
+
+void HedgedRequestExecuter::onExecuterFinished(int candidateId, RequestExecuterRetCode retCode)
+{
+    if (bFinished_) {
+        return;
+    }
+
+    int ind = -1;
+    for (int i = 0; i < inFlight_.size(); ++i) {
+        if (inFlight_[i].id == candidateId) {
+            ind = i;
+            break;
+        }
+    }
+    if (ind == -1) {
+        return;
+    }
+    const Candidate candidate = inFlight_.takeAt(ind);
+    QScopedPointer<RequestExecuterViaFailover> executer(candidate.executer);
+
+    if (retCode == RequestExecuterRetCode::kSuccess) {
+        winnerFailoverData_.reset(new failover::FailoverData(executer->failoverData()));
+        winnerFailoverId_ = executer->failover()->uniqueId();
+        winnerFailoverInd_ = candidate.failoverInd;
+        qCDebug(LOG_FAILOVER) << "Hedged failover succeeded:" << executer->failover()->name() << "in" << elapsedTimer_.elapsed() << "ms,"
+                              << startedCount_ << "candidates started";
+        finish(retCode);
+    } else if (retCode == RequestExecuterRetCode::kRequestDeleted) {
+        finish(retCode);
+    } else if (retCode == RequestExecuterRetCode::kConnectStateChanged) {
+        // ServerAPI repeats the request, let it start over from the same failover
+        restoreContainerPosition();
+        finish(retCode);
+    } else if (retCode == RequestExecuterRetCode::kFailoverFailed) {
+        qCDebug(LOG_FAILOVER) << "Hedged failover failed:" << executer->failover()->name();
+        // replace the failed candidate right away, no need to wait for the hedge delay
+        if (inFlight_.size() < maxInFlight_) {
+            startNextCandidate();
+        }
+        if (inFlight_.isEmpty()) {
+            finish(retCode);
+        }
+    } else {
+        WS_ASSERT(false);
+    }
+}
+
+void HedgedRequestExecuter::onResponseReceived(int candidateId)
+{
+    if (inFlight_.size() > 1) {
+        qCDebug(LOG_FAILOVER) << "Hedged failover got a response, cancelling the other candidates";
+    }
+    cancelAll(candidateId);
+}
+
+void HedgedRequestExecuter::cancelAll(int exceptCandidateId)
+{
+    hedgeTimer_.stop();
+    // deleting the executers aborts their requests in progress
+    QVector<Candidate> kept;
+    for (const Candidate &candidate : qAsConst(inFlight_)) {
+        if (candidate.id == exceptCandidateId) {
+            kept << candidate;
+        } else {
+            delete candidate.executer;
+        }
+    }
+    inFlight_ = kept;
+}
+
+void HedgedRequestExecuter::finish(RequestExecuterRetCode retCode)
+{
+    cancelAll();
+    bFinished_ = true;
+    elapsedMs_ = elapsedTimer_.elapsed();
+    emit finished(retCode);
+}
+
+void HedgedRequestExecuter::restoreContainerPosition()
+{
+    failoverContainer_->reset();
+    for (int i = 0; i < startFailoverInd_; ++i) {
+        failoverContainer_->gotoNext();
+    }
+}
+
+} // namespace server_api
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QVector>
+
+#include "requestexecuterviafailover.h"
+#include "engine/failover/ifailovercontainer.h"
+
+
+namespace server_api {
+
+// Helper class used by ServerAPI in the hedged failover mode.
+// Instead of walking the failover container strictly one at a time, it starts the next failover candidate
+// after hedgeDelayMs while the earlier ones are still in progress (at most maxInFlight at the same time).
+// A failed candidate is replaced with the next one immediately. The candidates share the request, so the first one the server answers
+// cancels the rest before the response is handled. If the response turns out invalid, the racing goes on with the next candidates.
+// The container is left positioned at the last started candidate.
+// Only for the idempotent (GET) requests, the same request can reach the server through several candidates.
+class HedgedRequestExecuter : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr int kDefaultMaxInFlight = 3;
+
+    explicit HedgedRequestExecuter(QObject *parent, IConnectStateController *connectStateController, NetworkAccessManager *networkAccessManager,
+                                   failover::IFailoverContainer *failoverContainer, int hedgeDelayMs, int maxInFlight = kDefaultMaxInFlight);
+
+    void execute(QPointer<BaseRequest> request, bool bIgnoreSslErrors);
+    QPointer<BaseRequest> request() { return request_; }
+
+    // valid only after the kSuccess
+    failover::FailoverData failoverData() const;
+    QString failoverUniqueId() const { return winnerFailoverId_; }
+    int failoverInd() const { return winnerFailoverInd_; }
+    // time from the start of the execution to the finish
+    qint64 elapsedMs() const { return elapsedMs_; }
+    int startedCount() const { return startedCount_; }
+
+signals:
+    void finished(server_api::RequestExecuterRetCode retCode);
+    // emitted when a candidate is started, the ind is the position of the failover in the container
+    void candidateStarted(int failoverInd);
+
+private slots:
+    void onHedgeTimer();
+
+private:
+    IConnectStateController *connectStateController_;
+    NetworkAccessManager *networkAccessManager_;
+    failover::IFailoverContainer *failoverContainer_;
+    const int hedgeDelayMs_;
+    const int maxInFlight_;
+
+    QPointer<BaseRequest> request_;
+    bool bIgnoreSslErrors_;
+
+    QTimer hedgeTimer_;
+    QElapsedTimer elapsedTimer_;
+    qint64 elapsedMs_;
+
+    struct Candidate
+    {
+        int id;
+        RequestExecuterViaFailover *executer;
+        int failoverInd;
+    };
+    QVector<Candidate> inFlight_;
+    int nextCandidateId_;
+    int startedCount_;
+    int startFailoverInd_;
+    bool bNoMoreCandidates_;
+    bool bFinished_;
+
+    QScopedPointer<failover::FailoverData> winnerFailoverData_;
+    QString winnerFailoverId_;
+    int winnerFailoverInd_;
+
+    // returns false if there are no more candidates in the container
+    bool startNextCandidate();
+    void onExecuterFinished(int candidateId, RequestExecuterRetCode retCode);
+    void onResponseReceived(int candidateId);
+    void cancelAll(int exceptCandidateId = -1);
+    void finish(RequestExecuterRetCode retCode);
+    void restoreContainerPosition();
+};
+
+} // namespace server_api
@@ -8,15 +8,29 @@
 #include "utils/extraconfig.h"
 #include "engine/connectstatecontroller/iconnectstatecontroller.h"
 #include "engine/dnsresolver/dnsserversconfiguration.h"
+#include "responsecache.h"
 
 namespace server_api {
 
 
 RequestExecuterViaFailover::RequestExecuterViaFailover(QObject *parent, IConnectStateController *connectStateController, NetworkAccessManager *networkAccessManager) : QObject(parent),
-    connectStateController_(connectStateController), networkAccessManager_(networkAccessManager), failover_(nullptr)
+    connectStateController_(connectStateController), networkAccessManager_(networkAccessManager), failover_(nullptr), bFailoverInProgress_(false)
 {
 }
 
+RequestExecuterViaFailover::~RequestExecuterViaFailover()
+{
+    // abort the network request in progress, if any
+    if (reply_) {
+        delete reply_;
+    }
+
+    // the failover is reused by the next executers, its result must not reach them
+    if (failover_ && bFailoverInProgress_) {
+        failover_->cancel();
+    }
+}
+
 void RequestExecuterViaFailover::execute(QPointer<BaseRequest> request, QSharedPointer<failover::BaseFailover> failover, bool bIgnoreSslErrors)
 {
     WS_ASSERT(request_ == nullptr);
@@ -27,6 +41,7 @@ void RequestExecuterViaFailover::execute(QPointer<BaseRequest> request, QSharedP
     connectStateWatcher_.reset(new ConnectStateWatcher(this, connectStateController_));
 
     connect(failover_.get(), &failover::BaseFailover::finished, this, &RequestExecuterViaFailover::onFailoverFinished);
+    bFailoverInProgress_ = true;
     failover_->getData(bIgnoreSslErrors_);
 }
 
@@ -38,6 +53,7 @@ failover::FailoverData RequestExecuterViaFailover::failoverData() const
 
 void RequestExecuterViaFailover::onFailoverFinished(const QVector<failover::FailoverData> &data)
 {
+    bFailoverInProgress_ = false;
     // if the request has already been deleted before completion
     if (!request_) {
         emit finished(RequestExecuterRetCode::kRequestDeleted);
@@ -63,6 +79,7 @@ void RequestExecuterViaFailover::onNetworkRequestFinished()
 {
     NetworkReply *reply = static_cast<NetworkReply *>(sender());
     QSharedPointer<NetworkReply> obj = QSharedPointer<NetworkReply>(reply, &QObject::deleteLater);
+    reply_ = nullptr;
 
     // if the request has already been deleted before completion
     if (!request_) {
@@ -86,6 +103,13 @@ void RequestExecuterViaFailover::onNetworkRequestFinished()
         return;
     }
 
+    emit responseReceived();
+
+    if (ResponseCache::checkNotModified(request_, reply)) {
+        emit finished(RequestExecuterRetCode::kSuccess);
+        return;
+    }
+
     QByteArray serverResponse = reply->readAll();
     if (ExtraConfig::instance().getLogAPIResponse()) {
         qCDebug(LOG_SERVER_API) << request_->name();
@@ -104,6 +128,7 @@ void RequestExecuterViaFailover::onNetworkRequestFinished()
         return;
     }
 
+    ResponseCache::instance().update(request_, requestUrl_, reply);
     emit finished(RequestExecuterRetCode::kSuccess);
 }
 
@@ -112,7 +137,13 @@ void RequestExecuterViaFailover::executeBaseRequest(const failover::FailoverData
     // Make sure the network return code is reset if we've failed over
     request_->setNetworkRetCode(SERVER_RETURN_SUCCESS);
 
-    NetworkRequest networkRequest(request_->url(failoverData.domain()).toString(), request_->timeout(), true, DnsServersConfiguration::instance().getCurrentDnsServers(), bIgnoreSslErrors_);
+    requestUrl_ = request_->url(failoverData.domain());
+    NetworkRequest networkRequest(requestUrl_.toString(), request_->timeout(), true, DnsServersConfiguration::instance().getCurrentDnsServers(), bIgnoreSslErrors_);
+    // the API responses are read in whole when finished
+    networkRequest.setCoalesceBody(true);
+    networkRequest.setPriority(request_->priority());
+    networkRequest.setTimingEndpoint(request_->name());
+    ResponseCache::instance().addConditionalHeaders(request_, requestUrl_, networkRequest);
     if (!failoverData.echConfig().isEmpty()) {
         networkRequest.setEchConfig(failoverData.echConfig());
     }
@@ -134,6 +165,7 @@ void RequestExecuterViaFailover::executeBaseRequest(const failover::FailoverData
         default:
             WS_ASSERT(false);
     }
+    reply_ = reply;
     connect(reply, &NetworkReply::finished, this, &RequestExecuterViaFailover::onNetworkRequestFinished);
 }
 
@@ -15,7 +15,8 @@ namespace server_api {
 
 // Helper class used by ServerAPI.
 // Tries to execute a request through the specified failover and returns the result of this execution.
-// In short it executes the failover request first and then, if successful, the request itself
+// In short it executes the failover request first and then, if successful, the request itself.
+// Deleting the object cancels the execution: the network request in progress is aborted.
 
 enum class RequestExecuterRetCode { kSuccess, kRequestDeleted, kFailoverFailed, kConnectStateChanged};
 QDebug operator<<(QDebug dbg, const RequestExecuterRetCode &f);
@@ -26,13 +27,17 @@ class RequestExecuterViaFailover : public QObject
     Q_OBJECT
 public:
     explicit RequestExecuterViaFailover(QObject *parent, IConnectStateController *connectStateController, NetworkAccessManager *networkAccessManager);
+    ~RequestExecuterViaFailover();
 
     void execute(QPointer<BaseRequest> request, QSharedPointer<failover::BaseFailover> failover, bool bIgnoreSslErrors);
     QPointer<BaseRequest> request() { return request_; }
     failover::FailoverData failoverData() const;
+    QSharedPointer<failover::BaseFailover> failover() const { return failover_; }
 
 signals:
     void finished(server_api::RequestExecuterRetCode retCode);
+    // emitted when the server answered, right before the response is handled into the request
+    void responseReceived();
 
 private slots:
     void onFailoverFinished(const QVector<failover::FailoverData> &data);
@@ -45,6 +50,9 @@ private:
     QPointer<BaseRequest> request_;
     QSharedPointer<failover::BaseFailover> failover_;
     bool bIgnoreSslErrors_;
+    bool bFailoverInProgress_;
+    QPointer<NetworkReply> reply_;
+    QUrl requestUrl_;
 
     QScopedPointer<ConnectStateWatcher> connectStateWatcher_;
 
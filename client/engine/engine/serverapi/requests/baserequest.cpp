@@ -31,10 +31,15 @@ QByteArray BaseRequest::postData() const
     return QByteArray();
 }
 
+QString BaseRequest::cacheSlot() const
+{
+    return QString();
+}
+
 QString BaseRequest::hostname(const QString &domain, SudomainType subdomain) const
 {
-    // if this is IP, return without change
-    if (IpValidation::isIp(domain)) {
+    // if this is IP, return without change (the IP can come with a port, e.g. a local API server in the tests)
+    if (IpValidation::isIp(domain.section(':', 0, 0))) {
         if (subdomain == SudomainType::kAssets) {
             return domain + "/" + HardcodedSettings::instance().serverAssetsSubdomain();
         } else if (subdomain == SudomainType::kTunnelTest) {
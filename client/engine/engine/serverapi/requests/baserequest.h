@@ -2,6 +2,7 @@
 
 #include <QObject>
 #include <QUrlQuery>
+#include "engine/networkaccessmanager/networkrequest.h"
 #include "types/enums.h"
 
 namespace server_api {
@@ -21,6 +22,8 @@ public:
     virtual QByteArray postData() const;
     virtual QString name() const = 0;
     virtual void handle(const QByteArray &arr) = 0;
+    // the slot in ResponseCache, empty if the validators of the responses are not cached (by default)
+    virtual QString cacheSlot() const;
 
     RequestType requestType() const { return requestType_; }
     int timeout() const { return timeout_; }
@@ -28,9 +31,22 @@ public:
     bool isWriteToLog() const { return isWriteToLog_; }
     void setNotWriteToLog() { isWriteToLog_ = false; }
 
+    NetworkRequest::Priority priority() const { return priority_; }
+    void setPriority(NetworkRequest::Priority priority) { priority_ = priority; }
+
     void setNetworkRetCode(SERVER_API_RET_CODE retCode) { networkRetCode_ = retCode; }
     SERVER_API_RET_CODE networkRetCode() const { return networkRetCode_; }
 
+    // Send the validators from ResponseCache, so the server can answer 304 Not Modified if the resource has not changed.
+    // Set it only if the caller still has the data of the previous response.
+    bool isConditional() const { return isConditional_; }
+    void setConditional(bool isConditional) { isConditional_ = isConditional; }
+
+    // The server answered 304 Not Modified to the conditional request: the response was not handled and the output values are empty,
+    // the data of the previous response is still valid
+    bool isNotModified() const { return isNotModified_; }
+    void setNotModified(bool isNotModified) { isNotModified_ = isNotModified; }
+
 signals:
     void finished();
 
@@ -42,7 +58,10 @@ private:
     int timeout_ = 5000;          // timeout 5 sec by default
     RequestType requestType_;
     bool isWriteToLog_ = true;
+    NetworkRequest::Priority priority_ = NetworkRequest::Priority::kNormal;
     SERVER_API_RET_CODE networkRetCode_ = SERVER_RETURN_SUCCESS;
+    bool isConditional_ = false;
+    bool isNotModified_ = false;
 };
 
 } // namespace server_api
@@ -12,6 +12,7 @@ namespace server_api {
 CheckUpdateRequest::CheckUpdateRequest(QObject *parent, UPDATE_CHANNEL updateChannel) : BaseRequest(parent, RequestType::kGet),
     updateChannel_(updateChannel)
 {
+    setPriority(NetworkRequest::Priority::kBackground);
 }
 
 QUrl CheckUpdateRequest::url(const QString &domain) const
@@ -13,6 +13,8 @@ LoginRequest::LoginRequest(QObject *parent, const QString &username, const QStri
     password_(password),
     code2fa_(code2fa)
 {
+    // the user is waiting for it
+    setPriority(NetworkRequest::Priority::kInteractive);
 }
 
 QString LoginRequest::contentTypeHeader() const
@@ -11,6 +11,7 @@ namespace server_api {
 NotificationsRequest::NotificationsRequest(QObject *parent, const QString &authHash) : BaseRequest(parent, RequestType::kGet),
     authHash_(authHash)
 {
+    setPriority(NetworkRequest::Priority::kBackground);
 }
 
 QUrl NotificationsRequest::url(const QString &domain) const
@@ -28,6 +29,11 @@ QString NotificationsRequest::name() const
     return "Notifications";
 }
 
+QString NotificationsRequest::cacheSlot() const
+{
+    return name();
+}
+
 void NotificationsRequest::handle(const QByteArray &arr)
 {
     QJsonParseError errCode;
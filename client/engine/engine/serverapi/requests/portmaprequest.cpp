@@ -29,6 +29,11 @@ QString PortMapRequest::name() const
     return "PortMap";
 }
 
+QString PortMapRequest::cacheSlot() const
+{
+    return name();
+}
+
 void PortMapRequest::handle(const QByteArray &arr)
 {
     QJsonParseError errCode;
@@ -15,6 +15,7 @@ ServerConfigsRequest::ServerConfigsRequest(QObject *parent, const QString &authH
     BaseRequest(parent, RequestType::kGet),
     authHash_(authHash)
 {
+    setPriority(NetworkRequest::Priority::kBackground);
 }
 
 QUrl ServerConfigsRequest::url(const QString &domain) const
@@ -34,6 +35,11 @@ QString ServerConfigsRequest::name() const
     return "ServerConfigs";
 }
 
+QString ServerConfigsRequest::cacheSlot() const
+{
+    return name();
+}
+
 void ServerConfigsRequest::handle(const QByteArray &arr)
 {
     qCDebug(LOG_SERVER_API) << "API request ServerConfigs successfully executed";
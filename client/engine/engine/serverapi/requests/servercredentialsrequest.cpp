@@ -40,6 +40,12 @@ QString ServerCredentialsRequest::name() const
     return "ServerCredentials";
 }
 
+QString ServerCredentialsRequest::cacheSlot() const
+{
+    // the credentials of the protocols are different resources
+    return name() + (protocol_.isOpenVpnProtocol() ? "/openvpn" : "/ikev2");
+}
+
 void ServerCredentialsRequest::handle(const QByteArray &arr)
 {
     QJsonParseError errCode;
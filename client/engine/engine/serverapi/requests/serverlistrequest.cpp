@@ -1,9 +1,8 @@
 #include "serverlistrequest.h"
 
-#include <QJsonArray>
-#include <QJsonDocument>
 #include <QSettings>
 
+#include "engine/apiinfo/serverlistparser.h"
 #include "utils/logger.h"
 #include "engine/utils/urlquery_utils.h"
 
@@ -63,44 +62,44 @@ QString ServerListRequest::name() const
     return "ServerList";
 }
 
+QString ServerListRequest::cacheSlot() const
+{
+    return name();
+}
+
 void ServerListRequest::handle(const QByteArray &arr)
 {
-    QJsonParseError errCode;
-    QJsonDocument doc = QJsonDocument::fromJson(arr, &errCode);
-    if (errCode.error != QJsonParseError::NoError || !doc.isObject()) {
+    // the streaming parser builds the locations without the intermediate QJsonDocument, the lists can be large
+    apiinfo::ServerListParser parser;
+    const apiinfo::ServerListParser::Result result = parser.parse(arr);
+    if (result == apiinfo::ServerListParser::Result::kIncorrectJson) {
         qCDebugMultiline(LOG_SERVER_API) << arr;
         qCDebug(LOG_SERVER_API) << "API request ServerLocations incorrect json";
         setNetworkRetCode(SERVER_RETURN_INCORRECT_JSON);
         return;
     }
-    QJsonObject jsonObject = doc.object();
 
-    if (!jsonObject.contains("info")) {
+    if (result == apiinfo::ServerListParser::Result::kNoInfo) {
         qCDebugMultiline(LOG_SERVER_API) << arr;
         qCDebug(LOG_SERVER_API) << "API request ServerLocations incorrect json (info field not found)";
         setNetworkRetCode(SERVER_RETURN_INCORRECT_JSON);
         return;
     }
 
-    if (!jsonObject.contains("data")) {
+    if (result == apiinfo::ServerListParser::Result::kNoData) {
         qCDebugMultiline(LOG_SERVER_API) << arr;
         qCDebug(LOG_SERVER_API) << "API request ServerLocations incorrect json (data field not found)";
         setNetworkRetCode(SERVER_RETURN_INCORRECT_JSON);
         return;
     }
-    // parse revision number
-    QJsonObject jsonInfo = jsonObject["info"].toObject();
-    bool isChanged = jsonInfo["changed"].toInt() != 0;
-    int newRevision = jsonInfo["revision"].toInt();
-    QString revisionHash = jsonInfo["revision_hash"].toString();
 
     // manage the country override flag according to the documentation
     // https://gitlab.int.windscribe.com/ws/client/desktop/client-desktop-public/-/issues/354
-    if (jsonInfo.contains("country_override")) {
+    if (parser.hasCountryOverride()) {
         if (isFromDisconnectedVPNState_ && connectStateController_->currentState() == CONNECT_STATE::CONNECT_STATE_DISCONNECTED) {
             QSettings settings;
-            settings.setValue("countryOverride", jsonInfo["country_override"].toString());
-            qCDebug(LOG_SERVER_API) << "API request ServerLocations saved countryOverride = " << jsonInfo["country_override"].toString();
+            settings.setValue("countryOverride", parser.countryOverride());
+            qCDebug(LOG_SERVER_API) << "API request ServerLocations saved countryOverride = " << parser.countryOverride();
         }
     } else {
         if (isFromDisconnectedVPNState_ && connectStateController_->currentState() == CONNECT_STATE::CONNECT_STATE_DISCONNECTED) {
@@ -110,29 +109,22 @@ void ServerListRequest::handle(const QByteArray &arr)
         }
     }
 
-    if (isChanged)  {
-        qCDebug(LOG_SERVER_API) << "API request ServerLocations successfully executed, revision changed =" << newRevision
-                                << ", revision_hash =" << revisionHash;
-
-        // parse locations array
-        const QJsonArray jsonData = jsonObject["data"].toArray();
-
-        for (int i = 0; i < jsonData.size(); ++i) {
-            if (jsonData.at(i).isObject()) {
-                apiinfo::Location sl;
-                QJsonObject dataElement = jsonData.at(i).toObject();
-                if (sl.initFromJson(dataElement, forceDisconnectNodes_)) {
-                    locations_ << sl;
-                } else {
-                    QJsonDocument invalidData(dataElement);
-                    qCDebug(LOG_SERVER_API) << "API request ServerLocations skipping invalid/incomplete 'data' element at index" << i
-                                            << "(" << invalidData.toJson(QJsonDocument::Compact) << ")";
-                }
+    if (parser.isChanged())  {
+        qCDebug(LOG_SERVER_API) << "API request ServerLocations successfully executed, revision changed =" << parser.revision()
+                                << ", revision_hash =" << parser.revisionHash();
+
+        for (const auto &element : parser.invalidElements()) {
+            if (element.isObject) {
+                qCDebug(LOG_SERVER_API) << "API request ServerLocations skipping invalid/incomplete 'data' element at index" << element.index
+                                        << "(" << element.json << ")";
             } else {
-                qCDebug(LOG_SERVER_API) << "API request ServerLocations skipping non-object 'data' element at index" << i;
+                qCDebug(LOG_SERVER_API) << "API request ServerLocations skipping non-object 'data' element at index" << element.index;
             }
         }
 
+        locations_ = parser.locations();
+        forceDisconnectNodes_ = parser.forceDisconnectNodes();
+
         if (locations_.empty())  {
             qCDebugMultiline(LOG_SERVER_API) << arr;
             qCDebug(LOG_SERVER_API) << "API request ServerLocations incorrect json, no valid 'data' elements were found";
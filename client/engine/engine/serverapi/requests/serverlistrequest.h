@@ -15,8 +15,12 @@ public:
 
     QUrl url(const QString &domain) const override;
     QString name() const override;
+    QString cacheSlot() const override;
     void handle(const QByteArray &arr) override;
 
+    // the response updates the country override flag (see handle()), so it can't be replaced by 304 Not Modified
+    bool isFromDisconnectedVPNState() const { return isFromDisconnectedVPNState_; }
+
     // output values
     QVector<apiinfo::Location> locations() const;
     QStringList forceDisconnectNodes() const;
@@ -12,6 +12,7 @@ StaticIpsRequest::StaticIpsRequest(QObject *parent, const QString &authHash, con
     authHash_(authHash),
     deviceId_(deviceId)
 {
+    setPriority(NetworkRequest::Priority::kBackground);
 }
 
 QUrl StaticIpsRequest::url(const QString &domain) const
@@ -39,6 +40,11 @@ QString StaticIpsRequest::name() const
     return "StaticIps";
 }
 
+QString StaticIpsRequest::cacheSlot() const
+{
+    return name();
+}
+
 void StaticIpsRequest::handle(const QByteArray &arr)
 {
     QJsonParseError errCode;
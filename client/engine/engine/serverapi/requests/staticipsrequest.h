@@ -13,6 +13,7 @@ public:
 
     QUrl url(const QString &domain) const override;
     QString name() const override;
+    QString cacheSlot() const override;
     void handle(const QByteArray &arr) override;
 
     // output values
@@ -0,0 +1,155 @@
+#include "responsecache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QUrlQuery>
+
+#include "utils/logger.h"
+
+namespace server_api {
+
+ResponseCache::ResponseCache(const QString &filePath)
+{
+    setFilePath(filePath.isEmpty() ? QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/apicache.dat" : filePath);
+}
+
+void ResponseCache::setFilePath(const QString &filePath)
+{
+    QMutexLocker locker(&mutex_);
+    filePath_ = filePath;
+    load();
+}
+
+ResponseCache::Validators ResponseCache::validators(const QString &slot, const QUrl &url) const
+{
+    QMutexLocker locker(&mutex_);
+    auto it = entries_.constFind(slot);
+    if (it == entries_.constEnd() || it->requestHash != requestHash(url))
+        return Validators();
+    return it->validators;
+}
+
+void ResponseCache::store(const QString &slot, const QUrl &url, const Validators &validators)
+{
+    QMutexLocker locker(&mutex_);
+    Entry &entry = entries_[slot];
+    entry.requestHash = requestHash(url);
+    entry.validators = validators;
+    save();
+}
+
+void ResponseCache::remove(const QString &slot)
+{
+    QMutexLocker locker(&mutex_);
+    if (entries_.remove(slot) > 0)
+        save();
+}
+
+void ResponseCache::clear()
+{
+    QMutexLocker locker(&mutex_);
+    entries_.clear();
+    QFile::remove(filePath_);
+}
+
+void ResponseCache::addConditionalHeaders(const BaseRequest *request, const QUrl &url, NetworkRequest &networkRequest) const
+{
+    if (!request->isConditional() || request->cacheSlot().isEmpty())
+        return;
+
+    const Validators v = validators(request->cacheSlot(), url);
+    if (!v.etag.isEmpty())
+        networkRequest.setRawHeader("If-None-Match", v.etag);
+    if (!v.lastModified.isEmpty())
+        networkRequest.setRawHeader("If-Modified-Since", v.lastModified);
+}
+
+bool ResponseCache::checkNotModified(BaseRequest *request, const NetworkReply *reply)
+{
+    if (!request->isConditional() || reply->httpCode() != 304)
+        return false;
+
+    if (request->isWriteToLog())
+        qCDebug(LOG_SERVER_API) << "API request" << request->name() << "not modified";
+    request->setNotModified(true);
+    return true;
+}
+
+void ResponseCache::update(const BaseRequest *request, const QUrl &url, const NetworkReply *reply)
+{
+    if (request->cacheSlot().isEmpty() || reply->httpCode() != 200)
+        return;
+
+    Validators v;
+    v.etag = reply->rawHeader("ETag");
+    v.lastModified = reply->rawHeader("Last-Modified");
+    if (v.isEmpty())
+        remove(request->cacheSlot());
+    else
+        store(request->cacheSlot(), url, v);
+}
+
+QByteArray ResponseCache::requestHash(const QUrl &url)
+{
+    // the same resource is requested through the different failover domains, the timestamp and its hash change every time
+    QUrlQuery query(url);
+    query.removeAllQueryItems("time");
+    query.removeAllQueryItems("client_auth_hash");
+    const QString str = url.path() + "?" + query.toString(QUrl::FullyEncoded);
+    return QCryptographicHash::hash(str.toUtf8(), QCryptographicHash::Sha256);
+}
+
+void ResponseCache::load()
+{
+    entries_.clear();
+
+    QFile file(filePath_);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream ds(&file);
+    quint32 magic, version;
+    ds >> magic;
+    if (magic != magic_)
+        return;
+    ds >> version;
+    if (version > versionForSerialization_)
+        return;
+
+    QHash<QString, Entry> entries;
+    qint32 count;
+    ds >> count;
+    for (qint32 i = 0; i < count && ds.status() == QDataStream::Ok; ++i) {
+        QString slot;
+        Entry entry;
+        ds >> slot >> entry.requestHash >> entry.validators.etag >> entry.validators.lastModified;
+        entries[slot] = entry;
+    }
+    if (ds.status() != QDataStream::Ok) {
+        qCDebug(LOG_SERVER_API) << "API response cache is corrupted, ignored";
+        return;
+    }
+    entries_ = entries;
+}
+
+void ResponseCache::save() const
+{
+    QDir().mkpath(QFileInfo(filePath_).absolutePath());
+    QSaveFile file(filePath_);
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream ds(&file);
+    ds << magic_ << versionForSerialization_ << static_cast<qint32>(entries_.size());
+    for (auto it = entries_.cbegin(); it != entries_.cend(); ++it)
+        ds << it.key() << it->requestHash << it->validators.etag << it->validators.lastModified;
+    if (!file.commit())
+        qCDebug(LOG_SERVER_API) << "Can't save the API response cache:" << file.errorString();
+}
+
+} // namespace server_api
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QUrl>
+#include "engine/networkaccessmanager/networkreply.h"
+#include "engine/networkaccessmanager/networkrequest.h"
+#include "requests/baserequest.h"
+
+namespace server_api {
+
+// Persistent cache of the HTTP validators (ETag, Last-Modified) of the periodically refreshed API resources
+// (see BaseRequest::cacheSlot()). It allows to send the conditional requests, so the server answers 304 Not Modified
+// without a body if the resource has not changed, and the caller keeps the data parsed from the previous response.
+// There is one entry per slot, it is valid only for the same request (the URL without the host and the volatile auth items),
+// so the validators always match the latest response received for the slot.
+// The data itself is not stored here, the caller is responsible for having it when it asks for a conditional request.
+// Thread safe.
+class ResponseCache
+{
+public:
+    struct Validators
+    {
+        QByteArray etag;
+        QByteArray lastModified;
+
+        bool isEmpty() const { return etag.isEmpty() && lastModified.isEmpty(); }
+    };
+
+    static ResponseCache &instance()
+    {
+        static ResponseCache rc;
+        return rc;
+    }
+
+    // the file in the app local data location by default
+    explicit ResponseCache(const QString &filePath = QString());
+
+    // changes the file and loads the entries from it
+    void setFilePath(const QString &filePath);
+
+    // empty if there is no entry for the slot or it was stored for another request
+    Validators validators(const QString &slot, const QUrl &url) const;
+    void store(const QString &slot, const QUrl &url, const Validators &validators);
+    void remove(const QString &slot);
+    void clear();
+
+    // The helpers for the request executers.
+    // Adds If-None-Match/If-Modified-Since to the network request if the request is conditional and there are validators for it.
+    void addConditionalHeaders(const BaseRequest *request, const QUrl &url, NetworkRequest &networkRequest) const;
+    // Returns true if the server answered 304 Not Modified to the conditional request, the request is marked as not modified.
+    static bool checkNotModified(BaseRequest *request, const NetworkReply *reply);
+    // Updates the entry of the cacheable request after its response was successfully handled.
+    void update(const BaseRequest *request, const QUrl &url, const NetworkReply *reply);
+
+private:
+    struct Entry
+    {
+        QByteArray requestHash;     // hash of the request, so the auth hash is not stored on disk
+        Validators validators;
+    };
+
+    mutable QMutex mutex_;
+    QString filePath_;
+    QHash<QString, Entry> entries_;
+
+    // for serialization
+    static constexpr quint32 magic_ = 0x3C41E6B9;
+    static constexpr quint32 versionForSerialization_ = 1;  // should increment the version if the data format is changed
+
+    static QByteArray requestHash(const QUrl &url);
+    void load();
+    void save() const;
+};
+
+} // namespace server_api
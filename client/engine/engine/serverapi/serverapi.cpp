@@ -11,6 +11,7 @@
 #include "utils/hardcodedsettings.h"
 #include "engine/dnsresolver/dnsserversconfiguration.h"
 #include "engine/connectstatecontroller/iconnectstatecontroller.h"
+#include "responsecache.h"
 
 #include "requests/loginrequest.h"
 #include "requests/sessionrequest.h"
@@ -48,6 +49,7 @@ ServerAPI::ServerAPI(QObject *parent, IConnectStateController *connectStateContr
     networkDetectionManager_(networkDetectionManager),
     bIgnoreSslErrors_(false),
     failoverState_(FailoverState::kUnknown),
+    failoverHedgeDelayMs_(-1),
     failoverContainer_(failoverContainer)
 {
     connect(connectStateController_, &IConnectStateController::stateChanged, this, &ServerAPI::onConnectStateChanged);
@@ -57,11 +59,19 @@ ServerAPI::ServerAPI(QObject *parent, IConnectStateController *connectStateContr
     failoverFromSettingsId_ = readFailoverIdFromSettings();
     if (failoverContainer_->failoverById(failoverFromSettingsId_))
         failoverState_ = FailoverState::kFromSettingsUnknown;
+
+    bool success;
+    int hedgeDelay = ExtraConfig::instance().getFailoverHedgeDelay(success);
+    if (success) {
+        failoverHedgeDelayMs_ = hedgeDelay;
+        qCDebug(LOG_FAILOVER) << "Hedged failover mode, delay" << failoverHedgeDelayMs_ << "ms";
+    }
 }
 
 ServerAPI::~ServerAPI()
 {
     requestExecutorViaFailover_.reset();
+    hedgedRequestExecuter_.reset();
 }
 
 QString ServerAPI::getHostname() const
@@ -93,16 +103,18 @@ BaseRequest *ServerAPI::session(const QString &authHash)
     return request;
 }
 
-BaseRequest *ServerAPI::serverLocations(const QString &language, const QString &revision, bool isPro, const QStringList &alcList)
+BaseRequest *ServerAPI::serverLocations(const QString &language, const QString &revision, bool isPro, const QStringList &alcList, bool isConditional)
 {
     ServerListRequest *request = new ServerListRequest(this, language, revision, isPro, alcList, connectStateController_);
+    request->setConditional(isConditional && !request->isFromDisconnectedVPNState());
     executeRequest(request);
     return request;
 }
 
-BaseRequest *ServerAPI::serverCredentials(const QString &authHash, types::Protocol protocol)
+BaseRequest *ServerAPI::serverCredentials(const QString &authHash, types::Protocol protocol, bool isConditional)
 {
     ServerCredentialsRequest *request = new ServerCredentialsRequest(this, authHash, protocol);
+    request->setConditional(isConditional);
     executeRequest(request);
     return request;
 }
@@ -114,16 +126,18 @@ BaseRequest *ServerAPI::deleteSession(const QString &authHash)
     return request;
 }
 
-BaseRequest *ServerAPI::serverConfigs(const QString &authHash)
+BaseRequest *ServerAPI::serverConfigs(const QString &authHash, bool isConditional)
 {
     ServerConfigsRequest *request = new ServerConfigsRequest(this, authHash);
+    request->setConditional(isConditional);
     executeRequest(request);
     return request;
 }
 
-BaseRequest *ServerAPI::portMap(const QString &authHash)
+BaseRequest *ServerAPI::portMap(const QString &authHash, bool isConditional)
 {
     PortMapRequest *request = new PortMapRequest(this, authHash);
+    request->setConditional(isConditional);
     executeRequest(request);
     return request;
 }
@@ -189,9 +203,10 @@ BaseRequest *ServerAPI::speedRating(const QString &authHash, const QString &spee
     return request;
 }
 
-BaseRequest *ServerAPI::staticIps(const QString &authHash, const QString &deviceId)
+BaseRequest *ServerAPI::staticIps(const QString &authHash, const QString &deviceId, bool isConditional)
 {
     StaticIpsRequest *request = new StaticIpsRequest(this, authHash, deviceId);
+    request->setConditional(isConditional);
     executeRequest(request);
     return request;
 }
@@ -207,9 +222,10 @@ BaseRequest *ServerAPI::pingTest(uint timeout, bool bWriteLog)
     return request;
 }
 
-BaseRequest *ServerAPI::notifications(const QString &authHash)
+BaseRequest *ServerAPI::notifications(const QString &authHash, bool isConditional)
 {
     NotificationsRequest *request = new NotificationsRequest(this, authHash);
+    request->setConditional(isConditional);
     executeRequest(request);
     return request;
 }
@@ -264,6 +280,9 @@ void ServerAPI::onNetworkRequestFinished()
     if (!reply->isSuccess()) {
         setErrorCodeAndEmitRequestFinished(pointerToRequest, SERVER_RETURN_NETWORK_ERROR, reply->errorString());
     }
+    else if (ResponseCache::checkNotModified(pointerToRequest, reply)) {
+        emit pointerToRequest->finished();
+    }
     else {  // if reply->isSuccess()
         QByteArray serverResponse = reply->readAll();
         if (ExtraConfig::instance().getLogAPIResponse()) {
@@ -271,6 +290,8 @@ void ServerAPI::onNetworkRequestFinished()
             qCDebugMultiline(LOG_SERVER_API) << serverResponse;
         }
         pointerToRequest->handle(serverResponse);
+        if (pointerToRequest->networkRetCode() == SERVER_RETURN_SUCCESS)
+            ResponseCache::instance().update(pointerToRequest, reply->property("requestUrl").toUrl(), reply);
         emit pointerToRequest->finished();
     }
 }
@@ -331,6 +352,37 @@ void ServerAPI::onRequestExecuterViaFailoverFinished(RequestExecuterRetCode retC
     }
 }
 
+void ServerAPI::onHedgedRequestExecuterFinished(RequestExecuterRetCode retCode)
+{
+    WS_ASSERT(failoverState_ == FailoverState::kUnknown);
+    QPointer<BaseRequest> request = hedgedRequestExecuter_->request();
+
+    if (retCode == RequestExecuterRetCode::kSuccess) {
+        failoverState_ = FailoverState::kReady;
+        writeFailoverIdToSettings(hedgedRequestExecuter_->failoverUniqueId());
+        failoverData_.reset(new failover::FailoverData(hedgedRequestExecuter_->failoverData()));
+        hedgedRequestExecuter_.reset();
+        emit request->finished();
+        executeWaitingInQueueRequests();
+    } else if (retCode == RequestExecuterRetCode::kRequestDeleted) {
+        WS_ASSERT(request.isNull());
+        hedgedRequestExecuter_.reset();
+        executeWaitingInQueueRequests();
+    } else if (retCode == RequestExecuterRetCode::kFailoverFailed) {
+        // all the candidates have been tried
+        hedgedRequestExecuter_.reset();
+        failoverState_ = FailoverState::kFailed;
+        setErrorCodeAndEmitRequestFinished(request, SERVER_RETURN_FAILOVER_FAILED, "Failover API not ready");
+        finishWaitingInQueueRequests(SERVER_RETURN_FAILOVER_FAILED, "Failover API not ready");
+    } else if (retCode == RequestExecuterRetCode::kConnectStateChanged) {
+        // Repeat the execution of the request via failover
+        hedgedRequestExecuter_.reset();
+        executeRequest(request);
+    } else {
+        WS_ASSERT(false);
+    }
+}
+
 void ServerAPI::setIgnoreSslErrors(bool bIgnore)
 {
     bIgnoreSslErrors_ = bIgnore;
@@ -370,7 +422,7 @@ void ServerAPI::executeRequest(QPointer<BaseRequest> request)
     }
 
     // if failover already in progress then move the request to queue
-    if (requestExecutorViaFailover_ != nullptr) {
+    if (isFailoverInProgress()) {
         // wgConfigsInit, wgConfigsConnect and pingTest should have a higher priority in the queue to avoid potential connection delays
         if (dynamic_cast<PingTestRequest *>(request.get()) != nullptr ||
             dynamic_cast<WgConfigsInitRequest *>(request.get()) != nullptr ||
@@ -387,7 +439,7 @@ void ServerAPI::executeRequest(QPointer<BaseRequest> request)
         executeRequestImpl(request, failover::FailoverData(hostnameForConnectedState()));
         executeWaitingInQueueRequests();
     } else {
-        WS_ASSERT(requestExecutorViaFailover_ == nullptr);
+        WS_ASSERT(!isFailoverInProgress());
 
         bool bUseFailover = false;
         if (failoverState_ == FailoverState::kFromSettingsUnknown || failoverState_ == FailoverState::kUnknown) {
@@ -401,7 +453,17 @@ void ServerAPI::executeRequest(QPointer<BaseRequest> request)
             }
         }
 
-        if (bUseFailover) {
+        // only the idempotent requests are raced, the candidates can reach the server more than once (a duplicate login, a used 2FA code)
+        if (bUseFailover && failoverState_ == FailoverState::kUnknown && failoverHedgeDelayMs_ >= 0 && request->requestType() == RequestType::kGet) {
+            hedgedRequestExecuter_.reset(new HedgedRequestExecuter(this, connectStateController_, networkAccessManager_, failoverContainer_, failoverHedgeDelayMs_));
+            connect(hedgedRequestExecuter_.get(), &HedgedRequestExecuter::finished, this, &ServerAPI::onHedgedRequestExecuterFinished, Qt::QueuedConnection);
+            connect(hedgedRequestExecuter_.get(), &HedgedRequestExecuter::candidateStarted, this, [this](int failoverInd) {
+                // Do not emit this signal for the first failover
+                if (failoverInd > 0)
+                    emit tryingBackupEndpoint(failoverInd, failoverContainer_->count() - 1);
+            });
+            hedgedRequestExecuter_->execute(request, bIgnoreSslErrors_);
+        } else if (bUseFailover) {
             int failoverInd = -1;
             QSharedPointer<failover::BaseFailover> curFailover = (failoverState_ == FailoverState::kFromSettingsUnknown) ? failoverContainer_->failoverById(failoverFromSettingsId_) : failoverContainer_->currentFailover(&failoverInd);
             WS_ASSERT(curFailover);
@@ -432,12 +494,23 @@ void ServerAPI::executeRequest(QPointer<BaseRequest> request)
     }
 }
 
+bool ServerAPI::isFailoverInProgress() const
+{
+    return requestExecutorViaFailover_ != nullptr || hedgedRequestExecuter_ != nullptr;
+}
+
 void ServerAPI::executeRequestImpl(QPointer<BaseRequest> request, const failover::FailoverData &failoverData)
 {
     // Make sure the network return code is reset if we've failed over
     request->setNetworkRetCode(SERVER_RETURN_SUCCESS);
 
-    NetworkRequest networkRequest(request->url(failoverData.domain()).toString(), request->timeout(), true, DnsServersConfiguration::instance().getCurrentDnsServers(), bIgnoreSslErrors_);
+    const QUrl url = request->url(failoverData.domain());
+    NetworkRequest networkRequest(url.toString(), request->timeout(), true, DnsServersConfiguration::instance().getCurrentDnsServers(), bIgnoreSslErrors_);
+    // the API responses are read in whole when finished
+    networkRequest.setCoalesceBody(true);
+    networkRequest.setPriority(request->priority());
+    networkRequest.setTimingEndpoint(request->name());
+    ResponseCache::instance().addConditionalHeaders(request, url, networkRequest);
     if (!failoverData.echConfig().isEmpty()) {
         networkRequest.setEchConfig(failoverData.echConfig());
     }
@@ -461,6 +534,7 @@ void ServerAPI::executeRequestImpl(QPointer<BaseRequest> request, const failover
     }
     QPointer<BaseRequest> pointerToRequest(request);
     reply->setProperty("pointerToRequest",  QVariant::fromValue(pointerToRequest));
+    reply->setProperty("requestUrl", url);
     connect(reply, &NetworkReply::finished, this, &ServerAPI::onNetworkRequestFinished);
 }
 
@@ -14,6 +14,7 @@
 #include "types/protocol.h"
 #include "types/robertfilter.h"
 #include "requestexecuterviafailover.h"
+#include "hedgedrequestexecuter.h"
 
 namespace server_api {
 
@@ -50,11 +51,14 @@ public:
 
     BaseRequest *login(const QString &username, const QString &password, const QString &code2fa);
     BaseRequest *session(const QString &authHash);
-    BaseRequest *serverLocations(const QString &language, const QString &revision, bool isPro, const QStringList &alcList);
-    BaseRequest *serverCredentials(const QString &authHash, types::Protocol protocol);
+    // The conditional requests of the periodically refreshed resources (see ResponseCache): if isConditional is true and the server
+    // answers 304 Not Modified, the request finishes successfully with BaseRequest::isNotModified() and without the output values.
+    // serverLocations() is never conditional in the disconnected state, its body is needed to update the country override flag.
+    BaseRequest *serverLocations(const QString &language, const QString &revision, bool isPro, const QStringList &alcList, bool isConditional = false);
+    BaseRequest *serverCredentials(const QString &authHash, types::Protocol protocol, bool isConditional = false);
     BaseRequest *deleteSession(const QString &authHash);
-    BaseRequest *serverConfigs(const QString &authHash);
-    BaseRequest *portMap(const QString &authHash);
+    BaseRequest *serverConfigs(const QString &authHash, bool isConditional = false);
+    BaseRequest *portMap(const QString &authHash, bool isConditional = false);
     BaseRequest *recordInstall();
     BaseRequest *confirmEmail(const QString &authHash);
     BaseRequest *webSession(const QString authHash, WEB_SESSION_PURPOSE purpose);
@@ -65,11 +69,11 @@ public:
     BaseRequest *debugLog(const QString &username, const QString &strLog);
     BaseRequest *speedRating(const QString &authHash, const QString &speedRatingHostname, const QString &ip, int rating);
 
-    BaseRequest *staticIps(const QString &authHash, const QString &deviceId);
+    BaseRequest *staticIps(const QString &authHash, const QString &deviceId, bool isConditional = false);
 
     BaseRequest *pingTest(uint timeout, bool bWriteLog);
 
-    BaseRequest *notifications(const QString &authHash);
+    BaseRequest *notifications(const QString &authHash, bool isConditional = false);
 
     BaseRequest *getRobertFilters(const QString &authHash);
     BaseRequest *setRobertFilter(const QString &authHash, const types::RobertFilter &filter);
@@ -86,6 +90,7 @@ private slots:
     //void onFailoverNextHostnameAnswer(failover::FailoverRetCode retCode, const QString &hostname);
     void onConnectStateChanged(CONNECT_STATE state, DISCONNECT_REASON reason, CONNECT_ERROR err, const LocationID &location);
     void onRequestExecuterViaFailoverFinished(server_api::RequestExecuterRetCode retCode);
+    void onHedgedRequestExecuterFinished(server_api::RequestExecuterRetCode retCode);
 
 private:
     NetworkAccessManager *networkAccessManager_;
@@ -103,6 +108,8 @@ private:
     QString failoverFromSettingsId_;   // empty if not exists
 
     QScopedPointer<RequestExecuterViaFailover> requestExecutorViaFailover_;
+    QScopedPointer<HedgedRequestExecuter> hedgedRequestExecuter_;
+    int failoverHedgeDelayMs_;      // -1 if the hedged failover mode is disabled
 
     failover::IFailoverContainer *failoverContainer_;
     bool isGettingFailoverHostnameInProgress_ = false;
@@ -110,6 +117,7 @@ private:
     bool isFailoverFailedLogAlreadyDone_ = false;   // log "failover failed: API not ready" only once to avoid spam
 
     void executeRequest(QPointer<BaseRequest> request);
+    bool isFailoverInProgress() const;
     void executeRequestImpl(QPointer<BaseRequest> request, const failover::FailoverData &failoverData);
 
     void executeWaitingInQueueRequests();
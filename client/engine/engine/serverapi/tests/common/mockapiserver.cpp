@@ -0,0 +1,429 @@
+#include "mockapiserver.h"
+
+#include <QCryptographicHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+MockApiServer::MockApiServer(QObject *parent) : QObject(parent),
+    server_(new TestHttpServer(this, true)),
+    isPremium_(true),
+    locationsCount_(20),
+    staticIpsCount_(0),
+    notificationsCount_(3)
+{
+    setAccount("mockuser", "mockpassword", true);
+    server_->setHandler([this](const TestHttpServer::Request &request) {
+        return handleRequest(request);
+    });
+}
+
+bool MockApiServer::start()
+{
+    return server_->start();
+}
+
+QString MockApiServer::domain() const
+{
+    return "127.0.0.1:" + QString::number(server_->serverPort());
+}
+
+void MockApiServer::setScript(Endpoint endpoint, const Script &script)
+{
+    scripts_[endpoint] = script;
+}
+
+void MockApiServer::setScriptForAll(const Script &script)
+{
+    for (int i = 0; i < static_cast<int>(Endpoint::kUnknown); ++i)
+        scripts_[static_cast<Endpoint>(i)] = script;
+}
+
+void MockApiServer::resetScripts()
+{
+    scripts_.clear();
+}
+
+void MockApiServer::setAccount(const QString &username, const QString &password, bool isPremium)
+{
+    username_ = username;
+    password_ = password;
+    isPremium_ = isPremium;
+    // the same format as the real one: user id, session type, timestamp and two hashes
+    const QByteArray hash = QCryptographicHash::hash((username + ":" + password).toUtf8(), QCryptographicHash::Sha256).toHex();
+    authHash_ = "142257:3:1678311600:" + hash.left(42) + ":" + hash.right(42);
+}
+
+void MockApiServer::setLocationsCount(int count)
+{
+    locationsCount_ = count;
+}
+
+void MockApiServer::setStaticIpsCount(int count)
+{
+    staticIpsCount_ = count;
+}
+
+void MockApiServer::setNotificationsCount(int count)
+{
+    notificationsCount_ = count;
+}
+
+int MockApiServer::nodesCount() const
+{
+    return locationsCount_ * kGroupsPerLocation * kNodesPerGroup;
+}
+
+int MockApiServer::requestsCount(Endpoint endpoint) const
+{
+    return requestsCount_.value(endpoint);
+}
+
+void MockApiServer::resetCounters()
+{
+    requestsCount_.clear();
+    server_->resetCounters();
+}
+
+MockApiServer::Endpoint MockApiServer::endpoint(const QByteArray &method, const QString &path)
+{
+    if (path == "/Session") {
+        if (method == "POST")
+            return Endpoint::kLogin;
+        else if (method == "DELETE")
+            return Endpoint::kDeleteSession;
+        return Endpoint::kSession;
+    }
+    // the assets subdomain is the path prefix for an IP domain
+    if (path.contains("/serverlist/"))
+        return Endpoint::kServerList;
+    if (path == "/ServerCredentials")
+        return Endpoint::kServerCredentials;
+    if (path == "/ServerConfigs")
+        return Endpoint::kServerConfigs;
+    if (path == "/PortMap")
+        return Endpoint::kPortMap;
+    if (path == "/StaticIps")
+        return Endpoint::kStaticIps;
+    if (path == "/Notifications")
+        return Endpoint::kNotifications;
+    if (path == "/WgConfigs/init")
+        return Endpoint::kWgConfigsInit;
+    if (path == "/WgConfigs/connect")
+        return Endpoint::kWgConfigsConnect;
+    return Endpoint::kUnknown;
+}
+
+TestHttpServer::Response MockApiServer::handleRequest(const TestHttpServer::Request &request)
+{
+    const QUrl url(QString::fromUtf8(request.path));
+    const Endpoint ep = endpoint(request.method, url.path());
+    requestsCount_[ep]++;
+    const Script script = takeScript(ep);
+
+    TestHttpServer::Response response;
+    response.delayMs = script.delayMs;
+    response.closeConnection = script.closeConnection;
+
+    if (ep == Endpoint::kUnknown || script.statusCode != 200) {
+        response.statusCode = (ep == Endpoint::kUnknown) ? 404 : script.statusCode;
+        response.headers << qMakePair(QByteArray("Content-Type"), QByteArray("text/html"));
+        response.body = "<html><head><title>" + QByteArray::number(response.statusCode) + "</title></head><body><center><h1>" +
+                        QByteArray::number(response.statusCode) + "</h1></center><hr><center>nginx</center></body></html>";
+        return response;
+    }
+
+    response.headers << qMakePair(QByteArray("Content-Type"), QByteArray(ep == Endpoint::kServerConfigs ? "text/plain" : "application/json"));
+
+    // the authentication items are in the query of GET and in the body of POST
+    const QUrlQuery query(request.method == "POST" ? QString::fromUtf8(request.body) : url.query());
+
+    if (script.errorCode != 0) {
+        response.body = errorJson(script.errorCode, "Scripted error");
+    } else if (ep == Endpoint::kLogin && (query.queryItemValue("username", QUrl::FullyDecoded) != username_ ||
+                                          query.queryItemValue("password", QUrl::FullyDecoded) != password_)) {
+        response.body = errorJson(702, "Could not log in with provided credentials");
+    } else if (ep != Endpoint::kLogin && ep != Endpoint::kServerList && query.queryItemValue("session_auth_hash", QUrl::FullyDecoded) != authHash_) {
+        // any authenticated endpoint
+        response.body = errorJson(701, "Submitted session is invalid");
+    } else {
+        response.body = responseBody(ep, query);
+    }
+
+    if (ep == Endpoint::kServerConfigs) {
+        // the OpenVPN config is not JSON, enlarged with the comments
+        if (script.paddingBytes > 0 && script.errorCode == 0)
+            response.body = QByteArray(QByteArray::fromBase64(response.body) + "\n# " + QByteArray(script.paddingBytes, 'x') + "\n").toBase64();
+    } else {
+        response.body = pad(response.body, script.paddingBytes);
+    }
+    if (script.isInvalidJson)
+        response.body.chop(response.body.size() / 2);
+    return response;
+}
+
+MockApiServer::Script MockApiServer::takeScript(Endpoint endpoint)
+{
+    auto it = scripts_.find(endpoint);
+    if (it == scripts_.end())
+        return Script();
+
+    const Script script = it.value();
+    if (it->times > 0 && --it->times == 0)
+        scripts_.erase(it);
+    return script;
+}
+
+QByteArray MockApiServer::responseBody(Endpoint endpoint, const QUrlQuery &query) const
+{
+    switch (endpoint) {
+    case Endpoint::kLogin:
+        return sessionJson(true);
+    case Endpoint::kSession:
+        return sessionJson(false);
+    case Endpoint::kDeleteSession:
+        return R"({"data": {"success": 1}})";
+    case Endpoint::kServerList:
+        return serverListJson();
+    case Endpoint::kServerCredentials:
+        return serverCredentialsJson(query.queryItemValue("type"));
+    case Endpoint::kServerConfigs:
+        return serverConfigs();
+    case Endpoint::kPortMap:
+        return portMapJson();
+    case Endpoint::kStaticIps:
+        return staticIpsJson();
+    case Endpoint::kNotifications:
+        return notificationsJson();
+    case Endpoint::kWgConfigsInit:
+        return wgConfigsInitJson();
+    case Endpoint::kWgConfigsConnect:
+        return wgConfigsConnectJson(query.queryItemValue("hostname", QUrl::FullyDecoded));
+    default:
+        return QByteArray();
+    }
+}
+
+QByteArray MockApiServer::sessionJson(bool isLogin) const
+{
+    QJsonObject data;
+    if (isLogin)
+        data["session_auth_hash"] = authHash_;
+    data["username"] = username_;
+    data["user_id"] = "5a0b1c2d3e4f";
+    data["traffic_used"] = 1512345678.0;
+    data["traffic_max"] = isPremium_ ? -1 : 10737418240.0;
+    data["status"] = 1;
+    data["email"] = username_ + "@example.com";
+    data["email_status"] = 1;
+    data["billing_plan_id"] = isPremium_ ? 1 : -9;
+    data["is_premium"] = isPremium_ ? 1 : 0;
+    data["rebill"] = 0;
+    data["premium_expiry_date"] = "2030-01-01";
+    data["last_reset"] = "2026-01-01";
+    data["loc_hash"] = revisionHash();
+    data["alc"] = QJsonArray();
+    QJsonObject sip;
+    sip["count"] = staticIpsCount_;
+    sip["update"] = QJsonArray();
+    data["sip"] = sip;
+
+    QJsonObject root;
+    root["data"] = data;
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+QByteArray MockApiServer::serverListJson() const
+{
+    static const char *kCountries[] = { "CA", "US", "GB", "DE", "NL", "FR", "JP", "AU", "SE", "CH" };
+
+    QByteArray json;
+    json.reserve(nodesCount() * 200 + 1024);
+    json += "{\"info\": {\"changed\": 1, \"revision\": " + QByteArray::number(locationsCount_) + ", \"revision_hash\": \"" +
+            revisionHash().toUtf8() + "\"}, \"data\": [";
+    int nodeId = 0;
+    for (int l = 0; l < locationsCount_; ++l) {
+        if (l > 0) json += ",";
+        json += QString("{\"id\": %1, \"name\": \"Location %1\", \"country_code\": \"%2\", \"status\": 1, \"premium_only\": %3, "
+                        "\"short_name\": \"%2\", \"p2p\": 1, \"tz\": \"America/Toronto\", \"tz_offset\": \"-5,EST\", "
+                        "\"loc_type\": \"normal\", \"dns_hostname\": \"loc%1.windscribe.example\", \"groups\": [")
+                    .arg(l + 1).arg(kCountries[l % 10]).arg(l % 3 == 0 ? 1 : 0).toUtf8();
+        for (int g = 0; g < kGroupsPerLocation; ++g) {
+            if (g > 0) json += ",";
+            const int groupId = l * kGroupsPerLocation + g + 1;
+            json += QString("{\"id\": %1, \"city\": \"City %1\", \"nick\": \"Nick %1\", \"pro\": %2, \"gps\": \"43.65,-79.38\", "
+                            "\"tz\": \"America/Toronto\", \"wg_pubkey\": \"pUbKeY%1pUbKeYpUbKeYpUbKeYpUbKeYpUbKeY=\", "
+                            "\"wg_endpoint\": \"wg%1.windscribe.example\", \"ovpn_x509\": \"group%1.windscribe.example\", "
+                            "\"ping_ip\": \"10.%3.%4.1\", \"ping_host\": \"https://ping%1.windscribe.example:6363/latency\", "
+                            "\"link_speed\": \"1000\", \"health\": %5, \"nodes\": [")
+                        .arg(groupId).arg(g % 2).arg(groupId / 256 % 256).arg(groupId % 256).arg(groupId % 100).toUtf8();
+            for (int n = 0; n < kNodesPerGroup; ++n) {
+                if (n > 0) json += ",";
+                json += QString("{\"ip\": \"172.16.%1.%2\", \"ip2\": \"172.17.%1.%2\", \"ip3\": \"172.18.%1.%2\", "
+                                "\"hostname\": \"node%3.windscribe.example\", \"weight\": %4, \"health\": %5}")
+                            .arg(nodeId / 256 % 256).arg(nodeId % 256).arg(nodeId).arg(1 + nodeId % 10).arg(nodeId % 100).toUtf8();
+                nodeId++;
+            }
+            json += "]}";
+        }
+        json += "]}";
+    }
+    json += "]}";
+    return json;
+}
+
+QByteArray MockApiServer::serverCredentialsJson(const QString &type) const
+{
+    QJsonObject data;
+    data["username"] = QString::fromUtf8(QByteArray("mock_" + type.toUtf8() + "_" + authHash_.right(8).toUtf8()).toBase64());
+    data["password"] = QString::fromUtf8(QByteArray("mock_" + type.toUtf8() + "_password").toBase64());
+    QJsonObject root;
+    root["data"] = data;
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+QByteArray MockApiServer::serverConfigs() const
+{
+    const QByteArray config =
+        "client\n"
+        "dev tun\n"
+        "remote-cert-tls server\n"
+        "auth-user-pass\n"
+        "resolv-retry infinite\n"
+        "nobind\n"
+        "persist-key\n"
+        "persist-tun\n"
+        "cipher AES-256-GCM\n"
+        "ncp-ciphers AES-256-GCM:AES-256-CBC:AES-128-GCM\n"
+        "auth SHA512\n"
+        "verb 2\n"
+        "mute-replay-warnings\n"
+        "key-direction 1\n"
+        "<ca>\n-----BEGIN CERTIFICATE-----\nMIIF3DCCA8SgAwIBAgIJAMsOivWTmu9fMA0GCSqGSIb3DQEBCwUAMHsxCzAJBgNV\n-----END CERTIFICATE-----\n</ca>\n"
+        "<tls-auth>\n-----BEGIN OpenVPN Static key V1-----\n5801926a57ac2ce27e3dfd1dd6ef8204\n-----END OpenVPN Static key V1-----\n</tls-auth>\n";
+    return config.toBase64();
+}
+
+QByteArray MockApiServer::portMapJson() const
+{
+    struct Item { const char *protocol; const char *heading; const char *use; QStringList ports; };
+    const QList<Item> items = {
+        { "wireguard", "WireGuard", "ip3", { "443", "80", "53", "123", "1194", "65142" } },
+        { "udp", "UDP", "ip2", { "443", "80", "53", "1194", "54783" } },
+        { "tcp", "TCP", "ip2", { "443", "587", "21", "22", "80", "143", "3306", "8080", "54783", "1194" } },
+        { "stealth", "Stealth", "ip3", { "443", "587", "21", "22", "80", "143", "3306", "8080", "54783", "1194" } },
+        { "wstunnel", "WStunnel", "ip3", { "443", "80" } },
+        { "ikev2", "IKEv2", "ip", { "500" } }
+    };
+
+    QJsonArray portmap;
+    for (const Item &item : items) {
+        QJsonObject obj;
+        obj["protocol"] = item.protocol;
+        obj["heading"] = item.heading;
+        obj["use"] = item.use;
+        obj["ports"] = QJsonArray::fromStringList(item.ports);
+        obj["legacy_ports"] = QJsonArray::fromStringList(item.ports);
+        portmap.append(obj);
+    }
+    QJsonObject data;
+    data["portmap"] = portmap;
+    QJsonObject root;
+    root["data"] = data;
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+QByteArray MockApiServer::staticIpsJson() const
+{
+    QJsonArray staticIps;
+    for (int i = 0; i < staticIpsCount_; ++i) {
+        QJsonObject node;
+        node["ip"] = QString("185.1.%1.1").arg(i);
+        node["ip2"] = QString("185.1.%1.2").arg(i);
+        node["ip3"] = QString("185.1.%1.3").arg(i);
+        node["city_name"] = "Toronto";
+        node["hostname"] = QString("static%1.windscribe.example").arg(i);
+        node["dns_hostname"] = QString("static%1-dns.windscribe.example").arg(i);
+
+        QJsonObject obj;
+        obj["id"] = 1000 + i;
+        obj["ip_id"] = 2000 + i;
+        obj["static_ip"] = QString("185.2.%1.10").arg(i);
+        obj["type"] = "dc";
+        obj["name"] = "Toronto";
+        obj["country_code"] = "CA";
+        obj["short_name"] = "CA";
+        obj["server_id"] = 3000 + i;
+        obj["wg_ip"] = QString("185.1.%1.3").arg(i);
+        obj["wg_pubkey"] = "sTaTiCpUbKeYsTaTiCpUbKeYsTaTiCpUbKeY=";
+        obj["ovpn_x509"] = QString("static%1.windscribe.example").arg(i);
+        obj["ping_host"] = QString("https://static%1.windscribe.example:6363/latency").arg(i);
+        obj["node"] = node;
+        QJsonObject credentials;
+        credentials["username"] = QString("static_user%1").arg(i);
+        credentials["password"] = QString("static_password%1").arg(i);
+        obj["credentials"] = credentials;
+        staticIps.append(obj);
+    }
+    QJsonObject data;
+    data["static_ips"] = staticIps;
+    QJsonObject root;
+    root["data"] = data;
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+QByteArray MockApiServer::notificationsJson() const
+{
+    QJsonArray notifications;
+    for (int i = 0; i < notificationsCount_; ++i) {
+        QJsonObject obj;
+        obj["id"] = 500 + i;
+        obj["title"] = QString("Notification %1").arg(i);
+        obj["message"] = QString("<p>The message of the notification %1 with a <a href=\"https://windscribe.example\">link</a>.</p>").arg(i);
+        obj["date"] = 1700000000 + i * 86400;
+        obj["perm_free"] = 1;
+        obj["perm_pro"] = 1;
+        obj["popup"] = (i == 0) ? 1 : 0;
+        notifications.append(obj);
+    }
+    QJsonObject data;
+    data["notifications"] = notifications;
+    QJsonObject root;
+    root["data"] = data;
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+QByteArray MockApiServer::wgConfigsInitJson() const
+{
+    return R"({"data": {"success": 1, "config": {"PresharedKey": "cHJlc2hhcmVka2V5cHJlc2hhcmVka2V5cHJlc2hhcmU=", "AllowedIPs": "0.0.0.0/0"}}})";
+}
+
+QByteArray MockApiServer::wgConfigsConnectJson(const QString &hostname) const
+{
+    // the address depends on the node, so the different connections can be told apart
+    const quint8 n = static_cast<quint8>(qHash(hostname) % 250 + 2);
+    return QString(R"({"data": {"success": 1, "config": {"Address": "100.64.0.%1/32", "DNS": "10.255.255.%2"}}})").arg(n).arg(n % 4 + 1).toUtf8();
+}
+
+QString MockApiServer::revisionHash() const
+{
+    return QCryptographicHash::hash(QByteArray::number(locationsCount_), QCryptographicHash::Md5).toHex();
+}
+
+QByteArray MockApiServer::errorJson(int errorCode, const QString &errorMessage)
+{
+    QJsonObject root;
+    root["errorCode"] = errorCode;
+    root["errorMessage"] = errorMessage;
+    root["errorDescription"] = errorMessage;
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+QByteArray MockApiServer::pad(const QByteArray &json, int paddingBytes)
+{
+    if (paddingBytes <= 0 || !json.startsWith('{'))
+        return json;
+    QByteArray padded = json;
+    padded.insert(1, "\"padding\": \"" + QByteArray(paddingBytes, 'x') + "\", ");
+    return padded;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <QHash>
+#include <QObject>
+#include <QUrl>
+#include <QUrlQuery>
+#include "../../../networkaccessmanager/tests/common/testhttpserver.h"
+
+// Local stand-in for the Windscribe API (over TLS, on 127.0.0.1 with a random port) for the offline integration tests and benchmarks.
+// Serves the realistic responses of the endpoints used from the login to the connection config: Session, the server list,
+// ServerCredentials, ServerConfigs, PortMap, StaticIps, Notifications and WgConfigs. The latency, the errors and the payload sizes
+// are scriptable per endpoint.
+// ServerAPI, the failovers and ApiResolutionSettings can be pointed to it with domain(): the requests with an IP domain go to
+// https://<domain>/<endpoint> (the server list to https://<domain>/assets/serverlist/...). The SSL errors must be ignored.
+// Runs in the thread where it was created, so the test must spin the event loop.
+class MockApiServer : public QObject
+{
+    Q_OBJECT
+public:
+    enum class Endpoint { kLogin, kSession, kDeleteSession, kServerList, kServerCredentials, kServerConfigs, kPortMap, kStaticIps,
+                          kNotifications, kWgConfigsInit, kWgConfigsConnect, kUnknown };
+
+    // How the endpoint answers, by default a valid response right away
+    struct Script
+    {
+        int delayMs = 0;
+        int statusCode = 200;       // if not 200, the body is an HTML error page as the reverse proxy sends it
+        int errorCode = 0;          // if not 0, the body is the API error {"errorCode": ..., "errorMessage": ...}
+        bool isInvalidJson = false; // the body is truncated
+        bool closeConnection = false;
+        int paddingBytes = 0;       // the JSON bodies are enlarged with an unused field of this size
+        int times = -1;             // the count of the requests the script is applied to, then the endpoint answers normally; -1 for all
+    };
+
+    explicit MockApiServer(QObject *parent = nullptr);
+
+    // listen on 127.0.0.1 with a random port
+    bool start();
+    // "127.0.0.1:<port>", the domain for the failovers
+    QString domain() const;
+    TestHttpServer *httpServer() const { return server_; }
+
+    void setScript(Endpoint endpoint, const Script &script);
+    void setScriptForAll(const Script &script);
+    void resetScripts();
+
+    // the only account the server knows, the other credentials get the error 702
+    void setAccount(const QString &username, const QString &password, bool isPremium);
+    QString username() const { return username_; }
+    QString password() const { return password_; }
+    QString authHash() const { return authHash_; }
+
+    // the payload sizes
+    void setLocationsCount(int count);
+    void setStaticIpsCount(int count);
+    void setNotificationsCount(int count);
+    int locationsCount() const { return locationsCount_; }
+    int nodesCount() const;
+
+    int requestsCount(Endpoint endpoint) const;
+    // the counters of all the endpoints
+    int requestsCount() const { return server_->requestsCount(); }
+    int connectionsCount() const { return server_->connectionsCount(); }
+    qint64 bytesSent() const { return server_->bytesSent(); }
+    void resetCounters();
+
+    static Endpoint endpoint(const QByteArray &method, const QString &path);
+
+private:
+    static constexpr int kGroupsPerLocation = 5;
+    static constexpr int kNodesPerGroup = 4;
+
+    TestHttpServer *server_;
+    QHash<Endpoint, Script> scripts_;
+    QHash<Endpoint, int> requestsCount_;
+
+    QString username_;
+    QString password_;
+    QString authHash_;
+    bool isPremium_;
+    int locationsCount_;
+    int staticIpsCount_;
+    int notificationsCount_;
+
+    TestHttpServer::Response handleRequest(const TestHttpServer::Request &request);
+    Script takeScript(Endpoint endpoint);
+    QByteArray responseBody(Endpoint endpoint, const QUrlQuery &query) const;
+
+    QByteArray sessionJson(bool isLogin) const;
+    QByteArray serverListJson() const;
+    QByteArray serverCredentialsJson(const QString &type) const;
+    QByteArray serverConfigs() const;
+    QByteArray portMapJson() const;
+    QByteArray staticIpsJson() const;
+    QByteArray notificationsJson() const;
+    QByteArray wgConfigsInitJson() const;
+    QByteArray wgConfigsConnectJson(const QString &hostname) const;
+
+    QString revisionHash() const;
+    static QByteArray errorJson(int errorCode, const QString &errorMessage);
+    static QByteArray pad(const QByteArray &json, int paddingBytes);
+};
@@ -0,0 +1,282 @@
+#include "hedgedfailover.test.h"
+
+#include <QtTest>
+#include <QJsonDocument>
+#include <QJsonObject>
+#ifdef Q_OS_WIN
+#include <WinSock2.h>
+#endif
+
+#include "engine/serverapi/hedgedrequestexecuter.h"
+#include "engine/serverapi/requestexecuterviafailover.h"
+#include "../../../networkaccessmanager/tests/common/testhttpserver.h"
+
+namespace {
+// the upper limit for a single run, all the candidates time out well before it
+constexpr int kRunTimeout = 30000;
+
+template <typename Spy>
+bool waitForSignal(Spy &spy, int timeoutMs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (spy.isEmpty() && timer.elapsed() < timeoutMs) {
+        spy.wait(100);
+    }
+    return !spy.isEmpty();
+}
+}
+
+void TestRequest::handle(const QByteArray &arr)
+{
+    handledCount_++;
+    QJsonParseError errCode;
+    QJsonDocument doc = QJsonDocument::fromJson(arr, &errCode);
+    if (errCode.error != QJsonParseError::NoError || !doc.isObject() || !doc.object().contains("data")) {
+        setNetworkRetCode(SERVER_RETURN_INCORRECT_JSON);
+        return;
+    }
+    ip_ = doc.object()["data"].toObject()["user_ip"].toString();
+}
+
+HedgedFailover_test::HedgedFailover_test() : networkAccessManager_(nullptr), connectStateController_(nullptr),
+    okServer_(nullptr), slowServer_(nullptr), brokenServer_(nullptr)
+{
+#ifdef Q_OS_WIN
+    // Initialize Winsock
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2,2), &wsaData);
+#endif
+}
+
+void HedgedFailover_test::initTestCase()
+{
+    okServer_ = new TestHttpServer(this, true);
+    okServer_->setHandler([](const TestHttpServer::Request &) {
+        TestHttpServer::Response response;
+        response.body = "{\"data\":{\"user_ip\":\"127.0.0.1\"}}";
+        return response;
+    });
+    okServer_->setResponseDelayMs(100);
+    QVERIFY(okServer_->start());
+
+    slowServer_ = new TestHttpServer(this, true);
+    slowServer_->setResponseDelayMs(kRequestTimeout * 3);
+    QVERIFY(slowServer_->start());
+
+    brokenServer_ = new TestHttpServer(this, true);
+    brokenServer_->setHandler([](const TestHttpServer::Request &) {
+        TestHttpServer::Response response;
+        response.body = "<html>blocked</html>";
+        return response;
+    });
+    QVERIFY(brokenServer_->start());
+}
+
+void HedgedFailover_test::init()
+{
+    networkAccessManager_ = new NetworkAccessManager(this);
+    connectStateController_ = new ConnectStateController_moc(this);
+    okServer_->resetCounters();
+    slowServer_->resetCounters();
+    brokenServer_->resetCounters();
+}
+
+void HedgedFailover_test::cleanup()
+{
+    delete networkAccessManager_;
+    delete connectStateController_;
+}
+
+void HedgedFailover_test::testFirstSuccessWins()
+{
+    TestFailoverContainer *container = makeContainer({ "slow:0", "fail:1500", "broken:0", "ok:0", "ok:0" });
+    QString winnerId;
+    qint64 elapsed = runHedged(container, 250, &winnerId);
+    QVERIFY(elapsed >= 0);
+    QCOMPARE(winnerId, QString("3:ok"));
+    // the slow candidate is still in progress, so the winner is found well before the request timeout
+    QVERIFY2(elapsed < kRequestTimeout, qPrintable(QString("elapsed = %1 ms").arg(elapsed)));
+    // the last candidate is not needed
+    QCOMPARE(okServer_->requestsCount(), 1);
+    delete container;
+}
+
+void HedgedFailover_test::testNoHedgingIfFirstIsFast()
+{
+    TestFailoverContainer *container = makeContainer({ "ok:0", "ok:0", "ok:0" });
+    TestRequest request(this, kRequestTimeout);
+    server_api::HedgedRequestExecuter executer(this, connectStateController_, networkAccessManager_, container, 1000);
+    QSignalSpy spy(&executer, &server_api::HedgedRequestExecuter::finished);
+    executer.execute(&request, true);
+    QVERIFY(waitForSignal(spy, kRunTimeout));
+    QCOMPARE(spy.first().at(0).value<server_api::RequestExecuterRetCode>(), server_api::RequestExecuterRetCode::kSuccess);
+    QCOMPARE(executer.startedCount(), 1);
+    QCOMPARE(executer.failoverInd(), 0);
+    QCOMPARE(request.ip(), QString("127.0.0.1"));
+    delete container;
+}
+
+void HedgedFailover_test::testResponseHandledOnce()
+{
+    // no hedging delay, all the candidates are in flight and answered at about the same time
+    TestFailoverContainer *container = makeContainer({ "ok:0", "ok:0", "ok:0" });
+    TestRequest request(this, kRequestTimeout);
+    server_api::HedgedRequestExecuter executer(this, connectStateController_, networkAccessManager_, container, 0);
+    QSignalSpy spy(&executer, &server_api::HedgedRequestExecuter::finished);
+    executer.execute(&request, true);
+    QVERIFY(waitForSignal(spy, kRunTimeout));
+    QCOMPARE(spy.first().at(0).value<server_api::RequestExecuterRetCode>(), server_api::RequestExecuterRetCode::kSuccess);
+    QCOMPARE(executer.startedCount(), 3);
+    // the other candidates were cancelled before the shared request was handled
+    QTest::qWait(500);
+    QCOMPARE(request.handledCount(), 1);
+    QCOMPARE(request.networkRetCode(), SERVER_RETURN_SUCCESS);
+    delete container;
+}
+
+void HedgedFailover_test::testAllFailed()
+{
+    TestFailoverContainer *container = makeContainer({ "fail:0", "broken:0", "fail:200", "broken:100" });
+    TestRequest request(this, kRequestTimeout);
+    server_api::HedgedRequestExecuter executer(this, connectStateController_, networkAccessManager_, container, 50, 2);
+    QSignalSpy spy(&executer, &server_api::HedgedRequestExecuter::finished);
+    executer.execute(&request, true);
+    QVERIFY(waitForSignal(spy, kRunTimeout));
+    QCOMPARE(spy.first().at(0).value<server_api::RequestExecuterRetCode>(), server_api::RequestExecuterRetCode::kFailoverFailed);
+    QCOMPARE(executer.startedCount(), container->count());
+    delete container;
+}
+
+void HedgedFailover_test::testRequestDeleted()
+{
+    TestFailoverContainer *container = makeContainer({ "slow:0", "slow:0", "slow:0" });
+    TestRequest *request = new TestRequest(this, kRequestTimeout);
+    server_api::HedgedRequestExecuter executer(this, connectStateController_, networkAccessManager_, container, 100);
+    QSignalSpy spy(&executer, &server_api::HedgedRequestExecuter::finished);
+    executer.execute(request, true);
+    QTest::qWait(500);
+    delete request;
+    QVERIFY(waitForSignal(spy, kRunTimeout));
+    QCOMPARE(spy.first().at(0).value<server_api::RequestExecuterRetCode>(), server_api::RequestExecuterRetCode::kRequestDeleted);
+    delete container;
+}
+
+void HedgedFailover_test::testCancelledFailoverRun()
+{
+    TestFailoverContainer *container = makeContainer({ "ok:300" });
+    TestRequest request(this, kRequestTimeout);
+
+    // the first executer is cancelled while the failover is still in progress
+    server_api::RequestExecuterViaFailover *cancelled = new server_api::RequestExecuterViaFailover(this, connectStateController_, networkAccessManager_);
+    cancelled->execute(&request, container->currentFailover(), true);
+    QTest::qWait(100);
+    delete cancelled;
+
+    // the same failover is reused, the result of the cancelled run doesn't reach the new executer
+    server_api::RequestExecuterViaFailover executer(this, connectStateController_, networkAccessManager_);
+    QSignalSpy spy(&executer, &server_api::RequestExecuterViaFailover::finished);
+    executer.execute(&request, container->currentFailover(), true);
+    QVERIFY(waitForSignal(spy, kRunTimeout));
+    QTest::qWait(500);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.first().at(0).value<server_api::RequestExecuterRetCode>(), server_api::RequestExecuterRetCode::kSuccess);
+    QCOMPARE(okServer_->requestsCount(), 1);
+    delete container;
+}
+
+void HedgedFailover_test::testTimeToFirstSuccess_data()
+{
+    QTest::addColumn<QStringList>("candidates");
+    QTest::addColumn<int>("hedgeDelayMs");
+
+    // the primary domain works
+    QTest::newRow("open network") << QStringList{ "ok:0", "ok:0", "ok:300" } << 250;
+    // the first domains are blackholed, the later failovers work
+    QTest::newRow("censored network") << QStringList{ "slow:0", "slow:0", "fail:1000", "broken:0", "ok:300" } << 250;
+    // everything slow except the last one
+    QTest::newRow("mostly blackholed") << QStringList{ "slow:0", "slow:0", "slow:0", "slow:0", "slow:0", "ok:0" } << 100;
+    // no hedging delay, the candidates are started right away up to the limit
+    QTest::newRow("censored network, no delay") << QStringList{ "slow:0", "slow:0", "fail:1000", "broken:0", "ok:300" } << 0;
+}
+
+void HedgedFailover_test::testTimeToFirstSuccess()
+{
+    QFETCH(QStringList, candidates);
+    QFETCH(int, hedgeDelayMs);
+
+    TestFailoverContainer *container = makeContainer(candidates);
+    const qint64 sequentialMs = runSequential(container);
+    container->reset();
+    const qint64 hedgedMs = runHedged(container, hedgeDelayMs);
+    delete container;
+
+    qDebug() << "time to first success: sequential" << sequentialMs << "ms, hedged" << hedgedMs << "ms";
+    QVERIFY(sequentialMs >= 0);
+    QVERIFY(hedgedMs >= 0);
+    // allow some jitter for the case where the first candidate wins in both modes
+    QVERIFY2(hedgedMs <= sequentialMs + 100, qPrintable(QString("sequential = %1 ms, hedged = %2 ms").arg(sequentialMs).arg(hedgedMs)));
+}
+
+TestFailoverContainer *HedgedFailover_test::makeContainer(const QStringList &candidates)
+{
+    TestFailoverContainer *container = new TestFailoverContainer(nullptr);
+    for (int i = 0; i < candidates.size(); ++i) {
+        const QStringList parts = candidates[i].split(':');
+        const QString kind = parts[0];
+        const int delayMs = parts.size() > 1 ? parts[1].toInt() : 0;
+
+        QString domain;
+        if (kind == "ok")
+            domain = QString("127.0.0.1:%1").arg(okServer_->serverPort());
+        else if (kind == "slow")
+            domain = QString("127.0.0.1:%1").arg(slowServer_->serverPort());
+        else if (kind == "broken")
+            domain = QString("127.0.0.1:%1").arg(brokenServer_->serverPort());
+
+        container->add(QSharedPointer<failover::BaseFailover>(new TestFailover(nullptr, QString("%1:%2").arg(i).arg(kind), domain, delayMs)));
+    }
+    return container;
+}
+
+qint64 HedgedFailover_test::runSequential(failover::IFailoverContainer *container)
+{
+    // the same walk as ServerAPI does without the hedged mode
+    TestRequest request(this, kRequestTimeout);
+    QElapsedTimer timer;
+    timer.start();
+    while (true) {
+        server_api::RequestExecuterViaFailover executer(this, connectStateController_, networkAccessManager_);
+        QSignalSpy spy(&executer, &server_api::RequestExecuterViaFailover::finished);
+        executer.execute(&request, container->currentFailover(), true);
+        if (!waitForSignal(spy, kRunTimeout)) {
+            return -1;
+        }
+        if (spy.first().at(0).value<server_api::RequestExecuterRetCode>() == server_api::RequestExecuterRetCode::kSuccess) {
+            return timer.elapsed();
+        }
+        if (!container->gotoNext()) {
+            return -1;
+        }
+    }
+}
+
+qint64 HedgedFailover_test::runHedged(failover::IFailoverContainer *container, int hedgeDelayMs, QString *outWinnerId)
+{
+    TestRequest request(this, kRequestTimeout);
+    server_api::HedgedRequestExecuter executer(this, connectStateController_, networkAccessManager_, container, hedgeDelayMs);
+    QSignalSpy spy(&executer, &server_api::HedgedRequestExecuter::finished);
+    executer.execute(&request, true);
+    if (!waitForSignal(spy, kRunTimeout)) {
+        return -1;
+    }
+    if (spy.first().at(0).value<server_api::RequestExecuterRetCode>() != server_api::RequestExecuterRetCode::kSuccess) {
+        return -1;
+    }
+    if (outWinnerId) {
+        *outWinnerId = executer.failoverUniqueId();
+    }
+    return executer.elapsedMs();
+}
+
+QTEST_MAIN(HedgedFailover_test)
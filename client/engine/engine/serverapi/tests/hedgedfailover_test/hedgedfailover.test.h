@@ -0,0 +1,161 @@
+#pragma once
+
+#include <QList>
+#include <QObject>
+#include <QTimer>
+#include <QUrl>
+#include "engine/networkaccessmanager/networkaccessmanager.h"
+#include "engine/connectstatecontroller/iconnectstatecontroller.h"
+#include "engine/failover/ifailovercontainer.h"
+#include "engine/serverapi/requests/baserequest.h"
+
+class TestHttpServer;
+
+class ConnectStateController_moc : public IConnectStateController
+{
+    Q_OBJECT
+public:
+    explicit ConnectStateController_moc(QObject *parent) : IConnectStateController(parent),
+        state_(CONNECT_STATE_DISCONNECTED),
+        prevState_(CONNECT_STATE_DISCONNECTED)
+    {}
+
+    CONNECT_STATE currentState() override {  return state_;  }
+    CONNECT_STATE prevState() override  {  return prevState_; }
+
+    DISCONNECT_REASON disconnectReason() override
+    {
+        return DISCONNECTED_ITSELF;
+    }
+    CONNECT_ERROR connectionError() override  { return NO_CONNECT_ERROR;  }
+    const LocationID& locationId() override  { return lid_;  }
+
+private:
+    LocationID lid_;
+    CONNECT_STATE state_;
+    CONNECT_STATE prevState_;
+};
+
+// Stand-in for a failover: answers the given domain (or fails if it is empty) after an injected delay
+class TestFailover : public failover::BaseFailover
+{
+    Q_OBJECT
+public:
+    explicit TestFailover(QObject *parent, const QString &uniqueId, const QString &domain, int delayMs) : failover::BaseFailover(parent, uniqueId),
+        domain_(domain), delayMs_(delayMs)
+    {}
+
+    void getData(bool /*bIgnoreSslErrors*/) override
+    {
+        const quint64 run = startRun();
+        QTimer::singleShot(delayMs_, this, [this, run]() {
+            if (domain_.isEmpty())
+                emitFinished(run, QVector<failover::FailoverData>());
+            else
+                emitFinished(run, QVector<failover::FailoverData>() << failover::FailoverData(domain_));
+        });
+    }
+
+    QString name() const override { return uniqueId_; }
+
+private:
+    QString domain_;
+    int delayMs_;
+};
+
+class TestFailoverContainer : public failover::IFailoverContainer
+{
+    Q_OBJECT
+public:
+    explicit TestFailoverContainer(QObject *parent) : failover::IFailoverContainer(parent), curInd_(0) {}
+
+    void add(QSharedPointer<failover::BaseFailover> failover) { failovers_ << failover; }
+
+    void reset() override { curInd_ = 0; }
+    QSharedPointer<failover::BaseFailover> currentFailover(int *outInd = nullptr) override
+    {
+        if (outInd)
+            *outInd = curInd_;
+        return failovers_[curInd_];
+    }
+    bool gotoNext() override
+    {
+        if (curInd_ < failovers_.size() - 1) {
+            curInd_++;
+            return true;
+        }
+        return false;
+    }
+    QSharedPointer<failover::BaseFailover> failoverById(const QString &failoverUniqueId) override
+    {
+        for (const auto &failover : failovers_)
+            if (failover->uniqueId() == failoverUniqueId)
+                return failover;
+        return nullptr;
+    }
+    int count() const override { return failovers_.size(); }
+
+private:
+    QVector<QSharedPointer<failover::BaseFailover> > failovers_;
+    int curInd_;
+};
+
+// MyIp-like request that takes the domain with a port, so it can be pointed to the local servers
+class TestRequest : public server_api::BaseRequest
+{
+    Q_OBJECT
+public:
+    explicit TestRequest(QObject *parent, int timeout) : server_api::BaseRequest(parent, server_api::RequestType::kGet, true, timeout) {}
+
+    QUrl url(const QString &domain) const override { return QUrl("https://" + domain + "/MyIp"); }
+    QString name() const override { return "TestMyIp"; }
+    void handle(const QByteArray &arr) override;
+
+    QString ip() const { return ip_; }
+    int handledCount() const { return handledCount_; }
+
+private:
+    QString ip_;
+    int handledCount_ = 0;
+};
+
+
+// Races the failovers against the local stand-in endpoints with injected delays and failures
+// and reports the time to the first success of the sequential and the hedged modes.
+class HedgedFailover_test : public QObject
+{
+    Q_OBJECT
+
+public:
+    HedgedFailover_test();
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testFirstSuccessWins();
+    void testNoHedgingIfFirstIsFast();
+    void testResponseHandledOnce();
+    void testAllFailed();
+    void testRequestDeleted();
+    void testCancelledFailoverRun();
+    void testTimeToFirstSuccess_data();
+    void testTimeToFirstSuccess();
+
+private:
+    static constexpr int kRequestTimeout = 2000;
+
+    NetworkAccessManager *networkAccessManager_;
+    ConnectStateController_moc *connectStateController_;
+
+    TestHttpServer *okServer_;          // answers the valid response after a short delay
+    TestHttpServer *slowServer_;        // answers after the request timeout, behaves as a blackholed endpoint
+    TestHttpServer *brokenServer_;      // answers an invalid response immediately
+
+    // candidates are described as "<kind>:<failover delay ms>", the kind is one of ok, slow, broken or fail (failover itself failed)
+    TestFailoverContainer *makeContainer(const QStringList &candidates);
+    // returns the time to the first success in ms or -1 if failed
+    qint64 runSequential(failover::IFailoverContainer *container);
+    qint64 runHedged(failover::IFailoverContainer *container, int hedgeDelayMs, QString *outWinnerId = nullptr);
+};
@@ -0,0 +1,316 @@
+#include "mockapi.test.h"
+
+#include <QtTest>
+#include <QElapsedTimer>
+#ifdef Q_OS_WIN
+#include <WinSock2.h>
+#endif
+
+#include "engine/apiresources/apiresourcesmanager.h"
+#include "engine/serverapi/responsecache.h"
+#include "engine/serverapi/requests/portmaprequest.h"
+#include "engine/serverapi/requests/serverlistrequest.h"
+#include "engine/serverapi/requests/sessionrequest.h"
+#include "engine/serverapi/requests/wgconfigsconnectrequest.h"
+#include "engine/serverapi/requests/wgconfigsinitrequest.h"
+#include "../common/mockapiserver.h"
+
+MockApi_test::MockApi_test() : connectStateController_(nullptr), networkDetectionManager_(nullptr), networkAccessManager_(nullptr),
+    server_(nullptr)
+{
+#ifdef Q_OS_WIN
+    // Initialize Winsock
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2,2), &wsaData);
+#endif
+}
+
+void MockApi_test::initTestCase()
+{
+    // ApiResourcesManager and ServerAPI keep the state in the settings, don't touch the ones of the app
+    QCoreApplication::setOrganizationName("WindscribeTests");
+    QCoreApplication::setApplicationName("mockapi.test");
+    QVERIFY(tempDir_.isValid());
+    server_api::ResponseCache::instance().setFilePath(tempDir_.filePath("apicache.dat"));
+
+    server_ = new MockApiServer(this);
+    QVERIFY(server_->start());
+}
+
+void MockApi_test::init()
+{
+    api_resources::ApiResourcesManager::removeFromSettings();
+    QSettings().clear();
+    connectStateController_ = new ConnectStateController_moc(this);
+    networkDetectionManager_ = new NetworkDetectionManager_moc(this);
+    networkAccessManager_ = new NetworkAccessManager(this);
+    server_->resetScripts();
+    server_->resetCounters();
+    server_->setLocationsCount(20);
+    server_->setStaticIpsCount(0);
+}
+
+void MockApi_test::cleanup()
+{
+    delete networkAccessManager_;
+    delete networkDetectionManager_;
+    delete connectStateController_;
+}
+
+void MockApi_test::testLoginToConnectConfig()
+{
+    server_->setStaticIpsCount(2);
+    QScopedPointer<server_api::ServerAPI> serverAPI(createServerAPI(QStringList() << server_->domain()));
+
+    api_resources::ApiResourcesManager manager(nullptr, serverAPI.get(), connectStateController_, networkDetectionManager_);
+    QSignalSpy readySpy(&manager, &api_resources::ApiResourcesManager::readyForLogin);
+    QElapsedTimer timer;
+    timer.start();
+    manager.login(server_->username(), server_->password(), "");
+    QVERIFY(readySpy.wait(kTimeoutMs));
+    const qint64 loginMs = timer.elapsed();
+
+    QCOMPARE(manager.authHash(), server_->authHash());
+    QVERIFY(manager.sessionStatus().isPremium());
+    QCOMPARE(manager.locations().size(), server_->locationsCount());
+    QCOMPARE(manager.portMap().getPortItemCount(), 6);
+    QCOMPARE(manager.staticIps().getIpsCount(), 2);
+    QVERIFY(manager.serverCredentials().isInitialized());
+    QVERIFY(manager.ovpnConfig().startsWith("client"));
+
+    // the connection config of WireGuard
+    timer.restart();
+    QSharedPointer<server_api::WgConfigsInitRequest> initRequest(static_cast<server_api::WgConfigsInitRequest *>(
+        serverAPI->wgConfigsInit(manager.authHash(), "Y2xpZW50cHVibGlja2V5Y2xpZW50cHVibGlja2V5Y2w=", false)), &QObject::deleteLater);
+    QVERIFY(waitFinished(initRequest.get()));
+    QCOMPARE(initRequest->networkRetCode(), SERVER_RETURN_SUCCESS);
+    QVERIFY(!initRequest->presharedKey().isEmpty());
+    QCOMPARE(initRequest->allowedIps(), QString("0.0.0.0/0"));
+
+    QSharedPointer<server_api::WgConfigsConnectRequest> connectRequest(static_cast<server_api::WgConfigsConnectRequest *>(
+        serverAPI->wgConfigsConnect(manager.authHash(), "Y2xpZW50cHVibGlja2V5Y2xpZW50cHVibGlja2V5Y2w=", "node1.windscribe.example", "")),
+        &QObject::deleteLater);
+    QVERIFY(waitFinished(connectRequest.get()));
+    QCOMPARE(connectRequest->networkRetCode(), SERVER_RETURN_SUCCESS);
+    QVERIFY(connectRequest->ipAddress().startsWith("100.64.0."));
+    const qint64 wgConfigsMs = timer.elapsed();
+
+    qDebug() << "login to readyForLogin:" << loginMs << "ms, WireGuard config:" << wgConfigsMs << "ms,"
+             << server_->requestsCount() << "requests over" << server_->connectionsCount() << "connections," << server_->bytesSent() << "bytes";
+
+    QCOMPARE(server_->requestsCount(MockApiServer::Endpoint::kLogin), 1);
+    QCOMPARE(server_->requestsCount(MockApiServer::Endpoint::kServerList), 1);
+    QCOMPARE(server_->requestsCount(MockApiServer::Endpoint::kServerCredentials), 2);
+    QCOMPARE(server_->requestsCount(MockApiServer::Endpoint::kServerConfigs), 1);
+    QCOMPARE(server_->requestsCount(MockApiServer::Endpoint::kPortMap), 1);
+    QCOMPARE(server_->requestsCount(MockApiServer::Endpoint::kStaticIps), 1);
+    QCOMPARE(server_->requestsCount(MockApiServer::Endpoint::kWgConfigsInit), 1);
+    QCOMPARE(server_->requestsCount(MockApiServer::Endpoint::kWgConfigsConnect), 1);
+    QCOMPARE(server_->requestsCount(MockApiServer::Endpoint::kUnknown), 0);
+}
+
+void MockApi_test::testLoginFailed()
+{
+    QScopedPointer<server_api::ServerAPI> serverAPI(createServerAPI(QStringList() << server_->domain()));
+
+    api_resources::ApiResourcesManager manager(nullptr, serverAPI.get(), connectStateController_, networkDetectionManager_);
+    QSignalSpy failedSpy(&manager, &api_resources::ApiResourcesManager::loginFailed);
+    manager.login(server_->username(), "wrongpassword", "");
+    QVERIFY(failedSpy.wait(kTimeoutMs));
+    QCOMPARE(failedSpy.first().at(0).value<LOGIN_RET>(), LOGIN_RET_BAD_USERNAME);
+    // nothing else is fetched
+    QTest::qWait(200);
+    QCOMPARE(server_->requestsCount(), 1);
+}
+
+void MockApi_test::testFailoverChain()
+{
+    // the first domain is behind a broken reverse proxy, the second one does not answer at all
+    MockApiServer brokenServer;
+    MockApiServer::Script script;
+    script.statusCode = 503;
+    brokenServer.setScriptForAll(script);
+    QVERIFY(brokenServer.start());
+    QTcpServer closedPort;
+    QVERIFY(closedPort.listen(QHostAddress::LocalHost, 0));
+    const QString closedDomain = "127.0.0.1:" + QString::number(closedPort.serverPort());
+    closedPort.close();
+
+    QScopedPointer<server_api::ServerAPI> serverAPI(createServerAPI(QStringList() << brokenServer.domain() << closedDomain << server_->domain()));
+    QSignalSpy backupSpy(serverAPI.get(), &server_api::ServerAPI::tryingBackupEndpoint);
+
+    QElapsedTimer timer;
+    timer.start();
+    QVERIFY(login(serverAPI.get()) >= 0);
+    qDebug() << "login via the third failover:" << timer.elapsed() << "ms";
+
+    QCOMPARE(backupSpy.count(), 2);
+    QCOMPARE(brokenServer.requestsCount(MockApiServer::Endpoint::kLogin), 1);
+    // the working domain is used for all the next requests
+    QCOMPARE(brokenServer.requestsCount(), 1);
+    QCOMPARE(server_->requestsCount(MockApiServer::Endpoint::kLogin), 1);
+    QCOMPARE(server_->requestsCount(MockApiServer::Endpoint::kServerList), 1);
+}
+
+void MockApi_test::testScriptedErrors()
+{
+    QScopedPointer<server_api::ServerAPI> serverAPI(createServerAPI(QStringList() << server_->domain()));
+    MockApiServer::Script script;
+
+    // the API error codes
+    script.errorCode = 701;
+    server_->setScript(MockApiServer::Endpoint::kSession, script);
+    QSharedPointer<server_api::SessionRequest> sessionRequest(static_cast<server_api::SessionRequest *>(serverAPI->session(server_->authHash())),
+                                                              &QObject::deleteLater);
+    QVERIFY(waitFinished(sessionRequest.get()));
+    QCOMPARE(sessionRequest->networkRetCode(), SERVER_RETURN_SUCCESS);
+    QCOMPARE(sessionRequest->sessionErrorCode(), server_api::SessionErrorCode::kSessionInvalid);
+
+    // the unknown auth hash is rejected as the API does
+    server_->resetScripts();
+    sessionRequest.reset(static_cast<server_api::SessionRequest *>(serverAPI->session("unknownhash")), &QObject::deleteLater);
+    QVERIFY(waitFinished(sessionRequest.get()));
+    QCOMPARE(sessionRequest->sessionErrorCode(), server_api::SessionErrorCode::kSessionInvalid);
+
+    // the error for the first request only
+    script.errorCode = 1310;
+    script.times = 1;
+    server_->setScript(MockApiServer::Endpoint::kWgConfigsInit, script);
+    for (int i = 0; i < 2; ++i) {
+        QSharedPointer<server_api::WgConfigsInitRequest> request(static_cast<server_api::WgConfigsInitRequest *>(
+            serverAPI->wgConfigsInit(server_->authHash(), "pubkey=", false)), &QObject::deleteLater);
+        QVERIFY(waitFinished(request.get()));
+        QCOMPARE(request->isErrorCode(), i == 0);
+        if (i == 0)
+            QCOMPARE(request->errorCode(), 1310);
+        else
+            QVERIFY(!request->presharedKey().isEmpty());
+    }
+
+    // the truncated JSON, the HTML error page and the dropped connection
+    script = MockApiServer::Script();
+    script.isInvalidJson = true;
+    server_->setScript(MockApiServer::Endpoint::kPortMap, script);
+    script = MockApiServer::Script();
+    script.statusCode = 500;
+    server_->setScript(MockApiServer::Endpoint::kServerList, script);
+    script = MockApiServer::Script();
+    script.closeConnection = true;
+    script.isInvalidJson = true;
+    server_->setScript(MockApiServer::Endpoint::kNotifications, script);
+
+    QSharedPointer<server_api::BaseRequest> portMapRequest(serverAPI->portMap(server_->authHash()), &QObject::deleteLater);
+    QSharedPointer<server_api::BaseRequest> serverListRequest(serverAPI->serverLocations("en", "", true, QStringList()), &QObject::deleteLater);
+    QSharedPointer<server_api::BaseRequest> notificationsRequest(serverAPI->notifications(server_->authHash()), &QObject::deleteLater);
+    QVERIFY(waitFinished(portMapRequest.get()));
+    QVERIFY(waitFinished(serverListRequest.get()));
+    QVERIFY(waitFinished(notificationsRequest.get()));
+    QCOMPARE(portMapRequest->networkRetCode(), SERVER_RETURN_INCORRECT_JSON);
+    QCOMPARE(serverListRequest->networkRetCode(), SERVER_RETURN_INCORRECT_JSON);
+    QCOMPARE(notificationsRequest->networkRetCode(), SERVER_RETURN_INCORRECT_JSON);
+}
+
+void MockApi_test::testLatency()
+{
+    const int kDelayMs = 300;
+    QScopedPointer<server_api::ServerAPI> serverAPI(createServerAPI(QStringList() << server_->domain()));
+
+    // detect the failover first
+    QSharedPointer<server_api::BaseRequest> sessionRequest(serverAPI->session(server_->authHash()), &QObject::deleteLater);
+    QVERIFY(waitFinished(sessionRequest.get()));
+
+    MockApiServer::Script script;
+    script.delayMs = kDelayMs;
+    server_->setScript(MockApiServer::Endpoint::kServerList, script);
+
+    QElapsedTimer timer;
+    timer.start();
+    QSharedPointer<server_api::BaseRequest> serverListRequest(serverAPI->serverLocations("en", "", true, QStringList()), &QObject::deleteLater);
+    QSharedPointer<server_api::BaseRequest> portMapRequest(serverAPI->portMap(server_->authHash()), &QObject::deleteLater);
+    QVERIFY(waitFinished(portMapRequest.get()));
+    const qint64 portMapMs = timer.elapsed();
+    QVERIFY(waitFinished(serverListRequest.get()));
+    const qint64 serverListMs = timer.elapsed();
+    qDebug() << "delayed server list:" << serverListMs << "ms, port map in parallel:" << portMapMs << "ms";
+
+    QCOMPARE(serverListRequest->networkRetCode(), SERVER_RETURN_SUCCESS);
+    QCOMPARE(portMapRequest->networkRetCode(), SERVER_RETURN_SUCCESS);
+    QVERIFY(serverListMs >= kDelayMs * 9 / 10);
+    // the delay of one endpoint doesn't hold the others
+    QVERIFY(portMapMs < kDelayMs);
+}
+
+void MockApi_test::testPayloadSizes()
+{
+    for (int locationsCount : { 10, 100, 1000 }) {
+        api_resources::ApiResourcesManager::removeFromSettings();
+        server_->setLocationsCount(locationsCount);
+        server_->resetCounters();
+        QScopedPointer<server_api::ServerAPI> serverAPI(createServerAPI(QStringList() << server_->domain()));
+
+        int receivedCount = 0;
+        const qint64 elapsedMs = login(serverAPI.get(), &receivedCount);
+        QVERIFY(elapsedMs >= 0);
+        QCOMPARE(receivedCount, locationsCount);
+        qDebug() << locationsCount << "locations," << server_->nodesCount() << "nodes:" << elapsedMs << "ms from the login to readyForLogin,"
+                 << server_->bytesSent() << "bytes";
+    }
+
+    // the padded responses are still parsed
+    const int kPaddingBytes = 1024 * 1024;
+    MockApiServer::Script script;
+    script.paddingBytes = kPaddingBytes;
+    server_->setScript(MockApiServer::Endpoint::kPortMap, script);
+    server_->setScript(MockApiServer::Endpoint::kServerConfigs, script);
+    server_->resetCounters();
+    QScopedPointer<server_api::ServerAPI> serverAPI(createServerAPI(QStringList() << server_->domain()));
+
+    QElapsedTimer timer;
+    timer.start();
+    QSharedPointer<server_api::PortMapRequest> portMapRequest(static_cast<server_api::PortMapRequest *>(serverAPI->portMap(server_->authHash())),
+                                                              &QObject::deleteLater);
+    QSharedPointer<server_api::BaseRequest> serverConfigsRequest(serverAPI->serverConfigs(server_->authHash()), &QObject::deleteLater);
+    QVERIFY(waitFinished(portMapRequest.get()));
+    QVERIFY(waitFinished(serverConfigsRequest.get()));
+    qDebug() << "two padded responses:" << timer.elapsed() << "ms," << server_->bytesSent() << "bytes";
+
+    QCOMPARE(portMapRequest->networkRetCode(), SERVER_RETURN_SUCCESS);
+    QCOMPARE(portMapRequest->portMap().getPortItemCount(), 6);
+    QCOMPARE(serverConfigsRequest->networkRetCode(), SERVER_RETURN_SUCCESS);
+    QVERIFY(server_->bytesSent() > 2 * kPaddingBytes);
+}
+
+server_api::ServerAPI *MockApi_test::createServerAPI(const QStringList &domains)
+{
+    server_api::ServerAPI *serverAPI = new server_api::ServerAPI(nullptr, connectStateController_, networkAccessManager_, networkDetectionManager_,
+                                                                 new FailoverContainer_moc(nullptr, domains));
+    // the self-signed certificate of the local server
+    serverAPI->setIgnoreSslErrors(true);
+    return serverAPI;
+}
+
+qint64 MockApi_test::login(server_api::ServerAPI *serverAPI, int *outLocationsCount)
+{
+    api_resources::ApiResourcesManager manager(nullptr, serverAPI, connectStateController_, networkDetectionManager_);
+    QSignalSpy readySpy(&manager, &api_resources::ApiResourcesManager::readyForLogin);
+    QSignalSpy failedSpy(&manager, &api_resources::ApiResourcesManager::loginFailed);
+
+    QElapsedTimer timer;
+    timer.start();
+    manager.login(server_->username(), server_->password(), "");
+    QTest::qWaitFor([&]() { return !readySpy.isEmpty() || !failedSpy.isEmpty(); }, kTimeoutMs);
+    if (readySpy.isEmpty())
+        return -1;
+
+    if (outLocationsCount)
+        *outLocationsCount = manager.locations().size();
+    return timer.elapsed();
+}
+
+bool MockApi_test::waitFinished(server_api::BaseRequest *request)
+{
+    QSignalSpy spy(request, &server_api::BaseRequest::finished);
+    return spy.wait(kTimeoutMs);
+}
+
+QTEST_MAIN(MockApi_test)
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <QObject>
+#include <QTemporaryDir>
+#include "engine/connectstatecontroller/iconnectstatecontroller.h"
+#include "engine/networkdetectionmanager/inetworkdetectionmanager.h"
+#include "engine/serverapi/serverapi.h"
+#include "engine/networkaccessmanager/networkaccessmanager.h"
+#include "engine/failover/ifailovercontainer.h"
+
+class MockApiServer;
+
+class ConnectStateController_moc : public IConnectStateController
+{
+    Q_OBJECT
+public:
+    explicit ConnectStateController_moc(QObject *parent) : IConnectStateController(parent) {}
+
+    CONNECT_STATE currentState() override { return CONNECT_STATE_DISCONNECTED; }
+    CONNECT_STATE prevState() override { return CONNECT_STATE_DISCONNECTED; }
+    DISCONNECT_REASON disconnectReason() override { return DISCONNECTED_ITSELF; }
+    CONNECT_ERROR connectionError() override { return NO_CONNECT_ERROR; }
+    const LocationID& locationId() override { return lid_; }
+
+private:
+    LocationID lid_;
+};
+
+class NetworkDetectionManager_moc : public INetworkDetectionManager
+{
+    Q_OBJECT
+public:
+    explicit NetworkDetectionManager_moc(QObject *parent) : INetworkDetectionManager(parent) {}
+    void getCurrentNetworkInterface(types::NetworkInterface &networkInterface) override {}
+    bool isOnline() override { return true; }
+};
+
+class Failover_moc : public failover::BaseFailover
+{
+    Q_OBJECT
+public:
+    explicit Failover_moc(QObject *parent, const QString &domain) : failover::BaseFailover(parent, "id_" + domain), domain_(domain) {}
+
+    void getData(bool /*bIgnoreSslErrors*/) override
+    {
+        emit finished(QVector<failover::FailoverData>() << failover::FailoverData(domain_));
+    }
+    QString name() const override { return "failoverName: " + domain_; }
+
+private:
+    QString domain_;
+};
+
+// Ordered failovers, each of them gives one domain
+class FailoverContainer_moc : public failover::IFailoverContainer
+{
+    Q_OBJECT
+public:
+    explicit FailoverContainer_moc(QObject *parent, const QStringList &domains) : IFailoverContainer(parent), domains_(domains), curFailoverInd_(0)
+    {
+        reset();
+    }
+
+    void reset() override
+    {
+        curFailoverInd_ = 0;
+        currentFailover_ = QSharedPointer<failover::BaseFailover>(new Failover_moc(this, domains_[curFailoverInd_]));
+    }
+
+    QSharedPointer<failover::BaseFailover> currentFailover(int *outInd = nullptr) override
+    {
+        if (outInd)
+            *outInd = curFailoverInd_;
+        return currentFailover_;
+    }
+
+    bool gotoNext() override
+    {
+        if (curFailoverInd_ >= domains_.size() - 1)
+            return false;
+        curFailoverInd_++;
+        currentFailover_ = QSharedPointer<failover::BaseFailover>(new Failover_moc(this, domains_[curFailoverInd_]));
+        return true;
+    }
+
+    QSharedPointer<failover::BaseFailover> failoverById(const QString & /*failoverUniqueId*/) override { return nullptr; }
+    int count() const override { return domains_.count(); }
+
+private:
+    QStringList domains_;
+    int curFailoverInd_;
+    QSharedPointer<failover::BaseFailover> currentFailover_;
+};
+
+
+// Offline integration tests and benchmarks of ServerAPI, ApiResourcesManager and the failover chain against the local
+// stand-in API server (MockApiServer): the full login-to-connect-config flow, the scripted errors, latency and payload sizes.
+class MockApi_test : public QObject
+{
+    Q_OBJECT
+
+public:
+    MockApi_test();
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testLoginToConnectConfig();
+    void testLoginFailed();
+    void testFailoverChain();
+    void testScriptedErrors();
+    void testLatency();
+    void testPayloadSizes();
+
+private:
+    static constexpr int kTimeoutMs = 20000;
+
+    QTemporaryDir tempDir_;
+    ConnectStateController_moc *connectStateController_;
+    NetworkDetectionManager_moc *networkDetectionManager_;
+    NetworkAccessManager *networkAccessManager_;
+    MockApiServer *server_;
+
+    server_api::ServerAPI *createServerAPI(const QStringList &domains);
+    // returns the elapsed time from the login to readyForLogin or -1 if it failed
+    qint64 login(server_api::ServerAPI *serverAPI, int *outLocationsCount = nullptr);
+    // waits for the request to finish, returns false on timeout
+    static bool waitFinished(server_api::BaseRequest *request);
+};
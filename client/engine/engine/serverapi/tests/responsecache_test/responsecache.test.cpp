@@ -0,0 +1,283 @@
+#include "responsecache.test.h"
+
+#include <QtTest>
+#include <QDateTime>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QUrlQuery>
+#ifdef Q_OS_WIN
+#include <WinSock2.h>
+#endif
+
+#include "engine/serverapi/requestexecuterviafailover.h"
+#include "engine/serverapi/responsecache.h"
+#include "../../../networkaccessmanager/tests/common/testhttpserver.h"
+
+int TestResourceRequest::parseCount = 0;
+
+QUrl TestResourceRequest::url(const QString &domain) const
+{
+    QUrl url("https://" + domain + "/PortMap");
+    QUrlQuery query;
+    query.addQueryItem("version", "6");
+    query.addQueryItem("session_auth_hash", authHash_);
+    // the volatile items as urlquery_utils::addAuthQueryItems() adds them
+    query.addQueryItem("time", QString::number(QDateTime::currentMSecsSinceEpoch()));
+    query.addQueryItem("client_auth_hash", QString::number(QRandomGenerator::global()->generate()));
+    url.setQuery(query);
+    return url;
+}
+
+void TestResourceRequest::handle(const QByteArray &arr)
+{
+    parseCount++;
+    QJsonParseError errCode;
+    QJsonDocument doc = QJsonDocument::fromJson(arr, &errCode);
+    if (errCode.error != QJsonParseError::NoError || !doc.isObject() || !doc.object().contains("data")) {
+        setNetworkRetCode(SERVER_RETURN_INCORRECT_JSON);
+        return;
+    }
+    itemsCount_ = doc.object()["data"].toObject()["portmap"].toArray().size();
+}
+
+ResponseCache_test::ResponseCache_test() : networkAccessManager_(nullptr), connectStateController_(nullptr), server_(nullptr),
+    notModifiedCount_(0)
+{
+#ifdef Q_OS_WIN
+    // Initialize Winsock
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2,2), &wsaData);
+#endif
+}
+
+void ResponseCache_test::initTestCase()
+{
+    QVERIFY(tempDir_.isValid());
+
+    server_ = new TestHttpServer(this, true);
+    server_->setHandler([this](const TestHttpServer::Request &request) {
+        TestHttpServer::Response response;
+        if (!etag_.isEmpty())
+            response.headers << qMakePair(QByteArray("ETag"), etag_);
+        if (!lastModified_.isEmpty())
+            response.headers << qMakePair(QByteArray("Last-Modified"), lastModified_);
+
+        // If-None-Match takes precedence over If-Modified-Since
+        bool isNotModified = false;
+        if (request.headers.contains("if-none-match"))
+            isNotModified = !etag_.isEmpty() && request.headers.value("if-none-match") == etag_;
+        else if (request.headers.contains("if-modified-since"))
+            isNotModified = !lastModified_.isEmpty() && request.headers.value("if-modified-since") == lastModified_;
+
+        if (isNotModified) {
+            response.statusCode = 304;
+            notModifiedCount_++;
+        } else {
+            response.body = body_;
+        }
+        return response;
+    });
+    QVERIFY(server_->start());
+}
+
+void ResponseCache_test::init()
+{
+    networkAccessManager_ = new NetworkAccessManager(this);
+    connectStateController_ = new ConnectStateController_moc(this);
+    server_->resetCounters();
+    notModifiedCount_ = 0;
+    TestResourceRequest::parseCount = 0;
+    server_api::ResponseCache::instance().setFilePath(tempDir_.filePath("apicache.dat"));
+    server_api::ResponseCache::instance().clear();
+}
+
+void ResponseCache_test::cleanup()
+{
+    delete networkAccessManager_;
+    delete connectStateController_;
+}
+
+void ResponseCache_test::testValidators()
+{
+    server_api::ResponseCache cache(tempDir_.filePath("validators.dat"));
+    server_api::ResponseCache::Validators v;
+    v.etag = "\"v1\"";
+    cache.store("PortMap", QUrl("https://api.example.com/PortMap?version=6&session_auth_hash=a&time=1&client_auth_hash=x"), v);
+
+    // another failover domain and another timestamp, the same request
+    QCOMPARE(cache.validators("PortMap", QUrl("https://backup.example.org/PortMap?version=6&session_auth_hash=a&time=2&client_auth_hash=y")).etag,
+             QByteArray("\"v1\""));
+    // another user or another resource
+    QVERIFY(cache.validators("PortMap", QUrl("https://api.example.com/PortMap?version=6&session_auth_hash=b&time=1&client_auth_hash=x")).isEmpty());
+    QVERIFY(cache.validators("StaticIps", QUrl("https://api.example.com/PortMap?version=6&session_auth_hash=a&time=1&client_auth_hash=x")).isEmpty());
+
+    // one entry per slot, the latest request wins
+    v.etag = "\"v2\"";
+    cache.store("PortMap", QUrl("https://api.example.com/PortMap?version=6&session_auth_hash=b"), v);
+    QVERIFY(cache.validators("PortMap", QUrl("https://api.example.com/PortMap?version=6&session_auth_hash=a")).isEmpty());
+    QCOMPARE(cache.validators("PortMap", QUrl("https://api.example.com/PortMap?version=6&session_auth_hash=b")).etag, QByteArray("\"v2\""));
+
+    cache.remove("PortMap");
+    QVERIFY(cache.validators("PortMap", QUrl("https://api.example.com/PortMap?version=6&session_auth_hash=b")).isEmpty());
+}
+
+void ResponseCache_test::testPersistence()
+{
+    const QString filePath = tempDir_.filePath("persistence.dat");
+    const QUrl url("https://api.example.com/ServerCredentials?type=ikev2&session_auth_hash=a&time=1&client_auth_hash=x");
+    {
+        server_api::ResponseCache cache(filePath);
+        server_api::ResponseCache::Validators v;
+        v.etag = "W/\"abc\"";
+        v.lastModified = "Wed, 21 Oct 2015 07:28:00 GMT";
+        cache.store("ServerCredentials/ikev2", url, v);
+    }
+
+    {
+        server_api::ResponseCache cache(filePath);
+        const server_api::ResponseCache::Validators v = cache.validators("ServerCredentials/ikev2", url);
+        QCOMPARE(v.etag, QByteArray("W/\"abc\""));
+        QCOMPARE(v.lastModified, QByteArray("Wed, 21 Oct 2015 07:28:00 GMT"));
+    }
+
+    // the auth hash is not stored as is
+    QFile file(filePath);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QByteArray data = file.readAll();
+    file.close();
+    QVERIFY(!data.contains("session_auth_hash"));
+
+    // a truncated file is ignored as a whole
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write(data.left(data.size() - 5));
+    file.close();
+    server_api::ResponseCache cache(filePath);
+    QVERIFY(cache.validators("ServerCredentials/ikev2", url).isEmpty());
+
+    cache.clear();
+    QVERIFY(!QFile::exists(filePath));
+}
+
+void ResponseCache_test::testConditionalRefreshes()
+{
+    setResource("\"rev1\"", QByteArray(), kItemsCount);
+
+    int itemsCount = 0;
+    QVERIFY(refresh(false, nullptr, &itemsCount));
+    QCOMPARE(itemsCount, kItemsCount);
+    const qint64 fullBytes = server_->bytesSent();
+    server_->resetCounters();
+
+    for (int i = 0; i < kRefreshes; ++i) {
+        bool isNotModified = false;
+        QVERIFY(refresh(true, &isNotModified, &itemsCount));
+        QVERIFY(isNotModified);
+        // the caller keeps the data of the previous response
+        QCOMPARE(itemsCount, 0);
+    }
+
+    qDebug() << "full response:" << fullBytes << "bytes," << kRefreshes << "conditional refreshes:" << server_->bytesSent() << "bytes";
+    QCOMPARE(notModifiedCount_, kRefreshes);
+    QCOMPARE(TestResourceRequest::parseCount, 1);
+    // only the status lines and the headers
+    QVERIFY(server_->bytesSent() < fullBytes / 10);
+    QVERIFY(server_->bytesSent() < kRefreshes * 300);
+}
+
+void ResponseCache_test::testResourceChanged()
+{
+    setResource("\"rev1\"", QByteArray(), 10);
+    QVERIFY(refresh(false));
+
+    setResource("\"rev2\"", QByteArray(), 20);
+    bool isNotModified = true;
+    int itemsCount = 0;
+    QVERIFY(refresh(true, &isNotModified, &itemsCount));
+    QVERIFY(!isNotModified);
+    QCOMPARE(itemsCount, 20);
+
+    // the validators of the new revision are stored
+    QVERIFY(refresh(true, &isNotModified));
+    QVERIFY(isNotModified);
+    QCOMPARE(TestResourceRequest::parseCount, 2);
+
+    // the server stopped sending the validators, the entry is removed
+    setResource(QByteArray(), QByteArray(), 30);
+    QVERIFY(refresh(true, &isNotModified));
+    QVERIFY(!isNotModified);
+    QVERIFY(refresh(true, &isNotModified));
+    QVERIFY(!isNotModified);
+    QCOMPARE(TestResourceRequest::parseCount, 4);
+}
+
+void ResponseCache_test::testLastModified()
+{
+    setResource(QByteArray(), "Wed, 21 Oct 2015 07:28:00 GMT", 10);
+    QVERIFY(refresh(false));
+
+    bool isNotModified = false;
+    QVERIFY(refresh(true, &isNotModified));
+    QVERIFY(isNotModified);
+    QCOMPARE(notModifiedCount_, 1);
+    QCOMPARE(TestResourceRequest::parseCount, 1);
+}
+
+void ResponseCache_test::testUnconditionalRequest()
+{
+    setResource("\"rev1\"", QByteArray(), 10);
+    QVERIFY(refresh(false));
+
+    // the validators are stored, but the caller has no data, so they are not sent
+    bool isNotModified = true;
+    int itemsCount = 0;
+    QVERIFY(refresh(false, &isNotModified, &itemsCount));
+    QVERIFY(!isNotModified);
+    QCOMPARE(itemsCount, 10);
+    QCOMPARE(notModifiedCount_, 0);
+    QCOMPARE(TestResourceRequest::parseCount, 2);
+}
+
+void ResponseCache_test::setResource(const QByteArray &etag, const QByteArray &lastModified, int itemsCount)
+{
+    etag_ = etag;
+    lastModified_ = lastModified;
+    QJsonArray portmap;
+    for (int i = 0; i < itemsCount; ++i) {
+        QJsonObject item;
+        item["protocol"] = "udp";
+        item["heading"] = QString("UDP %1").arg(i);
+        item["use"] = "ip";
+        item["ports"] = QJsonArray({ 443, 80, 53, 1194, 54783 });
+        portmap.append(item);
+    }
+    QJsonObject data;
+    data["portmap"] = portmap;
+    QJsonObject root;
+    root["data"] = data;
+    body_ = QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+bool ResponseCache_test::refresh(bool isConditional, bool *outNotModified, int *outItemsCount)
+{
+    TestResourceRequest request(this, "authhash");
+    request.setConditional(isConditional);
+    QSharedPointer<failover::BaseFailover> failover(new TestFailover(nullptr, server_->url().authority()));
+    server_api::RequestExecuterViaFailover executer(this, connectStateController_, networkAccessManager_);
+    QSignalSpy spy(&executer, &server_api::RequestExecuterViaFailover::finished);
+    executer.execute(&request, failover, true);
+    if (spy.isEmpty() && !spy.wait(10000))
+        return false;
+    if (spy.first().at(0).value<server_api::RequestExecuterRetCode>() != server_api::RequestExecuterRetCode::kSuccess)
+        return false;
+
+    if (outNotModified)
+        *outNotModified = request.isNotModified();
+    if (outItemsCount)
+        *outItemsCount = request.itemsCount();
+    return true;
+}
+
+QTEST_MAIN(ResponseCache_test)
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <QObject>
+#include <QTemporaryDir>
+#include "engine/networkaccessmanager/networkaccessmanager.h"
+#include "engine/connectstatecontroller/iconnectstatecontroller.h"
+#include "engine/failover/basefailover.h"
+#include "engine/serverapi/requests/baserequest.h"
+
+class TestHttpServer;
+
+class ConnectStateController_moc : public IConnectStateController
+{
+    Q_OBJECT
+public:
+    explicit ConnectStateController_moc(QObject *parent) : IConnectStateController(parent) {}
+
+    CONNECT_STATE currentState() override { return CONNECT_STATE_DISCONNECTED; }
+    CONNECT_STATE prevState() override { return CONNECT_STATE_DISCONNECTED; }
+    DISCONNECT_REASON disconnectReason() override { return DISCONNECTED_ITSELF; }
+    CONNECT_ERROR connectionError() override { return NO_CONNECT_ERROR; }
+    const LocationID& locationId() override { return lid_; }
+
+private:
+    LocationID lid_;
+};
+
+// Stand-in for a failover: answers the given domain right away
+class TestFailover : public failover::BaseFailover
+{
+    Q_OBJECT
+public:
+    explicit TestFailover(QObject *parent, const QString &domain) : failover::BaseFailover(parent, "test"), domain_(domain) {}
+
+    void getData(bool /*bIgnoreSslErrors*/) override
+    {
+        emit finished(QVector<failover::FailoverData>() << failover::FailoverData(domain_));
+    }
+    QString name() const override { return domain_; }
+
+private:
+    QString domain_;
+};
+
+// PortMap-like cacheable request that takes the domain with a port, so it can be pointed to the local stand-in API server.
+// Counts the parsed responses.
+class TestResourceRequest : public server_api::BaseRequest
+{
+    Q_OBJECT
+public:
+    explicit TestResourceRequest(QObject *parent, const QString &authHash) : server_api::BaseRequest(parent, server_api::RequestType::kGet, true, 5000),
+        authHash_(authHash), itemsCount_(0)
+    {}
+
+    QUrl url(const QString &domain) const override;
+    QString name() const override { return "TestPortMap"; }
+    QString cacheSlot() const override { return name(); }
+    void handle(const QByteArray &arr) override;
+
+    int itemsCount() const { return itemsCount_; }
+
+    static int parseCount;
+
+private:
+    QString authHash_;
+    int itemsCount_;
+};
+
+
+// Refreshes a resource repeatedly from the local stand-in API server answering 304 Not Modified on the matching validators
+// and checks the bytes transferred and the parse counts.
+class ResponseCache_test : public QObject
+{
+    Q_OBJECT
+
+public:
+    ResponseCache_test();
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testValidators();
+    void testPersistence();
+    void testConditionalRefreshes();
+    void testResourceChanged();
+    void testLastModified();
+    void testUnconditionalRequest();
+
+private:
+    static constexpr int kRefreshes = 10;
+    static constexpr int kItemsCount = 2000;
+
+    QTemporaryDir tempDir_;
+    NetworkAccessManager *networkAccessManager_;
+    ConnectStateController_moc *connectStateController_;
+    TestHttpServer *server_;
+
+    // the resource served by the stand-in server, the validators are sent if not empty
+    QByteArray etag_;
+    QByteArray lastModified_;
+    QByteArray body_;
+    int notModifiedCount_;
+
+    void setResource(const QByteArray &etag, const QByteArray &lastModified, int itemsCount);
+    // returns false if the request failed
+    bool refresh(bool isConditional, bool *outNotModified = nullptr, int *outItemsCount = nullptr);
+};
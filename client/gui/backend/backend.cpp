@@ -57,6 +57,9 @@ void Backend::init()
     connect(engine_, &Engine::cleanupFinished, threadEngine_, &QThread::quit);
     connect(threadEngine_, &QThread::finished, this,  &Backend::onEngineCleanupFinished);
     connect(engine_, &Engine::initFinished, this, &Backend::onEngineInitFinished);
+    // the favorites are pinged before the rest of the locations
+    engine_->setFavoriteLocations(locationsModelManager_->favoriteLocations());
+    connect(locationsModelManager_, &gui_locations::LocationsModelManager::favoriteLocationsChanged, engine_, &Engine::setFavoriteLocations, Qt::DirectConnection);
     connect(engine_, &Engine::bfeEnableFinished, this, &Backend::onEngineBfeEnableFinished);
     connect(engine_, &Engine::firewallStateChanged, this, &Backend::onEngineFirewallStateChanged);
     connect(engine_, &Engine::loginFinished, this, &Backend::onEngineLoginFinished);
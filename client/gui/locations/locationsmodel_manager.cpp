@@ -13,6 +13,7 @@ LocationsModelManager::LocationsModelManager(QObject *parent) : QObject(parent)
     connect(&timer_, &QTimer::timeout, this, &LocationsModelManager::onChangeConnectionSpeedTimer);
 
     locationsModel_ = new LocationsModel(this);
+    connect(locationsModel_, &LocationsModel::favoriteLocationsChanged, this, &LocationsModelManager::favoriteLocationsChanged);
     sortedLocationsProxyModel_ = new SortedLocationsProxyModel(this);
     sortedLocationsProxyModel_->setSourceModel(locationsModel_);
     sortedLocationsProxyModel_->sort(0);
@@ -202,6 +203,11 @@ void LocationsModelManager::saveFavoriteLocations()
     locationsModel_->saveFavoriteLocations();
 }
 
+QSet<LocationID> LocationsModelManager::favoriteLocations() const
+{
+    return locationsModel_->favoriteLocations();
+}
+
 void LocationsModelManager::onChangeConnectionSpeedTimer()
 {
     for (QHash<LocationID, PingTime>::const_iterator it = connectionSpeeds_.constBegin(); it != connectionSpeeds_.constEnd(); ++it)
@@ -42,9 +42,11 @@ public:
     void setFilterString(const QString &filterString);
 
     void saveFavoriteLocations();
+    QSet<LocationID> favoriteLocations() const;
 
 signals:
     void deviceNameChanged(const QString &deviceName);
+    void favoriteLocationsChanged(const QSet<LocationID> &favoriteLocations);
 
 private slots:
     void onChangeConnectionSpeedTimer();
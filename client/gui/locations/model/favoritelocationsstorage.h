@@ -14,6 +14,7 @@ public:
     void addToFavorites(const LocationID &locationId);
     void removeFromFavorites(const LocationID &locationId);
     bool isFavorite(const LocationID &locationId) const;
+    const QSet<LocationID> &favoriteLocations() const { return favoriteLocations_; }
 
     void readFromSettings();
     void writeToSettings();
@@ -357,6 +357,7 @@ bool LocationsModel::setData(const QModelIndex &index, const QVariant &value, in
                 favoriteLocationsStorage_.removeFromFavorites(lid);
             }
             emit dataChanged(index, index, QList<int>() << kIsFavorite);
+            emit favoriteLocationsChanged(favoriteLocationsStorage_.favoriteLocations());
             return true;
         }
     }
@@ -457,6 +458,11 @@ QModelIndex LocationsModel::getCustomConfigLocationIndex() const
     return QModelIndex();
 }
 
+QSet<LocationID> LocationsModel::favoriteLocations() const
+{
+    return favoriteLocationsStorage_.favoriteLocations();
+}
+
 void LocationsModel::saveFavoriteLocations()
 {
     favoriteLocationsStorage_.writeToSettings();